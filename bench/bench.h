@@ -0,0 +1,38 @@
+#ifndef MODULE_BENCH_H
+#define MODULE_BENCH_H
+
+#include <stdio.h>
+#include <time.h>
+
+//-------------------------------------------------------------
+// Definitions
+//-------------------------------------------------------------
+
+// Benchmarks are plain executables that print their results, they aren't
+// registered with ctest. clock_gettime needs _POSIX_C_SOURCE defined at the
+// top of the benchmark's source, before any include.
+
+// Repeats the timed body and keeps the fastest run, the usual way to keep
+// the numbers steady on a busy machine
+#define BENCH_REPEATS 10
+
+//-------------------------------------------------------------
+// Prototypes
+//-------------------------------------------------------------
+
+// Written to by every benchmark so the compiler can't drop the work
+static volatile float benchSink;
+
+static inline double benchNow(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static inline void benchReport(const char* name, double seconds, double count, const char* unit)
+{
+    printf("%-40s %10.2f ns/%s %14.0f %s/s\n", name, seconds * 1e9 / count, unit, count / seconds, unit);
+}
+
+#endif // MODULE_BENCH_H
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include "collision.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Triangle soups like the original measurements: small triangles spread
+// through a 100 unit cube, random rays from a slightly larger one
+#define RAY_COUNT 200000
+#define RUNS      5
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static void benchSoup(uint triangles)
+{
+    v3* vertices = malloc(triangles * 3 * sizeof *vertices);
+    uint* indices = malloc(triangles * 3 * sizeof *indices);
+
+    for (uint i = 0; i < triangles; ++i)
+    {
+        v3 c = {randomf() * 50.0f, randomf() * 50.0f, randomf() * 50.0f};
+
+        for (uint k = 0; k < 3; ++k)
+        {
+            vertices[i * 3 + k] = (v3){c.x + randomf(), c.y + randomf(), c.z + randomf()};
+            indices[i * 3 + k] = i * 3 + k;
+        }
+    }
+
+    Ray* rays = malloc(RAY_COUNT * sizeof *rays);
+    BvhHit* hits = malloc(RAY_COUNT * sizeof *hits);
+
+    for (uint i = 0; i < RAY_COUNT; ++i)
+        rays[i] = (Ray){{randomf() * 60.0f, randomf() * 60.0f, randomf() * 60.0f}, {randomf(), randomf(), randomf()}};
+
+    parallelSetThreadCount(1);
+
+    double build = 1e9;
+    for (uint r = 0; r < RUNS; ++r)
+    {
+        double t0 = benchNow();
+        Bvh* bvh = bvhCreate(vertices, indices, triangles);
+        build = fmin(build, benchNow() - t0);
+        bvhDestroy(bvh);
+    }
+
+    Bvh* bvh = bvhCreate(vertices, indices, triangles);
+    if (!bvh)
+        return;
+
+    double closest = 1e9, any = 1e9;
+    for (uint r = 0; r < RUNS; ++r)
+    {
+        uint count = 0;
+
+        double t0 = benchNow();
+        for (uint i = 0; i < RAY_COUNT; ++i)
+            count += bvhRayCast(bvh, rays[i], 1000.0f, &hits[i]);
+
+        double t1 = benchNow();
+        for (uint i = 0; i < RAY_COUNT; ++i)
+            count += bvhRayAny(bvh, rays[i], 1000.0f);
+
+        double t2 = benchNow();
+        closest = fmin(closest, t1 - t0);
+        any     = fmin(any, t2 - t1);
+        benchSink += count;
+    }
+
+    // Every core, the batch splits the rays across threads
+    parallelSetThreadCount(0);
+
+    double batch = 1e9;
+    for (uint r = 0; r < RUNS; ++r)
+    {
+        double t0 = benchNow();
+        bvhRayCastBatch(bvh, rays, 1000.0f, hits, RAY_COUNT);
+        batch = fmin(batch, benchNow() - t0);
+    }
+
+    printf("%u triangles, %u nodes\n", triangles, bvh->nodeCount);
+    printf("  build, one core   %8.1f ms\n", build * 1e3);
+    benchReport("  bvhRayCast, one core", closest, RAY_COUNT, "ray");
+    benchReport("  bvhRayAny, one core", any, RAY_COUNT, "ray");
+
+    char name[64];
+    snprintf(name, sizeof name, "  bvhRayCastBatch, %u threads", parallelThreadCount());
+    benchReport(name, batch, RAY_COUNT, "ray");
+
+    bvhDestroy(bvh);
+    free(vertices);
+    free(indices);
+    free(rays);
+    free(hits);
+}
+
+int main(void)
+{
+    benchSoup(20000);
+    benchSoup(200000);
+    return 0;
+}
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include "animation.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// The setup from the original measurements: 1000 joints, 121 frames at
+// 30 fps, smooth rotations, moving translations on 1 in 10 joints and
+// scales on 1 in 7
+#define JOINT_COUNT 1000
+#define FRAME_COUNT 121
+#define FRAME_RATE  30.0f
+#define TOLERANCE   1e-3f
+#define RUNS        50
+
+static TRS pose(uint joint, float time, float phase)
+{
+    float a = sinf(time * 1.3f + joint * 0.7f + phase) * 1.2f;
+    float b = cosf(time * 0.9f + joint * 0.3f) * 0.8f;
+    quat rotation = quatMul(quatFromAxisAngle((v3){0.0f, 0.0f, 1.0f}, a), quatFromAxisAngle((v3){1.0f, 0.0f, 0.0f}, b));
+
+    v3 translation = joint % 10 == 0 ? (v3){sinf(time) * 2.0f, 0.5f * time, cosf(time * 2.0f)} : (v3){0.0f, 1.0f, 0.0f};
+    v3 scale = joint % 7 == 0 ? (v3){1.0f + 0.2f * sinf(time * 3.0f), 1.0f, 1.0f} : (v3){1.0f, 1.0f, 1.0f};
+
+    return (TRS){translation, rotation, scale};
+}
+
+// Rotations flip hemisphere at random, as exported ones often do
+static TRS* makeFrames(float phase)
+{
+    TRS* frames = malloc(JOINT_COUNT * FRAME_COUNT * sizeof *frames);
+
+    for (uint f = 0; f < FRAME_COUNT; ++f)
+    {
+        for (uint j = 0; j < JOINT_COUNT; ++j)
+        {
+            TRS* t = &frames[f * JOINT_COUNT + j];
+            *t = pose(j, f / FRAME_RATE, phase);
+
+            if (rand() % 2)
+                t->rotation = quatMulf(t->rotation, -1.0f);
+        }
+    }
+
+    return frames;
+}
+
+int main(void)
+{
+    TRS* frames  = makeFrames(0.0f);
+    TRS* frames2 = makeFrames(1.5f);
+    TRS* out     = malloc(JOINT_COUNT * sizeof *out);
+
+    double t0 = benchNow();
+    Clip* clip = clipCreate(frames, JOINT_COUNT, FRAME_COUNT, FRAME_RATE, TOLERANCE);
+    double build = benchNow() - t0;
+
+    Clip* other    = clipCreate(frames2, JOINT_COUNT, FRAME_COUNT, FRAME_RATE, TOLERANCE);
+    Clip* lossless = clipCreate(frames, JOINT_COUNT, FRAME_COUNT, FRAME_RATE, 0.0f);
+
+    if (!clip || !other || !lossless)
+        return 1;
+
+    size_t raw = JOINT_COUNT * FRAME_COUNT * sizeof(TRS);
+    printf("%u joints, %u frames\n", JOINT_COUNT, FRAME_COUNT);
+    printf("  raw TRS           %8zu KB\n", raw / 1024);
+    printf("  tolerance %.0e   %8u KB (%.1fx)\n", TOLERANCE, clipSize(clip) / 1024, (double)raw / clipSize(clip));
+    printf("  tolerance 0       %8u KB (%.1fx)\n", clipSize(lossless) / 1024, (double)raw / clipSize(lossless));
+    printf("  build             %8.1f ms\n", build * 1e3);
+
+    // Random times so the key searches don't always land on the same keys
+    const Clip* clips[2] = {clip, other};
+    float weights[2] = {0.5f, 0.5f};
+    double sample = 1e9, blend = 1e9;
+
+    for (uint r = 0; r < RUNS; ++r)
+    {
+        float time = rand() / (float)RAND_MAX * clip->duration;
+        float times[2] = {time, time * 0.7f};
+
+        double t1 = benchNow();
+        clipSample(clip, time, out);
+
+        double t2 = benchNow();
+        clipBlend(clips, times, weights, 2, out);
+
+        double t3 = benchNow();
+        sample = fmin(sample, t2 - t1);
+        blend  = fmin(blend, t3 - t2);
+        benchSink += out[0].rotation.w;
+    }
+
+    double perThousand = 1000.0 / JOINT_COUNT;
+    printf("Per 1000 bones, one core\n");
+    printf("  clipSample        %8.1f us\n", sample * perThousand * 1e6);
+    printf("  clipBlend of 2    %8.1f us\n", blend * perThousand * 1e6);
+
+    clipDestroy(clip);
+    clipDestroy(other);
+    clipDestroy(lossless);
+    free(frames);
+    free(frames2);
+    free(out);
+    return 0;
+}
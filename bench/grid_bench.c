@@ -0,0 +1,71 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include "collision.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Rects 0.5 to 2.5 units wide on cells of 2, spread so the density stays
+// the same at every count, the setup of the original measurements
+#define CELL_SIZE 2.0f
+#define RUNS      5
+
+static float random01(void)
+{
+    return rand() / (float)RAND_MAX;
+}
+
+static void benchGrid(uint n)
+{
+    float width = sqrtf((float)n) * 4.0f;
+    Rect* rects = malloc(n * sizeof *rects);
+
+    for (uint i = 0; i < n; ++i)
+        rects[i] = (Rect){random01() * width, random01() * width, 0.5f + random01() * 2.0f, 0.5f + random01() * 2.0f};
+
+    Grid* grid = gridCreate(CELL_SIZE);
+
+    // The first build grows the buffers, later ones reuse them like frames do
+    gridBuild(grid, rects, n);
+    gridPairs(grid, NULL);
+
+    double build = 1e9, pairs = 1e9;
+    uint count = 0;
+
+    for (uint r = 0; r < RUNS; ++r)
+    {
+        double t0 = benchNow();
+        gridBuild(grid, rects, n);
+
+        double t1 = benchNow();
+        count = gridPairs(grid, NULL);
+
+        double t2 = benchNow();
+        build = fmin(build, t1 - t0);
+        pairs = fmin(pairs, t2 - t1);
+    }
+
+    printf("%7u objects, %u pairs, %u threads\n", n, count, parallelThreadCount());
+    printf("  gridBuild  %8.2f ms\n", build * 1e3);
+    printf("  gridPairs  %8.2f ms\n", pairs * 1e3);
+
+    gridDestroy(grid);
+    free(rects);
+}
+
+int main(void)
+{
+    uint threads[] = {1, 0};
+
+    for (uint t = 0; t < sizeof threads / sizeof *threads; ++t)
+    {
+        parallelSetThreadCount(threads[t]);
+
+        benchGrid(10000);
+        benchGrid(100000);
+        benchGrid(1000000);
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include "scene.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// 1000 rigs of 100 bones, each bone hanging off one of the four before it so
+// the rigs are chains with short branches
+#define NODE_COUNT 100000
+#define RIG_BONES  100
+#define RUNS       20
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static quat randomQuat(void)
+{
+    return quatNormTo((quat){randomf(), randomf(), randomf(), randomf()});
+}
+
+// Best hierarchyUpdate time after changing the rotation of changes nodes,
+// random ones unless every node changes. Their subtrees are updated too.
+static double benchUpdate(Hierarchy* h, const uint* ids, const quat* rotations, uint changes)
+{
+    double best = 1e9;
+
+    for (uint r = 0; r < RUNS; ++r)
+    {
+        for (uint i = 0; i < changes; ++i)
+        {
+            uint k = changes == NODE_COUNT ? i : (uint)rand() % NODE_COUNT;
+            hierarchySetRotation(h, ids[k], rotations[k]);
+        }
+
+        double t0 = benchNow();
+        hierarchyUpdate(h);
+        best = fmin(best, benchNow() - t0);
+    }
+
+    benchSink += h->worlds[0].m30;
+    return best;
+}
+
+int main(void)
+{
+    Hierarchy* h = hierarchyCreate();
+    uint* ids = malloc(NODE_COUNT * sizeof *ids);
+    quat* rotations = malloc(NODE_COUNT * sizeof *rotations);
+
+    for (uint i = 0; i < NODE_COUNT; ++i)
+    {
+        uint bone = i % RIG_BONES;
+        uint parent = bone == 0 ? HIERARCHY_NULL : ids[i - 1 - (uint)rand() % MIN(bone, 4)];
+
+        rotations[i] = randomQuat();
+        ids[i] = hierarchyAdd(h, parent, (v3){randomf(), randomf(), randomf()}, rotations[i], (v3){1.0f, 1.0f, 1.0f});
+    }
+
+    hierarchyUpdate(h);
+
+    uint threads[] = {1, 0};
+    for (uint t = 0; t < sizeof threads / sizeof *threads; ++t)
+    {
+        parallelSetThreadCount(threads[t]);
+
+        double few = benchUpdate(h, ids, rotations, NODE_COUNT / 100);
+        double all = benchUpdate(h, ids, rotations, NODE_COUNT);
+
+        printf("%u threads, %u nodes\n", parallelThreadCount(), NODE_COUNT);
+        printf("  1%% changed   %8.3f ms\n", few * 1e3);
+        printf("  100%% changed %8.3f ms\n", all * 1e3);
+    }
+
+    hierarchyDestroy(h);
+    free(ids);
+    free(rotations);
+    return 0;
+}
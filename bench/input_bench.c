@@ -0,0 +1,251 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include "core.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Runs on a headless window, the events come from a replay built here so no
+// GLFW window or context is needed
+#define FRAMES    100000
+#define QUERIES   16
+
+//-----------------------------
+// ~Before
+
+// The layout the bitsets replaced: one bitfield per key, every poll walked
+// all of them. Called through pointers so they stay calls, like they were
+// from outside core.c.
+typedef struct OldButton
+{
+    bool down     : 1;
+    bool pressed  : 1;
+    bool released : 1;
+} OldButton;
+
+typedef struct OldInput
+{
+    OldButton keys[KEY_LAST];
+    OldButton buttons[MOUSE_BUTTON_LAST];
+} OldInput;
+
+static void oldRefresh(OldInput* input)
+{
+    for (int i = 0; i < KEY_LAST; ++i)
+    {
+        input->keys[i].pressed  = 0;
+        input->keys[i].released = 0;
+    }
+
+    for (int i = 0; i < MOUSE_BUTTON_LAST; ++i)
+    {
+        input->buttons[i].pressed  = 0;
+        input->buttons[i].released = 0;
+    }
+}
+
+static void oldApply(OldInput* input, KeyCode key, uchar action)
+{
+    OldButton* button = &input->keys[key];
+
+    if (action == INPUT_PRESS)
+    {
+        button->pressed |= !button->down;
+        button->down = 1;
+    }
+    else
+    {
+        button->released = 1;
+        button->down = 0;
+    }
+}
+
+static bool oldIsKeyDown(const OldInput* input, KeyCode key)
+{
+    if (!input || key < KEY_UNKNOWN || key >= KEY_LAST)
+        return 0;
+
+    return input->keys[key].down;
+}
+
+static void (*volatile oldRefreshFn)(OldInput*)                = oldRefresh;
+static void (*volatile oldApplyFn)(OldInput*, KeyCode, uchar)  = oldApply;
+static bool (*volatile oldIsKeyDownFn)(const OldInput*, KeyCode) = oldIsKeyDown;
+
+//-----------------------------
+// ~Replay
+
+// One key event per frame, pressing and releasing keys[i % count] in turn.
+// NULL when out of memory.
+static InputRecording* replayCreate(const KeyCode* keys, uint count)
+{
+    InputRecording* recording = inputRecordingCreate();
+    double time = 0.0;
+
+    if (!recording)
+        return NULL;
+
+    for (uint i = 0; i < FRAMES; ++i)
+    {
+        float delta = 1.0f / 60.0f;
+        time += delta;
+
+        InputEvent event = {
+            .time   = time,
+            .code   = (short)keys[i % count],
+            .type   = INPUT_KEY,
+            .action = (i / count) & 1 ? INPUT_RELEASE : INPUT_PRESS,
+        };
+
+        inputRecordingWriteFrame(recording, time, delta, &event, 1);
+    }
+
+    if (recording->failed)
+    {
+        inputRecordingDestroy(recording);
+        return NULL;
+    }
+
+    return recording;
+}
+
+//-----------------------------
+// ~Benchmarks
+
+static void benchPoll(Window* window, OldInput* old, const KeyCode* keys)
+{
+    double before = 1e9, after = 1e9;
+
+    for (uint r = 0; r < BENCH_REPEATS; ++r)
+    {
+        double t0 = benchNow();
+
+        for (uint i = 0; i < FRAMES; ++i)
+            oldRefreshFn(old);
+
+        double t1 = benchNow();
+
+        for (uint i = 0; i < FRAMES; ++i)
+            windowPollEvents(window);
+
+        double t2 = benchNow();
+        before = fmin(before, t1 - t0);
+        after  = fmin(after, t2 - t1);
+    }
+
+    benchReport("poll, no events, before", before, FRAMES, "poll");
+    benchReport("poll, no events, after", after, FRAMES, "poll");
+
+    // After also decodes the replay and fills the event ring, before only
+    // refreshes and applies the event
+    InputRecording* replay = replayCreate(keys, QUERIES);
+    before = 1e9, after = 1e9;
+
+    if (!replay)
+        return;
+
+    for (uint r = 0; r < BENCH_REPEATS; ++r)
+    {
+        double t0 = benchNow();
+
+        for (uint i = 0; i < FRAMES; ++i)
+        {
+            oldRefreshFn(old);
+            oldApplyFn(old, keys[i % QUERIES], (i / QUERIES) & 1 ? INPUT_RELEASE : INPUT_PRESS);
+        }
+
+        double t1 = benchNow();
+        windowReplayInput(window, replay);
+
+        for (uint i = 0; i < FRAMES; ++i)
+            windowPollEvents(window);
+
+        double t2 = benchNow();
+        before = fmin(before, t1 - t0);
+        after  = fmin(after, t2 - t1);
+    }
+
+    benchReport("poll, one key event, before", before, FRAMES, "poll");
+    benchReport("poll, one key event, after", after, FRAMES, "poll");
+
+    windowReplayInput(window, NULL);
+    inputRecordingDestroy(replay);
+}
+
+static void benchQueries(const Window* window, const OldInput* old, const KeyCode* keys)
+{
+    KeySet set = {0};
+
+    for (uint k = 0; k < QUERIES; ++k)
+        keySetAdd(&set, keys[k]);
+
+    double before = 1e9, single = 1e9, any = 1e9;
+    uint hits = 0;
+
+    for (uint r = 0; r < BENCH_REPEATS; ++r)
+    {
+        double t0 = benchNow();
+
+        for (uint i = 0; i < FRAMES; ++i)
+        {
+            bool down = 0;
+
+            for (uint k = 0; k < QUERIES; ++k)
+                down |= oldIsKeyDownFn(old, keys[k]);
+
+            hits += down;
+        }
+
+        double t1 = benchNow();
+
+        for (uint i = 0; i < FRAMES; ++i)
+        {
+            bool down = 0;
+
+            for (uint k = 0; k < QUERIES; ++k)
+                down |= windowIsKeyDown(window, keys[k]);
+
+            hits += down;
+        }
+
+        double t2 = benchNow();
+
+        for (uint i = 0; i < FRAMES; ++i)
+            hits += windowIsAnyKeyDown(window, &set);
+
+        double t3 = benchNow();
+        before = fmin(before, t1 - t0);
+        single = fmin(single, t2 - t1);
+        any    = fmin(any, t3 - t2);
+    }
+
+    benchSink = (float)hits;
+
+    benchReport("16 keys, before", before, FRAMES, "query");
+    benchReport("16 keys, windowIsKeyDown", single, FRAMES, "query");
+    benchReport("16 keys, windowIsAnyKeyDown", any, FRAMES, "query");
+}
+
+int main(void)
+{
+    Window*   window = windowCreateHeadless("input_bench", 640, 480);
+    OldInput* old    = calloc(1, sizeof *old);
+
+    if (!window || !old)
+        return 1;
+
+    // Spread over several words, none of them down so no query stops early
+    KeyCode keys[QUERIES] = {
+        KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H,
+        KEY_SPACE, KEY_ENTER, KEY_ESCAPE, KEY_LEFT_SHIFT, KEY_F1, KEY_F2, KEY_UP, KEY_DOWN,
+    };
+
+    benchPoll(window, old, keys);
+    benchQueries(window, old, keys);
+
+    free(old);
+    windowDestroy(window);
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include "core.h"
+#include "scene.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Replays a recorded session on a headless window and prints a histogram of
+// the frame times:
+//     replay_bench [recording]
+// Without a recording it replays a synthetic one, 10 minutes at 60 Hz of
+// mouse motion and WASD presses. Each frame polls, reads the events and
+// updates a scene driven by them.
+#define FRAMES       36000
+#define NODE_COUNT   10000
+#define BUCKETS      16    // Powers of two from 1 us, the last one holds the rest
+#define BAR_WIDTH    50
+
+static float random01(void)
+{
+    return rand() / (float)RAND_MAX;
+}
+
+//-----------------------------
+// ~Synthetic session
+
+// NULL when out of memory
+static InputRecording* sessionCreate(void)
+{
+    static const KeyCode keys[] = {KEY_W, KEY_A, KEY_S, KEY_D};
+    InputRecording* recording = inputRecordingCreate();
+    double time = 0.0;
+    uint   down = 0;
+    float  x = 320.0f, y = 240.0f;
+
+    if (!recording)
+        return NULL;
+
+    for (uint i = 0; i < FRAMES; ++i)
+    {
+        float delta = 1.0f / 60.0f;
+        InputEvent events[2];
+        uint count = 0;
+
+        time += delta;
+        x += (random01() - 0.5f) * 8.0f;
+        y += (random01() - 0.5f) * 8.0f;
+
+        events[count++] = (InputEvent){.time = time - delta * random01(), .x = x, .y = y, .type = INPUT_MOTION};
+
+        if (random01() < 0.1f)
+        {
+            uint k = (uint)rand() % 4;
+
+            events[count++] = (InputEvent){
+                .time   = time - delta * random01(),
+                .code   = (short)keys[k],
+                .type   = INPUT_KEY,
+                .action = down >> k & 1 ? INPUT_RELEASE : INPUT_PRESS,
+            };
+
+            down ^= 1u << k;
+        }
+
+        inputRecordingWriteFrame(recording, time, delta, events, count);
+    }
+
+    if (recording->failed)
+    {
+        inputRecordingDestroy(recording);
+        return NULL;
+    }
+
+    return recording;
+}
+
+//-----------------------------
+// ~Frame
+
+typedef struct Scene
+{
+    Hierarchy* h;
+    uint*      ids;
+    v3         position;
+    float      yaw;
+    uint       presses;
+} Scene;
+
+static void sceneCreate(Scene* scene)
+{
+    scene->h   = hierarchyCreate();
+    scene->ids = malloc(NODE_COUNT * sizeof *scene->ids);
+
+    // A player root with everything else hanging off it in short chains
+    for (uint i = 0; i < NODE_COUNT; ++i)
+    {
+        uint parent = i == 0 ? HIERARCHY_NULL : scene->ids[i % 8 == 1 ? 0 : i - 1];
+        v3   offset = {random01(), random01(), random01()};
+
+        scene->ids[i] = hierarchyAdd(scene->h, parent, offset, (quat){0.0f, 0.0f, 0.0f, 1.0f}, (v3){1.0f, 1.0f, 1.0f});
+    }
+}
+
+static void sceneDestroy(Scene* scene)
+{
+    hierarchyDestroy(scene->h);
+    free(scene->ids);
+}
+
+static void frame(Window* window, Scene* scene)
+{
+    windowPollEvents(window);
+
+    float dt    = windowDeltaTime(window);
+    float speed = 4.0f * dt;
+
+    uint it = 0;
+    for (const InputEvent* e; (e = windowNextEvent(window, &it));)
+        scene->presses += e->type == INPUT_KEY && e->action == INPUT_PRESS;
+
+    scene->yaw += windowMouseXOffset(window) * 0.001f;
+
+    scene->position.z += windowIsKeyDown(window, KEY_W) ? speed : 0.0f;
+    scene->position.z -= windowIsKeyDown(window, KEY_S) ? speed : 0.0f;
+    scene->position.x -= windowIsKeyDown(window, KEY_A) ? speed : 0.0f;
+    scene->position.x += windowIsKeyDown(window, KEY_D) ? speed : 0.0f;
+
+    quat rotation = {0.0f, sinf(scene->yaw * 0.5f), 0.0f, cosf(scene->yaw * 0.5f)};
+    hierarchySetLocal(scene->h, scene->ids[0], scene->position, rotation, (v3){1.0f, 1.0f, 1.0f});
+
+    // Every chain sways a little, so the whole scene changes each frame
+    for (uint i = 1; i < NODE_COUNT; i += 8)
+    {
+        float angle = sinf((float)windowTime(window) + (float)i) * 0.1f;
+        hierarchySetRotation(scene->h, scene->ids[i], (quat){sinf(angle), 0.0f, 0.0f, cosf(angle)});
+    }
+
+    hierarchyUpdate(scene->h);
+    benchSink += scene->h->worlds[NODE_COUNT - 1].m30;
+}
+
+//-----------------------------
+// ~Histogram
+
+static int compareDouble(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void histogramPrint(double* times, uint count)
+{
+    uint buckets[BUCKETS] = {0}, most = 1;
+
+    for (uint i = 0; i < count; ++i)
+    {
+        uint b = 0;
+
+        for (double limit = 1e-6; b < BUCKETS - 1 && times[i] >= limit; limit *= 2.0)
+            b++;
+
+        buckets[b]++;
+    }
+
+    for (uint b = 0; b < BUCKETS; ++b)
+        most = buckets[b] > most ? buckets[b] : most;
+
+    printf("%u frames\n", count);
+
+    for (uint b = 0; b < BUCKETS; ++b)
+    {
+        if (!buckets[b])
+            continue;
+
+        double lo = b ? ldexp(1.0, (int)b - 1) : 0.0;
+        printf("  %8.0f us+ %7u ", lo, buckets[b]);
+
+        for (uint w = 0, width = (uint)((uint64_t)buckets[b] * BAR_WIDTH / most); w < width; ++w)
+            putchar('#');
+
+        putchar('\n');
+    }
+
+    qsort(times, count, sizeof *times, compareDouble);
+
+    printf("  p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+        times[count / 2] * 1e6, times[count * 9 / 10] * 1e6, times[count * 99 / 100] * 1e6, times[count - 1] * 1e6);
+}
+
+int main(int argc, char** argv)
+{
+    InputRecording* recording = argc > 1 ? inputRecordingLoad(argv[1]) : sessionCreate();
+
+    if (!recording)
+    {
+        if (argc > 1)
+            fprintf(stderr, "%s isn't an input recording\n", argv[1]);
+
+        return 1;
+    }
+
+    Window* window = windowCreateHeadless("replay_bench", 1280, 720);
+    Scene scene = {0};
+    sceneCreate(&scene);
+
+    windowReplayInput(window, recording);
+
+    uint    capacity = FRAMES, count = 0;
+    double* times    = malloc(capacity * sizeof *times);
+
+    while (windowIsReplaying(window))
+    {
+        if (count == capacity)
+            times = realloc(times, (capacity *= 2) * sizeof *times);
+
+        double t0 = benchNow();
+        frame(window, &scene);
+        times[count++] = benchNow() - t0;
+    }
+
+    if (count)
+        histogramPrint(times, count);
+
+    printf("  %u key presses replayed\n", scene.presses);
+
+    free(times);
+    sceneDestroy(&scene);
+    windowDestroy(window);
+
+    inputRecordingDestroy(recording);
+
+    return 0;
+}
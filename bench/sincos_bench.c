@@ -0,0 +1,67 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include "maths.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define SINCOS_COUNT (1 << 20)
+
+int main(void)
+{
+    float* x = malloc(SINCOS_COUNT * sizeof *x);
+    float* s = malloc(SINCOS_COUNT * sizeof *s);
+    float* c = malloc(SINCOS_COUNT * sizeof *c);
+
+    // Typical rotation angles, a few turns either way
+    for (uint i = 0; i < SINCOS_COUNT; ++i)
+        x[i] = (rand() / (float)RAND_MAX * 2.0f - 1.0f) * 4.0f * (float)PI;
+
+    double best[4] = {1e9, 1e9, 1e9, 1e9};
+
+    for (uint r = 0; r < BENCH_REPEATS; ++r)
+    {
+        double t0 = benchNow();
+        for (uint i = 0; i < SINCOS_COUNT; ++i)
+        {
+            s[i] = sinf(x[i]);
+            c[i] = cosf(x[i]);
+        }
+
+        double t1 = benchNow();
+        for (uint i = 0; i < SINCOS_COUNT; ++i)
+            sinCosPrecise(x[i], &s[i], &c[i]);
+
+        double t2 = benchNow();
+        for (uint i = 0; i < SINCOS_COUNT; ++i)
+            sinCosFast(x[i], &s[i], &c[i]);
+
+        double t3 = benchNow();
+        sinCosBatch(x, s, c, SINCOS_COUNT);
+
+        double t4 = benchNow();
+        benchSink += s[r] + c[r];
+
+        double times[4] = {t1 - t0, t2 - t1, t3 - t2, t4 - t3};
+        for (uint k = 0; k < 4; ++k)
+            best[k] = fmin(best[k], times[k]);
+    }
+
+    benchReport("sinf + cosf", best[0], SINCOS_COUNT, "call");
+    benchReport("sinCosPrecise", best[1], SINCOS_COUNT, "call");
+    benchReport("sinCosFast", best[2], SINCOS_COUNT, "call");
+    benchReport("sinCosBatch", best[3], SINCOS_COUNT, "call");
+
+    // Max absolute error against double precision over the same inputs
+    double worst = 0.0;
+    for (uint i = 0; i < SINCOS_COUNT; ++i)
+        worst = fmax(worst, fmax(fabs(s[i] - sin((double)x[i])), fabs(c[i] - cos((double)x[i]))));
+
+    printf("sinCosBatch max error %.3g\n", worst);
+
+    free(x);
+    free(s);
+    free(c);
+    return 0;
+}
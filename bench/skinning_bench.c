@@ -0,0 +1,104 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include "animation.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// The mesh from the original measurements: 1M vertices over a 64 joint
+// palette, cycling through 1 to 4 joints per vertex
+#define VERTEX_COUNT (1u << 20)
+#define JOINT_COUNT  64
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+// Weights for jointCount joints per vertex, 0 cycles through 1 to 4
+static void setWeights(ushort* joints, v4* weights, uint jointCount)
+{
+    for (uint i = 0; i < VERTEX_COUNT; ++i)
+    {
+        uint used = jointCount ? jointCount : 1 + i % 4;
+        float w[4] = {0.0f, 0.0f, 0.0f, 0.0f}, sum = 0.0f;
+
+        for (uint k = 0; k < 4; ++k)
+        {
+            joints[i * 4 + k] = (ushort)(rand() % JOINT_COUNT);
+
+            if (k < used)
+            {
+                w[k] = rand() / (float)RAND_MAX + 0.01f;
+                sum += w[k];
+            }
+        }
+
+        weights[i] = (v4){w[0] / sum, w[1] / sum, w[2] / sum, w[3] / sum};
+    }
+}
+
+int main(void)
+{
+    m4x3 palette[JOINT_COUNT];
+    DualQuat dualQuats[JOINT_COUNT];
+
+    for (uint j = 0; j < JOINT_COUNT; ++j)
+    {
+        TRS trs = {{randomf() * 5.0f, randomf() * 5.0f, randomf() * 5.0f}, quatNormTo((quat){randomf(), randomf(), randomf(), randomf()}), {1.0f, 1.0f, 1.0f}};
+        palette[j]   = trsToM4x3(trs);
+        dualQuats[j] = dualQuatFromTRS(trs);
+    }
+
+    v3* positions    = malloc(VERTEX_COUNT * sizeof *positions);
+    v3* normals      = malloc(VERTEX_COUNT * sizeof *normals);
+    v3* outPositions = malloc(VERTEX_COUNT * sizeof *outPositions);
+    v3* outNormals   = malloc(VERTEX_COUNT * sizeof *outNormals);
+    ushort* joints   = malloc(VERTEX_COUNT * 4 * sizeof *joints);
+    v4* weights      = malloc(VERTEX_COUNT * sizeof *weights);
+
+    for (uint i = 0; i < VERTEX_COUNT; ++i)
+    {
+        positions[i] = (v3){randomf(), randomf(), randomf()};
+        normals[i]   = v3NormTo((v3){randomf(), randomf(), randomf() + 2.0f});
+    }
+
+    // Per core numbers, parallelFor would otherwise split the mesh
+    parallelSetThreadCount(1);
+
+    uint jointCounts[] = {0, 1, 4};
+    const char* names[] = {"1-4 joints", "1 joint", "4 joints"};
+
+    for (uint c = 0; c < sizeof jointCounts / sizeof *jointCounts; ++c)
+    {
+        setWeights(joints, weights, jointCounts[c]);
+
+        double linear = 1e9, dualQuat = 1e9;
+        for (uint r = 0; r < BENCH_REPEATS; ++r)
+        {
+            double t0 = benchNow();
+            skinLinear(palette, joints, weights, positions, normals, outPositions, outNormals, VERTEX_COUNT);
+
+            double t1 = benchNow();
+            skinDualQuat(dualQuats, joints, weights, positions, normals, outPositions, outNormals, VERTEX_COUNT);
+
+            double t2 = benchNow();
+            linear   = fmin(linear, t1 - t0);
+            dualQuat = fmin(dualQuat, t2 - t1);
+        }
+        benchSink += outPositions[0].x;
+
+        printf("%s, %u vertices, one core\n", names[c], VERTEX_COUNT);
+        benchReport("  skinLinear", linear, VERTEX_COUNT, "vertex");
+        benchReport("  skinDualQuat", dualQuat, VERTEX_COUNT, "vertex");
+    }
+
+    free(positions);
+    free(normals);
+    free(outPositions);
+    free(outNormals);
+    free(joints);
+    free(weights);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include "maths.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Built twice, as transform_bench with the maths calls out of line and as
+// transform_inline_bench with MATHS_INLINE, compare the two outputs
+#ifdef MATHS_INLINE
+    #define CALLS "inline"
+#else
+    #define CALLS "out of line"
+#endif // MATHS_INLINE
+
+#define OBJECTS 100000
+
+typedef struct Object
+{
+    v3    position;
+    v3    axis;
+    float angle;
+    v3    scale;
+} Object;
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+// A transform heavy frame: every object builds its model matrix from a
+// translation, rotation and scale, takes it to clip space and tests the 8
+// corners of its unit box against the view
+static uint frameInPlace(const Object* objects, const m4* viewProj)
+{
+    uint visible = 0;
+
+    for (uint i = 0; i < OBJECTS; ++i)
+    {
+        m4 model = m4Identity(), mvp;
+
+        m4TranslateInPlace(&model, objects[i].position);
+        m4RotateInPlace(&model, objects[i].axis, objects[i].angle);
+        m4ScaleInPlace(&model, objects[i].scale);
+        m4MulTo(&mvp, viewProj, &model);
+
+        for (uint c = 0; c < 8; ++c)
+        {
+            v4 corner = {c & 1 ? 1.0f : -1.0f, c & 2 ? 1.0f : -1.0f, c & 4 ? 1.0f : -1.0f, 1.0f}, clip;
+            m4Mulv4To(&clip, &mvp, &corner);
+
+            visible += fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w;
+        }
+    }
+
+    return visible;
+}
+
+// The same frame through the by-value functions
+static uint frameByValue(const Object* objects, m4 viewProj)
+{
+    uint visible = 0;
+
+    for (uint i = 0; i < OBJECTS; ++i)
+    {
+        m4 model = m4Identity();
+
+        model = m4Translate(model, objects[i].position);
+        model = m4Rotate(model, objects[i].axis, objects[i].angle);
+        model = m4Scale(model, objects[i].scale);
+
+        m4 mvp = m4Mul(viewProj, model);
+
+        for (uint c = 0; c < 8; ++c)
+        {
+            v4 clip = m4Mulv4(mvp, (v4){c & 1 ? 1.0f : -1.0f, c & 2 ? 1.0f : -1.0f, c & 4 ? 1.0f : -1.0f, 1.0f});
+
+            visible += fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w;
+        }
+    }
+
+    return visible;
+}
+
+int main(void)
+{
+    Object* objects = malloc(OBJECTS * sizeof *objects);
+
+    for (uint i = 0; i < OBJECTS; ++i)
+    {
+        objects[i].position = (v3){randomf() * 100.0f, randomf() * 10.0f, randomf() * 100.0f};
+        objects[i].axis     = (v3){randomf(), randomf(), randomf()};
+        objects[i].angle    = randomf() * (float)PI;
+        objects[i].scale    = (v3){1.0f + randomf() * 0.5f, 1.0f + randomf() * 0.5f, 1.0f + randomf() * 0.5f};
+
+        v3Norm(&objects[i].axis);
+    }
+
+    m4 view     = m4LookAt((v3){0.0f, 20.0f, -120.0f}, (v3){0.0f, 0.0f, 0.0f}, (v3){0.0f, 1.0f, 0.0f});
+    m4 proj     = m4Perspective(60.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+    m4 viewProj = m4Mul(proj, view);
+
+    double inPlace = 1e9, byValue = 1e9;
+    uint visible = 0;
+
+    for (uint r = 0; r < BENCH_REPEATS; ++r)
+    {
+        double t0 = benchNow();
+        visible += frameInPlace(objects, &viewProj);
+
+        double t1 = benchNow();
+        visible += frameByValue(objects, viewProj);
+
+        double t2 = benchNow();
+        inPlace = fmin(inPlace, t1 - t0);
+        byValue = fmin(byValue, t2 - t1);
+    }
+
+    benchSink = (float)visible;
+
+    printf("%u objects, maths calls %s\n", OBJECTS, CALLS);
+    benchReport("in place, m4MulTo / m4Mulv4To", inPlace, OBJECTS, "object");
+    benchReport("by value, m4Mul / m4Mulv4", byValue, OBJECTS, "object");
+
+    free(objects);
+
+    return 0;
+}
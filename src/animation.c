@@ -0,0 +1,815 @@
+#include "animation.h"
+#include "simd.h"
+
+#include <math.h>   // sqrtf, fabsf, floorf
+#include <stdlib.h> // malloc, calloc, realloc, free
+#include <string.h> // memcpy
+
+//-----------------------------
+// ~Skinning
+
+#define SKIN_PARALLEL 4096 // Vertices, each one costs far more than a stream element
+
+typedef struct SkinJob
+{
+    const float* palette;
+    const ushort* joints;
+    const v4* weights;
+    const v3* positions;
+    const v3* normals;
+    v3* outPositions;
+    v3* outNormals;
+} SkinJob;
+
+static void skinLinearRange(void* data, uint begin, uint end);
+static void skinDualQuatRange(void* data, uint begin, uint end);
+static inline void  skinGather(const SkinJob* job, uint stride, uint slot, uint i, uint end, simdf* out);
+static inline simdf skinLoad(const void* array, uint stride, uint field, uint i, uint end);
+static inline void  skinStore(v3* out, simdf x, simdf y, simdf z, uint i, uint end);
+static inline simdf skinInvLength(simdf x, simdf y, simdf z);
+
+void skinLinear(const m4x3* palette, const ushort* joints, const v4* weights,
+                const v3* positions, const v3* normals, v3* outPositions, v3* outNormals, uint n)
+{
+    SkinJob job = {&palette->m00, joints, weights, positions, normals, outPositions, outNormals};
+    parallelFor(n, SKIN_PARALLEL, skinLinearRange, &job);
+}
+
+void skinDualQuat(const DualQuat* palette, const ushort* joints, const v4* weights,
+                  const v3* positions, const v3* normals, v3* outPositions, v3* outNormals, uint n)
+{
+    SkinJob job = {&palette->real.x, joints, weights, positions, normals, outPositions, outNormals};
+    parallelFor(n, SKIN_PARALLEL, skinDualQuatRange, &job);
+}
+
+DualQuat dualQuatFromTRS(TRS trs)
+{
+    quat t = {trs.translation.x, trs.translation.y, trs.translation.z, 0.0f};
+    return (DualQuat){trs.rotation, quatMulf(quatMul(t, trs.rotation), 0.5f)};
+}
+
+// The columns are normalized to strip the scale, then the rotation is read
+// off the largest of w, x, y and z so the division stays well conditioned
+DualQuat dualQuatFromM4x3(m4x3 m)
+{
+    v3 c0 = {m.m00, m.m01, m.m02};
+    v3 c1 = {m.m10, m.m11, m.m12};
+    v3 c2 = {m.m20, m.m21, m.m22};
+    v3Norm(&c0);
+    v3Norm(&c1);
+    v3Norm(&c2);
+
+    float trace = c0.x + c1.y + c2.z;
+    quat r;
+
+    if (trace > 0.0f)
+    {
+        float s = sqrtf(trace + 1.0f) * 2.0f;
+        r = (quat){(c1.z - c2.y) / s, (c2.x - c0.z) / s, (c0.y - c1.x) / s, 0.25f * s};
+    }
+    else if (c0.x > c1.y && c0.x > c2.z)
+    {
+        float s = sqrtf(1.0f + c0.x - c1.y - c2.z) * 2.0f;
+        r = (quat){0.25f * s, (c1.x + c0.y) / s, (c2.x + c0.z) / s, (c1.z - c2.y) / s};
+    }
+    else if (c1.y > c2.z)
+    {
+        float s = sqrtf(1.0f + c1.y - c0.x - c2.z) * 2.0f;
+        r = (quat){(c1.x + c0.y) / s, 0.25f * s, (c2.y + c1.z) / s, (c2.x - c0.z) / s};
+    }
+    else
+    {
+        float s = sqrtf(1.0f + c2.z - c0.x - c1.y) * 2.0f;
+        r = (quat){(c2.x + c0.z) / s, (c2.y + c1.z) / s, 0.25f * s, (c0.y - c1.x) / s};
+    }
+
+    TRS trs = {{m.m30, m.m31, m.m32}, quatNormTo(r), {1.0f, 1.0f, 1.0f}};
+    return dualQuatFromTRS(trs);
+}
+
+//-----------------------------
+// ~Clip
+
+#define CLIP_STEPS 16383.0f    // Rotation steps per 1 / sqrt(2), the largest a smallest component can be
+#define CLIP_SQRT2 1.41421356f
+
+// Scratch for one track of one joint at a time
+typedef struct ClipBuilder
+{
+    const TRS* frames;
+    uint jointCount;
+    uint frameCount;
+    float tolerance;
+    float* values;   // Source values, rotations on one hemisphere frame to frame
+    float* decoded;  // What the sampler reads back for each frame
+    ushort* packed;  // 3 per frame
+    ushort* keys;
+    uint counts[3];  // Keys written to each track so far
+} ClipBuilder;
+
+static void         clipBuildTrack(Clip* clip, ClipBuilder* b, uint joint, uint track);
+static uint         clipReduce(const ClipBuilder* b, uint dims);
+static bool         clipFits(const ClipBuilder* b, uint dims, uint first, uint last, uint from, uint to);
+static void         clipPackRotation(quat q, ushort* out);
+static inline void  clipUnpackRotation(const ushort* in, float* out);
+static inline float clipFrame(const Clip* clip, float time);
+static inline float clipFind(const ClipTrack* track, uint joint, float frame, uint* a, uint* b);
+static inline v3    clipLerp(v3 a, v3 b, float t);
+static inline void  clipNlerp(const float* a, const float* b, float t, float* out);
+static inline void  clipUnpackLanes(const int32_t* packed, simdf* out);
+static void         clipSampleLanes(const Clip* clip, uint first, uint count, float frame, TRS* out);
+
+// Every track is fitted against the values the sampler will decode, so the
+// tolerance holds with the rotation quantization included. The key arrays
+// are sized for every frame and shrunk once all the joints are done.
+Clip* clipCreate(const TRS* frames, uint jointCount, uint frameCount, float frameRate, float tolerance)
+{
+    if (!frames || !jointCount || !frameCount || frameCount > 65536 || !(frameRate > 0.0f))
+        return NULL;
+
+    size_t most = (size_t)jointCount * frameCount;
+
+    ClipBuilder b = {0};
+    b.frames     = frames;
+    b.jointCount = jointCount;
+    b.frameCount = frameCount;
+    b.tolerance  = tolerance;
+    b.values     = malloc(frameCount * 4 * sizeof *b.values);
+    b.decoded    = malloc(frameCount * 4 * sizeof *b.decoded);
+    b.packed     = malloc(frameCount * 3 * sizeof *b.packed);
+    b.keys       = malloc(frameCount * sizeof *b.keys);
+
+    Clip* clip = calloc(1, sizeof *clip);
+
+    if (!b.values || !b.decoded || !b.packed || !b.keys || !clip)
+        goto fail;
+
+    clip->jointCount = jointCount;
+    clip->frameCount = frameCount;
+    clip->frameRate  = frameRate;
+    clip->duration   = (float)(frameCount - 1) / frameRate;
+
+    ClipTrack* tracks[3] = {&clip->translation, &clip->rotation, &clip->scale};
+    for (uint t = 0; t < 3; ++t)
+    {
+        tracks[t]->starts = malloc((jointCount + 1) * sizeof *tracks[t]->starts);
+        tracks[t]->frames = malloc(most * sizeof *tracks[t]->frames);
+        if (!tracks[t]->starts || !tracks[t]->frames)
+            goto fail;
+    }
+
+    clip->translations = malloc(most * sizeof *clip->translations);
+    clip->rotations    = malloc(most * 3 * sizeof *clip->rotations);
+    clip->scales       = malloc(most * sizeof *clip->scales);
+
+    if (!clip->translations || !clip->rotations || !clip->scales)
+        goto fail;
+
+    for (uint j = 0; j < jointCount; ++j)
+        for (uint t = 0; t < 3; ++t)
+            clipBuildTrack(clip, &b, j, t);
+
+    // Shrinking can't fail in practice, and keeping the larger block is fine if it does
+    void* p;
+    for (uint t = 0; t < 3; ++t)
+    {
+        tracks[t]->starts[jointCount] = b.counts[t];
+        if ((p = realloc(tracks[t]->frames, b.counts[t] * sizeof *tracks[t]->frames)))
+            tracks[t]->frames = p;
+    }
+    if ((p = realloc(clip->translations, b.counts[0] * sizeof *clip->translations)))
+        clip->translations = p;
+    if ((p = realloc(clip->rotations, b.counts[1] * 3 * sizeof *clip->rotations)))
+        clip->rotations = p;
+    if ((p = realloc(clip->scales, b.counts[2] * sizeof *clip->scales)))
+        clip->scales = p;
+
+    free(b.values);
+    free(b.decoded);
+    free(b.packed);
+    free(b.keys);
+    return clip;
+
+fail:
+    free(b.values);
+    free(b.decoded);
+    free(b.packed);
+    free(b.keys);
+    clipDestroy(clip);
+    return NULL;
+}
+
+void clipDestroy(Clip* clip)
+{
+    if (!clip)
+        return;
+
+    free(clip->translation.starts);
+    free(clip->translation.frames);
+    free(clip->rotation.starts);
+    free(clip->rotation.frames);
+    free(clip->scale.starts);
+    free(clip->scale.frames);
+    free(clip->translations);
+    free(clip->rotations);
+    free(clip->scales);
+    free(clip);
+}
+
+uint clipSize(const Clip* clip)
+{
+    uint translations = clip->translation.starts[clip->jointCount];
+    uint rotations    = clip->rotation.starts[clip->jointCount];
+    uint scales       = clip->scale.starts[clip->jointCount];
+
+    return (uint)(sizeof *clip
+                + 3 * (clip->jointCount + 1) * sizeof(uint)
+                + (translations + rotations + scales) * sizeof(ushort)
+                + translations * sizeof(v3)
+                + rotations * 3 * sizeof(ushort)
+                + scales * sizeof(v3));
+}
+
+void clipSample(const Clip* clip, float time, TRS* out)
+{
+    float frame = clipFrame(clip, time);
+
+    for (uint j = 0; j < clip->jointCount; j += SIMD_WIDTH)
+        clipSampleLanes(clip, j, MIN(SIMD_WIDTH, clip->jointCount - j), frame, out + j);
+}
+
+// Clip by clip so each one is still read front to back. Rotations are added
+// on the hemisphere of the sum so far and normalized at the end.
+void clipBlend(const Clip* const* clips, const float* times, const float* weights, uint count, TRS* out)
+{
+    float total = 0.0f;
+    for (uint i = 0; i < count; ++i)
+        total += MAX(weights[i], 0.0f);
+
+    if (!(total > 0.0f))
+    {
+        clipSample(clips[0], times[0], out);
+        return;
+    }
+
+    uint jointCount = clips[0]->jointCount;
+    bool first = 1;
+
+    for (uint i = 0; i < count; ++i)
+    {
+        if (!(weights[i] > 0.0f))
+            continue;
+
+        const Clip* clip = clips[i];
+        float frame = clipFrame(clip, times[i]);
+        float w = weights[i] / total;
+
+        for (uint j = 0; j < jointCount; j += SIMD_WIDTH)
+        {
+            TRS lanes[SIMD_WIDTH];
+            uint n = MIN(SIMD_WIDTH, jointCount - j);
+            clipSampleLanes(clip, j, n, frame, lanes);
+
+            for (uint k = 0; k < n; ++k)
+            {
+                TRS* o = &out[j + k];
+                const TRS* p = &lanes[k];
+
+                if (first)
+                    *o = (TRS){{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+
+                float dot = o->rotation.x * p->rotation.x + o->rotation.y * p->rotation.y
+                          + o->rotation.z * p->rotation.z + o->rotation.w * p->rotation.w;
+                float rw = dot < 0.0f ? -w : w;
+
+                o->translation.x += p->translation.x * w;
+                o->translation.y += p->translation.y * w;
+                o->translation.z += p->translation.z * w;
+                o->rotation.x    += p->rotation.x * rw;
+                o->rotation.y    += p->rotation.y * rw;
+                o->rotation.z    += p->rotation.z * rw;
+                o->rotation.w    += p->rotation.w * rw;
+                o->scale.x       += p->scale.x * w;
+                o->scale.y       += p->scale.y * w;
+                o->scale.z       += p->scale.z * w;
+            }
+        }
+
+        first = 0;
+    }
+
+    for (uint j = 0; j < jointCount; ++j)
+    {
+        quat* r = &out[j].rotation;
+        float inv = 1.0f / sqrtf(r->x * r->x + r->y * r->y + r->z * r->z + r->w * r->w);
+
+        r->x *= inv;
+        r->y *= inv;
+        r->z *= inv;
+        r->w *= inv;
+    }
+}
+
+//- - - - - - - - - - - - - - -
+
+// SIMD_WIDTH vertices at a time, the blended matrix is built per lane from
+// the gathered joint rows. Slots whose weight is 0 in every lane are
+// skipped, so vertices with fewer influences cost less. Lanes past end
+// repeat the last vertex and are never stored.
+static void skinLinearRange(void* data, uint begin, uint end)
+{
+    SkinJob* job = data;
+    simdf zero = simdZero();
+
+    for (uint i = begin; i < end; i += SIMD_WIDTH)
+    {
+        simdf m[12], g[12];
+        simdf w = skinLoad(job->weights, 4, 0, i, end);
+
+        skinGather(job, 12, 0, i, end, g);
+        for (int c = 0; c < 12; ++c)
+            m[c] = simdMul(w, g[c]);
+
+        for (uint k = 1; k < 4; ++k)
+        {
+            w = skinLoad(job->weights, 4, k, i, end);
+            if (!simdMask(simdCmpGt(w, zero)))
+                continue;
+
+            skinGather(job, 12, k, i, end, g);
+            for (int c = 0; c < 12; ++c)
+                m[c] = simdAdd(m[c], simdMul(w, g[c]));
+        }
+
+        simdf x = skinLoad(job->positions, 3, 0, i, end);
+        simdf y = skinLoad(job->positions, 3, 1, i, end);
+        simdf z = skinLoad(job->positions, 3, 2, i, end);
+
+        simdf nx = zero, ny = zero, nz = zero;
+        if (job->normals)
+        {
+            nx = skinLoad(job->normals, 3, 0, i, end);
+            ny = skinLoad(job->normals, 3, 1, i, end);
+            nz = skinLoad(job->normals, 3, 2, i, end);
+        }
+
+        skinStore(job->outPositions,
+            simdAdd(simdAdd(simdAdd(simdMul(m[0], x), simdMul(m[1], y)), simdMul(m[2], z)), m[3]),
+            simdAdd(simdAdd(simdAdd(simdMul(m[4], x), simdMul(m[5], y)), simdMul(m[6], z)), m[7]),
+            simdAdd(simdAdd(simdAdd(simdMul(m[8], x), simdMul(m[9], y)), simdMul(m[10], z)), m[11]),
+            i, end);
+
+        if (!job->normals || !job->outNormals)
+            continue;
+
+        // Blended matrices aren't rigid, so the normals need renormalizing
+        simdf ox = simdAdd(simdAdd(simdMul(m[0], nx), simdMul(m[1], ny)), simdMul(m[2], nz));
+        simdf oy = simdAdd(simdAdd(simdMul(m[4], nx), simdMul(m[5], ny)), simdMul(m[6], nz));
+        simdf oz = simdAdd(simdAdd(simdMul(m[8], nx), simdMul(m[9], ny)), simdMul(m[10], nz));
+        simdf inv = skinInvLength(ox, oy, oz);
+
+        skinStore(job->outNormals, simdMul(ox, inv), simdMul(oy, inv), simdMul(oz, inv), i, end);
+    }
+}
+
+// Each joint is flipped onto the same hemisphere as the first before it is
+// added, the sum is normalized and applied as a rotation by real followed
+// by the translation 2 * dual * conjugate(real)
+static void skinDualQuatRange(void* data, uint begin, uint end)
+{
+    SkinJob* job = data;
+    simdf zero = simdZero(), two = simdSet1(2.0f), sign = simdSet1(-0.0f);
+
+    for (uint i = begin; i < end; i += SIMD_WIDTH)
+    {
+        simdf b[8], g[8];
+        simdf w = skinLoad(job->weights, 4, 0, i, end);
+
+        skinGather(job, 8, 0, i, end, g);
+        for (int c = 0; c < 8; ++c)
+            b[c] = simdMul(w, g[c]);
+
+        simdf px = g[0], py = g[1], pz = g[2], pw = g[3];
+
+        for (uint k = 1; k < 4; ++k)
+        {
+            w = skinLoad(job->weights, 4, k, i, end);
+            if (!simdMask(simdCmpGt(w, zero)))
+                continue;
+
+            skinGather(job, 8, k, i, end, g);
+
+            simdf dot = simdAdd(simdAdd(simdAdd(simdMul(px, g[0]), simdMul(py, g[1])), simdMul(pz, g[2])), simdMul(pw, g[3]));
+            w = simdXor(w, simdAnd(simdCmpLt(dot, zero), sign));
+
+            for (int c = 0; c < 8; ++c)
+                b[c] = simdAdd(b[c], simdMul(w, g[c]));
+        }
+
+        simdf len2 = simdAdd(simdAdd(simdAdd(simdMul(b[0], b[0]), simdMul(b[1], b[1])), simdMul(b[2], b[2])), simdMul(b[3], b[3]));
+        simdf valid = simdCmpGt(len2, zero);
+        simdf inv = simdAnd(valid, simdDiv(simdSet1(1.0f), simdSqrt(simdSelect(valid, len2, simdSet1(1.0f)))));
+
+        simdf rx = simdMul(b[0], inv), ry = simdMul(b[1], inv), rz = simdMul(b[2], inv), rw = simdMul(b[3], inv);
+        simdf dx = simdMul(b[4], inv), dy = simdMul(b[5], inv), dz = simdMul(b[6], inv), dw = simdMul(b[7], inv);
+
+        simdf tx = simdMul(two, simdAdd(simdSub(simdMul(rw, dx), simdMul(dw, rx)), simdSub(simdMul(ry, dz), simdMul(rz, dy))));
+        simdf ty = simdMul(two, simdAdd(simdSub(simdMul(rw, dy), simdMul(dw, ry)), simdSub(simdMul(rz, dx), simdMul(rx, dz))));
+        simdf tz = simdMul(two, simdAdd(simdSub(simdMul(rw, dz), simdMul(dw, rz)), simdSub(simdMul(rx, dy), simdMul(ry, dx))));
+
+        simdf x = skinLoad(job->positions, 3, 0, i, end);
+        simdf y = skinLoad(job->positions, 3, 1, i, end);
+        simdf z = skinLoad(job->positions, 3, 2, i, end);
+
+        simdf nx = zero, ny = zero, nz = zero;
+        if (job->normals)
+        {
+            nx = skinLoad(job->normals, 3, 0, i, end);
+            ny = skinLoad(job->normals, 3, 1, i, end);
+            nz = skinLoad(job->normals, 3, 2, i, end);
+        }
+
+        // v + 2 * cross(r, cross(r, v) + w * v)
+        simdf cx = simdAdd(simdSub(simdMul(ry, z), simdMul(rz, y)), simdMul(rw, x));
+        simdf cy = simdAdd(simdSub(simdMul(rz, x), simdMul(rx, z)), simdMul(rw, y));
+        simdf cz = simdAdd(simdSub(simdMul(rx, y), simdMul(ry, x)), simdMul(rw, z));
+
+        skinStore(job->outPositions,
+            simdAdd(simdAdd(x, simdMul(two, simdSub(simdMul(ry, cz), simdMul(rz, cy)))), tx),
+            simdAdd(simdAdd(y, simdMul(two, simdSub(simdMul(rz, cx), simdMul(rx, cz)))), ty),
+            simdAdd(simdAdd(z, simdMul(two, simdSub(simdMul(rx, cy), simdMul(ry, cx)))), tz),
+            i, end);
+
+        if (!job->normals || !job->outNormals)
+            continue;
+
+        cx = simdAdd(simdSub(simdMul(ry, nz), simdMul(rz, ny)), simdMul(rw, nx));
+        cy = simdAdd(simdSub(simdMul(rz, nx), simdMul(rx, nz)), simdMul(rw, ny));
+        cz = simdAdd(simdSub(simdMul(rx, ny), simdMul(ry, nx)), simdMul(rw, nz));
+
+        skinStore(job->outNormals,
+            simdAdd(nx, simdMul(two, simdSub(simdMul(ry, cz), simdMul(rz, cy)))),
+            simdAdd(ny, simdMul(two, simdSub(simdMul(rz, cx), simdMul(rx, cz)))),
+            simdAdd(nz, simdMul(two, simdSub(simdMul(rx, cy), simdMul(ry, cx)))),
+            i, end);
+    }
+}
+
+// out[c] holds float c of the palette entry in joint slot slot of every lane
+static inline void skinGather(const SkinJob* job, uint stride, uint slot, uint i, uint end, simdf* out)
+{
+    float lane[12][SIMD_WIDTH];
+
+    for (uint k = 0; k < SIMD_WIDTH; ++k)
+    {
+        uint v = MIN(i + k, end - 1);
+        const float* src = job->palette + (size_t)job->joints[v * 4 + slot] * stride;
+
+        for (uint c = 0; c < stride; ++c)
+            lane[c][k] = src[c];
+    }
+
+    for (uint c = 0; c < stride; ++c)
+        out[c] = simdLoadu(lane[c]);
+}
+
+static inline simdf skinLoad(const void* array, uint stride, uint field, uint i, uint end)
+{
+    const float* f = array;
+    float lane[SIMD_WIDTH];
+
+    for (uint k = 0; k < SIMD_WIDTH; ++k)
+        lane[k] = f[(size_t)MIN(i + k, end - 1) * stride + field];
+
+    return simdLoadu(lane);
+}
+
+static inline void skinStore(v3* out, simdf x, simdf y, simdf z, uint i, uint end)
+{
+    float lx[SIMD_WIDTH], ly[SIMD_WIDTH], lz[SIMD_WIDTH];
+    simdStoreu(lx, x);
+    simdStoreu(ly, y);
+    simdStoreu(lz, z);
+
+    for (uint k = 0; k < SIMD_WIDTH && i + k < end; ++k)
+        out[i + k] = (v3){lx[k], ly[k], lz[k]};
+}
+
+// 1 / length, or 0 for zero vectors so they stay zero
+static inline simdf skinInvLength(simdf x, simdf y, simdf z)
+{
+    simdf len2 = simdAdd(simdAdd(simdMul(x, x), simdMul(y, y)), simdMul(z, z));
+    simdf valid = simdCmpGt(len2, simdZero());
+    simdf one = simdSet1(1.0f);
+    return simdAnd(valid, simdDiv(one, simdSqrt(simdSelect(valid, len2, one))));
+}
+
+// Loads one track of one joint into the builder, fits it and appends the
+// kept frames to the clip
+static void clipBuildTrack(Clip* clip, ClipBuilder* b, uint joint, uint track)
+{
+    uint dims = track == 1 ? 4 : 3;
+
+    for (uint f = 0; f < b->frameCount; ++f)
+    {
+        const TRS* src = &b->frames[(size_t)f * b->jointCount + joint];
+        float* v = b->values + f * dims;
+
+        float* d = b->decoded + f * dims;
+
+        if (track == 1)
+        {
+            quat q = quatNormTo(src->rotation);
+            if (f && q.x * v[-4] + q.y * v[-3] + q.z * v[-2] + q.w * v[-1] < 0.0f)
+                q = quatMulf(q, -1.0f);
+
+            memcpy(v, &q, sizeof q);
+            clipPackRotation(q, b->packed + f * 3);
+            clipUnpackRotation(b->packed + f * 3, d);
+        }
+        else
+        {
+            v3 p = track == 0 ? src->translation : src->scale;
+
+            v[0] = d[0] = p.x;
+            v[1] = d[1] = p.y;
+            v[2] = d[2] = p.z;
+        }
+    }
+
+    uint n = clipReduce(b, dims);
+    ClipTrack* tracks[3] = {&clip->translation, &clip->rotation, &clip->scale};
+    uint first = b->counts[track];
+
+    tracks[track]->starts[joint] = first;
+    for (uint k = 0; k < n; ++k)
+    {
+        uint f = b->keys[k];
+        tracks[track]->frames[first + k] = (ushort)f;
+
+        const float* d = b->decoded + f * dims;
+
+        if (track == 0)
+            clip->translations[first + k] = (v3){d[0], d[1], d[2]};
+        else if (track == 1)
+            for (uint c = 0; c < 3; ++c)
+                clip->rotations[(first + k) * 3 + c] = b->packed[f * 3 + c];
+        else
+            clip->scales[first + k] = (v3){d[0], d[1], d[2]};
+    }
+
+    b->counts[track] += n;
+}
+
+// Greedy fit: each key reaches as far ahead as the frames in between still
+// interpolate within the tolerance. A track that never leaves the
+// tolerance of its first frame keeps only that frame.
+static uint clipReduce(const ClipBuilder* b, uint dims)
+{
+    uint last = b->frameCount - 1;
+    uint n = 0;
+
+    b->keys[n++] = 0;
+    if (clipFits(b, dims, 0, 0, 1, last + 1))
+        return n;
+
+    for (uint key = 0; key < last;)
+    {
+        uint next = key + 1;
+        while (next < last && clipFits(b, dims, key, next + 1, key + 1, next + 1))
+            ++next;
+
+        b->keys[n++] = (ushort)next;
+        key = next;
+    }
+
+    return n;
+}
+
+// Whether the frames [from, to) are within the tolerance of what sampling
+// between the keys first and last returns for them
+static bool clipFits(const ClipBuilder* b, uint dims, uint first, uint last, uint from, uint to)
+{
+    const float* a = b->decoded + first * dims;
+    const float* c = b->decoded + last * dims;
+
+    for (uint f = from; f < to; ++f)
+    {
+        float t = first == last ? 0.0f : (float)(f - first) / (float)(last - first);
+        const float* v = b->values + f * dims;
+        float r[4];
+
+        if (dims == 4)
+        {
+            clipNlerp(a, c, t, r);
+
+            if (r[0] * v[0] + r[1] * v[1] + r[2] * v[2] + r[3] * v[3] < 0.0f)
+                for (uint d = 0; d < 4; ++d)
+                    r[d] = -r[d];
+        }
+        else
+        {
+            v3 p = clipLerp((v3){a[0], a[1], a[2]}, (v3){c[0], c[1], c[2]}, t);
+
+            r[0] = p.x;
+            r[1] = p.y;
+            r[2] = p.z;
+        }
+
+        for (uint d = 0; d < dims; ++d)
+            if (!(fabsf(r[d] - v[d]) <= b->tolerance))
+                return 0;
+    }
+
+    return 1;
+}
+
+// Smallest three: the largest component is dropped and made positive by
+// negating the quaternion, the others are at most 1 / sqrt(2) and get 15
+// bits each. The top bits of the first two hold the dropped index.
+static void clipPackRotation(quat q, ushort* out)
+{
+    float c[4] = {q.x, q.y, q.z, q.w};
+
+    uint largest = 0;
+    for (uint i = 1; i < 4; ++i)
+        if (fabsf(c[i]) > fabsf(c[largest]))
+            largest = i;
+
+    float scale = (c[largest] < 0.0f ? -CLIP_STEPS : CLIP_STEPS) * CLIP_SQRT2;
+
+    for (uint i = 0, k = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+
+        float v = MIN(MAX(c[i] * scale, -CLIP_STEPS), CLIP_STEPS);
+        out[k++] = (ushort)((int)floorf(v + 0.5f) + (int)CLIP_STEPS);
+    }
+
+    out[0] |= (ushort)((largest & 1) << 15);
+    out[1] |= (ushort)((largest >> 1) << 15);
+}
+
+// Components before the dropped one are the stored ones in order, those
+// after it are shifted by one
+static inline void clipUnpackRotation(const ushort* in, float* out)
+{
+    uint largest = (uint)(in[0] >> 15) | (uint)(in[1] >> 15) << 1;
+    float scale = 1.0f / (CLIP_STEPS * CLIP_SQRT2);
+
+    float a = (float)((int)(in[0] & 0x7fff) - (int)CLIP_STEPS) * scale;
+    float b = (float)((int)(in[1] & 0x7fff) - (int)CLIP_STEPS) * scale;
+    float c = (float)((int)(in[2] & 0x7fff) - (int)CLIP_STEPS) * scale;
+    float l = sqrtf(1.0f - a * a - b * b - c * c); // The smallest three add up to at most 3 / 4
+
+    out[0] = largest == 0 ? l : a;
+    out[1] = largest == 1 ? l : largest == 0 ? a : b;
+    out[2] = largest == 2 ? l : largest == 3 ? c : b;
+    out[3] = largest == 3 ? l : c;
+}
+
+// clipUnpackRotation for SIMD_WIDTH rotations, packed holds the first
+// stored value of every lane, then the second and the third. The dropped
+// index differs from joint to joint so it is applied with selects.
+static inline void clipUnpackLanes(const int32_t* packed, simdf* out)
+{
+    simdi low = simdiSet1(0x7fff);
+    simdi bias = simdiSet1((int32_t)CLIP_STEPS);
+    simdf scale = simdSet1(1.0f / (CLIP_STEPS * CLIP_SQRT2));
+    simdi in[3];
+    simdf v[3];
+
+    for (uint c = 0; c < 3; ++c)
+    {
+        float raw[SIMD_WIDTH];
+        memcpy(raw, packed + c * SIMD_WIDTH, sizeof raw);
+        in[c] = simdCast(simdLoadu(raw));
+        v[c] = simdMul(simdiToFloat(simdiSub(simdiAnd(in[c], low), bias)), scale);
+    }
+
+    simdi largest = simdiOr(simdiShr(in[0], 15), simdiShl(simdiShr(in[1], 15), 1));
+    simdf is0 = simdiCmpEq(largest, simdiSet1(0));
+    simdf is1 = simdiCmpEq(largest, simdiSet1(1));
+    simdf is2 = simdiCmpEq(largest, simdiSet1(2));
+    simdf is3 = simdiCmpEq(largest, simdiSet1(3));
+
+    simdf l = simdSub(simdSub(simdSub(simdSet1(1.0f), simdMul(v[0], v[0])), simdMul(v[1], v[1])), simdMul(v[2], v[2]));
+    l = simdSqrt(l);
+
+    out[0] = simdSelect(is0, l, v[0]);
+    out[1] = simdSelect(is1, l, simdSelect(is0, v[0], v[1]));
+    out[2] = simdSelect(is2, l, simdSelect(is3, v[2], v[1]));
+    out[3] = simdSelect(is3, l, v[2]);
+}
+
+static inline float clipFrame(const Clip* clip, float time)
+{
+    float frame = time * clip->frameRate;
+    return frame > 0.0f ? MIN(frame, (float)(clip->frameCount - 1)) : 0.0f;
+}
+
+// Keys a and b around frame and how far frame is from a to b. Every track
+// starts with a key at frame 0, past the last key a and b are both the last.
+static inline float clipFind(const ClipTrack* track, uint joint, float frame, uint* a, uint* b)
+{
+    uint lo = track->starts[joint];
+    uint end = track->starts[joint + 1];
+
+    // Halving without a branch on the comparison, which is a coin flip
+    for (uint n = end - lo; n > 1; n -= n / 2)
+        lo = (float)track->frames[lo + n / 2] <= frame ? lo + n / 2 : lo;
+
+    *a = lo;
+    *b = lo + 1 < end ? lo + 1 : lo;
+
+    if (*a == *b)
+        return 0.0f;
+
+    float f0 = (float)track->frames[*a];
+    return (frame - f0) / ((float)track->frames[*b] - f0);
+}
+
+static inline v3 clipLerp(v3 a, v3 b, float t)
+{
+    float s = 1.0f - t;
+    return (v3){a.x * s + b.x * t, a.y * s + b.y * t, a.z * s + b.z * t};
+}
+
+// What clipSampleLanes does to one rotation, for fitting the keys
+static inline void clipNlerp(const float* a, const float* b, float t, float* out)
+{
+    float s = 1.0f - t;
+    float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    t = dot < 0.0f ? -t : t;
+
+    float len2 = 0.0f;
+    for (uint d = 0; d < 4; ++d)
+    {
+        out[d] = a[d] * s + b[d] * t;
+        len2 += out[d] * out[d];
+    }
+
+    float inv = 1.0f / sqrtf(len2);
+    for (uint d = 0; d < 4; ++d)
+        out[d] *= inv;
+}
+
+// SIMD_WIDTH joints at a time: each one finds its keys and interpolates
+// its translation and scale, then the rotations are decoded and
+// interpolated side by side. Lanes past count repeat the last joint and
+// are never stored.
+static void clipSampleLanes(const Clip* clip, uint first, uint count, float frame, TRS* out)
+{
+    int32_t packed[2][3 * SIMD_WIDTH];
+    float weights[SIMD_WIDTH];
+
+    for (uint k = 0; k < SIMD_WIDTH; ++k)
+    {
+        uint j = first + MIN(k, count - 1);
+        uint a, b;
+        float t;
+
+        if (k < count)
+        {
+            t = clipFind(&clip->translation, j, frame, &a, &b);
+            out[k].translation = clipLerp(clip->translations[a], clip->translations[b], t);
+
+            t = clipFind(&clip->scale, j, frame, &a, &b);
+            out[k].scale = clipLerp(clip->scales[a], clip->scales[b], t);
+        }
+
+        weights[k] = clipFind(&clip->rotation, j, frame, &a, &b);
+        for (uint c = 0; c < 3; ++c)
+        {
+            packed[0][c * SIMD_WIDTH + k] = clip->rotations[a * 3 + c];
+            packed[1][c * SIMD_WIDTH + k] = clip->rotations[b * 3 + c];
+        }
+    }
+
+    simdf ra[4], rb[4], r[4];
+    clipUnpackLanes(packed[0], ra);
+    clipUnpackLanes(packed[1], rb);
+
+    // clipNlerp
+    simdf zero = simdZero(), one = simdSet1(1.0f);
+    simdf t = simdLoadu(weights);
+    simdf s = simdSub(one, t);
+    simdf dot = simdAdd(simdAdd(simdAdd(simdMul(ra[0], rb[0]), simdMul(ra[1], rb[1])), simdMul(ra[2], rb[2])), simdMul(ra[3], rb[3]));
+    t = simdXor(t, simdAnd(simdCmpLt(dot, zero), simdSet1(-0.0f)));
+
+    simdf len2 = zero;
+    for (uint c = 0; c < 4; ++c)
+    {
+        r[c] = simdAdd(simdMul(ra[c], s), simdMul(rb[c], t));
+        len2 = simdAdd(len2, simdMul(r[c], r[c]));
+    }
+
+    simdf inv = simdDiv(one, simdSqrt(len2));
+    float lanes[4][SIMD_WIDTH];
+    for (uint c = 0; c < 4; ++c)
+        simdStoreu(lanes[c], simdMul(r[c], inv));
+
+    for (uint k = 0; k < count; ++k)
+        out[k].rotation = (quat){lanes[0][k], lanes[1][k], lanes[2][k], lanes[3][k]};
+}
@@ -0,0 +1,94 @@
+#ifndef MODULE_ANIMATION_H
+#define MODULE_ANIMATION_H
+
+#include "maths.h"
+
+//-------------------------------------------------------------
+// Definitions
+//-------------------------------------------------------------
+
+// Rigid transform as a unit dual quaternion, the rotation in real and half
+// the translation times the rotation in dual. Blending these instead of
+// matrices keeps twisting joints from collapsing the skin around them.
+typedef struct DualQuat
+{
+    quat real;
+    quat dual;
+} DualQuat;
+
+// Keyframes of the local transforms of jointCount joints, sampled from
+// frameCount evenly spaced source frames. Every joint keeps its own subset
+// of those frames for each of translation, rotation and scale, dropping the
+// frames that interpolating their neighbours reproduces within the clip's
+// tolerance. Rotations are stored in 48 bits as their three smallest
+// components, a 2 bit index says which one was left out.
+typedef struct ClipTrack
+{
+    uint*   starts;       // First key of every joint, jointCount + 1 entries
+    ushort* frames;       // Source frame of every key, ascending per joint
+} ClipTrack;
+
+typedef struct Clip
+{
+    uint      jointCount;
+    uint      frameCount;
+    float     frameRate;
+    float     duration;   // Seconds from the first frame to the last
+
+    ClipTrack translation;
+    ClipTrack rotation;
+    ClipTrack scale;
+    v3*       translations;
+    ushort*   rotations;  // 3 per key
+    v3*       scales;
+} Clip;
+
+//-------------------------------------------------------------
+// Prototypes
+//-------------------------------------------------------------
+
+//-----------------------------
+// ~Skinning
+
+// Every vertex blends up to 4 joints of the palette, joints holds 4 indices
+// per vertex and weights their weights, which should add up to 1. Unused
+// slots get weight 0 and any valid index. For a Mesh pass mesh->vertices,
+// mesh->joints, mesh->weights and mesh->vertexCount.
+//
+// Palette entries are usually a joint's world transform times its inverse
+// bind pose. normals and outNormals may be NULL, out may be the same array
+// as the input. The outputs are tightly packed v3s, ready for
+// vboSubmitData. Large meshes are skinned on several threads.
+
+void     skinLinear(const m4x3* palette, const ushort* joints, const v4* weights,
+                    const v3* positions, const v3* normals, v3* outPositions, v3* outNormals, uint n);
+
+void     skinDualQuat(const DualQuat* palette, const ushort* joints, const v4* weights,
+                      const v3* positions, const v3* normals, v3* outPositions, v3* outNormals, uint n);
+
+// Dual quaternions can't hold scale, so it is dropped. The matrix should be
+// rotation, translation and scale only.
+DualQuat dualQuatFromTRS(TRS trs);
+DualQuat dualQuatFromM4x3(m4x3 m);
+
+//-----------------------------
+// ~Clip
+
+// frames holds frameCount poses of jointCount local transforms each, one
+// pose after the other. tolerance is the largest error allowed in any
+// component of a sampled translation, rotation or scale, 0 keeps every
+// frame. Returns NULL when out of memory or past 65536 frames.
+Clip*    clipCreate(const TRS* frames, uint jointCount, uint frameCount, float frameRate, float tolerance);
+void     clipDestroy(Clip* clip);
+uint     clipSize(const Clip* clip); // Bytes, the struct included
+
+// Writes the pose at time into out, jointCount transforms. time is clamped
+// to the clip, wrap it with fmodf for looping clips. Joints are sampled in
+// order so every key array is read front to back in one pass.
+void     clipSample(const Clip* clip, float time, TRS* out);
+
+// Weighted blend of count clips, each sampled at its own time. The weights
+// are normalized and the clips must have the same joints.
+void     clipBlend(const Clip* const* clips, const float* times, const float* weights, uint count, TRS* out);
+
+#endif // MODULE_ANIMATION_H
@@ -0,0 +1,2720 @@
+#include "collision.h"
+#include "simd.h"
+
+#include <math.h>   // sqrtf, fabsf
+#include <stddef.h> // offsetof
+#include <stdlib.h> // qsort
+
+#define COLLISION_EPSILON 1e-12f // Squared lengths and determinants below this are degenerate
+
+// Clips [tmin, tmax] to the slab lo <= o + t * d <= hi, inv is 1 / d. A ray
+// parallel to the slab never crosses it, all of it is inside or none is.
+static inline bool collisionClipSlab(float lo, float hi, float o, float d, float inv, float* tmin, float* tmax)
+{
+    if (d == 0.0f)
+        return o >= lo && o <= hi;
+
+    float t1 = (lo - o) * inv;
+    float t2 = (hi - o) * inv;
+
+    *tmin = MAX(*tmin, MIN(t1, t2));
+    *tmax = MIN(*tmax, MAX(t1, t2));
+    return 1;
+}
+
+//-----------------------------
+// ~2D
+
+bool rectContains(Rect r, v2 p)
+{
+    return p.x >= r.x && p.x <= r.x + r.w && p.y >= r.y && p.y <= r.y + r.h;
+}
+
+bool circleContains(Circle c, v2 p)
+{
+    v2 d = {p.x - c.x, p.y - c.y};
+    return v2Dot(d, d) <= c.r * c.r;
+}
+
+// p0 + t * d1 = q0 + u * d2, solved with 2D cross products
+bool lineOverlapsLine(Line a, Line b, v2* point)
+{
+    v2 d1 = {a.x1 - a.x0, a.y1 - a.y0};
+    v2 d2 = {b.x1 - b.x0, b.y1 - b.y0};
+    v2 r  = {b.x0 - a.x0, b.y0 - a.y0};
+
+    float denom = d1.x * d2.y - d1.y * d2.x;
+    if (denom == 0.0f)
+        return 0;
+
+    float t = (r.x * d2.y - r.y * d2.x) / denom;
+    float u = (r.x * d1.y - r.y * d1.x) / denom;
+
+    if (t < 0.0f || t > 1.0f || u < 0.0f || u > 1.0f)
+        return 0;
+
+    if (point)
+        *point = (v2){a.x0 + d1.x * t, a.y0 + d1.y * t};
+
+    return 1;
+}
+
+// Slab test clipped to the segment, t in [0, 1]
+bool lineOverlapsRect(Line l, Rect r)
+{
+    float o[2] = {l.x0, l.y0};
+    float d[2] = {l.x1 - l.x0, l.y1 - l.y0};
+    float lo[2] = {r.x, r.y};
+    float hi[2] = {r.x + r.w, r.y + r.h};
+
+    float tmin = 0.0f, tmax = 1.0f;
+
+    for (int i = 0; i < 2; ++i)
+        if (!collisionClipSlab(lo[i], hi[i], o[i], d[i], 1.0f / d[i], &tmin, &tmax))
+            return 0;
+
+    return tmin <= tmax;
+}
+
+bool lineOverlapsCircle(Line l, Circle c)
+{
+    return circleContains(c, lineClosestPoint(l, (v2){c.x, c.y}));
+}
+
+bool rectOverlapsRect(Rect a, Rect b)
+{
+    return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+}
+
+bool circleOverlapsCircle(Circle a, Circle b)
+{
+    v2 d = {b.x - a.x, b.y - a.y};
+    float r = a.r + b.r;
+    return v2Dot(d, d) <= r * r;
+}
+
+bool circleOverlapsRect(Circle c, Rect r)
+{
+    return circleContains(c, rectClosestPoint(r, (v2){c.x, c.y}));
+}
+
+v2 lineClosestPoint(Line l, v2 p)
+{
+    v2 a = {l.x0, l.y0};
+    v2 d = {l.x1 - l.x0, l.y1 - l.y0};
+
+    float len2 = v2Dot(d, d);
+    if (len2 <= COLLISION_EPSILON)
+        return a;
+
+    float t = CLAMP(v2Dot(v2Sub(p, a), d) / len2, 0.0f, 1.0f);
+    return v2Add(a, v2Mulf(d, t));
+}
+
+v2 rectClosestPoint(Rect r, v2 p)
+{
+    return (v2) {
+        CLAMP(p.x, r.x, r.x + r.w),
+        CLAMP(p.y, r.y, r.y + r.h)
+    };
+}
+
+v2 circleClosestPoint(Circle c, v2 p)
+{
+    v2 d = {p.x - c.x, p.y - c.y};
+    float len2 = v2Dot(d, d);
+
+    if (len2 <= c.r * c.r)
+        return p;
+
+    return v2Add((v2){c.x, c.y}, v2Mulf(d, c.r / sqrtf(len2)));
+}
+
+//-----------------------------
+// ~3D
+
+bool aabbContains(AABB b, v3 p)
+{
+    return p.x >= b.x && p.x <= b.x + b.w
+        && p.y >= b.y && p.y <= b.y + b.h
+        && p.z >= b.z && p.z <= b.z + b.d;
+}
+
+bool sphereContains(Sphere s, v3 p)
+{
+    v3 d = {p.x - s.x, p.y - s.y, p.z - s.z};
+    return v3Dot(d, d) <= s.r * s.r;
+}
+
+bool aabbOverlapsAABB(AABB a, AABB b)
+{
+    return a.x <= b.x + b.w && b.x <= a.x + a.w
+        && a.y <= b.y + b.h && b.y <= a.y + a.h
+        && a.z <= b.z + b.d && b.z <= a.z + a.d;
+}
+
+// The box reaches as far from its centre as its extents projected on the normal
+bool aabbOverlapsPlane(AABB b, Plane p)
+{
+    float ex = b.w * 0.5f, ey = b.h * 0.5f, ez = b.d * 0.5f;
+    float r = fabsf(p.x) * ex + fabsf(p.y) * ey + fabsf(p.z) * ez;
+
+    return fabsf(planeDistance(p, (v3){b.x + ex, b.y + ey, b.z + ez})) <= r;
+}
+
+bool sphereOverlapsSphere(Sphere a, Sphere b)
+{
+    v3 d = {b.x - a.x, b.y - a.y, b.z - a.z};
+    float r = a.r + b.r;
+    return v3Dot(d, d) <= r * r;
+}
+
+bool sphereOverlapsAABB(Sphere s, AABB b)
+{
+    return sphereContains(s, aabbClosestPoint(b, (v3){s.x, s.y, s.z}));
+}
+
+bool sphereOverlapsPlane(Sphere s, Plane p)
+{
+    return fabsf(planeDistance(p, (v3){s.x, s.y, s.z})) <= s.r;
+}
+
+float planeDistance(Plane p, v3 point)
+{
+    return p.x * point.x + p.y * point.y + p.z * point.z + p.d;
+}
+
+v3 planeClosestPoint(Plane p, v3 point)
+{
+    return v3Sub(point, v3Mulf((v3){p.x, p.y, p.z}, planeDistance(p, point)));
+}
+
+v3 aabbClosestPoint(AABB b, v3 p)
+{
+    return (v3) {
+        CLAMP(p.x, b.x, b.x + b.w),
+        CLAMP(p.y, b.y, b.y + b.h),
+        CLAMP(p.z, b.z, b.z + b.d)
+    };
+}
+
+v3 sphereClosestPoint(Sphere s, v3 p)
+{
+    v3 d = {p.x - s.x, p.y - s.y, p.z - s.z};
+    float len2 = v3Dot(d, d);
+
+    if (len2 <= s.r * s.r)
+        return p;
+
+    return v3Add((v3){s.x, s.y, s.z}, v3Mulf(d, s.r / sqrtf(len2)));
+}
+
+// Real-Time Collision Detection 5.1.9, the segment parameters are found on
+// the infinite lines first and then clamped one after the other
+float segmentClosestPoints(v3 p0, v3 p1, v3 q0, v3 q1, v3* a, v3* b)
+{
+    v3 d1 = v3Sub(p1, p0);
+    v3 d2 = v3Sub(q1, q0);
+    v3 r  = v3Sub(p0, q0);
+
+    float aa = v3Dot(d1, d1);
+    float ee = v3Dot(d2, d2);
+    float f  = v3Dot(d2, r);
+    float s = 0.0f, t = 0.0f;
+
+    if (aa <= COLLISION_EPSILON && ee <= COLLISION_EPSILON)
+    {
+        // Both segments are points
+    }
+    else if (aa <= COLLISION_EPSILON)
+    {
+        t = CLAMP(f / ee, 0.0f, 1.0f);
+    }
+    else
+    {
+        float c = v3Dot(d1, r);
+
+        if (ee <= COLLISION_EPSILON)
+        {
+            s = CLAMP(-c / aa, 0.0f, 1.0f);
+        }
+        else
+        {
+            float bb = v3Dot(d1, d2);
+            float denom = aa * ee - bb * bb;
+
+            if (denom != 0.0f)
+                s = CLAMP((bb * f - c * ee) / denom, 0.0f, 1.0f);
+
+            t = (bb * s + f) / ee;
+
+            if (t < 0.0f)
+            {
+                t = 0.0f;
+                s = CLAMP(-c / aa, 0.0f, 1.0f);
+            }
+            else if (t > 1.0f)
+            {
+                t = 1.0f;
+                s = CLAMP((bb - c) / aa, 0.0f, 1.0f);
+            }
+        }
+    }
+
+    v3 ca = v3Add(p0, v3Mulf(d1, s));
+    v3 cb = v3Add(q0, v3Mulf(d2, t));
+
+    if (a) *a = ca;
+    if (b) *b = cb;
+
+    v3 d = v3Sub(ca, cb);
+    return v3Dot(d, d);
+}
+
+//-----------------------------
+// ~Ray
+
+// Slab test, an axis the ray is parallel to only checks the origin lies
+// between its planes
+bool rayCastAABB(Ray r, AABB b, float maxT, float* t)
+{
+    float o[3]  = {r.origin.x, r.origin.y, r.origin.z};
+    float d[3]  = {r.dir.x, r.dir.y, r.dir.z};
+    float lo[3] = {b.x, b.y, b.z};
+    float hi[3] = {b.x + b.w, b.y + b.h, b.z + b.d};
+
+    float tmin = 0.0f, tmax = maxT;
+
+    for (int i = 0; i < 3; ++i)
+        if (!collisionClipSlab(lo[i], hi[i], o[i], d[i], 1.0f / d[i], &tmin, &tmax))
+            return 0;
+
+    if (tmin > tmax)
+        return 0;
+
+    if (t) *t = tmin;
+    return 1;
+}
+
+// |o + t * d - c|^2 = r^2 solved for t with b = dot(c - o, d)
+bool rayCastSphere(Ray r, Sphere s, float maxT, float* t)
+{
+    v3 oc = {s.x - r.origin.x, s.y - r.origin.y, s.z - r.origin.z};
+
+    float a = v3Dot(r.dir, r.dir);
+    float b = v3Dot(oc, r.dir);
+    float c = v3Dot(oc, oc) - s.r * s.r;
+
+    // A zero direction never moves, it hits at 0 from inside or not at all
+    if (a == 0.0f)
+    {
+        if (c > 0.0f)
+            return 0;
+
+        if (t) *t = 0.0f;
+        return 1;
+    }
+
+    float disc = b * b - a * c;
+
+    if (disc < 0.0f)
+        return 0;
+
+    float root = sqrtf(disc);
+    float t0 = (b - root) / a;
+    float t1 = (b + root) / a;
+
+    if (t1 < 0.0f || t0 > maxT)
+        return 0;
+
+    if (t) *t = MAX(t0, 0.0f);
+    return 1;
+}
+
+bool rayCastPlane(Ray r, Plane p, float maxT, float* t)
+{
+    float dist  = planeDistance(p, r.origin);
+    float denom = p.x * r.dir.x + p.y * r.dir.y + p.z * r.dir.z;
+
+    if (dist == 0.0f)
+    {
+        if (t) *t = 0.0f;
+        return 1;
+    }
+
+    if (denom == 0.0f)
+        return 0;
+
+    float hit = -dist / denom;
+    if (hit < 0.0f || hit > maxT)
+        return 0;
+
+    if (t) *t = hit;
+    return 1;
+}
+
+// Moller-Trumbore, u and v are the barycentric weights of v1 and v2
+bool rayCastTriangle(Ray r, v3 v0, v3 v1, v3 v2, float maxT, float* t)
+{
+    v3 e1 = v3Sub(v1, v0);
+    v3 e2 = v3Sub(v2, v0);
+    v3 p  = v3Cross(r.dir, e2);
+
+    float det = v3Dot(e1, p);
+    if (fabsf(det) <= COLLISION_EPSILON)
+        return 0;
+
+    float inv = 1.0f / det;
+    v3 s = v3Sub(r.origin, v0);
+
+    float u = v3Dot(s, p) * inv;
+    if (u < 0.0f || u > 1.0f)
+        return 0;
+
+    v3 q = v3Cross(s, e1);
+
+    float v = v3Dot(r.dir, q) * inv;
+    if (v < 0.0f || u + v > 1.0f)
+        return 0;
+
+    float hit = v3Dot(e2, q) * inv;
+    if (hit < 0.0f || hit > maxT)
+        return 0;
+
+    if (t) *t = hit;
+    return 1;
+}
+
+//-----------------------------
+// ~Batch
+
+static inline uint collisionMaskStore(uint* mask, uint i, uint count, int bits);
+static inline void collisionClipSlabs(simdf lo, simdf hi, simdf inv, simdf parallel, simdf* tmin, simdf* tmax);
+static uint collisionSortHits(RayHit* hits, uint n);
+static int  collisionCompareHits(const void* a, const void* b);
+
+uint circleOverlapsCircles(Circle c, const v3Stream* circles, uint* mask)
+{
+    simdf cx = simdSet1(c.x), cy = simdSet1(c.y), cr = simdSet1(c.r);
+    uint hits = 0;
+
+    for (uint i = 0; i < circles->count; i += SIMD_WIDTH)
+    {
+        simdf dx = simdSub(simdLoad(circles->comps[0] + i), cx);
+        simdf dy = simdSub(simdLoad(circles->comps[1] + i), cy);
+        simdf r  = simdAdd(simdLoad(circles->comps[2] + i), cr);
+
+        simdf d2 = simdAdd(simdMul(dx, dx), simdMul(dy, dy));
+        hits += collisionMaskStore(mask, i, circles->count, simdMask(simdCmpLe(d2, simdMul(r, r))));
+    }
+
+    return hits;
+}
+
+uint rectOverlapsRects(Rect r, const v2Stream* centres, const v2Stream* extents, uint* mask)
+{
+    uint count = MIN(centres->count, extents->count);
+    simdf sign = simdSet1(-0.0f);
+    simdf ex = simdSet1(r.w * 0.5f), ey = simdSet1(r.h * 0.5f);
+    simdf cx = simdSet1(r.x + r.w * 0.5f), cy = simdSet1(r.y + r.h * 0.5f);
+    uint hits = 0;
+
+    for (uint i = 0; i < count; i += SIMD_WIDTH)
+    {
+        simdf dx = simdAndNot(sign, simdSub(simdLoad(centres->comps[0] + i), cx));
+        simdf dy = simdAndNot(sign, simdSub(simdLoad(centres->comps[1] + i), cy));
+
+        simdf in = simdAnd(simdCmpLe(dx, simdAdd(simdLoad(extents->comps[0] + i), ex)),
+                           simdCmpLe(dy, simdAdd(simdLoad(extents->comps[1] + i), ey)));
+
+        hits += collisionMaskStore(mask, i, count, simdMask(in));
+    }
+
+    return hits;
+}
+
+uint sphereOverlapsSpheres(Sphere s, const v4Stream* spheres, uint* mask)
+{
+    simdf sx = simdSet1(s.x), sy = simdSet1(s.y), sz = simdSet1(s.z), sr = simdSet1(s.r);
+    uint hits = 0;
+
+    for (uint i = 0; i < spheres->count; i += SIMD_WIDTH)
+    {
+        simdf dx = simdSub(simdLoad(spheres->comps[0] + i), sx);
+        simdf dy = simdSub(simdLoad(spheres->comps[1] + i), sy);
+        simdf dz = simdSub(simdLoad(spheres->comps[2] + i), sz);
+        simdf r  = simdAdd(simdLoad(spheres->comps[3] + i), sr);
+
+        simdf d2 = simdAdd(simdAdd(simdMul(dx, dx), simdMul(dy, dy)), simdMul(dz, dz));
+        hits += collisionMaskStore(mask, i, spheres->count, simdMask(simdCmpLe(d2, simdMul(r, r))));
+    }
+
+    return hits;
+}
+
+uint aabbOverlapsAABBs(AABB b, const v3Stream* centres, const v3Stream* extents, uint* mask)
+{
+    uint count = MIN(centres->count, extents->count);
+    simdf sign = simdSet1(-0.0f);
+    simdf ex = simdSet1(b.w * 0.5f), ey = simdSet1(b.h * 0.5f), ez = simdSet1(b.d * 0.5f);
+    simdf cx = simdSet1(b.x + b.w * 0.5f), cy = simdSet1(b.y + b.h * 0.5f), cz = simdSet1(b.z + b.d * 0.5f);
+    uint hits = 0;
+
+    for (uint i = 0; i < count; i += SIMD_WIDTH)
+    {
+        simdf dx = simdAndNot(sign, simdSub(simdLoad(centres->comps[0] + i), cx));
+        simdf dy = simdAndNot(sign, simdSub(simdLoad(centres->comps[1] + i), cy));
+        simdf dz = simdAndNot(sign, simdSub(simdLoad(centres->comps[2] + i), cz));
+
+        simdf in = simdAnd(simdAnd(simdCmpLe(dx, simdAdd(simdLoad(extents->comps[0] + i), ex)),
+                                   simdCmpLe(dy, simdAdd(simdLoad(extents->comps[1] + i), ey))),
+                                   simdCmpLe(dz, simdAdd(simdLoad(extents->comps[2] + i), ez)));
+
+        hits += collisionMaskStore(mask, i, count, simdMask(in));
+    }
+
+    return hits;
+}
+
+// Same maths as rayCastSphere, lanes that miss may hold NaN but are masked out
+uint rayCastSpheres(Ray r, float maxT, const v4Stream* spheres, RayHit* hits)
+{
+    simdf ox = simdSet1(r.origin.x), oy = simdSet1(r.origin.y), oz = simdSet1(r.origin.z);
+    simdf dx = simdSet1(r.dir.x), dy = simdSet1(r.dir.y), dz = simdSet1(r.dir.z);
+    simdf a  = simdSet1(v3Dot(r.dir, r.dir));
+    simdf zero = simdZero(), tmax = simdSet1(maxT);
+    uint n = 0;
+
+    // A zero direction hits at 0 the spheres holding the origin, see rayCastSphere
+    simdf still = simdCmpLe(a, zero);
+
+    for (uint i = 0; i < spheres->count; i += SIMD_WIDTH)
+    {
+        simdf cx = simdSub(simdLoad(spheres->comps[0] + i), ox);
+        simdf cy = simdSub(simdLoad(spheres->comps[1] + i), oy);
+        simdf cz = simdSub(simdLoad(spheres->comps[2] + i), oz);
+        simdf rr = simdLoad(spheres->comps[3] + i);
+
+        simdf b = simdAdd(simdAdd(simdMul(cx, dx), simdMul(cy, dy)), simdMul(cz, dz));
+        simdf c = simdSub(simdAdd(simdAdd(simdMul(cx, cx), simdMul(cy, cy)), simdMul(cz, cz)), simdMul(rr, rr));
+        simdf disc = simdSub(simdMul(b, b), simdMul(a, c));
+
+        simdf root = simdSqrt(simdMax(disc, zero));
+        simdf t0 = simdDiv(simdSub(b, root), a);
+        simdf t1 = simdDiv(simdAdd(b, root), a);
+
+        simdf hit = simdAnd(simdAnd(simdCmpGe(disc, zero), simdCmpGe(t1, zero)), simdCmpLe(t0, tmax));
+        hit = simdSelect(still, simdCmpLe(c, zero), hit);
+
+        int bits = simdMask(hit);
+        if (!bits)
+            continue;
+
+        float t[SIMD_WIDTH];
+        simdStoreu(t, simdSelect(still, zero, simdMax(t0, zero)));
+
+        for (uint k = 0; k < SIMD_WIDTH && i + k < spheres->count; ++k)
+            if ((bits >> k) & 1)
+                hits[n++] = (RayHit){t[k], i + k};
+    }
+
+    return collisionSortHits(hits, n);
+}
+
+uint rayCastAABBs(Ray r, float maxT, const v3Stream* centres, const v3Stream* extents, RayHit* hits)
+{
+    uint count = MIN(centres->count, extents->count);
+    simdf ox = simdSet1(r.origin.x), oy = simdSet1(r.origin.y), oz = simdSet1(r.origin.z);
+    simdf ix = simdSet1(1.0f / r.dir.x), iy = simdSet1(1.0f / r.dir.y), iz = simdSet1(1.0f / r.dir.z);
+    simdf zero = simdZero(), tmax0 = simdSet1(maxT);
+    uint n = 0;
+
+    // Axes the ray is parallel to (d == 0), see collisionClipSlabs
+    simdf dx = simdSet1(r.dir.x), dy = simdSet1(r.dir.y), dz = simdSet1(r.dir.z);
+    simdf zx = simdAnd(simdCmpLe(dx, zero), simdCmpGe(dx, zero));
+    simdf zy = simdAnd(simdCmpLe(dy, zero), simdCmpGe(dy, zero));
+    simdf zz = simdAnd(simdCmpLe(dz, zero), simdCmpGe(dz, zero));
+
+    for (uint i = 0; i < count; i += SIMD_WIDTH)
+    {
+        simdf cx = simdSub(simdLoad(centres->comps[0] + i), ox), ex = simdLoad(extents->comps[0] + i);
+        simdf cy = simdSub(simdLoad(centres->comps[1] + i), oy), ey = simdLoad(extents->comps[1] + i);
+        simdf cz = simdSub(simdLoad(centres->comps[2] + i), oz), ez = simdLoad(extents->comps[2] + i);
+
+        simdf tmin = zero, tmax = tmax0;
+        collisionClipSlabs(simdSub(cx, ex), simdAdd(cx, ex), ix, zx, &tmin, &tmax);
+        collisionClipSlabs(simdSub(cy, ey), simdAdd(cy, ey), iy, zy, &tmin, &tmax);
+        collisionClipSlabs(simdSub(cz, ez), simdAdd(cz, ez), iz, zz, &tmin, &tmax);
+
+        int bits = simdMask(simdCmpLe(tmin, tmax));
+        if (!bits)
+            continue;
+
+        float t[SIMD_WIDTH];
+        simdStoreu(t, tmin);
+
+        for (uint k = 0; k < SIMD_WIDTH && i + k < count; ++k)
+            if ((bits >> k) & 1)
+                hits[n++] = (RayHit){t[k], i + k};
+    }
+
+    return collisionSortHits(hits, n);
+}
+
+//- - - - - - - - - - - - - - -
+
+// SIMD_WIDTH divides 32 and i is a multiple of it, so a register never
+// straddles two words. Lanes past count read stream padding and are dropped.
+static inline uint collisionMaskStore(uint* mask, uint i, uint count, int bits)
+{
+    if (count - i < SIMD_WIDTH)
+        bits &= (1 << (count - i)) - 1;
+
+    if (i % 32 == 0)
+        mask[i / 32] = 0;
+
+    mask[i / 32] |= (uint)bits << (i % 32);
+
+    uint n = 0;
+    for (; bits; bits &= bits - 1)
+        ++n;
+
+    return n;
+}
+
+// collisionClipSlab for SIMD_WIDTH boxes, lo and hi relative to the origin.
+// parallel is all ones when the ray's direction along this axis is 0, then
+// lo * inv or hi * inv may be NaN and the slab instead clips to nothing or
+// to everything depending on whether the origin lies between the planes.
+static inline void collisionClipSlabs(simdf lo, simdf hi, simdf inv, simdf parallel, simdf* tmin, simdf* tmax)
+{
+    simdf t1 = simdMul(lo, inv);
+    simdf t2 = simdMul(hi, inv);
+
+    simdf zero   = simdZero();
+    simdf inf    = simdSet1(INFINITY);
+    simdf inside = simdAnd(simdCmpLe(lo, zero), simdCmpGe(hi, zero));
+
+    simdf near = simdSelect(parallel, simdSelect(inside, simdSub(zero, inf), inf), simdMin(t1, t2));
+    simdf far  = simdSelect(parallel, simdSelect(inside, inf, simdSub(zero, inf)), simdMax(t1, t2));
+
+    *tmin = simdMax(*tmin, near);
+    *tmax = simdMin(*tmax, far);
+}
+
+static uint collisionSortHits(RayHit* hits, uint n)
+{
+    qsort(hits, n, sizeof *hits, collisionCompareHits);
+    return n;
+}
+
+// Ties keep index order so the result doesn't depend on the SIMD width
+static int collisionCompareHits(const void* a, const void* b)
+{
+    const RayHit* ha = a;
+    const RayHit* hb = b;
+
+    if (ha->t != hb->t)
+        return ha->t < hb->t ? -1 : 1;
+
+    return ha->index < hb->index ? -1 : ha->index > hb->index;
+}
+
+//-----------------------------
+// ~Bvh
+
+#define BVH_BINS         16   // SAH candidate planes per axis
+#define BVH_MEDIAN_DEPTH 48   // Deeper splits take the median, bounds the depth to 48 + log2(n)
+#define BVH_STACK_SIZE   256  // 3 entries per level of a 4 wide tree at most 80 deep
+#define BVH_TASK_MIN     4096 // Smallest subtree handed to a thread of its own
+#define BVH_PARALLEL_RAYS 256 // Rays cost far more than the stream kernels, split early
+
+typedef struct BvhBuildNode
+{
+    v3 lo, hi;
+    uint left, right;
+    uint first, count; // count is 0 for inner nodes
+} BvhBuildNode;
+
+typedef struct BvhTask
+{
+    uint node;
+    uint first, count;
+    uint depth;
+    uint next; // Start of the node range reserved for the subtree
+} BvhTask;
+
+typedef struct BvhBuilder
+{
+    const v3* vertices;
+    const uint* indices;
+    v3* lo;
+    v3* hi;
+    v3* centroids;
+    uint* order; // Triangle indices, partitioned in place
+    BvhBuildNode* nodes;
+    uint nodeCount;
+    BvhTask* tasks;
+    uint taskCount;
+    uint taskDepth;
+} BvhBuilder;
+
+typedef struct BvhRay
+{
+    float ox, oy, oz;
+    float dx, dy, dz;
+    float ix, iy, iz; // 1 / d
+} BvhRay;
+
+typedef struct BvhBatchJob
+{
+    const Bvh* bvh;
+    const Ray* rays;
+    float maxT;
+    BvhHit* hits;
+} BvhBatchJob;
+
+static void  bvhBoundsRange(void* data, uint begin, uint end);
+static void  bvhTaskRange(void* data, uint begin, uint end);
+static void  bvhBuild(BvhBuilder* b, uint node, uint first, uint count, uint depth, uint* next);
+static uint  bvhSplit(BvhBuilder* b, uint first, uint count, v3 clo, v3 chi, uint depth);
+static float bvhArea(v3 lo, v3 hi);
+static void  bvhCount(const BvhBuilder* b, uint node, uint* inner, uint* leaves);
+static uint  bvhEmit(Bvh* bvh, const BvhBuilder* b, uint node);
+static void  bvhEmitNode(Bvh* bvh, const BvhBuilder* b, uint index, const uint* kids, uint count);
+static void  bvhEmitPacket(Bvh* bvh, const BvhBuilder* b, const BvhBuildNode* leaf);
+static bool  bvhTraverse(const Bvh* bvh, Ray r, float maxT, int any, BvhHit* hit);
+static void  bvhBatchRange(void* data, uint begin, uint end);
+static inline int bvhNodeHits(const BvhNode* n, const BvhRay* r, float best, float* t);
+static inline int bvhPacketHits(const BvhPacket* p, const BvhRay* r, float best, float* t, float* u, float* v);
+
+// Triangle bounds and centroids first, then the top of the tree on this
+// thread until there are enough subtrees to keep every thread busy, then
+// the subtrees in parallel, each in its own reserved range of build nodes.
+// The binary tree is finally collapsed into 4 wide nodes depth first.
+Bvh* bvhCreate(const v3* vertices, const uint* indices, uint triangleCount)
+{
+    Bvh* bvh = calloc(1, sizeof *bvh);
+
+    // Without triangles the BVH stays empty and every ray misses it
+    if (!bvh || !vertices || !triangleCount)
+        return bvh;
+
+    BvhBuilder b = {0};
+    b.vertices  = vertices;
+    b.indices   = indices;
+    b.lo        = malloc(triangleCount * sizeof *b.lo);
+    b.hi        = malloc(triangleCount * sizeof *b.hi);
+    b.centroids = malloc(triangleCount * sizeof *b.centroids);
+    b.order     = malloc(triangleCount * sizeof *b.order);
+    b.nodes     = malloc(2 * triangleCount * sizeof *b.nodes);
+    b.tasks     = malloc((triangleCount / BVH_TASK_MIN + 1) * sizeof *b.tasks);
+
+    if (!b.lo || !b.hi || !b.centroids || !b.order || !b.nodes || !b.tasks)
+        goto fail;
+
+    parallelFor(triangleCount, parallelThreshold(), bvhBoundsRange, &b);
+
+    // parallelFor hands out ranges in multiples of SIMD_PAD, so aim for that
+    // many subtrees per thread
+    uint threads = parallelThreadCount();
+    b.taskDepth = (uint)-1;
+    if (threads > 1)
+        for (b.taskDepth = 0; (1u << b.taskDepth) < threads * SIMD_PAD; ++b.taskDepth) {}
+
+    b.nodeCount = 1;
+    bvhBuild(&b, 0, 0, triangleCount, 0, &b.nodeCount);
+
+    uint next = b.nodeCount;
+    for (uint i = 0; i < b.taskCount; ++i)
+    {
+        b.tasks[i].next = next;
+        next += 2 * b.tasks[i].count - 2;
+    }
+
+    parallelFor(b.taskCount, 0, bvhTaskRange, &b);
+
+    uint inner = 0, leaves = 0;
+    bvhCount(&b, 0, &inner, &leaves);
+
+    // A leaf root still gets a node so traversal always starts at one
+    bvh->nodes   = malloc((inner + 1) * sizeof *bvh->nodes);
+    bvh->packets = malloc(leaves * sizeof *bvh->packets);
+    bvh->triangleCount = triangleCount;
+
+    if (!bvh->nodes || !bvh->packets)
+        goto fail;
+
+    if (b.nodes[0].count)
+    {
+        uint root = 0;
+        bvh->nodeCount = 1;
+        bvhEmitNode(bvh, &b, 0, &root, 1);
+    }
+    else
+    {
+        bvhEmit(bvh, &b, 0);
+    }
+
+    free(b.lo);
+    free(b.hi);
+    free(b.centroids);
+    free(b.order);
+    free(b.nodes);
+    free(b.tasks);
+    return bvh;
+
+fail:
+    free(b.lo);
+    free(b.hi);
+    free(b.centroids);
+    free(b.order);
+    free(b.nodes);
+    free(b.tasks);
+    bvhDestroy(bvh);
+    return NULL;
+}
+
+void bvhDestroy(Bvh* bvh)
+{
+    if (!bvh)
+        return;
+
+    free(bvh->nodes);
+    free(bvh->packets);
+    free(bvh);
+}
+
+bool bvhRayCast(const Bvh* bvh, Ray r, float maxT, BvhHit* hit)
+{
+    return bvhTraverse(bvh, r, maxT, 0, hit);
+}
+
+bool bvhRayAny(const Bvh* bvh, Ray r, float maxT)
+{
+    return bvhTraverse(bvh, r, maxT, 1, NULL);
+}
+
+void bvhRayCastBatch(const Bvh* bvh, const Ray* rays, float maxT, BvhHit* hits, uint n)
+{
+    BvhBatchJob job = {bvh, rays, maxT, hits};
+    parallelFor(n, BVH_PARALLEL_RAYS, bvhBatchRange, &job);
+}
+
+//- - - - - - - - - - - - - - -
+
+static void bvhBoundsRange(void* data, uint begin, uint end)
+{
+    BvhBuilder* b = data;
+
+    for (uint i = begin; i < end; ++i)
+    {
+        v3 v0 = b->vertices[b->indices ? b->indices[i * 3 + 0] : i * 3 + 0];
+        v3 v1 = b->vertices[b->indices ? b->indices[i * 3 + 1] : i * 3 + 1];
+        v3 v2 = b->vertices[b->indices ? b->indices[i * 3 + 2] : i * 3 + 2];
+
+        b->lo[i] = v3Min(v3Min(v0, v1), v2);
+        b->hi[i] = v3Max(v3Max(v0, v1), v2);
+        b->centroids[i] = v3Mulf(v3Add(b->lo[i], b->hi[i]), 0.5f);
+        b->order[i] = i;
+    }
+}
+
+static void bvhTaskRange(void* data, uint begin, uint end)
+{
+    BvhBuilder* b = data;
+
+    for (uint i = begin; i < end; ++i)
+    {
+        BvhTask* t = &b->tasks[i];
+        bvhBuild(b, t->node, t->first, t->count, t->depth, &t->next);
+    }
+}
+
+// Nodes come from *next, the shared counter while the top of the tree is
+// built and a task's own range after that. On the top level thread a big
+// enough subtree at taskDepth is recorded as a task instead of recursing.
+static void bvhBuild(BvhBuilder* b, uint node, uint first, uint count, uint depth, uint* next)
+{
+    BvhBuildNode* n = &b->nodes[node];
+
+    v3 lo = b->lo[b->order[first]], hi = b->hi[b->order[first]];
+    v3 clo = b->centroids[b->order[first]], chi = clo;
+
+    for (uint i = first + 1; i < first + count; ++i)
+    {
+        uint tri = b->order[i];
+        lo  = v3Min(lo, b->lo[tri]);
+        hi  = v3Max(hi, b->hi[tri]);
+        clo = v3Min(clo, b->centroids[tri]);
+        chi = v3Max(chi, b->centroids[tri]);
+    }
+
+    n->lo = lo;
+    n->hi = hi;
+    n->first = first;
+    n->count = count;
+
+    if (count <= 4)
+        return;
+
+    if (next == &b->nodeCount && depth == b->taskDepth && count >= BVH_TASK_MIN)
+    {
+        b->tasks[b->taskCount++] = (BvhTask){node, first, count, depth, 0};
+        n->count = 0;
+        return;
+    }
+
+    uint left = bvhSplit(b, first, count, clo, chi, depth);
+
+    n->count = 0;
+    n->left  = (*next)++;
+    n->right = (*next)++;
+
+    bvhBuild(b, n->left, first, left, depth + 1, next);
+    bvhBuild(b, n->right, first + left, count - left, depth + 1, next);
+}
+
+// Binned SAH over the centroid bounds, every axis is tried and the plane
+// with the lowest area * count cost on both sides wins. Returns how many
+// triangles ended up on the left, never 0 or count.
+static uint bvhSplit(BvhBuilder* b, uint first, uint count, v3 clo, v3 chi, uint depth)
+{
+    float lo[3] = {clo.x, clo.y, clo.z};
+    float ext[3] = {chi.x - clo.x, chi.y - clo.y, chi.z - clo.z};
+
+    float bestCost = 0.0f;
+    int bestAxis = -1, bestBin = 0;
+
+    for (int axis = 0; axis < 3 && depth < BVH_MEDIAN_DEPTH; ++axis)
+    {
+        if (ext[axis] <= 0.0f)
+            continue;
+
+        uint counts[BVH_BINS] = {0};
+        v3 blo[BVH_BINS], bhi[BVH_BINS];
+        float scale = BVH_BINS / ext[axis];
+
+        for (uint i = first; i < first + count; ++i)
+        {
+            uint tri = b->order[i];
+            int bin = MIN((int)(((&b->centroids[tri].x)[axis] - lo[axis]) * scale), BVH_BINS - 1);
+
+            blo[bin] = counts[bin] ? v3Min(blo[bin], b->lo[tri]) : b->lo[tri];
+            bhi[bin] = counts[bin] ? v3Max(bhi[bin], b->hi[tri]) : b->hi[tri];
+            counts[bin]++;
+        }
+
+        // Left sweep stores the cost of everything up to and including bin i
+        float leftCost[BVH_BINS];
+        uint n = 0;
+        v3 l = {0}, h = {0};
+
+        for (int i = 0; i < BVH_BINS - 1; ++i)
+        {
+            if (counts[i])
+            {
+                l = n ? v3Min(l, blo[i]) : blo[i];
+                h = n ? v3Max(h, bhi[i]) : bhi[i];
+                n += counts[i];
+            }
+            leftCost[i] = n ? bvhArea(l, h) * n : 0.0f;
+        }
+
+        n = 0;
+        for (int i = BVH_BINS - 1; i > 0; --i)
+        {
+            if (counts[i])
+            {
+                l = n ? v3Min(l, blo[i]) : blo[i];
+                h = n ? v3Max(h, bhi[i]) : bhi[i];
+                n += counts[i];
+            }
+
+            if (!n || n == count)
+                continue;
+
+            float cost = leftCost[i - 1] + bvhArea(l, h) * n;
+            if (bestAxis < 0 || cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin  = i - 1;
+            }
+        }
+    }
+
+    if (bestAxis < 0)
+        return count / 2;
+
+    float scale = BVH_BINS / ext[bestAxis];
+    uint i = first, j = first + count;
+
+    while (i < j)
+    {
+        uint tri = b->order[i];
+        int bin = MIN((int)(((&b->centroids[tri].x)[bestAxis] - lo[bestAxis]) * scale), BVH_BINS - 1);
+
+        if (bin <= bestBin)
+        {
+            ++i;
+        }
+        else
+        {
+            b->order[i] = b->order[--j];
+            b->order[j] = tri;
+        }
+    }
+
+    return i - first;
+}
+
+static float bvhArea(v3 lo, v3 hi)
+{
+    v3 d = v3Sub(hi, lo);
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static void bvhCount(const BvhBuilder* b, uint node, uint* inner, uint* leaves)
+{
+    const BvhBuildNode* n = &b->nodes[node];
+
+    if (n->count)
+    {
+        ++*leaves;
+        return;
+    }
+
+    ++*inner;
+    bvhCount(b, n->left, inner, leaves);
+    bvhCount(b, n->right, inner, leaves);
+}
+
+// Pulls up to four children out of a binary inner node by repeatedly opening
+// the inner child with the largest surface area
+static uint bvhEmit(Bvh* bvh, const BvhBuilder* b, uint node)
+{
+    const BvhBuildNode* n = &b->nodes[node];
+
+    if (n->count)
+    {
+        bvhEmitPacket(bvh, b, n);
+        return (bvh->packetCount - 1) | BVH_LEAF;
+    }
+
+    uint kids[4] = {n->left, n->right};
+    uint count = 2;
+
+    while (count < 4)
+    {
+        int open = -1;
+        float area = 0.0f;
+
+        for (uint i = 0; i < count; ++i)
+        {
+            const BvhBuildNode* k = &b->nodes[kids[i]];
+            float a = bvhArea(k->lo, k->hi);
+
+            if (!k->count && (open < 0 || a > area))
+            {
+                open = (int)i;
+                area = a;
+            }
+        }
+
+        if (open < 0)
+            break;
+
+        const BvhBuildNode* k = &b->nodes[kids[open]];
+        kids[open] = k->left;
+        kids[count++] = k->right;
+    }
+
+    uint index = bvh->nodeCount++;
+    bvhEmitNode(bvh, b, index, kids, count);
+    return index;
+}
+
+static void bvhEmitNode(Bvh* bvh, const BvhBuilder* b, uint index, const uint* kids, uint count)
+{
+    BvhNode* out = &bvh->nodes[index];
+    *out = (BvhNode){0};
+    out->count = count;
+
+    for (uint i = 0; i < count; ++i)
+    {
+        const BvhBuildNode* k = &b->nodes[kids[i]];
+        out->minX[i] = k->lo.x; out->minY[i] = k->lo.y; out->minZ[i] = k->lo.z;
+        out->maxX[i] = k->hi.x; out->maxY[i] = k->hi.y; out->maxZ[i] = k->hi.z;
+    }
+
+    // Children are emitted after the parent so the layout is depth first,
+    // bvh->nodes is preallocated so out stays valid across the recursion
+    for (uint i = 0; i < count; ++i)
+        out->child[i] = bvhEmit(bvh, b, kids[i]);
+}
+
+static void bvhEmitPacket(Bvh* bvh, const BvhBuilder* b, const BvhBuildNode* leaf)
+{
+    BvhPacket* p = &bvh->packets[bvh->packetCount++];
+    *p = (BvhPacket){0};
+
+    for (uint i = 0; i < 4; ++i)
+        p->triangle[i] = BVH_NO_HIT;
+
+    for (uint i = 0; i < leaf->count; ++i)
+    {
+        uint tri = b->order[leaf->first + i];
+        v3 v0 = b->vertices[b->indices ? b->indices[tri * 3 + 0] : tri * 3 + 0];
+        v3 v1 = b->vertices[b->indices ? b->indices[tri * 3 + 1] : tri * 3 + 1];
+        v3 v2 = b->vertices[b->indices ? b->indices[tri * 3 + 2] : tri * 3 + 2];
+        v3 e1 = v3Sub(v1, v0);
+        v3 e2 = v3Sub(v2, v0);
+
+        p->v0x[i] = v0.x; p->v0y[i] = v0.y; p->v0z[i] = v0.z;
+        p->e1x[i] = e1.x; p->e1y[i] = e1.y; p->e1z[i] = e1.z;
+        p->e2x[i] = e2.x; p->e2y[i] = e2.y; p->e2z[i] = e2.z;
+        p->triangle[i] = tri;
+    }
+}
+
+// Children are pushed farthest first so the nearest is opened next, entries
+// keep the distance they were pushed with and are skipped once a closer hit
+// has been found.
+static bool bvhTraverse(const Bvh* bvh, Ray r, float maxT, int any, BvhHit* hit)
+{
+    if (!bvh || !bvh->nodeCount)
+        return 0;
+
+    BvhRay ray = {
+        r.origin.x, r.origin.y, r.origin.z,
+        r.dir.x, r.dir.y, r.dir.z,
+        1.0f / r.dir.x, 1.0f / r.dir.y, 1.0f / r.dir.z
+    };
+
+    uint  stack[BVH_STACK_SIZE];
+    float dist[BVH_STACK_SIZE];
+    int top = 0;
+
+    float best = maxT;
+    BvhHit found = {0.0f, 0.0f, 0.0f, BVH_NO_HIT};
+
+    stack[top] = 0;
+    dist[top++] = 0.0f;
+
+    while (top)
+    {
+        --top;
+        if (dist[top] > best)
+            continue;
+
+        uint ref = stack[top];
+        float t[4], u[4], v[4];
+
+        if (ref & BVH_LEAF)
+        {
+            const BvhPacket* p = &bvh->packets[ref & ~BVH_LEAF];
+            int mask = bvhPacketHits(p, &ray, best, t, u, v);
+
+            for (int k = 0; k < 4; ++k)
+            {
+                if (!((mask >> k) & 1) || t[k] > best)
+                    continue;
+
+                best = t[k];
+                found = (BvhHit){t[k], u[k], v[k], p->triangle[k]};
+
+                if (any)
+                    break;
+            }
+
+            if (any && found.triangle != BVH_NO_HIT)
+                break;
+
+            continue;
+        }
+
+        const BvhNode* n = &bvh->nodes[ref];
+        int mask = bvhNodeHits(n, &ray, best, t);
+
+        int order[4], c = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+            if (!((mask >> k) & 1))
+                continue;
+
+            int j = c++;
+            for (; j > 0 && t[order[j - 1]] < t[k]; --j)
+                order[j] = order[j - 1];
+            order[j] = k;
+        }
+
+        for (int k = 0; k < c; ++k)
+        {
+            stack[top] = n->child[order[k]];
+            dist[top++] = t[order[k]];
+        }
+    }
+
+    if (found.triangle == BVH_NO_HIT)
+        return 0;
+
+    if (hit) *hit = found;
+    return 1;
+}
+
+static void bvhBatchRange(void* data, uint begin, uint end)
+{
+    BvhBatchJob* job = data;
+
+    for (uint i = begin; i < end; ++i)
+    {
+        BvhHit hit = {0.0f, 0.0f, 0.0f, BVH_NO_HIT};
+        bvhTraverse(job->bvh, job->rays[i], job->maxT, 0, &hit);
+        job->hits[i] = hit;
+    }
+}
+
+// Same slab test as rayCastAABBs on the four child boxes, t receives the
+// entry distances and the result has a bit set per child hit before best
+static inline int bvhNodeHits(const BvhNode* n, const BvhRay* r, float best, float* t)
+{
+    int valid = (1 << n->count) - 1;
+
+#ifdef MATHS_SSE2
+    __m128 ox = _mm_set1_ps(r->ox), oy = _mm_set1_ps(r->oy), oz = _mm_set1_ps(r->oz);
+    __m128 ix = _mm_set1_ps(r->ix), iy = _mm_set1_ps(r->iy), iz = _mm_set1_ps(r->iz);
+
+    __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n->minX), ox), ix), tx2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n->maxX), ox), ix);
+    __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n->minY), oy), iy), ty2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n->maxY), oy), iy);
+    __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n->minZ), oz), iz), tz2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n->maxZ), oz), iz);
+
+    __m128 tmin = _mm_max_ps(_mm_max_ps(_mm_max_ps(_mm_setzero_ps(), _mm_min_ps(tx1, tx2)), _mm_min_ps(ty1, ty2)), _mm_min_ps(tz1, tz2));
+    __m128 tmax = _mm_min_ps(_mm_min_ps(_mm_min_ps(_mm_set1_ps(best), _mm_max_ps(tx1, tx2)), _mm_max_ps(ty1, ty2)), _mm_max_ps(tz1, tz2));
+
+    _mm_storeu_ps(t, tmin);
+    return _mm_movemask_ps(_mm_cmple_ps(tmin, tmax)) & valid;
+#else
+    int mask = 0;
+
+    for (int k = 0; k < 4; ++k)
+    {
+        float tx1 = (n->minX[k] - r->ox) * r->ix, tx2 = (n->maxX[k] - r->ox) * r->ix;
+        float ty1 = (n->minY[k] - r->oy) * r->iy, ty2 = (n->maxY[k] - r->oy) * r->iy;
+        float tz1 = (n->minZ[k] - r->oz) * r->iz, tz2 = (n->maxZ[k] - r->oz) * r->iz;
+
+        float tmin = MAX(MAX(MAX(0.0f, MIN(tx1, tx2)), MIN(ty1, ty2)), MIN(tz1, tz2));
+        float tmax = MIN(MIN(MIN(best, MAX(tx1, tx2)), MAX(ty1, ty2)), MAX(tz1, tz2));
+
+        t[k] = tmin;
+        mask |= (tmin <= tmax) << k;
+    }
+
+    return mask & valid;
+#endif // MATHS_SSE2
+}
+
+// rayCastTriangle on four triangles at once, padding lanes have zero edges
+// so their determinant fails the epsilon test
+static inline int bvhPacketHits(const BvhPacket* p, const BvhRay* r, float best, float* t, float* u, float* v)
+{
+#ifdef MATHS_SSE2
+    __m128 dx = _mm_set1_ps(r->dx), dy = _mm_set1_ps(r->dy), dz = _mm_set1_ps(r->dz);
+    __m128 e1x = _mm_loadu_ps(p->e1x), e1y = _mm_loadu_ps(p->e1y), e1z = _mm_loadu_ps(p->e1z);
+    __m128 e2x = _mm_loadu_ps(p->e2x), e2y = _mm_loadu_ps(p->e2y), e2z = _mm_loadu_ps(p->e2z);
+
+    __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    __m128 sx = _mm_sub_ps(_mm_set1_ps(r->ox), _mm_loadu_ps(p->v0x));
+    __m128 sy = _mm_sub_ps(_mm_set1_ps(r->oy), _mm_loadu_ps(p->v0y));
+    __m128 sz = _mm_sub_ps(_mm_set1_ps(r->oz), _mm_loadu_ps(p->v0z));
+
+    __m128 uu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv);
+
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+
+    __m128 vv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv);
+    __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 hit = _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), det), _mm_set1_ps(COLLISION_EPSILON));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(uu, zero));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(vv, zero));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(uu, vv), _mm_set1_ps(1.0f)));
+    hit = _mm_and_ps(hit, _mm_cmpge_ps(tt, zero));
+    hit = _mm_and_ps(hit, _mm_cmple_ps(tt, _mm_set1_ps(best)));
+
+    _mm_storeu_ps(t, tt);
+    _mm_storeu_ps(u, uu);
+    _mm_storeu_ps(v, vv);
+    return _mm_movemask_ps(hit);
+#else
+    int mask = 0;
+
+    for (int k = 0; k < 4; ++k)
+    {
+        float px = r->dy * p->e2z[k] - r->dz * p->e2y[k];
+        float py = r->dz * p->e2x[k] - r->dx * p->e2z[k];
+        float pz = r->dx * p->e2y[k] - r->dy * p->e2x[k];
+
+        float det = p->e1x[k] * px + p->e1y[k] * py + p->e1z[k] * pz;
+        float inv = 1.0f / det;
+
+        float sx = r->ox - p->v0x[k], sy = r->oy - p->v0y[k], sz = r->oz - p->v0z[k];
+        float uu = (sx * px + sy * py + sz * pz) * inv;
+
+        float qx = sy * p->e1z[k] - sz * p->e1y[k];
+        float qy = sz * p->e1x[k] - sx * p->e1z[k];
+        float qz = sx * p->e1y[k] - sy * p->e1x[k];
+
+        float vv = (r->dx * qx + r->dy * qy + r->dz * qz) * inv;
+        float tt = (p->e2x[k] * qx + p->e2y[k] * qy + p->e2z[k] * qz) * inv;
+
+        t[k] = tt;
+        u[k] = uu;
+        v[k] = vv;
+        mask |= (fabsf(det) > COLLISION_EPSILON && uu >= 0.0f && vv >= 0.0f && uu + vv <= 1.0f && tt >= 0.0f && tt <= best) << k;
+    }
+
+    return mask;
+#endif // MATHS_SSE2
+}
+
+//-----------------------------
+// ~AabbTree
+
+#define AABBTREE_GROW  16   // Initial node capacity, doubled from there
+#define AABBTREE_SLACK 4.0f // Fat boxes looser than this many margins are shrunk on the next move
+
+static uint aabbTreeAllocNode(AabbTree* tree);
+static void aabbTreeFreeNode(AabbTree* tree, uint node);
+static void aabbTreeInsertLeaf(AabbTree* tree, uint leaf);
+static void aabbTreeRemoveLeaf(AabbTree* tree, uint leaf);
+static uint aabbTreeBalance(AabbTree* tree, uint a);
+static void aabbTreeRefit(AabbTree* tree, uint node);
+static bool aabbTreeBufferMove(AabbTree* tree, uint proxy);
+static void aabbTreeFindPairs(AabbTree* tree, uint proxy);
+static int  aabbTreeComparePairs(const void* a, const void* b);
+
+static inline bool aabbTreeOverlaps(v3 alo, v3 ahi, v3 blo, v3 bhi)
+{
+    return alo.x <= bhi.x && blo.x <= ahi.x &&
+           alo.y <= bhi.y && blo.y <= ahi.y &&
+           alo.z <= bhi.z && blo.z <= ahi.z;
+}
+
+static inline bool aabbTreeEncloses(v3 alo, v3 ahi, v3 blo, v3 bhi)
+{
+    return alo.x <= blo.x && alo.y <= blo.y && alo.z <= blo.z &&
+           bhi.x <= ahi.x && bhi.y <= ahi.y && bhi.z <= ahi.z;
+}
+
+AabbTree* aabbTreeCreate(float margin)
+{
+    AabbTree* tree = calloc(1, sizeof *tree);
+
+    if (!tree)
+        return NULL;
+
+    tree->root     = AABBTREE_NULL;
+    tree->freeList = AABBTREE_NULL;
+    tree->margin   = margin;
+    return tree;
+}
+
+void aabbTreeDestroy(AabbTree* tree)
+{
+    if (!tree)
+        return;
+
+    free(tree->nodes);
+    free(tree->moved);
+    free(tree->pairs);
+    free(tree);
+}
+
+uint aabbTreeInsert(AabbTree* tree, AABB box, uint data)
+{
+    // The leaf also needs a parent, both are allocated up front and the spare
+    // one put back on the free list so aabbTreeInsertLeaf can't run out
+    uint leaf  = aabbTreeAllocNode(tree);
+    uint spare = leaf != AABBTREE_NULL ? aabbTreeAllocNode(tree) : AABBTREE_NULL;
+
+    if (spare == AABBTREE_NULL)
+    {
+        if (leaf != AABBTREE_NULL)
+            aabbTreeFreeNode(tree, leaf);
+        return AABBTREE_NULL;
+    }
+
+    aabbTreeFreeNode(tree, spare);
+
+    AabbTreeNode* n = &tree->nodes[leaf];
+    n->lo     = v3Subf((v3){box.x, box.y, box.z}, tree->margin);
+    n->hi     = v3Addf((v3){box.x + box.w, box.y + box.h, box.z + box.d}, tree->margin);
+    n->height = 0;
+    n->data   = data;
+    n->moved  = 0;
+
+    if (!aabbTreeBufferMove(tree, leaf))
+    {
+        aabbTreeFreeNode(tree, leaf);
+        return AABBTREE_NULL;
+    }
+
+    aabbTreeInsertLeaf(tree, leaf);
+    return leaf;
+}
+
+void aabbTreeRemove(AabbTree* tree, uint proxy)
+{
+    if (tree->nodes[proxy].moved)
+    {
+        for (uint i = 0; i < tree->movedCount; ++i)
+            if (tree->moved[i] == proxy)
+                tree->moved[i] = AABBTREE_NULL;
+    }
+
+    aabbTreeRemoveLeaf(tree, proxy);
+    aabbTreeFreeNode(tree, proxy);
+}
+
+// A fat box that still encloses the object is kept unless it grew so loose
+// from an earlier displacement that it would report far too many pairs
+bool aabbTreeMove(AabbTree* tree, uint proxy, AABB box, v3 displacement)
+{
+    AabbTreeNode* n = &tree->nodes[proxy];
+
+    v3 lo = {box.x, box.y, box.z};
+    v3 hi = {box.x + box.w, box.y + box.h, box.z + box.d};
+
+    v3 fatLo = v3Subf(lo, tree->margin);
+    v3 fatHi = v3Addf(hi, tree->margin);
+    fatLo = v3Add(fatLo, v3Min(displacement, (v3){0.0f, 0.0f, 0.0f}));
+    fatHi = v3Add(fatHi, v3Max(displacement, (v3){0.0f, 0.0f, 0.0f}));
+
+    if (aabbTreeEncloses(n->lo, n->hi, lo, hi))
+    {
+        float slack = AABBTREE_SLACK * tree->margin;
+        if (aabbTreeEncloses(v3Subf(fatLo, slack), v3Addf(fatHi, slack), n->lo, n->hi))
+            return 0;
+    }
+
+    aabbTreeRemoveLeaf(tree, proxy);
+    n->lo = fatLo;
+    n->hi = fatHi;
+    aabbTreeInsertLeaf(tree, proxy);
+
+    // The proxy is already reinserted, so rather than undo that the next
+    // aabbTreeUpdatePairs treats every leaf as moved
+    if (!aabbTreeBufferMove(tree, proxy))
+        tree->rebuildPairs = 1;
+
+    return 1;
+}
+
+AABB aabbTreeFatBox(const AabbTree* tree, uint proxy)
+{
+    const AabbTreeNode* n = &tree->nodes[proxy];
+    return (AABB){n->lo.x, n->lo.y, n->lo.z, n->hi.x - n->lo.x, n->hi.y - n->lo.y, n->hi.z - n->lo.z};
+}
+
+uint aabbTreeData(const AabbTree* tree, uint proxy)
+{
+    return tree->nodes[proxy].data;
+}
+
+// Walks the tree through the parent links, so no stack is needed however
+// deep the tree gets: coming down a node is tested, coming up from the left
+// child the right one is next, coming up from the right the parent is.
+void aabbTreeQuery(const AabbTree* tree, AABB box, AabbTreeQueryFn fn, void* ctx)
+{
+    v3 lo = {box.x, box.y, box.z};
+    v3 hi = {box.x + box.w, box.y + box.h, box.z + box.d};
+
+    uint node = tree->root, prev = AABBTREE_NULL;
+
+    while (node != AABBTREE_NULL)
+    {
+        const AabbTreeNode* n = &tree->nodes[node];
+        uint from = prev;
+        prev = node;
+
+        if (from == n->parent)
+        {
+            if (!aabbTreeOverlaps(lo, hi, n->lo, n->hi))
+            {
+                node = n->parent;
+            }
+            else if (n->left == AABBTREE_NULL)
+            {
+                if (!fn(ctx, node))
+                    return;
+                node = n->parent;
+            }
+            else
+            {
+                node = n->left;
+            }
+        }
+        else
+        {
+            node = from == n->left ? n->right : n->parent;
+        }
+    }
+}
+
+void aabbTreeRayCast(const AabbTree* tree, Ray r, float maxT, AabbTreeRayFn fn, void* ctx)
+{
+    v3 inv = {1.0f / r.dir.x, 1.0f / r.dir.y, 1.0f / r.dir.z};
+
+    uint node = tree->root, prev = AABBTREE_NULL;
+
+    while (node != AABBTREE_NULL)
+    {
+        const AabbTreeNode* n = &tree->nodes[node];
+        uint from = prev;
+        prev = node;
+
+        if (from != n->parent)
+        {
+            node = from == n->left ? n->right : n->parent;
+            continue;
+        }
+
+        // Same slab test as rayCastAABB
+        float tmin = 0.0f, tmax = maxT;
+        bool crosses = collisionClipSlab(n->lo.x, n->hi.x, r.origin.x, r.dir.x, inv.x, &tmin, &tmax)
+                    && collisionClipSlab(n->lo.y, n->hi.y, r.origin.y, r.dir.y, inv.y, &tmin, &tmax)
+                    && collisionClipSlab(n->lo.z, n->hi.z, r.origin.z, r.dir.z, inv.z, &tmin, &tmax);
+
+        if (!crosses || tmin > tmax)
+        {
+            node = n->parent;
+        }
+        else if (n->left == AABBTREE_NULL)
+        {
+            float t = fn(ctx, node, r, maxT);
+            if (t < 0.0f)
+                return;
+            maxT = MIN(maxT, t);
+            node = n->parent;
+        }
+        else
+        {
+            node = n->left;
+        }
+    }
+}
+
+// Every moved proxy queries the tree with its fat box. When both proxies of
+// a pair moved it is only recorded from the lower id's query, and sorting
+// makes the order independent of the tree's shape. After a move that didn't
+// fit in the buffer every leaf is queried instead.
+uint aabbTreeUpdatePairs(AabbTree* tree, const AabbPair** pairs)
+{
+    tree->pairCount = 0;
+
+    if (tree->rebuildPairs)
+    {
+        for (uint i = 0; i < tree->capacity; ++i)
+            if (tree->nodes[i].height == 0)
+                tree->nodes[i].moved = 1;
+
+        for (uint i = 0; i < tree->capacity; ++i)
+            if (tree->nodes[i].height == 0)
+                aabbTreeFindPairs(tree, i);
+
+        for (uint i = 0; i < tree->capacity; ++i)
+            tree->nodes[i].moved = 0;
+
+        tree->rebuildPairs = 0;
+    }
+    else
+    {
+        for (uint i = 0; i < tree->movedCount; ++i)
+            if (tree->moved[i] != AABBTREE_NULL)
+                aabbTreeFindPairs(tree, tree->moved[i]);
+
+        for (uint i = 0; i < tree->movedCount; ++i)
+            if (tree->moved[i] != AABBTREE_NULL)
+                tree->nodes[tree->moved[i]].moved = 0;
+    }
+
+    tree->movedCount = 0;
+
+    qsort(tree->pairs, tree->pairCount, sizeof *tree->pairs, aabbTreeComparePairs);
+
+    if (pairs) *pairs = tree->pairs;
+    return tree->pairCount;
+}
+
+//- - - - - - - - - - - - - - -
+
+static uint aabbTreeAllocNode(AabbTree* tree)
+{
+    if (tree->freeList == AABBTREE_NULL)
+    {
+        uint capacity = tree->capacity ? tree->capacity * 2 : AABBTREE_GROW;
+        AabbTreeNode* nodes = realloc(tree->nodes, capacity * sizeof *nodes);
+
+        if (!nodes)
+            return AABBTREE_NULL;
+
+        for (uint i = tree->capacity; i < capacity; ++i)
+        {
+            nodes[i].parent = i + 1 < capacity ? i + 1 : AABBTREE_NULL;
+            nodes[i].height = -1;
+        }
+
+        tree->nodes    = nodes;
+        tree->freeList = tree->capacity;
+        tree->capacity = capacity;
+    }
+
+    uint node = tree->freeList;
+    AabbTreeNode* n = &tree->nodes[node];
+    tree->freeList = n->parent;
+
+    n->parent = AABBTREE_NULL;
+    n->left   = AABBTREE_NULL;
+    n->right  = AABBTREE_NULL;
+    n->height = 0;
+    n->data   = 0;
+    n->moved  = 0;
+    return node;
+}
+
+static void aabbTreeFreeNode(AabbTree* tree, uint node)
+{
+    tree->nodes[node].parent = tree->freeList;
+    tree->nodes[node].height = -1;
+    tree->freeList = node;
+}
+
+// Walks down towards the sibling that costs the least surface area, where
+// stopping at a node costs a new parent over it and going on costs the
+// growth of every box passed on the way down
+static void aabbTreeInsertLeaf(AabbTree* tree, uint leaf)
+{
+    if (tree->root == AABBTREE_NULL)
+    {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = AABBTREE_NULL;
+        return;
+    }
+
+    v3 lo = tree->nodes[leaf].lo;
+    v3 hi = tree->nodes[leaf].hi;
+
+    uint sibling = tree->root;
+
+    while (tree->nodes[sibling].left != AABBTREE_NULL)
+    {
+        const AabbTreeNode* n = &tree->nodes[sibling];
+
+        float area     = bvhArea(n->lo, n->hi);
+        float combined = bvhArea(v3Min(lo, n->lo), v3Max(hi, n->hi));
+
+        float cost        = 2.0f * combined;
+        float inheritance = 2.0f * (combined - area);
+
+        float childCost[2];
+        uint  child[2] = {n->left, n->right};
+
+        for (int i = 0; i < 2; ++i)
+        {
+            const AabbTreeNode* c = &tree->nodes[child[i]];
+            float grown = bvhArea(v3Min(lo, c->lo), v3Max(hi, c->hi));
+
+            if (c->left == AABBTREE_NULL)
+                childCost[i] = grown + inheritance;
+            else
+                childCost[i] = grown - bvhArea(c->lo, c->hi) + inheritance;
+        }
+
+        if (cost < childCost[0] && cost < childCost[1])
+            break;
+
+        sibling = childCost[0] < childCost[1] ? child[0] : child[1];
+    }
+
+    // Callers leave a free node so this never grows the array
+    uint parent = aabbTreeAllocNode(tree);
+
+    AabbTreeNode* p = &tree->nodes[parent];
+    AabbTreeNode* s = &tree->nodes[sibling];
+    uint grandparent = s->parent;
+
+    p->parent = grandparent;
+    p->left   = sibling;
+    p->right  = leaf;
+    p->lo     = v3Min(lo, s->lo);
+    p->hi     = v3Max(hi, s->hi);
+    p->height = s->height + 1;
+
+    s->parent = parent;
+    tree->nodes[leaf].parent = parent;
+
+    if (grandparent == AABBTREE_NULL)
+        tree->root = parent;
+    else if (tree->nodes[grandparent].left == sibling)
+        tree->nodes[grandparent].left = parent;
+    else
+        tree->nodes[grandparent].right = parent;
+
+    for (uint i = tree->nodes[leaf].parent; i != AABBTREE_NULL; i = tree->nodes[i].parent)
+    {
+        i = aabbTreeBalance(tree, i);
+        aabbTreeRefit(tree, i);
+    }
+}
+
+// The leaf's parent goes back on the free list, where aabbTreeMove's
+// reinsert picks it up again, and the sibling takes its place
+static void aabbTreeRemoveLeaf(AabbTree* tree, uint leaf)
+{
+    if (leaf == tree->root)
+    {
+        tree->root = AABBTREE_NULL;
+        return;
+    }
+
+    uint parent      = tree->nodes[leaf].parent;
+    uint grandparent = tree->nodes[parent].parent;
+    uint sibling     = tree->nodes[parent].left == leaf ? tree->nodes[parent].right : tree->nodes[parent].left;
+
+    tree->nodes[sibling].parent = grandparent;
+    aabbTreeFreeNode(tree, parent);
+
+    if (grandparent == AABBTREE_NULL)
+    {
+        tree->root = sibling;
+        return;
+    }
+
+    if (tree->nodes[grandparent].left == parent)
+        tree->nodes[grandparent].left = sibling;
+    else
+        tree->nodes[grandparent].right = sibling;
+
+    for (uint i = grandparent; i != AABBTREE_NULL; i = tree->nodes[i].parent)
+    {
+        i = aabbTreeBalance(tree, i);
+        aabbTreeRefit(tree, i);
+    }
+}
+
+// If one child of a is two or more levels taller than the other it is
+// rotated up into a's place. Of its own children the taller stays with it
+// and the shorter moves under a. Returns the node now at a's position.
+static uint aabbTreeBalance(AabbTree* tree, uint a)
+{
+    AabbTreeNode* nodes = tree->nodes;
+    AabbTreeNode* A = &nodes[a];
+
+    if (A->left == AABBTREE_NULL || A->height < 2)
+        return a;
+
+    int balance = nodes[A->right].height - nodes[A->left].height;
+
+    if (balance >= -1 && balance <= 1)
+        return a;
+
+    bool rightUp = balance > 0;
+    uint up   = rightUp ? A->right : A->left;
+    AabbTreeNode* U = &nodes[up];
+
+    uint tall  = nodes[U->left].height > nodes[U->right].height ? U->left : U->right;
+    uint small = tall == U->left ? U->right : U->left;
+
+    // up takes a's place under a's parent
+    U->parent = A->parent;
+    if (U->parent == AABBTREE_NULL)
+        tree->root = up;
+    else if (nodes[U->parent].left == a)
+        nodes[U->parent].left = up;
+    else
+        nodes[U->parent].right = up;
+
+    // a becomes up's child in the slot the short grandchild leaves, the
+    // short grandchild fills the slot up left in a
+    U->left  = a;
+    U->right = tall;
+    A->parent = up;
+
+    if (rightUp)
+        A->right = small;
+    else
+        A->left = small;
+    nodes[small].parent = a;
+
+    aabbTreeRefit(tree, a);
+    aabbTreeRefit(tree, up);
+    return up;
+}
+
+static void aabbTreeRefit(AabbTree* tree, uint node)
+{
+    AabbTreeNode* n = &tree->nodes[node];
+    const AabbTreeNode* l = &tree->nodes[n->left];
+    const AabbTreeNode* r = &tree->nodes[n->right];
+
+    n->lo     = v3Min(l->lo, r->lo);
+    n->hi     = v3Max(l->hi, r->hi);
+    n->height = 1 + MAX(l->height, r->height);
+}
+
+static bool aabbTreeBufferMove(AabbTree* tree, uint proxy)
+{
+    if (tree->nodes[proxy].moved)
+        return 1;
+
+    if (tree->movedCount == tree->movedCapacity)
+    {
+        uint capacity = tree->movedCapacity ? tree->movedCapacity * 2 : AABBTREE_GROW;
+        uint* moved = realloc(tree->moved, capacity * sizeof *moved);
+
+        if (!moved)
+            return 0;
+
+        tree->moved = moved;
+        tree->movedCapacity = capacity;
+    }
+
+    tree->moved[tree->movedCount++] = proxy;
+    tree->nodes[proxy].moved = 1;
+    return 1;
+}
+
+// Same walk as aabbTreeQuery with the pair recording inlined
+static void aabbTreeFindPairs(AabbTree* tree, uint proxy)
+{
+    v3 lo = tree->nodes[proxy].lo;
+    v3 hi = tree->nodes[proxy].hi;
+
+    uint node = tree->root, prev = AABBTREE_NULL;
+
+    while (node != AABBTREE_NULL)
+    {
+        const AabbTreeNode* n = &tree->nodes[node];
+        uint from = prev;
+        prev = node;
+
+        if (from != n->parent)
+        {
+            node = from == n->left ? n->right : n->parent;
+            continue;
+        }
+
+        if (!aabbTreeOverlaps(lo, hi, n->lo, n->hi))
+        {
+            node = n->parent;
+            continue;
+        }
+
+        if (n->left != AABBTREE_NULL)
+        {
+            node = n->left;
+            continue;
+        }
+
+        if (node != proxy && !(n->moved && node < proxy))
+        {
+            if (tree->pairCount == tree->pairCapacity)
+            {
+                uint capacity = tree->pairCapacity ? tree->pairCapacity * 2 : AABBTREE_GROW;
+                AabbPair* pairs = realloc(tree->pairs, capacity * sizeof *pairs);
+
+                if (!pairs)
+                    return;
+
+                tree->pairs = pairs;
+                tree->pairCapacity = capacity;
+            }
+
+            tree->pairs[tree->pairCount++] = (AabbPair){MIN(node, proxy), MAX(node, proxy)};
+        }
+
+        node = n->parent;
+    }
+}
+
+static int aabbTreeComparePairs(const void* a, const void* b)
+{
+    const AabbPair* pa = a;
+    const AabbPair* pb = b;
+
+    if (pa->a != pb->a)
+        return pa->a < pb->a ? -1 : 1;
+
+    if (pa->b != pb->b)
+        return pa->b < pb->b ? -1 : 1;
+
+    return 0;
+}
+
+//-----------------------------
+// ~Grid
+
+#define GRID_BLOCK   1024 // Objects per build block, every block keeps its own radix histogram
+#define GRID_RADIX   256  // Buckets are sorted on their top 8 bits first, then within each digit
+#define GRID_BUCKETS 1024 // Smallest bucket table, at least 4 buckets per digit
+
+typedef struct GridJob
+{
+    Grid* grid;
+    const Rect* rects;
+    const Circle* circles;
+    uint blocks;
+    uint shift;        // Bucket >> shift is the radix digit
+    uint* digitStart;  // Pair offsets per digit, GRID_RADIX + 1
+} GridJob;
+
+static bool gridCreateBuild(Grid* grid, const Rect* rects, const Circle* circles, uint n);
+static bool gridGrow(void* array, uint count, size_t size);
+static void gridCellsRange(void* data, uint begin, uint end);
+static void gridEmitRange(void* data, uint begin, uint end);
+static void gridScatterRange(void* data, uint begin, uint end);
+static void gridSortRange(void* data, uint begin, uint end);
+static void gridCountPairsRange(void* data, uint begin, uint end);
+static void gridFillPairsRange(void* data, uint begin, uint end);
+static uint gridBucketPairs(const Grid* grid, uint first, uint last, AabbPair* out);
+static uint gridQuery(const Grid* grid, v4 lo, const Circle* c, uint* out, uint max);
+
+static inline int gridCell(const Grid* grid, float x)
+{
+    return (int)floorf(x / grid->cellSize);
+}
+
+static inline uint gridHash(const Grid* grid, int x, int y)
+{
+    return ((uint)x * 0x8da6b343u ^ (uint)y * 0xd8163841u) & (grid->bucketCount - 1);
+}
+
+Grid* gridCreate(float cellSize)
+{
+    Grid* grid = calloc(1, sizeof *grid);
+
+    if (!grid)
+        return NULL;
+
+    grid->cellSize = cellSize;
+    return grid;
+}
+
+void gridDestroy(Grid* grid)
+{
+    if (!grid)
+        return;
+
+    free(grid->bucketStart);
+    free(grid->items);
+    free(grid->itemCells);
+    free(grid->itemBounds);
+    free(grid->bounds);
+    free(grid->cells);
+    free(grid->keys);
+    free(grid->sortKeys);
+    free(grid->sortItems);
+    free(grid->sortCells);
+    free(grid->cursor);
+    free(grid->blockStart);
+    free(grid->histogram);
+    free(grid->pairs);
+    free(grid);
+}
+
+bool gridBuild(Grid* grid, const Rect* rects, uint n)
+{
+    return gridCreateBuild(grid, rects, NULL, n);
+}
+
+bool gridBuildCircles(Grid* grid, const Circle* circles, uint n)
+{
+    return gridCreateBuild(grid, NULL, circles, n);
+}
+
+uint gridQueryRect(const Grid* grid, Rect r, uint* out, uint max)
+{
+    return gridQuery(grid, (v4){r.x, r.y, r.x + r.w, r.y + r.h}, NULL, out, max);
+}
+
+uint gridQueryCircle(const Grid* grid, Circle c, uint* out, uint max)
+{
+    return gridQuery(grid, (v4){c.x - c.r, c.y - c.r, c.x + c.r, c.y + c.r}, &c, out, max);
+}
+
+// Walks the buckets in order so every scan is linear, split by radix digit
+// so threads own disjoint bucket ranges. Counted first so every digit knows
+// where its pairs go, then filled and sorted.
+uint gridPairs(Grid* grid, const AabbPair** pairs)
+{
+    uint digitStart[GRID_RADIX + 1];
+    uint threshold = grid->objectCount >= parallelThreshold() ? 0 : (uint)-1;
+
+    GridJob job = {grid, NULL, NULL, 0, 0, digitStart};
+    grid->pairCount = 0;
+
+    if (pairs) *pairs = grid->pairs;
+
+    if (!grid->itemCount)
+        return 0;
+
+    while (((uint)GRID_RADIX << job.shift) < grid->bucketCount)
+        ++job.shift;
+
+    parallelFor(GRID_RADIX, threshold, gridCountPairsRange, &job);
+
+    uint total = 0;
+    for (uint d = 0; d < GRID_RADIX; ++d)
+    {
+        uint count = digitStart[d];
+        digitStart[d] = total;
+        total += count;
+    }
+    digitStart[GRID_RADIX] = total;
+
+    if (total > grid->pairCapacity)
+    {
+        if (!gridGrow(&grid->pairs, total, sizeof *grid->pairs))
+            return 0;
+
+        grid->pairCapacity = total;
+    }
+
+    parallelFor(GRID_RADIX, threshold, gridFillPairsRange, &job);
+
+    qsort(grid->pairs, total, sizeof *grid->pairs, aabbTreeComparePairs);
+
+    grid->pairCount = total;
+    if (pairs) *pairs = grid->pairs;
+    return total;
+}
+
+//- - - - - - - - - - - - - - -
+
+// Per block cell ranges and entry counts, a prefix over the blocks, the
+// entries written out per block with a histogram of their top bucket bits,
+// a stable scatter by that digit and finally a counting sort of each digit
+// on its own. Every pass is split by blocks or digits so nothing is shared
+// between threads, and the order within a bucket is always ascending ids.
+static bool gridCreateBuild(Grid* grid, const Rect* rects, const Circle* circles, uint n)
+{
+    uint blocks = (n + GRID_BLOCK - 1) / GRID_BLOCK;
+    uint threshold = n >= parallelThreshold() ? 0 : (uint)-1;
+
+    grid->objectCount = 0;
+    grid->itemCount   = 0;
+    grid->bucketCount = 0;
+    grid->pairCount   = 0;
+
+    if (!n)
+        return 1;
+
+    if (n > grid->objectCapacity)
+    {
+        if (!gridGrow(&grid->bounds, n, sizeof *grid->bounds) ||
+            !gridGrow(&grid->cells, n, sizeof *grid->cells))
+            return 0;
+
+        grid->objectCapacity = n;
+    }
+
+    if (blocks + 1 > grid->blockCapacity)
+    {
+        if (!gridGrow(&grid->blockStart, blocks + 1, sizeof *grid->blockStart) ||
+            !gridGrow(&grid->histogram, blocks * GRID_RADIX, sizeof *grid->histogram))
+            return 0;
+
+        grid->blockCapacity = blocks + 1;
+    }
+
+    GridJob job = {grid, rects, circles, blocks, 0, NULL};
+    grid->objectCount = n;
+
+    parallelFor(blocks, threshold, gridCellsRange, &job);
+
+    uint total = 0;
+    for (uint b = 0; b < blocks; ++b)
+    {
+        uint count = grid->blockStart[b];
+        grid->blockStart[b] = total;
+        total += count;
+    }
+    grid->blockStart[blocks] = total;
+
+    uint buckets = GRID_BUCKETS, shift = 2;
+    while (buckets < total)
+    {
+        buckets <<= 1;
+        ++shift;
+    }
+
+    if (total > grid->itemCapacity)
+    {
+        if (!gridGrow(&grid->items, total, sizeof *grid->items) ||
+            !gridGrow(&grid->itemCells, total, sizeof *grid->itemCells) ||
+            !gridGrow(&grid->itemBounds, total, sizeof *grid->itemBounds) ||
+            !gridGrow(&grid->keys, total, sizeof *grid->keys) ||
+            !gridGrow(&grid->sortKeys, total, sizeof *grid->sortKeys) ||
+            !gridGrow(&grid->sortItems, total, sizeof *grid->sortItems) ||
+            !gridGrow(&grid->sortCells, total, sizeof *grid->sortCells))
+        {
+            grid->objectCount = 0;
+            return 0;
+        }
+
+        grid->itemCapacity = total;
+    }
+
+    if (buckets > grid->bucketCapacity)
+    {
+        if (!gridGrow(&grid->bucketStart, buckets + 1, sizeof *grid->bucketStart) ||
+            !gridGrow(&grid->cursor, buckets, sizeof *grid->cursor))
+        {
+            grid->objectCount = 0;
+            return 0;
+        }
+
+        grid->bucketCapacity = buckets;
+    }
+
+    grid->itemCount   = total;
+    grid->bucketCount = buckets;
+    job.shift = shift;
+
+    parallelFor(blocks, threshold, gridEmitRange, &job);
+
+    // Digit major offsets so each digit's entries stay in block order
+    uint offset = 0;
+    for (uint d = 0; d < GRID_RADIX; ++d)
+    {
+        for (uint b = 0; b < blocks; ++b)
+        {
+            uint count = grid->histogram[b * GRID_RADIX + d];
+            grid->histogram[b * GRID_RADIX + d] = offset;
+            offset += count;
+        }
+    }
+
+    parallelFor(blocks, threshold, gridScatterRange, &job);
+    parallelFor(GRID_RADIX, threshold, gridSortRange, &job);
+
+    grid->bucketStart[buckets] = total;
+    return 1;
+}
+
+static bool gridGrow(void* array, uint count, size_t size)
+{
+    void** p = array;
+    void* grown = realloc(*p, count * size);
+
+    if (!grown)
+        return 0;
+
+    *p = grown;
+    return 1;
+}
+
+static void gridCellsRange(void* data, uint begin, uint end)
+{
+    GridJob* job = data;
+    Grid* grid = job->grid;
+
+    for (uint b = begin; b < end; ++b)
+    {
+        uint last  = MIN((b + 1) * GRID_BLOCK, grid->objectCount);
+        uint count = 0;
+
+        for (uint i = b * GRID_BLOCK; i < last; ++i)
+        {
+            v4 bounds;
+
+            if (job->rects)
+            {
+                Rect r = job->rects[i];
+                bounds = (v4){r.x, r.y, r.x + r.w, r.y + r.h};
+            }
+            else
+            {
+                Circle c = job->circles[i];
+                bounds = (v4){c.x - c.r, c.y - c.r, c.x + c.r, c.y + c.r};
+            }
+
+            iv4 cells = {
+                gridCell(grid, bounds.x), gridCell(grid, bounds.y),
+                gridCell(grid, bounds.z), gridCell(grid, bounds.w)
+            };
+
+            grid->bounds[i] = bounds;
+            grid->cells[i]  = cells;
+            count += (uint)(cells.z - cells.x + 1) * (uint)(cells.w - cells.y + 1);
+        }
+
+        grid->blockStart[b] = count;
+    }
+}
+
+// items and itemCells hold the unsorted entries until gridSortRange
+static void gridEmitRange(void* data, uint begin, uint end)
+{
+    GridJob* job = data;
+    Grid* grid = job->grid;
+
+    for (uint b = begin; b < end; ++b)
+    {
+        uint* histogram = grid->histogram + b * GRID_RADIX;
+        uint  last = MIN((b + 1) * GRID_BLOCK, grid->objectCount);
+        uint  p = grid->blockStart[b];
+
+        for (uint d = 0; d < GRID_RADIX; ++d)
+            histogram[d] = 0;
+
+        for (uint i = b * GRID_BLOCK; i < last; ++i)
+        {
+            iv4 c = grid->cells[i];
+
+            for (int y = c.y; y <= c.w; ++y)
+            {
+                for (int x = c.x; x <= c.z; ++x)
+                {
+                    uint key = gridHash(grid, x, y);
+                    grid->keys[p]      = key;
+                    grid->items[p]     = i;
+                    grid->itemCells[p] = (iv2){x, y};
+                    ++histogram[key >> job->shift];
+                    ++p;
+                }
+            }
+        }
+    }
+}
+
+static void gridScatterRange(void* data, uint begin, uint end)
+{
+    GridJob* job = data;
+    Grid* grid = job->grid;
+
+    for (uint b = begin; b < end; ++b)
+    {
+        uint* histogram = grid->histogram + b * GRID_RADIX;
+
+        for (uint p = grid->blockStart[b]; p < grid->blockStart[b + 1]; ++p)
+        {
+            uint key = grid->keys[p];
+            uint q = histogram[key >> job->shift]++;
+            grid->sortKeys[q]  = key;
+            grid->sortItems[q] = grid->items[p];
+            grid->sortCells[q] = grid->itemCells[p];
+        }
+    }
+}
+
+// After the scatter the last block's histogram entry for a digit has moved
+// on to where the digit ends
+static void gridSortRange(void* data, uint begin, uint end)
+{
+    GridJob* job = data;
+    Grid* grid = job->grid;
+    const uint* lastBlock = grid->histogram + (job->blocks - 1) * GRID_RADIX;
+
+    for (uint d = begin; d < end; ++d)
+    {
+        uint first  = d ? lastBlock[d - 1] : 0;
+        uint last   = lastBlock[d];
+        uint bucket = d << job->shift;
+        uint count  = 1u << job->shift;
+
+        for (uint k = 0; k < count; ++k)
+            grid->cursor[bucket + k] = 0;
+
+        for (uint p = first; p < last; ++p)
+            ++grid->cursor[grid->sortKeys[p]];
+
+        uint offset = first;
+        for (uint k = 0; k < count; ++k)
+        {
+            uint n = grid->cursor[bucket + k];
+            grid->bucketStart[bucket + k] = offset;
+            grid->cursor[bucket + k] = offset;
+            offset += n;
+        }
+
+        for (uint p = first; p < last; ++p)
+        {
+            uint q = grid->cursor[grid->sortKeys[p]]++;
+            uint i = grid->sortItems[p];
+            grid->items[q]      = i;
+            grid->itemCells[q]  = grid->sortCells[p];
+            grid->itemBounds[q] = grid->bounds[i];
+        }
+    }
+}
+
+static void gridCountPairsRange(void* data, uint begin, uint end)
+{
+    GridJob* job = data;
+    const Grid* grid = job->grid;
+
+    for (uint d = begin; d < end; ++d)
+    {
+        uint first = grid->bucketStart[d << job->shift];
+        uint last  = grid->bucketStart[(d + 1) << job->shift];
+        job->digitStart[d] = gridBucketPairs(grid, first, last, NULL);
+    }
+}
+
+static void gridFillPairsRange(void* data, uint begin, uint end)
+{
+    GridJob* job = data;
+    Grid* grid = job->grid;
+
+    for (uint d = begin; d < end; ++d)
+    {
+        uint first = grid->bucketStart[d << job->shift];
+        uint last  = grid->bucketStart[(d + 1) << job->shift];
+        gridBucketPairs(grid, first, last, grid->pairs + job->digitStart[d]);
+    }
+}
+
+// Entries p < q of one cell pair up when their bounds overlap. A pair that
+// shares several cells is only taken in the one holding the low corner of
+// the overlap. Entries of different cells that hashed into the same bucket
+// are all in one run, so the pairs are found by scanning the entries after
+// p until the run of buckets ends.
+static uint gridBucketPairs(const Grid* grid, uint first, uint last, AabbPair* out)
+{
+    uint count = 0;
+
+    for (uint p = first; p < last; ++p)
+    {
+        uint i  = grid->items[p];
+        iv2  ci = grid->itemCells[p];
+        v4   bi = grid->itemBounds[p];
+        uint bucket = gridHash(grid, ci.x, ci.y);
+        uint end = grid->bucketStart[bucket + 1];
+
+        for (uint q = p + 1; q < end; ++q)
+        {
+            iv2 cj = grid->itemCells[q];
+            v4  bj = grid->itemBounds[q];
+
+            if (cj.x != ci.x || cj.y != ci.y)
+                continue;
+
+            if (bi.x > bj.z || bj.x > bi.z || bi.y > bj.w || bj.y > bi.w)
+                continue;
+
+            if (ci.x != gridCell(grid, MAX(bi.x, bj.x)) || ci.y != gridCell(grid, MAX(bi.y, bj.y)))
+                continue;
+
+            if (out)
+            {
+                uint j = grid->items[q];
+                out[count] = (AabbPair){MIN(i, j), MAX(i, j)};
+            }
+
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+// The query's own cells are walked and an object is reported in the cell
+// holding the low corner of the overlap of both bounds, which it is sure to
+// be listed in. c then tests the circle itself instead of its bounds.
+static uint gridQuery(const Grid* grid, v4 lo, const Circle* c, uint* out, uint max)
+{
+    if (!grid->itemCount)
+        return 0;
+
+    iv4 cq = {gridCell(grid, lo.x), gridCell(grid, lo.y), gridCell(grid, lo.z), gridCell(grid, lo.w)};
+    uint count = 0;
+
+    for (int y = cq.y; y <= cq.w; ++y)
+    {
+        for (int x = cq.x; x <= cq.z; ++x)
+        {
+            uint bucket = gridHash(grid, x, y);
+
+            for (uint p = grid->bucketStart[bucket]; p < grid->bucketStart[bucket + 1]; ++p)
+            {
+                iv2 cj = grid->itemCells[p];
+                v4  bj = grid->itemBounds[p];
+
+                if (cj.x != x || cj.y != y)
+                    continue;
+
+                if (lo.x > bj.z || bj.x > lo.z || lo.y > bj.w || bj.y > lo.w)
+                    continue;
+
+                if (x != gridCell(grid, MAX(lo.x, bj.x)) || y != gridCell(grid, MAX(lo.y, bj.y)))
+                    continue;
+
+                if (c && !circleOverlapsRect(*c, (Rect){bj.x, bj.y, bj.z - bj.x, bj.w - bj.y}))
+                    continue;
+
+                if (count < max)
+                    out[count] = grid->items[p];
+                ++count;
+            }
+        }
+    }
+
+    return count;
+}
+
+//-----------------------------
+// ~Contact
+
+// Kernel results per lane, points 1 is only read for two point contacts
+typedef struct ContactLanes
+{
+    float nx[SIMD_WIDTH], ny[SIMD_WIDTH];
+    float depth[SIMD_WIDTH];
+    float x0[SIMD_WIDTH], y0[SIMD_WIDTH];
+    float x1[SIMD_WIDTH], y1[SIMD_WIDTH];
+} ContactLanes;
+
+static inline simdf contactGather(const void* shapes, uint stride, uint field, const AabbPair* pairs, uint i, uint n, int second);
+static inline simdf contactSafeInv(simdf len2, simdf valid);
+static inline uint  contactEmit(const ContactLanes* l, int bits, const AabbPair* pairs, uint i, uint n, uint points, Contact* out, uint count);
+
+#define CONTACT_LOAD(shapes, type, field, second) \
+    contactGather(shapes, sizeof(type) / sizeof(float), offsetof(type, field) / sizeof(float), pairs, i, n, second)
+
+// Every kernel gathers SIMD_WIDTH pairs at a time, works out each case the
+// shapes can be in and picks per lane with simdSelect, so the only branch
+// is on whether any lane touched at all. Lanes past n repeat the last pair
+// and are dropped by contactEmit.
+
+uint contactsCircleCircle(const Circle* circles, const AabbPair* pairs, uint n, Contact* out)
+{
+    simdf eps = simdSet1(COLLISION_EPSILON), one = simdSet1(1.0f), zero = simdZero();
+    uint count = 0;
+
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        simdf ax = CONTACT_LOAD(circles, Circle, x, 0), bx = CONTACT_LOAD(circles, Circle, x, 1);
+        simdf ay = CONTACT_LOAD(circles, Circle, y, 0), by = CONTACT_LOAD(circles, Circle, y, 1);
+        simdf ar = CONTACT_LOAD(circles, Circle, r, 0), br = CONTACT_LOAD(circles, Circle, r, 1);
+
+        simdf dx = simdSub(bx, ax), dy = simdSub(by, ay);
+        simdf d2 = simdAdd(simdMul(dx, dx), simdMul(dy, dy));
+        simdf r  = simdAdd(ar, br);
+
+        int bits = simdMask(simdCmpLe(d2, simdMul(r, r)));
+        if (!bits)
+            continue;
+
+        // Concentric circles are pushed apart along x
+        simdf valid = simdCmpGt(d2, eps);
+        simdf inv = contactSafeInv(d2, valid);
+        simdf nx = simdSelect(valid, simdMul(dx, inv), one);
+        simdf ny = simdAnd(valid, simdMul(dy, inv));
+        simdf dist = simdAnd(valid, simdMul(d2, inv));
+
+        ContactLanes l;
+        simdStoreu(l.nx, nx);
+        simdStoreu(l.ny, ny);
+        simdStoreu(l.depth, simdMax(simdSub(r, dist), zero));
+        simdStoreu(l.x0, simdSub(bx, simdMul(nx, br)));
+        simdStoreu(l.y0, simdSub(by, simdMul(ny, br)));
+
+        count = contactEmit(&l, bits, pairs, i, n, 1, out, count);
+    }
+
+    return count;
+}
+
+// With the centre outside the rect the normal runs from the centre to the
+// closest point. Inside, the rect is pushed out through the nearest side.
+uint contactsCircleRect(const Circle* circles, const Rect* rects, const AabbPair* pairs, uint n, Contact* out)
+{
+    simdf eps = simdSet1(COLLISION_EPSILON), one = simdSet1(1.0f), zero = simdZero();
+    uint count = 0;
+
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        simdf cx = CONTACT_LOAD(circles, Circle, x, 0);
+        simdf cy = CONTACT_LOAD(circles, Circle, y, 0);
+        simdf cr = CONTACT_LOAD(circles, Circle, r, 0);
+        simdf lx = CONTACT_LOAD(rects, Rect, x, 1), hx = simdAdd(lx, CONTACT_LOAD(rects, Rect, w, 1));
+        simdf ly = CONTACT_LOAD(rects, Rect, y, 1), hy = simdAdd(ly, CONTACT_LOAD(rects, Rect, h, 1));
+
+        simdf qx = simdMin(simdMax(cx, lx), hx);
+        simdf qy = simdMin(simdMax(cy, ly), hy);
+        simdf dx = simdSub(qx, cx), dy = simdSub(qy, cy);
+        simdf d2 = simdAdd(simdMul(dx, dx), simdMul(dy, dy));
+
+        int bits = simdMask(simdCmpLe(d2, simdMul(cr, cr)));
+        if (!bits)
+            continue;
+
+        simdf outside = simdCmpGt(d2, eps);
+        simdf inv = contactSafeInv(d2, outside);
+
+        // Later selects win, so ties go left, right, bottom, top
+        simdf dl = simdSub(cx, lx), dr = simdSub(hx, cx);
+        simdf db = simdSub(cy, ly), dt = simdSub(hy, cy);
+        simdf m  = simdMin(simdMin(dl, dr), simdMin(db, dt));
+
+        simdf inx = zero, iny = simdSet1(-1.0f), ipx = cx, ipy = hy;
+        simdf side = simdCmpLe(db, m);
+        iny = simdSelect(side, one, iny);
+        ipy = simdSelect(side, ly, ipy);
+        side = simdCmpLe(dr, m);
+        inx = simdSelect(side, simdSet1(-1.0f), inx);
+        iny = simdAndNot(side, iny);
+        ipx = simdSelect(side, hx, ipx);
+        ipy = simdSelect(side, cy, ipy);
+        side = simdCmpLe(dl, m);
+        inx = simdSelect(side, one, inx);
+        iny = simdAndNot(side, iny);
+        ipx = simdSelect(side, lx, ipx);
+        ipy = simdSelect(side, cy, ipy);
+
+        ContactLanes l;
+        simdStoreu(l.nx, simdSelect(outside, simdMul(dx, inv), inx));
+        simdStoreu(l.ny, simdSelect(outside, simdMul(dy, inv), iny));
+        simdStoreu(l.depth, simdSelect(outside, simdMax(simdSub(cr, simdMul(d2, inv)), zero), simdAdd(cr, m)));
+        simdStoreu(l.x0, simdSelect(outside, qx, ipx));
+        simdStoreu(l.y0, simdSelect(outside, qy, ipy));
+
+        count = contactEmit(&l, bits, pairs, i, n, 1, out, count);
+    }
+
+    return count;
+}
+
+// SAT on the two axes. On each b is pushed whichever way is shorter and the
+// axis needing the shorter push wins, the contact points are the ends of
+// the overlap along b's facing side.
+uint contactsRectRect(const Rect* rects, const AabbPair* pairs, uint n, Contact* out)
+{
+    simdf one = simdSet1(1.0f), zero = simdZero();
+    uint count = 0;
+
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        simdf alx = CONTACT_LOAD(rects, Rect, x, 0), ahx = simdAdd(alx, CONTACT_LOAD(rects, Rect, w, 0));
+        simdf aly = CONTACT_LOAD(rects, Rect, y, 0), ahy = simdAdd(aly, CONTACT_LOAD(rects, Rect, h, 0));
+        simdf blx = CONTACT_LOAD(rects, Rect, x, 1), bhx = simdAdd(blx, CONTACT_LOAD(rects, Rect, w, 1));
+        simdf bly = CONTACT_LOAD(rects, Rect, y, 1), bhy = simdAdd(bly, CONTACT_LOAD(rects, Rect, h, 1));
+
+        // Push distances towards +x, -x, +y and -y
+        simdf px = simdSub(ahx, blx), mx = simdSub(bhx, alx);
+        simdf py = simdSub(ahy, bly), my = simdSub(bhy, aly);
+        simdf ox = simdMin(px, mx), oy = simdMin(py, my);
+
+        int bits = simdMask(simdAnd(simdCmpGe(ox, zero), simdCmpGe(oy, zero)));
+        if (!bits)
+            continue;
+
+        simdf right = simdCmpLe(px, mx), up = simdCmpLe(py, my);
+        simdf sx = simdSelect(right, one, simdSet1(-1.0f)), fx = simdSelect(right, blx, bhx);
+        simdf sy = simdSelect(up, one, simdSet1(-1.0f)),    fy = simdSelect(up, bly, bhy);
+
+        simdf x0 = simdMax(alx, blx), x1 = simdMin(ahx, bhx);
+        simdf y0 = simdMax(aly, bly), y1 = simdMin(ahy, bhy);
+        simdf xAxis = simdCmpLt(ox, oy);
+
+        ContactLanes l;
+        simdStoreu(l.nx, simdAnd(xAxis, sx));
+        simdStoreu(l.ny, simdAndNot(xAxis, sy));
+        simdStoreu(l.depth, simdSelect(xAxis, ox, oy));
+        simdStoreu(l.x0, simdSelect(xAxis, fx, x0));
+        simdStoreu(l.y0, simdSelect(xAxis, y0, fy));
+        simdStoreu(l.x1, simdSelect(xAxis, fx, x1));
+        simdStoreu(l.y1, simdSelect(xAxis, y1, fy));
+
+        count = contactEmit(&l, bits, pairs, i, n, 2, out, count);
+    }
+
+    return count;
+}
+
+// Closest point on the segment to the centre as in lineClosestPoint. A
+// centre right on the line is pushed along the segment's normal.
+uint contactsLineCircle(const Line* lines, const Circle* circles, const AabbPair* pairs, uint n, Contact* out)
+{
+    simdf eps = simdSet1(COLLISION_EPSILON), one = simdSet1(1.0f), zero = simdZero();
+    uint count = 0;
+
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        simdf px = CONTACT_LOAD(lines, Line, x0, 0), dx = simdSub(CONTACT_LOAD(lines, Line, x1, 0), px);
+        simdf py = CONTACT_LOAD(lines, Line, y0, 0), dy = simdSub(CONTACT_LOAD(lines, Line, y1, 0), py);
+        simdf cx = CONTACT_LOAD(circles, Circle, x, 1);
+        simdf cy = CONTACT_LOAD(circles, Circle, y, 1);
+        simdf cr = CONTACT_LOAD(circles, Circle, r, 1);
+
+        simdf dd = simdAdd(simdMul(dx, dx), simdMul(dy, dy));
+        simdf segment = simdCmpGt(dd, eps);
+
+        simdf t = simdAdd(simdMul(simdSub(cx, px), dx), simdMul(simdSub(cy, py), dy));
+        t = simdDiv(t, simdSelect(segment, dd, one));
+        t = simdAnd(segment, simdMin(simdMax(t, zero), one));
+
+        simdf vx = simdSub(cx, simdAdd(px, simdMul(t, dx)));
+        simdf vy = simdSub(cy, simdAdd(py, simdMul(t, dy)));
+        simdf d2 = simdAdd(simdMul(vx, vx), simdMul(vy, vy));
+
+        int bits = simdMask(simdCmpLe(d2, simdMul(cr, cr)));
+        if (!bits)
+            continue;
+
+        simdf valid = simdCmpGt(d2, eps);
+        simdf inv = contactSafeInv(d2, valid);
+        simdf dinv = contactSafeInv(dd, segment);
+
+        simdf nx = simdSelect(valid, simdMul(vx, inv), simdSelect(segment, simdMul(simdSub(zero, dy), dinv), one));
+        simdf ny = simdSelect(valid, simdMul(vy, inv), simdAnd(segment, simdMul(dx, dinv)));
+        simdf dist = simdAnd(valid, simdMul(d2, inv));
+
+        ContactLanes l;
+        simdStoreu(l.nx, nx);
+        simdStoreu(l.ny, ny);
+        simdStoreu(l.depth, simdMax(simdSub(cr, dist), zero));
+        simdStoreu(l.x0, simdSub(cx, simdMul(nx, cr)));
+        simdStoreu(l.y0, simdSub(cy, simdMul(ny, cr)));
+
+        count = contactEmit(&l, bits, pairs, i, n, 1, out, count);
+    }
+
+    return count;
+}
+
+// SAT on x, y and the segment's normal, pushing b whichever way is shorter
+// on each like contactsRectRect. On x or y the point is the end of the
+// segment reaching furthest into b, clamped onto b's facing side. On the
+// normal it is the corner of the rect that reaches furthest over the line.
+uint contactsLineRect(const Line* lines, const Rect* rects, const AabbPair* pairs, uint n, Contact* out)
+{
+    simdf eps = simdSet1(COLLISION_EPSILON), one = simdSet1(1.0f), zero = simdZero();
+    simdf sign = simdSet1(-0.0f), half = simdSet1(0.5f), big = simdSet1(3.4e38f);
+    uint count = 0;
+
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        simdf ax = CONTACT_LOAD(lines, Line, x0, 0), bx = CONTACT_LOAD(lines, Line, x1, 0);
+        simdf ay = CONTACT_LOAD(lines, Line, y0, 0), by = CONTACT_LOAD(lines, Line, y1, 0);
+        simdf lx = CONTACT_LOAD(rects, Rect, x, 1), ex = simdMul(CONTACT_LOAD(rects, Rect, w, 1), half);
+        simdf ly = CONTACT_LOAD(rects, Rect, y, 1), ey = simdMul(CONTACT_LOAD(rects, Rect, h, 1), half);
+        simdf cx = simdAdd(lx, ex), hx = simdAdd(cx, ex);
+        simdf cy = simdAdd(ly, ey), hy = simdAdd(cy, ey);
+
+        simdf px = simdSub(simdMax(ax, bx), lx), mx = simdSub(hx, simdMin(ax, bx));
+        simdf py = simdSub(simdMax(ay, by), ly), my = simdSub(hy, simdMin(ay, by));
+        simdf ox = simdMin(px, mx), oy = simdMin(py, my);
+
+        // The segment projects onto its normal as a single value s
+        simdf dx = simdSub(bx, ax), dy = simdSub(by, ay);
+        simdf dd = simdAdd(simdMul(dx, dx), simdMul(dy, dy));
+        simdf segment = simdCmpGt(dd, eps);
+        simdf dinv = contactSafeInv(dd, segment);
+        simdf nx = simdMul(simdSub(zero, dy), dinv), ny = simdMul(dx, dinv);
+
+        simdf s  = simdAdd(simdMul(nx, ax), simdMul(ny, ay));
+        simdf c  = simdAdd(simdMul(nx, cx), simdMul(ny, cy));
+        simdf re = simdAdd(simdMul(simdAndNot(sign, nx), ex), simdMul(simdAndNot(sign, ny), ey));
+        simdf on = simdSelect(segment, simdSub(re, simdAndNot(sign, simdSub(c, s))), big);
+
+        int bits = simdMask(simdAnd(simdAnd(simdCmpGe(ox, zero), simdCmpGe(oy, zero)), simdCmpGe(on, zero)));
+        if (!bits)
+            continue;
+
+        simdf right = simdCmpLe(px, mx), up = simdCmpLe(py, my);
+        simdf ahead = simdCmpGe(c, s);
+        nx = simdSelect(ahead, nx, simdSub(zero, nx));
+        ny = simdSelect(ahead, ny, simdSub(zero, ny));
+
+        // Normal axis first, then overwritten by x or y
+        simdf depth = on;
+        simdf cornerX = simdSelect(simdCmpGe(nx, zero), lx, hx);
+        simdf cornerY = simdSelect(simdCmpGe(ny, zero), ly, hy);
+
+        simdf xAxis = simdAnd(simdCmpLe(ox, oy), simdCmpLe(ox, on));
+        simdf yAxis = simdAndNot(xAxis, simdCmpLe(oy, on));
+
+        // The end furthest along +-x or +-y
+        simdf deepX = simdCmpGe(simdSelect(right, bx, ax), simdSelect(right, ax, bx));
+        simdf deepY = simdCmpGe(simdSelect(up, by, ay), simdSelect(up, ay, by));
+
+        nx = simdSelect(xAxis, simdSelect(right, one, simdSet1(-1.0f)), nx);
+        ny = simdAndNot(xAxis, ny);
+        depth = simdSelect(xAxis, ox, depth);
+        cornerX = simdSelect(xAxis, simdSelect(right, lx, hx), cornerX);
+        cornerY = simdSelect(xAxis, simdMin(simdMax(simdSelect(deepX, by, ay), ly), hy), cornerY);
+
+        nx = simdAndNot(yAxis, nx);
+        ny = simdSelect(yAxis, simdSelect(up, one, simdSet1(-1.0f)), ny);
+        depth = simdSelect(yAxis, oy, depth);
+        cornerX = simdSelect(yAxis, simdMin(simdMax(simdSelect(deepY, bx, ax), lx), hx), cornerX);
+        cornerY = simdSelect(yAxis, simdSelect(up, ly, hy), cornerY);
+
+        ContactLanes l;
+        simdStoreu(l.nx, nx);
+        simdStoreu(l.ny, ny);
+        simdStoreu(l.depth, depth);
+        simdStoreu(l.x0, cornerX);
+        simdStoreu(l.y0, cornerY);
+
+        count = contactEmit(&l, bits, pairs, i, n, 1, out, count);
+    }
+
+    return count;
+}
+
+//- - - - - - - - - - - - - - -
+
+// Shapes are plain float structs, stride and field count floats
+static inline simdf contactGather(const void* shapes, uint stride, uint field, const AabbPair* pairs, uint i, uint n, int second)
+{
+    const float* f = shapes;
+    float lane[SIMD_WIDTH];
+
+    for (uint k = 0; k < SIMD_WIDTH; ++k)
+    {
+        const AabbPair* p = &pairs[MIN(i + k, n - 1)];
+        lane[k] = f[(second ? p->b : p->a) * stride + field];
+    }
+
+    return simdLoadu(lane);
+}
+
+// 1 / sqrt(len2) where valid, 1 elsewhere so nothing turns into inf or NaN
+static inline simdf contactSafeInv(simdf len2, simdf valid)
+{
+    simdf one = simdSet1(1.0f);
+    return simdDiv(one, simdSqrt(simdSelect(valid, len2, one)));
+}
+
+// Branchless append as in frustumCompact, out[count] is always within the
+// n entries out has room for
+static inline uint contactEmit(const ContactLanes* l, int bits, const AabbPair* pairs, uint i, uint n, uint points, Contact* out, uint count)
+{
+    for (uint k = 0; k < SIMD_WIDTH && i + k < n; ++k)
+    {
+        Contact* c = &out[count];
+        c->a = pairs[i + k].a;
+        c->b = pairs[i + k].b;
+        c->normal = (v2){l->nx[k], l->ny[k]};
+        c->depth = l->depth[k];
+        c->pointCount = points;
+        c->points[0] = (v2){l->x0[k], l->y0[k]};
+        c->points[1] = points > 1 ? (v2){l->x1[k], l->y1[k]} : c->points[0];
+        count += (bits >> k) & 1;
+    }
+
+    return count;
+}
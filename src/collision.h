@@ -0,0 +1,309 @@
+#ifndef MODULE_COLLISION_H
+#define MODULE_COLLISION_H
+
+#include "maths.h"
+
+//-------------------------------------------------------------
+// Definitions
+//-------------------------------------------------------------
+
+// Shapes are solid, a point inside a shape is its own closest point and a
+// shape touching another counts as overlapping.
+
+typedef struct Ray
+{
+    v3 origin;
+    v3 dir; // Doesn't have to be normalized, t is measured in lengths of dir
+} Ray;
+
+typedef struct RayHit
+{
+    float t;
+    uint index;
+} RayHit;
+
+// Static triangle BVH. Built as a binary tree with binned SAH and collapsed
+// into 4 wide nodes stored depth first, so a ray tests four child boxes in
+// one go. Every leaf is a packet of up to 4 triangles stored as v0 and the
+// two edges, ready for a 4 wide Moller-Trumbore test.
+
+#define BVH_LEAF   0x80000000u // Set in BvhNode.child for packets
+#define BVH_NO_HIT 0xffffffffu // BvhHit.triangle of a missed ray
+
+typedef struct BvhNode
+{
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+    uint child[4]; // Node index, or packet index | BVH_LEAF
+    uint count;    // Used child slots, always the first ones
+} BvhNode;
+
+typedef struct BvhPacket
+{
+    float v0x[4], v0y[4], v0z[4];
+    float e1x[4], e1y[4], e1z[4]; // v1 - v0
+    float e2x[4], e2y[4], e2z[4]; // v2 - v0, unused lanes are all 0
+    uint triangle[4];
+} BvhPacket;
+
+typedef struct Bvh
+{
+    BvhNode* nodes; // Root first
+    BvhPacket* packets;
+    uint nodeCount;
+    uint packetCount;
+    uint triangleCount;
+} Bvh;
+
+typedef struct BvhHit
+{
+    float t;
+    float u, v;    // Barycentric weights of v1 and v2
+    uint triangle; // Index of the triangle in the input
+} BvhHit;
+
+// Incremental AABB tree for things that move every frame. Leaves hold fat
+// boxes grown by a margin so small moves don't touch the tree, inner nodes
+// are kept balanced with AVL style rotations. Proxy ids are node indices
+// and stay valid until the proxy is removed.
+
+#define AABBTREE_NULL 0xffffffffu
+
+typedef struct AabbTreeNode
+{
+    v3 lo, hi;        // Fat box of a leaf, union of the children otherwise
+    uint parent;      // Next free node while on the free list
+    uint left, right; // AABBTREE_NULL for leaves
+    int height;       // 0 for leaves, -1 while free
+    uint data;
+    bool moved;
+} AabbTreeNode;
+
+typedef struct AabbPair
+{
+    uint a, b; // Proxy or object ids, a < b when both index the same set
+} AabbPair;
+
+typedef struct AabbTree
+{
+    AabbTreeNode* nodes;
+    uint capacity;
+    uint root;
+    uint freeList;
+    float margin;
+
+    // Reused between calls so pair updates stop allocating once they have
+    // grown to the scene's size
+    uint* moved;
+    uint movedCount;
+    uint movedCapacity;
+    bool rebuildPairs; // A move couldn't be buffered, see aabbTreeUpdatePairs
+    AabbPair* pairs;
+    uint pairCount;
+    uint pairCapacity;
+} AabbTree;
+
+// Return 0 to stop the query
+typedef bool (*AabbTreeQueryFn)(void* ctx, uint proxy);
+
+// Return maxT to carry on, a smaller distance to clip the ray there, or a
+// negative value to stop the cast
+typedef float (*AabbTreeRayFn)(void* ctx, uint proxy, Ray r, float maxT);
+
+// Uniform 2D grid rebuilt from scratch every frame. Cells are hashed into a
+// power of two bucket table and the objects are counting sorted by bucket
+// into one flat array, an object is listed in every cell its bounds touch.
+// Object ids are indices into the array the grid was built from.
+
+typedef struct Grid
+{
+    float cellSize;
+    uint  objectCount;
+    uint  itemCount;   // Object entries over all cells
+    uint  bucketCount;
+    uint* bucketStart; // bucketCount + 1 offsets into items
+    uint* items;       // Object ids grouped by bucket, ascending within one
+    iv2*  itemCells;   // Cell of each entry, a bucket can hold several
+    v4*   itemBounds;  // Bounds of each entry's object so bucket scans stay linear
+    v4*   bounds;      // Min x, min y, max x, max y per object
+    iv4*  cells;       // Inclusive cell range per object, same layout
+
+    // Build scratch and the pair output, kept so rebuilds of the same size
+    // don't allocate
+    uint* keys;
+    uint* sortKeys;
+    uint* sortItems;
+    iv2*  sortCells;
+    uint* cursor;
+    uint* blockStart;
+    uint* histogram;
+    AabbPair* pairs;
+    uint  pairCount;
+    uint  objectCapacity;
+    uint  itemCapacity;
+    uint  bucketCapacity;
+    uint  blockCapacity;
+    uint  pairCapacity;
+} Grid;
+
+// One touching pair from the narrowphase. The normal is the direction to
+// push b out of a, depth how far, and the points lie on b's surface where
+// the shapes touch. Rect pairs report both ends of the touching edge, the
+// rest one point.
+typedef struct Contact
+{
+    uint  a, b; // Indices from the pair
+    v2    normal;
+    float depth;
+    uint  pointCount;
+    v2    points[2];
+} Contact;
+
+//-------------------------------------------------------------
+// Prototypes
+//-------------------------------------------------------------
+
+//-----------------------------
+// ~2D
+
+bool rectContains(Rect r, v2 p);
+bool circleContains(Circle c, v2 p);
+
+bool lineOverlapsLine(Line a, Line b, v2* point); // point may be NULL, parallel lines never overlap
+bool lineOverlapsRect(Line l, Rect r);
+bool lineOverlapsCircle(Line l, Circle c);
+bool rectOverlapsRect(Rect a, Rect b);
+bool circleOverlapsCircle(Circle a, Circle b);
+bool circleOverlapsRect(Circle c, Rect r);
+
+v2   lineClosestPoint(Line l, v2 p);
+v2   rectClosestPoint(Rect r, v2 p);
+v2   circleClosestPoint(Circle c, v2 p);
+
+//-----------------------------
+// ~3D
+
+bool aabbContains(AABB b, v3 p);
+bool sphereContains(Sphere s, v3 p);
+
+bool aabbOverlapsAABB(AABB a, AABB b);
+bool aabbOverlapsPlane(AABB b, Plane p);
+bool sphereOverlapsSphere(Sphere a, Sphere b);
+bool sphereOverlapsAABB(Sphere s, AABB b);
+bool sphereOverlapsPlane(Sphere s, Plane p);
+
+float planeDistance(Plane p, v3 point); // Signed, positive on the side the normal points to
+v3    planeClosestPoint(Plane p, v3 point);
+v3    aabbClosestPoint(AABB b, v3 p);
+v3    sphereClosestPoint(Sphere s, v3 p);
+
+// Closest points between segments p0 -> p1 and q0 -> q1, returns the squared
+// distance between them. a and b may be NULL.
+float segmentClosestPoints(v3 p0, v3 p1, v3 q0, v3 q1, v3* a, v3* b);
+
+//-----------------------------
+// ~Ray
+
+// Return 1 when the ray enters the shape within [0, maxT] and write where to
+// t, a ray starting inside a shape hits it at 0. t may be NULL.
+bool rayCastAABB(Ray r, AABB b, float maxT, float* t);
+bool rayCastSphere(Ray r, Sphere s, float maxT, float* t);
+bool rayCastPlane(Ray r, Plane p, float maxT, float* t);
+bool rayCastTriangle(Ray r, v3 v0, v3 v1, v3 v2, float maxT, float* t); // Both sides
+
+//-----------------------------
+// ~Batch
+
+// One query against a whole stream. The overlap tests set bit i % 32 of
+// mask[i / 32] for every hit, mask needs (count + 31) / 32 words, and return
+// the number of hits. The ray casts write the hits sorted by t to hits, which
+// needs room for count entries, and return how many there are.
+//
+// Circles keep their radius in z and spheres in w, boxes are split into
+// centre and half extent streams like frustumCullAABBs.
+
+uint circleOverlapsCircles(Circle c, const v3Stream* circles, uint* mask);
+uint rectOverlapsRects(Rect r, const v2Stream* centres, const v2Stream* extents, uint* mask);
+uint sphereOverlapsSpheres(Sphere s, const v4Stream* spheres, uint* mask);
+uint aabbOverlapsAABBs(AABB b, const v3Stream* centres, const v3Stream* extents, uint* mask);
+
+uint rayCastSpheres(Ray r, float maxT, const v4Stream* spheres, RayHit* hits);
+uint rayCastAABBs(Ray r, float maxT, const v3Stream* centres, const v3Stream* extents, RayHit* hits);
+
+//-----------------------------
+// ~Bvh
+
+// indices holds three per triangle, NULL reads vertices as a triangle list.
+// For a Mesh pass mesh->vertices, mesh->indices and mesh->indexCount / 3.
+// Large inputs are built on several threads, returns NULL if out of memory.
+// No triangles or NULL vertices give an empty BVH that every ray misses.
+Bvh* bvhCreate(const v3* vertices, const uint* indices, uint triangleCount);
+void bvhDestroy(Bvh* bvh);
+
+bool bvhRayCast(const Bvh* bvh, Ray r, float maxT, BvhHit* hit); // Closest hit, hit may be NULL
+bool bvhRayAny(const Bvh* bvh, Ray r, float maxT);               // Stops at the first hit, for line of sight
+
+// Closest hit per ray, split across threads, misses get BVH_NO_HIT
+void bvhRayCastBatch(const Bvh* bvh, const Ray* rays, float maxT, BvhHit* hits, uint n);
+
+//-----------------------------
+// ~AabbTree
+
+AabbTree* aabbTreeCreate(float margin);
+void      aabbTreeDestroy(AabbTree* tree);
+
+uint      aabbTreeInsert(AabbTree* tree, AABB box, uint data); // Returns the proxy id, AABBTREE_NULL if out of memory
+void      aabbTreeRemove(AabbTree* tree, uint proxy);
+
+// Only touches the tree when box leaves the proxy's fat box, the new fat box
+// is then stretched by displacement to cover the next move. Returns 1 if the
+// proxy was reinserted.
+bool      aabbTreeMove(AabbTree* tree, uint proxy, AABB box, v3 displacement);
+
+AABB      aabbTreeFatBox(const AabbTree* tree, uint proxy);
+uint      aabbTreeData(const AabbTree* tree, uint proxy);
+
+void      aabbTreeQuery(const AabbTree* tree, AABB box, AabbTreeQueryFn fn, void* ctx);
+void      aabbTreeRayCast(const AabbTree* tree, Ray r, float maxT, AabbTreeRayFn fn, void* ctx);
+
+// Pairs of overlapping fat boxes where at least one proxy was inserted or
+// reinserted since the last call, sorted by a then b. The array belongs to
+// the tree and is valid until the next call.
+uint      aabbTreeUpdatePairs(AabbTree* tree, const AabbPair** pairs);
+
+//-----------------------------
+// ~Grid
+
+// cellSize works best around the size of a typical object. Large inputs are
+// built on several threads, the builds return 0 if out of memory.
+Grid* gridCreate(float cellSize);
+void  gridDestroy(Grid* grid);
+
+bool  gridBuild(Grid* grid, const Rect* rects, uint n);
+bool  gridBuildCircles(Grid* grid, const Circle* circles, uint n);
+
+// Write the ids of the objects whose bounds overlap the shape to out, each
+// once, and return how many there are. Only the first max are written. The
+// grid isn't modified, so queries can run on several threads at once.
+uint  gridQueryRect(const Grid* grid, Rect r, uint* out, uint max);
+uint  gridQueryCircle(const Grid* grid, Circle c, uint* out, uint max);
+
+// Every pair of objects with overlapping bounds, sorted by a then b. The
+// array belongs to the grid and is valid until the next call or build.
+uint  gridPairs(Grid* grid, const AabbPair** pairs);
+
+//-----------------------------
+// ~Contact
+
+// Narrowphase over the candidate pairs of one shape pairing. pair.a indexes
+// the first shape array and pair.b the second. The contacts of the pairs
+// that touch are written to out in pair order and their count is returned,
+// out needs room for n. Segments have no area, so lines only collide with
+// circles and rects.
+uint contactsCircleCircle(const Circle* circles, const AabbPair* pairs, uint n, Contact* out);
+uint contactsCircleRect(const Circle* circles, const Rect* rects, const AabbPair* pairs, uint n, Contact* out);
+uint contactsRectRect(const Rect* rects, const AabbPair* pairs, uint n, Contact* out);
+uint contactsLineCircle(const Line* lines, const Circle* circles, const AabbPair* pairs, uint n, Contact* out);
+uint contactsLineRect(const Line* lines, const Rect* rects, const AabbPair* pairs, uint n, Contact* out);
+
+#endif // MODULE_COLLISION_H
@@ -1,17 +1,38 @@
+#define _POSIX_C_SOURCE 200809L // nanosleep
+
 #include "core.h"
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
 
-#include <stdlib.h> // malloc, free
-#include <string.h> // memcpy
-#include <stdio.h>
+#include <stdlib.h> // malloc, realloc, free
+#include <string.h> // memcpy, memcmp
+#include <stdio.h>  // FILE, fopen, fread, fwrite
+
+#ifndef _WIN32
+    #include <pthread.h> // pthread_create, pthread_join
+    #include <time.h>    // nanosleep
+#endif // _WIN32
 
 #ifndef FILENAME
     #include <string.h>
     #define FILENAME (strrchr("/" __FILE__, '/') + 1)
 #endif // FILENAME
 
+#define INPUT_RECORDING_MAGIC "INR1"
+#define INPUT_RECORDING_GROW  4096
+#define INPUT_RECORDING_END   0xFF // Tag after the last event of a frame
+
+// Acquire / release for the InputQueue indices. There are no threads on
+// Windows yet so nothing shares a queue there.
+#ifndef _WIN32
+    #define INPUT_QUEUE_LOAD(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+    #define INPUT_QUEUE_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+    #define INPUT_QUEUE_LOAD(p)     (*(p))
+    #define INPUT_QUEUE_STORE(p, v) (*(p) = (v))
+#endif // _WIN32
+
 //-----------------------------
 // ~Window
 
@@ -40,7 +61,10 @@ Window* windowCreate(const char* title, int w, int h, uint flags)
     GLFWwindow* native = glfwCreateWindow(w, h, title, NULL, NULL);
 
     if (!native)
+    {
+        free(window);
         return NULL;
+    }
 
     glfwSetWindowUserPointer(native, window);
     glfwSetKeyCallback(native, windowOnKey);
@@ -51,7 +75,12 @@ Window* windowCreate(const char* title, int w, int h, uint flags)
     int x0, y0;
     glfwGetWindowPos(native, &x0, &y0);
 
-    Window tmp = {native, title, x0, y0, w, h, x0, y0, w, h, flags, {0}, {0}};
+    Window tmp = {
+        .native = native, .title = title,
+        .x0 = x0, .y0 = y0, .w0 = w, .h0 = h,
+        .x  = x0, .y  = y0, .w  = w, .h  = h,
+        .flags = flags,
+    };
     memcpy(window, &tmp, sizeof *window);
 
     glfwMakeContextCurrent(native);
@@ -60,20 +89,45 @@ Window* windowCreate(const char* title, int w, int h, uint flags)
     return window;
 }
 
+Window* windowCreateHeadless(const char* title, int w, int h)
+{
+    Window* window = malloc(sizeof *window);
+
+    if (!window)
+        return NULL;
+
+    Window tmp = {
+        .title = title,
+        .w0 = w, .h0 = h,
+        .w  = w, .h  = h,
+        .flags = WINDOW_STATIC,
+    };
+    memcpy(window, &tmp, sizeof *window);
+
+    return window;
+}
+
 void windowDestroy(Window* window)
 {
-    glfwDestroyWindow((GLFWwindow*)window->native);
+    GLFWwindow* native = window->native;
 
+    free(window->recorded);
     free(window);
     window = NULL;
 
+    if (!native)
+        return;
+
+    glfwDestroyWindow(native);
+
     // Only supports one window for now
     glfwTerminate();
 }
 
 void windowSwapBuffers(const Window* window)
 {
-    glfwSwapBuffers((GLFWwindow*)window->native);
+    if (window->native)
+        glfwSwapBuffers((GLFWwindow*)window->native);
 }
 
 int windowWidth(const Window* window)
@@ -88,7 +142,10 @@ int windowHeight(const Window* window)
 
 bool windowIsOpen(const Window* window)
 {
-    return window ? !glfwWindowShouldClose((GLFWwindow*)window->native) : 0;
+    if (!window || (window->replay && !windowIsReplaying(window)))
+        return 0;
+
+    return window->native ? !glfwWindowShouldClose((GLFWwindow*)window->native) : 1;
 }
 
 bool windowIsVsync(const Window* window)
@@ -114,7 +171,8 @@ void windowSetSize(Window* window, int w, int h)
     window->w = w;
     window->h = h;
 
-    glfwSetWindowSize((GLFWwindow*)window->native, w, h);
+    if (window->native)
+        glfwSetWindowSize((GLFWwindow*)window->native, w, h);
 }
 
 void windowSetPos(Window* window, int x, int y)
@@ -125,7 +183,8 @@ void windowSetPos(Window* window, int x, int y)
     window->x = x;
     window->y = y;
 
-    glfwSetWindowPos((GLFWwindow*)window->native, x, y);
+    if (window->native)
+        glfwSetWindowPos((GLFWwindow*)window->native, x, y);
 }
 
 void windowRestore(Window* window)
@@ -138,52 +197,178 @@ void windowRestore(Window* window)
     window->w = window->w0;
     window->h = window->h0;
 
+    if (!window->native)
+        return;
+
     glfwSetWindowPos((GLFWwindow*)window->native, window->x, window->y);
     glfwSetWindowSize((GLFWwindow*)window->native, window->w, window->h);
 }
 
+double windowTime(const Window* window)
+{
+    if (!window)
+        return 0.0;
+
+    return (window->native || window->source) && !window->replay ? glfwGetTime() : window->time;
+}
+
+float windowDeltaTime(const Window* window)
+{
+    return window ? window->delta : 0.0f;
+}
+
 //-----------------------------
 // ~Input
 
 static void windowRefreshInput(Window* window);
-
-static InputButton windowGetKey(const Window* window, KeyCode key);
-static InputButton windowGetButton(const Window* window, MouseCode button);
+static void windowReplayEvents(Window* window);
+static void windowReceiveEvents(Window* window);
+static void windowPushEvent(Window* window, InputEvent event);
+static void windowRecordEvent(Window* window, const InputEvent* event);
+static void windowApplyEvent(Window* window, const InputEvent* event);
+
+static void windowSetBit(uint* down, uint* pressed, uint* released, uint bit, uchar action);
+static bool windowTestKey(const uint* bits, KeyCode key);
+static bool windowTestButton(uint bits, MouseCode button);
+static bool windowTestKeySet(const uint* bits, const KeySet* set);
+
+static void inputRecordingWrite(InputRecording* recording, const void* data, uint size);
+static bool inputRecordingRead(InputRecording* recording, void* data, uint size);
+static void inputRecordingWriteEvent(InputRecording* recording, const InputEvent* event, double time);
+static void inputQueuePush(InputQueue* queue, const InputEvent* event);
 
 void windowPollEvents(Window* window)
 {
+    InputRecording* recording = window->recording;
+    InputRecording* replay    = window->replay;
+
     windowRefreshInput(window);
-    glfwPollEvents();
+
+    if (replay)
+    {
+        if (!inputRecordingRead(replay, &window->delta, sizeof window->delta))
+            window->delta = 0.0f;
+
+        window->time += window->delta;
+    }
+    else if (window->native || window->source)
+    {
+        // Stepped by the rounded delta, like a replay of it will be. The
+        // rounding is caught up on the next poll instead of accumulating.
+        window->delta = (float)(glfwGetTime() - window->time);
+        window->time += window->delta;
+    }
+
+    // Events are collected as they are pushed, the replayed ones included,
+    // and the poll is written once they have all arrived
+    if (replay)
+        windowReplayEvents(window);
+    else if (window->source)
+        windowReceiveEvents(window);
+    else if (window->native)
+        glfwPollEvents();
+
+    if (recording)
+    {
+        inputRecordingWriteFrame(recording, window->time, window->delta, window->recorded, window->recordedCount);
+        window->recordedCount = 0;
+    }
+
+    if (window->actions)
+        actionMapUpdate(window->actions, window);
+}
+
+void windowRecordInput(Window* window, InputRecording* recording)
+{
+    if (!window)
+        return;
+
+    window->recording     = recording;
+    window->recordedCount = 0;
+}
+
+void windowReplayInput(Window* window, InputRecording* recording)
+{
+    if (!window)
+        return;
+
+    window->replay = recording;
+
+    if (recording)
+        recording->cursor = sizeof INPUT_RECORDING_MAGIC - 1;
+}
+
+bool windowIsReplaying(const Window* window)
+{
+    return window && window->replay && window->replay->cursor < window->replay->size;
+}
+
+const InputEvent* windowNextEvent(const Window* window, uint* iterator)
+{
+    if (!window || !iterator || *iterator >= windowEventCount(window))
+        return NULL;
+
+    uint i = window->events.first + (*iterator)++;
+
+    return &window->events.events[i & (INPUT_EVENT_CAPACITY - 1)];
+}
+
+uint windowEventCount(const Window* window)
+{
+    return window ? window->events.end - window->events.first : 0;
 }
 
 bool windowIsKeyDown(const Window* window, KeyCode key)
 {
-    return windowGetKey(window, key).down;
+    return window ? windowTestKey(window->keyboard.down, key) : 0;
 }
 
 bool windowIsKeyPressed(const Window* window, KeyCode key)
 {
-    return windowGetKey(window, key).pressed;
+    return window ? windowTestKey(window->keyboard.pressed, key) : 0;
 }
 
 bool windowIsKeyReleased(const Window* window, KeyCode key)
 {
-    return windowGetKey(window, key).released;
+    return window ? windowTestKey(window->keyboard.released, key) : 0;
+}
+
+void keySetAdd(KeySet* set, KeyCode key)
+{
+    if (!set || (uint)key >= KEY_LAST)
+        return;
+
+    set->bits[key >> 5] |= 1u << (key & 31);
+}
+
+bool windowIsAnyKeyDown(const Window* window, const KeySet* set)
+{
+    return window && set ? windowTestKeySet(window->keyboard.down, set) : 0;
+}
+
+bool windowIsAnyKeyPressed(const Window* window, const KeySet* set)
+{
+    return window && set ? windowTestKeySet(window->keyboard.pressed, set) : 0;
+}
+
+bool windowIsAnyKeyReleased(const Window* window, const KeySet* set)
+{
+    return window && set ? windowTestKeySet(window->keyboard.released, set) : 0;
 }
 
 bool windowIsButtonDown(const Window* window, MouseCode button)
 {
-    return windowGetButton(window, button).down;
+    return window ? windowTestButton(window->mouse.down, button) : 0;
 }
 
 bool windowIsButtonPressed(const Window* window, MouseCode button)
 {
-    return windowGetButton(window, button).pressed;
+    return window ? windowTestButton(window->mouse.pressed, button) : 0;
 }
 
 bool windowIsButtonReleased(const Window* window, MouseCode button)
 {
-    return windowGetButton(window, button).released;
+    return window ? windowTestButton(window->mouse.released, button) : 0;
 }
 
 float windowMouseXPos(const Window* window)
@@ -278,63 +463,165 @@ bool windowIsCursorDisabled(const Window* window)
 
 static void windowRefreshInput(Window* window)
 {
-    for (int i = 0; i < KEY_LAST; ++i)
-    {
-        window->keyboard.keys[i].pressed  = 0;
-        window->keyboard.keys[i].released = 0;
-    }
+    Keyboard* keyboard = &window->keyboard;
 
-    for (int i = 0; i < MOUSE_BUTTON_LAST; ++i)
+    // Only the words that saw an event since the last poll
+    for (uint i = 0, dirty = keyboard->dirty; dirty; ++i, dirty >>= 1)
     {
-        window->mouse.buttons[i].pressed = 0;
-        window->mouse.buttons[i].released = 0;
+        if (!(dirty & 1))
+            continue;
+
+        keyboard->pressed[i]  = 0;
+        keyboard->released[i] = 0;
     }
 
+    keyboard->dirty = 0;
+
+    window->mouse.pressed  = 0;
+    window->mouse.released = 0;
     window->mouse.dx = 0.0f;
     window->mouse.dy = 0.0f;
     window->mouse.scrollX = 0.0f;
     window->mouse.scrollY = 0.0f;
+
+    window->events.first   = window->events.end;
+    window->events.dropped = 0;
+}
+
+static void windowReplayEvents(Window* window)
+{
+    InputRecording* replay = window->replay;
+    uchar tag;
+
+    while (inputRecordingRead(replay, &tag, 1) && tag != INPUT_RECORDING_END)
+    {
+        InputEvent event = {0};
+        float offset;
+
+        event.type   = tag & 3;
+        event.action = tag >> 2;
+
+        if (!inputRecordingRead(replay, &offset, sizeof offset))
+            return;
+
+        event.time = window->time + offset;
+
+        bool complete = event.type == INPUT_KEY || event.type == INPUT_BUTTON
+            ? inputRecordingRead(replay, &event.code, sizeof event.code) && inputRecordingRead(replay, &event.mods, 1)
+            : inputRecordingRead(replay, &event.x, sizeof event.x) && inputRecordingRead(replay, &event.y, sizeof event.y);
+
+        if (!complete)
+            return;
+
+        windowPushEvent(window, event);
+    }
 }
 
-static InputButton windowGetKey(const Window* window, KeyCode key)
+static void windowReceiveEvents(Window* window)
 {
-    if (!window || key < KEY_UNKNOWN || key > KEY_LAST)
-        return (InputButton){0};
+    InputQueue* queue = window->source;
+
+    uint   tail = queue->tail;
+    uint   head = INPUT_QUEUE_LOAD(&queue->head);
+    double now  = glfwGetTime();
 
-    return window->keyboard.keys[key];
+    for (; tail != head; ++tail)
+    {
+        InputEvent event = queue->events[tail & (INPUT_QUEUE_CAPACITY - 1)];
+        double latency = now - event.time;
+
+        queue->latency   += latency;
+        queue->latencyMax = latency > queue->latencyMax ? latency : queue->latencyMax;
+        queue->received++;
+
+        windowPushEvent(window, event);
+    }
+
+    INPUT_QUEUE_STORE(&queue->tail, tail);
 }
 
-static InputButton windowGetButton(const Window* window, MouseCode button)
+static void windowPushEvent(Window* window, InputEvent event)
 {
-    if (!window || button < 0 || button > MOUSE_BUTTON_LAST)
-        return (InputButton){0};
+    InputEvents* events = &window->events;
+
+    if (window->recording)
+        windowRecordEvent(window, &event);
+
+    if (window->forward)
+        inputQueuePush(window->forward, &event);
+
+    // The state is updated as events arrive so that a full ring only costs
+    // the oldest entries of the iterator, never a key that stays stuck down
+    windowApplyEvent(window, &event);
+
+    if (events->end - events->first == INPUT_EVENT_CAPACITY)
+    {
+        events->first++;
+        events->dropped++;
+    }
 
-    return window->mouse.buttons[button];
+    events->events[events->end++ & (INPUT_EVENT_CAPACITY - 1)] = event;
 }
 
-static void windowOnKey(GLFWwindow* native, int key, int scancode, int action, int mods)
+// Unlike the ring this keeps every event of the poll, a replay has to see
+// the ones the iterator dropped too
+static void windowRecordEvent(Window* window, const InputEvent* event)
 {
-    (void)scancode; (void)mods;
+    if (window->recordedCount == window->recordedCapacity)
+    {
+        uint capacity = window->recordedCapacity ? window->recordedCapacity * 2 : INPUT_EVENT_CAPACITY;
+        InputEvent* grown = realloc(window->recorded, capacity * sizeof *grown);
 
-    Window* window = glfwGetWindowUserPointer(native);
+        if (!grown)
+        {
+            window->recording->failed = 1;
+            return;
+        }
 
-    if (!window)
-        return;
+        window->recorded         = grown;
+        window->recordedCapacity = capacity;
+    }
 
-    // GLFW_KEY_UNKNOWN is -1, make it 0 to avoid a seg fault
-    if (key == GLFW_KEY_UNKNOWN)
-        key = KEY_UNKNOWN;
+    window->recorded[window->recordedCount++] = *event;
+}
 
-    switch (action)
+static void windowApplyEvent(Window* window, const InputEvent* event)
+{
+    Keyboard* keyboard = &window->keyboard;
+    Mouse*    mouse    = &window->mouse;
+
+    switch (event->type)
     {
-        case GLFW_PRESS: {
-            window->keyboard.keys[key].pressed = !window->keyboard.keys[key].down;
-            window->keyboard.keys[key].down = 1;
+        case INPUT_KEY: {
+            if ((uint)event->code >= KEY_LAST)
+                return;
+
+            uint i = event->code >> 5;
+
+            windowSetBit(&keyboard->down[i], &keyboard->pressed[i], &keyboard->released[i],
+                         1u << (event->code & 31), event->action);
+            keyboard->dirty |= 1u << i;
+            keyboard->mods   = event->mods;
         } break;
 
-        case GLFW_RELEASE: {
-            window->keyboard.keys[key].released = 1;
-            window->keyboard.keys[key].down = 0;
+        case INPUT_BUTTON: {
+            if ((uint)event->code >= MOUSE_BUTTON_LAST)
+                return;
+
+            windowSetBit(&mouse->down, &mouse->pressed, &mouse->released, 1u << event->code, event->action);
+            keyboard->mods = event->mods;
+        } break;
+
+        case INPUT_MOTION: {
+            mouse->dx += event->x - mouse->x;
+            mouse->dy += event->y - mouse->y;
+            mouse->x   = event->x;
+            mouse->y   = event->y;
+        } break;
+
+        case INPUT_SCROLL: {
+            mouse->scrollX += event->x;
+            mouse->scrollY += event->y;
         } break;
 
         default: {
@@ -342,25 +629,18 @@ static void windowOnKey(GLFWwindow* native, int key, int scancode, int action, i
     }
 }
 
-static void windowOnButton(GLFWwindow* native, int button, int action, int mods)
+static void windowSetBit(uint* down, uint* pressed, uint* released, uint bit, uchar action)
 {
-    (void)mods;
-
-    Window* window = glfwGetWindowUserPointer(native);
-
-    if (!window)
-        return;
-
     switch (action)
     {
-        case GLFW_PRESS: {
-            window->mouse.buttons[button].pressed = !window->mouse.buttons[button].down;
-            window->mouse.buttons[button].down = 1;
+        case INPUT_PRESS: {
+            *pressed |= bit & ~*down;
+            *down    |= bit;
         } break;
 
-        case GLFW_RELEASE: {
-            window->mouse.buttons[button].released = 1;
-            window->mouse.buttons[button].down = 0;
+        case INPUT_RELEASE: {
+            *released |= bit;
+            *down     &= ~bit;
         } break;
 
         default: {
@@ -368,6 +648,58 @@ static void windowOnButton(GLFWwindow* native, int button, int action, int mods)
     }
 }
 
+static bool windowTestKey(const uint* bits, KeyCode key)
+{
+    if ((uint)key >= KEY_LAST)
+        return 0;
+
+    return (bits[key >> 5] >> (key & 31)) & 1;
+}
+
+static bool windowTestButton(uint bits, MouseCode button)
+{
+    if ((uint)button >= MOUSE_BUTTON_LAST)
+        return 0;
+
+    return (bits >> button) & 1;
+}
+
+static bool windowTestKeySet(const uint* bits, const KeySet* set)
+{
+    uint any = 0;
+
+    for (int i = 0; i < INPUT_KEY_WORDS; ++i)
+        any |= bits[i] & set->bits[i];
+
+    return any != 0;
+}
+
+static void windowOnKey(GLFWwindow* native, int key, int scancode, int action, int mods)
+{
+    (void)scancode;
+
+    Window* window = glfwGetWindowUserPointer(native);
+
+    if (!window)
+        return;
+
+    // GLFW_KEY_UNKNOWN is -1, make it 0 to avoid a seg fault
+    if (key == GLFW_KEY_UNKNOWN)
+        key = KEY_UNKNOWN;
+
+    windowPushEvent(window, (InputEvent){glfwGetTime(), 0.0f, 0.0f, key, INPUT_KEY, action, mods});
+}
+
+static void windowOnButton(GLFWwindow* native, int button, int action, int mods)
+{
+    Window* window = glfwGetWindowUserPointer(native);
+
+    if (!window)
+        return;
+
+    windowPushEvent(window, (InputEvent){glfwGetTime(), 0.0f, 0.0f, button, INPUT_BUTTON, action, mods});
+}
+
 static void windowOnMouseMove(GLFWwindow* native, double x, double y)
 {
     Window* window = glfwGetWindowUserPointer(native);
@@ -375,10 +707,7 @@ static void windowOnMouseMove(GLFWwindow* native, double x, double y)
     if (!window)
         return;
 
-    window->mouse.dx = x - window->mouse.x;
-    window->mouse.dy = x - window->mouse.y;
-    window->mouse.x  = x;
-    window->mouse.y  = y;
+    windowPushEvent(window, (InputEvent){glfwGetTime(), x, y, 0, INPUT_MOTION, 0, 0});
 }
 
 static void windowOnMouseScroll(GLFWwindow* native, double x, double y)
@@ -388,6 +717,514 @@ static void windowOnMouseScroll(GLFWwindow* native, double x, double y)
     if (!window)
         return;
 
-    window->mouse.scrollX = x;
-    window->mouse.scrollY = y;
+    windowPushEvent(window, (InputEvent){glfwGetTime(), x, y, 0, INPUT_SCROLL, 0, 0});
+}
+
+//-----------------------------
+// ~ActionMap
+
+static uint actionMapMods(const Keyboard* keyboard);
+
+ActionMap* actionMapCreate(const InputBinding* bindings, uint bindingCount, uint actionCount)
+{
+    if (!bindings && bindingCount)
+        return NULL;
+
+    ActionMap* map = calloc(1, sizeof *map);
+
+    if (!map)
+        return NULL;
+
+    map->ruleCount   = bindingCount;
+    map->actionCount = actionCount;
+
+    // One extra so that an empty map still allocates
+    map->rules    = calloc(bindingCount + 1, sizeof *map->rules);
+    map->down     = calloc(actionCount + 1, sizeof *map->down);
+    map->pressed  = calloc(actionCount + 1, sizeof *map->pressed);
+    map->released = calloc(actionCount + 1, sizeof *map->released);
+    map->values   = calloc(actionCount + 1, sizeof *map->values);
+    map->previous = calloc(actionCount + 1, sizeof *map->previous);
+
+    if (!map->rules || !map->down || !map->pressed || !map->released || !map->values || !map->previous)
+        goto fail;
+
+    for (uint i = 0; i < bindingCount; ++i)
+    {
+        const InputBinding* binding = &bindings[i];
+
+        if (binding->action >= actionCount || binding->action > 0xFFFF || (uint)binding->chord >= KEY_LAST)
+            goto fail;
+
+        switch (binding->source)
+        {
+            case INPUT_SOURCE_KEY: {
+                if ((uint)binding->code >= KEY_LAST)
+                    goto fail;
+            } break;
+
+            case INPUT_SOURCE_BUTTON: {
+                if ((uint)binding->code >= MOUSE_BUTTON_LAST)
+                    goto fail;
+            } break;
+
+            case INPUT_SOURCE_MOUSE_X:
+            case INPUT_SOURCE_MOUSE_Y:
+            case INPUT_SOURCE_SCROLL_X:
+            case INPUT_SOURCE_SCROLL_Y: {
+                map->axisStart++;
+            } break;
+
+            default: {
+                goto fail;
+            } break;
+        }
+    }
+
+    // Keys and buttons fill the rules from the front and axes from axisStart
+    map->axisStart = bindingCount - map->axisStart;
+
+    for (uint i = 0, digital = 0, axis = map->axisStart; i < bindingCount; ++i)
+    {
+        const InputBinding* binding = &bindings[i];
+        bool isAxis = binding->source > INPUT_SOURCE_BUTTON;
+        ActionRule* rule = &map->rules[isAxis ? axis++ : digital++];
+
+        rule->action = binding->action;
+        rule->mods   = binding->mods;
+        rule->scale  = binding->scale;
+
+        if (binding->chord != KEY_UNKNOWN)
+        {
+            rule->chordWord = binding->chord >> 5;
+            rule->chordBit  = 1u << (binding->chord & 31);
+        }
+
+        switch (binding->source)
+        {
+            case INPUT_SOURCE_KEY: {
+                rule->word = binding->code >> 5;
+                rule->bit  = 1u << (binding->code & 31);
+            } break;
+
+            case INPUT_SOURCE_BUTTON: {
+                rule->word = INPUT_KEY_WORDS;
+                rule->bit  = 1u << binding->code;
+            } break;
+
+            default: {
+                rule->word = binding->source - INPUT_SOURCE_MOUSE_X;
+            } break;
+        }
+    }
+
+    return map;
+
+fail:
+    actionMapDestroy(map);
+    return NULL;
+}
+
+void actionMapDestroy(ActionMap* map)
+{
+    if (!map)
+        return;
+
+    free(map->rules);
+    free(map->down);
+    free(map->pressed);
+    free(map->released);
+    free(map->values);
+    free(map->previous);
+    free(map);
+}
+
+void actionMapUpdate(ActionMap* map, const Window* window)
+{
+    if (!map || !window)
+        return;
+
+    const Keyboard* keyboard = &window->keyboard;
+    const Mouse*    mouse    = &window->mouse;
+
+    // The keyboard words with the mouse buttons after them, so every rule
+    // reads its key or button and its chord the same way
+    uint down[INPUT_KEY_WORDS + 1];
+    uint taps[INPUT_KEY_WORDS + 1];
+
+    for (int i = 0; i < INPUT_KEY_WORDS; ++i)
+    {
+        down[i] = keyboard->down[i];
+        taps[i] = keyboard->pressed[i] & keyboard->released[i];
+    }
+
+    down[INPUT_KEY_WORDS] = mouse->down;
+    taps[INPUT_KEY_WORDS] = mouse->pressed & mouse->released;
+
+    uint  mods    = actionMapMods(keyboard);
+    float axes[4] = {mouse->dx, mouse->dy, mouse->scrollX, mouse->scrollY};
+    uint  count   = map->actionCount;
+
+    // Locals since every store through a bool may alias the map
+    const ActionRule* rules = map->rules;
+    bool*  actionDown = map->down;
+    bool*  pressed    = map->pressed;
+    bool*  released   = map->released;
+    bool*  previous   = map->previous;
+    float* values     = map->values;
+
+    // pressed collects the taps until the edges are worked out below
+    for (uint i = 0; i < count; ++i)
+    {
+        previous[i]   = actionDown[i];
+        actionDown[i] = 0;
+        pressed[i]    = 0;
+        values[i]     = 0.0f;
+    }
+
+    for (uint i = 0, end = map->axisStart; i < end; ++i)
+    {
+        ActionRule rule = rules[i];
+
+        bool active = ((mods & rule.mods) == rule.mods)
+                    & ((down[rule.chordWord] & rule.chordBit) == rule.chordBit);
+        bool held   = active & ((down[rule.word] & rule.bit) != 0);
+        bool tapped = active & ((taps[rule.word] & rule.bit) != 0);
+
+        values[rule.action]     += held ? rule.scale : 0.0f;
+        actionDown[rule.action] |= held;
+        pressed[rule.action]    |= tapped;
+    }
+
+    for (uint i = map->axisStart, end = map->ruleCount; i < end; ++i)
+    {
+        ActionRule rule = rules[i];
+
+        bool active = ((mods & rule.mods) == rule.mods)
+                    & ((down[rule.chordWord] & rule.chordBit) == rule.chordBit);
+        float value = active ? axes[rule.word] * rule.scale : 0.0f;
+
+        values[rule.action]     += value;
+        actionDown[rule.action] |= value != 0.0f;
+    }
+
+    for (uint i = 0; i < count; ++i)
+    {
+        bool tap = pressed[i];
+
+        pressed[i]  = (actionDown[i] && !previous[i]) || tap;
+        released[i] = (previous[i] && !actionDown[i]) || tap;
+    }
+}
+
+void windowSetActionMap(Window* window, ActionMap* map)
+{
+    if (!window)
+        return;
+
+    window->actions = map;
+}
+
+//- - - - - - - - - - - - - - -
+
+// Shift, control, alt and super from the keys held, the locks from the last
+// event since there is no key to tell whether they are on
+static uint actionMapMods(const Keyboard* keyboard)
+{
+    uint mods = keyboard->mods & (MOD_CAPS_LOCK | MOD_NUM_LOCK);
+
+    if (windowTestKey(keyboard->down, KEY_LEFT_SHIFT)   || windowTestKey(keyboard->down, KEY_RIGHT_SHIFT))
+        mods |= MOD_SHIFT;
+    if (windowTestKey(keyboard->down, KEY_LEFT_CONTROL) || windowTestKey(keyboard->down, KEY_RIGHT_CONTROL))
+        mods |= MOD_CONTROL;
+    if (windowTestKey(keyboard->down, KEY_LEFT_ALT)     || windowTestKey(keyboard->down, KEY_RIGHT_ALT))
+        mods |= MOD_ALT;
+    if (windowTestKey(keyboard->down, KEY_LEFT_SUPER)   || windowTestKey(keyboard->down, KEY_RIGHT_SUPER))
+        mods |= MOD_SUPER;
+
+    return mods;
+}
+
+//-----------------------------
+// ~Simulation
+
+#ifndef _WIN32
+static void* simulationRun(void* arg);
+#endif // _WIN32
+
+Simulation* simulationCreate(Window* window, float step, SimulationFn fn, void* data)
+{
+#ifndef _WIN32
+    if (!window || !fn || !(step > 0.0f) || window->forward)
+        return NULL;
+
+    Simulation* simulation = calloc(1, sizeof *simulation);
+
+    if (!simulation)
+        return NULL;
+
+    simulation->window  = window;
+    simulation->fn      = fn;
+    simulation->data    = data;
+    simulation->step    = step;
+    simulation->running = 1;
+    simulation->input   = windowCreateHeadless(window->title, window->w, window->h);
+    simulation->thread  = malloc(sizeof(pthread_t));
+
+    if (!simulation->input || !simulation->thread)
+        goto fail;
+
+    simulation->input->source = &simulation->queue;
+    window->forward = &simulation->queue;
+
+    if (pthread_create(simulation->thread, NULL, simulationRun, simulation) != 0)
+    {
+        window->forward = NULL;
+        goto fail;
+    }
+
+    return simulation;
+
+fail:
+    if (simulation->input)
+        windowDestroy(simulation->input);
+
+    free(simulation->thread);
+    free(simulation);
+    return NULL;
+#else
+    (void)window; (void)step; (void)fn; (void)data;
+    return NULL;
+#endif // _WIN32
+}
+
+void simulationDestroy(Simulation* simulation)
+{
+    if (!simulation)
+        return;
+
+#ifndef _WIN32
+    INPUT_QUEUE_STORE(&simulation->running, 0);
+    pthread_join(*(pthread_t*)simulation->thread, NULL);
+#endif // _WIN32
+
+    simulation->window->forward = NULL;
+
+    windowDestroy(simulation->input);
+    free(simulation->thread);
+    free(simulation);
+}
+
+void simulationLatency(const Simulation* simulation, double* mean, double* max)
+{
+    const InputQueue* queue = simulation ? &simulation->queue : NULL;
+
+    if (mean) *mean = queue && queue->received ? queue->latency / queue->received : 0.0;
+    if (max)  *max  = queue ? queue->latencyMax : 0.0;
+}
+
+//- - - - - - - - - - - - - - -
+
+#ifndef _WIN32
+static void* simulationRun(void* arg)
+{
+    Simulation* simulation = arg;
+    double next = glfwGetTime();
+
+    while (INPUT_QUEUE_LOAD(&simulation->running))
+    {
+        windowPollEvents(simulation->input);
+        simulation->fn(simulation, simulation->data);
+
+        // Keeps to the schedule, but a simulation that fell more than a
+        // step behind starts over from now instead of running to catch up
+        next += simulation->step;
+        double wait = next - glfwGetTime();
+
+        if (wait > 0.0)
+        {
+            struct timespec time = {(time_t)wait, (long)((wait - (time_t)wait) * 1e9)};
+            nanosleep(&time, NULL);
+        }
+        else if (wait < -simulation->step)
+        {
+            next = glfwGetTime();
+        }
+    }
+
+    return NULL;
+}
+#endif // _WIN32
+
+static void inputQueuePush(InputQueue* queue, const InputEvent* event)
+{
+    uint head = queue->head;
+
+    if (head - INPUT_QUEUE_LOAD(&queue->tail) == INPUT_QUEUE_CAPACITY)
+    {
+        queue->dropped++;
+        return;
+    }
+
+    queue->events[head & (INPUT_QUEUE_CAPACITY - 1)] = *event;
+    INPUT_QUEUE_STORE(&queue->head, head + 1);
+}
+
+//-----------------------------
+// ~InputRecording
+
+InputRecording* inputRecordingCreate(void)
+{
+    InputRecording* recording = calloc(1, sizeof *recording);
+
+    if (!recording)
+        return NULL;
+
+    inputRecordingWrite(recording, INPUT_RECORDING_MAGIC, sizeof INPUT_RECORDING_MAGIC - 1);
+
+    if (recording->failed)
+    {
+        free(recording);
+        return NULL;
+    }
+
+    return recording;
+}
+
+InputRecording* inputRecordingLoad(const char* path)
+{
+    InputRecording* recording = calloc(1, sizeof *recording);
+    FILE* fp = fopen(path, "rb");
+
+    if (!recording || !fp)
+        goto fail;
+
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    rewind(fp);
+
+    uint magic = sizeof INPUT_RECORDING_MAGIC - 1;
+
+    if (length < (long)magic || !(recording->data = malloc(length)))
+        goto fail;
+
+    if (fread(recording->data, 1, length, fp) != (size_t)length)
+        goto fail;
+
+    if (memcmp(recording->data, INPUT_RECORDING_MAGIC, magic) != 0)
+        goto fail;
+
+    recording->size     = length;
+    recording->capacity = length;
+    recording->cursor   = magic;
+
+    fclose(fp);
+    return recording;
+
+fail:
+    if (fp)
+        fclose(fp);
+
+    inputRecordingDestroy(recording);
+    return NULL;
+}
+
+bool inputRecordingSave(const InputRecording* recording, const char* path)
+{
+    if (!recording)
+        return 0;
+
+    FILE* fp = fopen(path, "wb");
+
+    if (!fp)
+        return 0;
+
+    bool written = fwrite(recording->data, 1, recording->size, fp) == recording->size;
+
+    return fclose(fp) == 0 && written;
+}
+
+void inputRecordingWriteFrame(InputRecording* recording, double time, float delta,
+                              const InputEvent* events, uint count)
+{
+    if (!recording)
+        return;
+
+    inputRecordingWrite(recording, &delta, sizeof delta);
+
+    for (uint i = 0; i < count; ++i)
+        inputRecordingWriteEvent(recording, &events[i], time);
+
+    inputRecordingWrite(recording, &(uchar){INPUT_RECORDING_END}, 1);
+}
+
+void inputRecordingDestroy(InputRecording* recording)
+{
+    if (!recording)
+        return;
+
+    free(recording->data);
+    free(recording);
+}
+
+//- - - - - - - - - - - - - - -
+
+static void inputRecordingWrite(InputRecording* recording, const void* data, uint size)
+{
+    if (recording->failed)
+        return;
+
+    if (recording->size + size > recording->capacity)
+    {
+        uint capacity = recording->capacity ? recording->capacity * 2 : INPUT_RECORDING_GROW;
+        uchar* grown = realloc(recording->data, capacity);
+
+        if (!grown)
+        {
+            recording->failed = 1;
+            return;
+        }
+
+        recording->data     = grown;
+        recording->capacity = capacity;
+    }
+
+    memcpy(recording->data + recording->size, data, size);
+    recording->size += size;
+}
+
+static bool inputRecordingRead(InputRecording* recording, void* data, uint size)
+{
+    // A truncated recording ends the replay
+    if (recording->size - recording->cursor < size)
+    {
+        recording->cursor = recording->size;
+        return 0;
+    }
+
+    memcpy(data, recording->data + recording->cursor, size);
+    recording->cursor += size;
+    return 1;
+}
+
+// Keys and buttons take 8 bytes, motion and scroll 13: a tag holding type and
+// action, the time after the poll as a float, then code and mods or x and y
+static void inputRecordingWriteEvent(InputRecording* recording, const InputEvent* event, double time)
+{
+    uchar tag    = event->type | event->action << 2;
+    float offset = (float)(event->time - time);
+
+    inputRecordingWrite(recording, &tag, 1);
+    inputRecordingWrite(recording, &offset, sizeof offset);
+
+    if (event->type == INPUT_KEY || event->type == INPUT_BUTTON)
+    {
+        inputRecordingWrite(recording, &event->code, sizeof event->code);
+        inputRecordingWrite(recording, &event->mods, 1);
+    }
+    else
+    {
+        inputRecordingWrite(recording, &event->x, sizeof event->x);
+        inputRecordingWrite(recording, &event->y, sizeof event->y);
+    }
 }
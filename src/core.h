@@ -3,7 +3,7 @@
 
 #ifndef uchar
     #define uchar  unsigned char
-    #define ushort unsigned int
+    #define ushort unsigned short
     #define uint   unsigned int
     #define ulong  unsigned long
     #define bool   unsigned char
@@ -16,21 +16,67 @@
 //-----------------------------
 // ~Input
 
-typedef struct InputButton
+#define INPUT_EVENT_CAPACITY 256 // Power of two
+
+typedef enum InputEventType
 {
-    bool down       : 1; // Is currently held down
-    bool pressed    : 1; // Was pressed this frame
-    bool released   : 1; // Was released this frame
-} InputButton;
+    INPUT_KEY,          // code is a KeyCode
+    INPUT_BUTTON,       // code is a MouseCode
+    INPUT_MOTION,       // x and y are the new cursor position
+    INPUT_SCROLL,       // x and y are the scroll offsets
+} InputEventType;
 
+typedef enum InputAction
+{
+    INPUT_RELEASE       = 0,
+    INPUT_PRESS         = 1,
+    INPUT_REPEAT        = 2,
+} InputAction;
+
+// One callback from the platform layer. time is in seconds on the
+// windowTime clock, taken when the event was received, so events polled in
+// the same frame still tell apart when they happened.
+typedef struct InputEvent
+{
+    double time;
+    float  x, y;
+    short  code;
+    uchar  type;        // InputEventType
+    uchar  action;      // InputAction, keys and buttons only
+    uchar  mods;        // MOD_* flags held, keys and buttons only
+} InputEvent;
+
+// Events received by the last windowPollEvents, oldest first. When more than
+// INPUT_EVENT_CAPACITY arrive in one frame the oldest are overwritten and
+// counted in dropped, the key and button state still sees every one of them.
+typedef struct InputEvents
+{
+    InputEvent events[INPUT_EVENT_CAPACITY];
+    uint       first;   // Free running, index with & (INPUT_EVENT_CAPACITY - 1)
+    uint       end;
+    uint       dropped;
+} InputEvents;
+
+#define INPUT_KEY_WORDS 11 // 32 keys per word, enough for KEY_LAST
+
+// Key and button state as one bit per key. pressed and released collect the
+// edges of every event in the frame, so a key tapped between two polls reads
+// as both. dirty has a bit per word of pressed / released that is non zero,
+// the next poll only clears those.
 typedef struct Keyboard
 {
-    InputButton keys[349];
+    uint down[INPUT_KEY_WORDS];
+    uint pressed[INPUT_KEY_WORDS];
+    uint released[INPUT_KEY_WORDS];
+    uint dirty;
+    uint mods;          // MOD_* flags of the last key or button event
 } Keyboard;
 
 typedef struct Mouse
 {
-    InputButton buttons[8];
+    uint  down;         // Bit per MouseCode
+    uint  pressed;
+    uint  released;
     float x, y;
     float dx, dy;
     float scrollX, scrollY;
@@ -38,6 +84,127 @@ typedef struct Mouse
     uchar disabled;
 } Mouse;
 
+#define INPUT_QUEUE_CAPACITY 1024 // Power of two
+
+// Hands events from one thread to another without locks. Only the producer
+// writes head and only the consumer writes tail, on separate cache lines. A
+// full queue drops the new event rather than block the producer. The
+// consumer measures how long events took from their callback to being
+// received, on its own cache line.
+typedef struct InputQueue
+{
+    InputEvent events[INPUT_QUEUE_CAPACITY];
+
+    uint   head;
+    uint   dropped;
+    uchar  producerPad[56];
+
+    uint   tail;
+    uint   received;
+    double latency;         // Sum of the latencies of the received events, in seconds
+    double latencyMax;
+    uchar  consumerPad[40];
+} InputQueue;
+
+// Everything windowPollEvents received, frame after frame: the time since
+// the previous poll followed by that poll's events. The bytes are in the
+// byte order of the machine that recorded them.
+typedef struct InputRecording
+{
+    uchar* data;
+    uint   size;
+    uint   capacity;
+    uint   cursor;      // Read position while replaying
+    bool   failed;      // Ran out of memory, nothing after that was recorded
+} InputRecording;
+
+// Any number of keys tested with one call, see keySetAdd
+typedef struct KeySet
+{
+    uint bits[INPUT_KEY_WORDS];
+} KeySet;
+
+//-----------------------------
+// ~ActionMap
+
+typedef enum InputSource
+{
+    INPUT_SOURCE_KEY,       // code is a KeyCode
+    INPUT_SOURCE_BUTTON,    // code is a MouseCode
+    INPUT_SOURCE_MOUSE_X,   // Cursor movement this frame
+    INPUT_SOURCE_MOUSE_Y,
+    INPUT_SOURCE_SCROLL_X,  // Scrolling this frame
+    INPUT_SOURCE_SCROLL_Y,
+} InputSource;
+
+// Binds one key, button or axis to an action. An action can have any number
+// of bindings, it is down while any of them is. A binding only counts while
+// its chord key and all of its mods are held, mods that aren't asked for
+// are ignored.
+typedef struct InputBinding
+{
+    uint        action;     // Index into the ActionMap arrays
+    InputSource source;
+    int         code;       // Unused by the axes
+    int         chord;      // KeyCode of another key that must be held, KEY_UNKNOWN for none
+    uint        mods;       // MOD_* flags
+    float       scale;      // Added to the action's value while held, axes are multiplied by it
+} InputBinding;
+
+// A binding compiled down to the words and bits it reads. Keys and buttons
+// read the keyboard words with the mouse buttons as one more word after
+// them, axes read the axis at word.
+typedef struct ActionRule
+{
+    ushort action;
+    uchar  mods;
+    uchar  word;
+    uchar  chordWord;
+    uint   bit;
+    uint   chordBit;        // 0 without a chord
+    float  scale;
+} ActionRule;
+
+// Evaluated in one pass over the rules, the results are one entry per
+// action. pressed and released are edges since the last update, a tap
+// between two updates sets both.
+typedef struct ActionMap
+{
+    ActionRule* rules;      // Keys and buttons first, then the axes
+    uint        ruleCount;
+    uint        axisStart;
+    uint        actionCount;
+
+    bool*       down;
+    bool*       pressed;
+    bool*       released;
+    float*      values;     // Sum of the scales of the held bindings and the scaled axes
+    bool*       previous;
+} ActionMap;
+
+//-----------------------------
+// ~Simulation
+
+typedef struct Simulation Simulation;
+typedef void (*SimulationFn)(Simulation* simulation, void* data);
+
+// Calls fn every step seconds on a thread of its own, while the window's
+// thread only has to poll. The window forwards its events through queue to
+// input, a headless window polled right before every step, so fn reads the
+// keys, the events and an action map set on input like it would on the
+// window. queue holds the input latency, from the callback to that poll.
+struct Simulation
+{
+    InputQueue     queue;
+    struct Window* window;
+    struct Window* input;
+    SimulationFn   fn;
+    void*          data;
+    float          step;    // Seconds between two calls of fn
+    uint           running; // Cleared to stop the thread
+    void*          thread;
+};
+
 //-----------------------------
 // ~Window
 
@@ -53,6 +220,22 @@ typedef struct Window
 
     Keyboard keyboard;
     Mouse mouse;
+    InputEvents events;
+
+    double time;  // windowTime at the last windowPollEvents
+    float  delta; // Seconds between the last two windowPollEvents
+
+    InputRecording* recording;
+    InputRecording* replay;
+
+    InputEvent* recorded;    // Events of the poll being recorded, all of them
+    uint        recordedCount;
+    uint        recordedCapacity;
+
+    ActionMap* actions;
+
+    InputQueue* forward; // Every event is also pushed here
+    InputQueue* source;  // Polled instead of the native window
 } Window;
 
 //-----------------------------
@@ -233,6 +416,7 @@ enum
 // ~Window
 
 Window* windowCreate(const char* title, int w, int h, uint flags);
+Window* windowCreateHeadless(const char* title, int w, int h); // No native window or context, for replays
 void    windowDestroy(Window* window);
 
 void    windowSwapBuffers(const Window* window);
@@ -249,19 +433,46 @@ void    windowSetSize(Window* window, int w, int h);
 void    windowSetPos(Window* window, int x, int y);
 void    windowRestore(Window* window);
 
+// Seconds since the first window was created and since the previous
+// windowPollEvents. While replaying both follow the recording instead of
+// the clock, so a simulation stepped by them replays the same way.
+double  windowTime(const Window* window);
+float   windowDeltaTime(const Window* window);
+
 //-----------------------------
 // ~Input
 
 void    windowPollEvents(Window* window);
 
+// Walks the events of the last windowPollEvents in the order they arrived.
+// Start with *iterator at 0, returns NULL once they have all been read:
+//     uint it = 0;
+//     for (const InputEvent* e; (e = windowNextEvent(window, &it));)
+const InputEvent* windowNextEvent(const Window* window, uint* iterator);
+uint    windowEventCount(const Window* window);
+
 bool    windowIsKeyDown(const Window* window, KeyCode key);
 bool    windowIsKeyPressed(const Window* window, KeyCode key);
 bool    windowIsKeyReleased(const Window* window, KeyCode key);
 
+// Start from KeySet set = {0}. The window queries are true when at least one
+// key of the set is down / pressed / released.
+void    keySetAdd(KeySet* set, KeyCode key);
+bool    windowIsAnyKeyDown(const Window* window, const KeySet* set);
+bool    windowIsAnyKeyPressed(const Window* window, const KeySet* set);
+bool    windowIsAnyKeyReleased(const Window* window, const KeySet* set);
+
 bool    windowIsButtonDown(const Window* window, MouseCode button);
 bool    windowIsButtonPressed(const Window* window, MouseCode button);
 bool    windowIsButtonReleased(const Window* window, MouseCode button);
 
+// Record every poll into recording, or replay one instead of polling the
+// native window, NULL stops either. A replay starts from the first frame,
+// once it runs out windowIsOpen returns 0. Record a replay to re-record it.
+void    windowRecordInput(Window* window, InputRecording* recording);
+void    windowReplayInput(Window* window, InputRecording* recording);
+bool    windowIsReplaying(const Window* window);
+
 float   windowMouseXPos(const Window* window);
 float   windowMouseYPos(const Window* window);
 void    windowMousePos(const Window* window, float* x, float* y);
@@ -282,4 +493,42 @@ void    windowEnableCursor(Window* window);
 void    windowDisableCursor(Window* window);
 bool    windowIsCursorDisabled(const Window* window);
 
+//-----------------------------
+// ~ActionMap
+
+// NULL when out of memory or a binding is out of range
+ActionMap*      actionMapCreate(const InputBinding* bindings, uint bindingCount, uint actionCount);
+void            actionMapDestroy(ActionMap* map);
+
+// Updates map from the window's current state. A map set on the window is
+// updated by every windowPollEvents, NULL removes it.
+void            actionMapUpdate(ActionMap* map, const Window* window);
+void            windowSetActionMap(Window* window, ActionMap* map);
+
+//-----------------------------
+// ~Simulation
+
+// Starts the thread, NULL when out of memory or without thread support.
+// Destroy the simulation before its window, that also stops the thread.
+Simulation*     simulationCreate(Window* window, float step, SimulationFn fn, void* data);
+void            simulationDestroy(Simulation* simulation);
+
+// Mean and worst latency of the input received so far, either may be NULL.
+// Call it from fn, the simulation thread updates both.
+void            simulationLatency(const Simulation* simulation, double* mean, double* max);
+
+//-----------------------------
+// ~InputRecording
+
+InputRecording* inputRecordingCreate(void);
+InputRecording* inputRecordingLoad(const char* path); // NULL if it can't be read or isn't a recording
+
+// Appends one poll the way windowPollEvents records it: delta, then count
+// events. time is windowTime after that poll, the events keep their times
+// relative to it. Builds synthetic sessions to replay.
+void            inputRecordingWriteFrame(InputRecording* recording, double time, float delta,
+                                         const InputEvent* events, uint count);
+bool            inputRecordingSave(const InputRecording* recording, const char* path);
+void            inputRecordingDestroy(InputRecording* recording);
+
 #endif // MODULE_CORE_H
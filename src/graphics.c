@@ -1,3 +1,4 @@
+#include "maths.h"
 #include "graphics.h"
 #include "glad/glad.h"
 #define STB_IMAGE_IMPLEMENTATION
@@ -32,8 +33,6 @@ static inline int glCheckError(const char* file, const char* func, int line)
 //-----------------------------
 // ~VBO
 
-static int glTypeSize(int type);
-
 VBO vboCreate(const void* data, uint size, uint stride, DrawMode mode)
 {
     VBO vbo = {0};
@@ -60,47 +59,50 @@ void vboUnbind(VBO vbo)
     glCheck(glBindBuffer(GL_ARRAY_BUFFER, 0));
 }
 
-void vboPushAttribute(VBO vbo, int type, int count, bool normalized)
+void vboPushAttribute(VBO* vbo, VertexAttribute attribute)
 {
-    vboBind(vbo);
+    vboBind(*vbo);
 
-    glCheck(glEnableVertexAttribArray(vbo.layout.index));
+    glCheck(glEnableVertexAttribArray(vbo->layout.index));
     glCheck(glVertexAttribPointer(
-        vbo.layout.index,
-        count,
-        type,
-        normalized,
-        vbo.layout.stride,
-        (const void*)&vbo.layout.offset
+        vbo->layout.index,
+        attribute.count,
+        attribute.type,
+        attribute.normalized,
+        vbo->layout.stride,
+        (const void*)(size_t)vbo->layout.offset
     ));
 
-    vbo.layout.index++;
-    vbo.layout.offset += glTypeSize(type);
+    vbo->layout.index++;
+    vbo->layout.offset += attribute.size;
 }
 
-void vboSubmitData(VBO vbo, const void* data, uint size, uint offset)
+// The shader rebuilds the matrix with transpose(mat4(row0, row1, row2, vec4(0, 0, 0, 1)))
+void vboPushInstanceTransform(VBO vbo, uint index)
 {
     vboBind(vbo);
-    glCheck(glBufferSubData(GL_ARRAY_BUFFER, offset, size, data));
-}
 
-//- - - - - - - - - - - - - - -
-
-static int glTypeSize(int type)
-{
-    switch (type)
+    for (uint i = 0; i < 3; ++i)
     {
-        case GL_BYTE:              return 1;
-        case GL_UNSIGNED_BYTE:     return 1;
-        case GL_SHORT:             return 2;
-        case GL_UNSIGNED_SHORT:    return 2;
-        case GL_INT:               return 4;
-        case GL_UNSIGNED_INT:      return 4;
-        case GL_FLOAT:             return 4;
-        default:                   return 0;
+        glCheck(glEnableVertexAttribArray(index + i));
+        glCheck(glVertexAttribPointer(
+            index + i,
+            4,
+            GL_FLOAT,
+            GL_FALSE,
+            sizeof(m4x3),
+            (const void*)(i * 4 * sizeof(float))
+        ));
+        glCheck(glVertexAttribDivisor(index + i, 1));
     }
 }
 
+void vboSubmitData(VBO vbo, const void* data, uint size, uint offset)
+{
+    vboBind(vbo);
+    glCheck(glBufferSubData(GL_ARRAY_BUFFER, offset, size, data));
+}
+
 //-----------------------------
 // ~IBO
 
@@ -438,3 +440,35 @@ void textureUnbind(Texture tex)
     (void)tex;
     glCheck(glBindTexture(GL_TEXTURE_2D, 0));
 }
+
+//-----------------------------
+// ~Model
+
+void modelTranslate(Model* model, v3 pos)
+{
+    if (!model)
+        return;
+
+    model->transform = m4x3Translate(model->transform, pos);
+}
+
+void modelRotate(Model* model, v3 axis, float angle)
+{
+    if (!model)
+        return;
+
+    model->transform = m4x3Rotate(model->transform, axis, angle);
+}
+
+void modelScale(Model* model, v3 scale)
+{
+    if (!model)
+        return;
+
+    model->transform = m4x3Scale(model->transform, scale);
+}
+
+void modelScaleUni(Model* model, float scale)
+{
+    modelScale(model, (v3){scale, scale, scale});
+}
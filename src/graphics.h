@@ -3,7 +3,7 @@
 
 #ifndef uchar
     #define uchar  unsigned char
-    #define ushort unsigned int
+    #define ushort unsigned short
     #define uint   unsigned int
     #define ulong  unsigned long
     #define bool   unsigned char
@@ -65,6 +65,12 @@
         float m30, m31, m32, m33;
     } m4;
 
+    typedef struct m4x3 {
+        float m00, m10, m20, m30;
+        float m01, m11, m21, m31;
+        float m02, m12, m22, m32;
+    } m4x3;
+
     typedef struct c4 {
         uchar r;
         uchar g;
@@ -152,10 +158,14 @@ typedef struct {
 // ~Mesh
 
 typedef struct {
-    v3*   vertices;
-    uint* indices;
-    v4*   colors;
-    v2*   uvs;
+    v3*     vertices;
+    uint*   indices;
+    v4*     colors;
+    v2*     uvs;
+    ushort* joints;  // 4 joint indices per vertex, NULL if the mesh isn't skinned
+    v4*     weights; // Weight of each of those joints, see skinLinear in animation.h
+    uint    vertexCount;
+    uint    indexCount;
 
     Material* material;
 
@@ -168,7 +178,7 @@ typedef struct {
 // ~Model
 
 typedef struct {
-    m4 transform;
+    m4x3 transform;
     Mesh* meshes;
     const char* path;
 } Model;
@@ -186,6 +196,25 @@ typedef enum DrawMode {
     STREAM_DRAW     = 0x88E0  // GL_STREAM_DRAW
 } DrawMode;
 
+// Layout of one vertex attribute for vboPushAttribute. The compact formats
+// match the quantize kernels in maths.h, shaders still read them as floats.
+typedef struct VertexAttribute {
+    int  type;
+    int  count;
+    bool normalized;
+    uint size; // Bytes in the buffer
+} VertexAttribute;
+
+#define VERTEX_F32x2        (VertexAttribute){ 0x1406, 2, 0, 8  } // GL_FLOAT
+#define VERTEX_F32x3        (VertexAttribute){ 0x1406, 3, 0, 12 } // GL_FLOAT
+#define VERTEX_F32x4        (VertexAttribute){ 0x1406, 4, 0, 16 } // GL_FLOAT
+#define VERTEX_F16x2        (VertexAttribute){ 0x140B, 2, 0, 4  } // GL_HALF_FLOAT, quantizeHalf
+#define VERTEX_F16x4        (VertexAttribute){ 0x140B, 4, 0, 8  } // GL_HALF_FLOAT, quantizeHalf
+#define VERTEX_SNORM16x2    (VertexAttribute){ 0x1402, 2, 1, 4  } // GL_SHORT, quantizeSnorm16 or quantizeOctahedral
+#define VERTEX_SNORM16x4    (VertexAttribute){ 0x1402, 4, 1, 8  } // GL_SHORT, quantizeSnorm16
+#define VERTEX_UNORM8x4     (VertexAttribute){ 0x1401, 4, 1, 4  } // GL_UNSIGNED_BYTE, quantizeUnorm8
+#define VERTEX_SNORM1010102 (VertexAttribute){ 0x8D9F, 4, 1, 4  } // GL_INT_2_10_10_10_REV, quantizeSnorm1010102
+
 //=============================================================
 // Prototypes
 //=============================================================
@@ -199,7 +228,8 @@ void        vboDestroy(VBO vbo);
 void        vboBind(VBO vbo);
 void        vboUnbind(VBO vbo);
 
-void        vboPushAttribute(VBO vbo, int type, int count, int normalized);
+void        vboPushAttribute(VBO* vbo, VertexAttribute attribute); // Call in attribute order, layout advances each time
+void        vboPushInstanceTransform(VBO vbo, uint index); // m4x3 per instance, rows at index..index + 2
 void        vboPushData(VBO vbo, const void* data, uint size);
 void        vboSetData(VBO vbo, const void* data, uint size);
 
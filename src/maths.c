@@ -1,833 +1,1993 @@
+#define _POSIX_C_SOURCE 200809L // sysconf
+
+// The small functions are defined in maths.h, this is the one translation
+// unit that emits them as regular functions even when the project is built
+// with MATHS_INLINE.
+#undef  MATHS_INLINE
+#define MATHS_IMPLEMENTATION
 #include "maths.h"
-#include <math.h> // sqrt, sin, cos, tan
+#include "simd.h"
+
+#include <math.h>   // sqrt, sin, cos, tan, fabsf
+#include <stdlib.h> // malloc, free
+#include <stdint.h> // uintptr_t
+#include <string.h> // memmove, memcpy
+
+#ifndef _WIN32
+    #include <pthread.h> // pthread_create, pthread_join
+    #include <unistd.h>  // sysconf
+#endif // _WIN32
 
 //-----------------------------
-// ~v2
+// ~Trig
 
-v2 v2Add(v2 a, v2 b)
-{
-    return (v2){a.x + b.x, a.y + b.y};
-}
+// Cody-Waite split of pi / 2, the first two parts have enough trailing zero
+// bits that q * part is exact for any quadrant a float can hold
+#define TRIG_PIO2_1 1.5703125f
+#define TRIG_PIO2_2 4.837512969970703125e-4f
+#define TRIG_PIO2_3 7.54978995489188216e-8f
 
-v2 v2Sub(v2 a, v2 b)
+// Minimax coefficients for [-pi/4, pi/4] (Cephes sinf/cosf)
+#define TRIG_S1 -1.6666654611e-1f
+#define TRIG_S2  8.3321608736e-3f
+#define TRIG_S3 -1.9515295891e-4f
+#define TRIG_C1  4.166664568298827e-2f
+#define TRIG_C2 -1.388731625493765e-3f
+#define TRIG_C3  2.443315711809948e-5f
+
+static inline void sinCosKernel(simdf x, simdf* s, simdf* c);
+
+void sinCos(float x, float* s, float* c)
 {
-    return (v2){a.x - b.x, a.y - b.y};
+#ifdef MATHS_FAST_TRIG
+    sinCosFast(x, s, c);
+#else
+    sinCosPrecise(x, s, c);
+#endif // MATHS_FAST_TRIG
 }
 
-v2 v2Mul(v2 a, v2 b)
+void sinCosPrecise(float x, float* s, float* c)
 {
-    return (v2){a.x * b.x, a.y * b.y};
+    *s = sinf(x);
+    *c = cosf(x);
 }
 
-v2 v2Div(v2 a, v2 b)
+// One lane of sinCosKernel, so it matches sinCosBatch bit for bit. Written
+// out in scalar code the quadrant selects became branches that mispredict
+// on arbitrary angles and lrintf a libm call, both slower than sinf + cosf.
+void sinCosFast(float x, float* s, float* c)
 {
-    return (v2){a.x / b.x, a.y / b.y};
+    simdf vs, vc;
+    sinCosKernel(simdSet1(x), &vs, &vc);
+
+    float ls[SIMD_WIDTH], lc[SIMD_WIDTH];
+    simdStoreu(ls, vs);
+    simdStoreu(lc, vc);
+
+    *s = ls[0];
+    *c = lc[0];
 }
 
-v2 v2Addf(v2 a, float b)
+void sinCosBatch(const float* x, float* s, float* c, uint n)
 {
-    return (v2){a.x + b, a.y + b};
+    uint i = 0;
+
+    for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    {
+        simdf vs, vc;
+        sinCosKernel(simdLoadu(x + i), &vs, &vc);
+        simdStoreu(s + i, vs);
+        simdStoreu(c + i, vc);
+    }
+
+    for (; i < n; ++i)
+        sinCosFast(x[i], &s[i], &c[i]);
 }
 
-v2 v2Subf(v2 a, float b)
+//- - - - - - - - - - - - - - -
+
+static inline void sinCosKernel(simdf x, simdf* s, simdf* c)
 {
-    return (v2){a.x - b, a.y - b};
+    simdi q = simdiRound(simdMul(x, simdSet1((float)(2.0 / PI))));
+    simdf qf = simdiToFloat(q);
+
+    simdf r = simdSub(x, simdMul(qf, simdSet1(TRIG_PIO2_1)));
+    r = simdSub(r, simdMul(qf, simdSet1(TRIG_PIO2_2)));
+    r = simdSub(r, simdMul(qf, simdSet1(TRIG_PIO2_3)));
+
+    simdf r2 = simdMul(r, r);
+
+    simdf ps = simdAdd(simdSet1(TRIG_S2), simdMul(r2, simdSet1(TRIG_S3)));
+    ps = simdAdd(simdSet1(TRIG_S1), simdMul(r2, ps));
+    ps = simdAdd(r, simdMul(simdMul(r, r2), ps));
+
+    simdf pc = simdAdd(simdSet1(TRIG_C2), simdMul(r2, simdSet1(TRIG_C3)));
+    pc = simdAdd(simdSet1(TRIG_C1), simdMul(r2, pc));
+    pc = simdAdd(simdSub(simdSet1(1.0f), simdMul(simdSet1(0.5f), r2)), simdMul(simdMul(r2, r2), pc));
+
+    simdi one = simdiSet1(1);
+    simdi two = simdiSet1(2);
+
+    simdf swap = simdiCmpEq(simdiAnd(q, one), one);
+    simdf ss = simdSelect(swap, pc, ps);
+    simdf cc = simdSelect(swap, ps, pc);
+
+    simdf sign = simdSet1(-0.0f);
+    *s = simdXor(ss, simdAnd(simdiCmpEq(simdiAnd(q, two), two), sign));
+    *c = simdXor(cc, simdAnd(simdiCmpEq(simdiAnd(simdiAdd(q, one), two), two), sign));
 }
 
-v2 v2Mulf(v2 a, float b)
+
+//-----------------------------
+// ~quat
+
+static inline quat quatNlerpKernel(quat a, quat b, float t);
+static inline quat quatSlerpKernel(quat a, quat b, float t);
+static inline void quatToM4Kernel(quat q, v3 t, v3 s, m4* out);
+
+#ifdef MATHS_SSE2
+static inline void quatToM4Lanes(__m128 x, __m128 y, __m128 z, __m128 w, __m128 sx, __m128 sy, __m128 sz, __m128 c[3][4]);
+static inline void quatStoreM4(m4* out, __m128 c[3][4], v3 t0, v3 t1, v3 t2, v3 t3);
+#endif // MATHS_SSE2
+
+quat quatIdentity(void)
 {
-    return (v2){a.x * b, a.y * b};
+    return (quat){0.0f, 0.0f, 0.0f, 1.0f};
 }
 
-v2 v2Divf(v2 a, float b)
+quat quatFromAxisAngle(v3 axis, float angle)
 {
-    return (v2){a.x / b, a.y / b};
+    float s, c;
+    sinCos(angle * 0.5f, &s, &c);
+    s /= v3Mag(axis);
+    return (quat){axis.x * s, axis.y * s, axis.z * s, c};
 }
 
-
-float v2Mag2(v2 a)
+quat quatMul(quat a, quat b)
 {
-    return a.x * a.x + a.y * a.y;
+    return (quat) {
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z
+    };
 }
 
-float v2Mag(v2 a)
+quat quatConjugate(quat q)
 {
-    return sqrtf(v2Mag2(a));
+    return (quat){-q.x, -q.y, -q.z, q.w};
 }
 
-float v2Dot(v2 a, v2 b)
+quat quatInverse(quat q)
 {
-    return a.x * b.x + a.y * b.y;
+    return quatDivf(quatConjugate(q), v4Mag2(q));
 }
 
-float v2MinVal(v2 a)
+quat quatNormTo(quat q)
 {
-    return MIN(a.x, a.y);
+    return quatDivf(q, v4Mag(q));
 }
 
-float v2MaxVal(v2 a)
+// v' = v + w * t + cross(q.xyz, t) where t = 2 * cross(q.xyz, v)
+v3 quatRotate(quat q, v3 v)
 {
-    return MAX(a.x, a.y);
+    v3 u = {q.x, q.y, q.z};
+    v3 t = v3Mulf(v3Cross(u, v), 2.0f);
+    return v3Add(v3Add(v, v3Mulf(t, q.w)), v3Cross(u, t));
 }
 
-v2 v2Min(v2 a, v2 b)
+quat quatNlerp(quat a, quat b, float t)
 {
-    return (v2){MIN(a.x, b.x), MIN(a.y, b.y)};
+    return quatNlerpKernel(a, b, t);
 }
 
-v2 v2Max(v2 a, v2 b)
+quat quatSlerp(quat a, quat b, float t)
 {
-    return (v2){MAX(a.x, b.x), MAX(a.y, b.y)};
+    return quatSlerpKernel(a, b, t);
 }
 
-void v2Norm(v2* a)
+m4 quatToM4(quat q)
 {
-    *a = v2Divf(*a, v2Mag(*a));
+    m4 out;
+    quatToM4Kernel(q, (v3){0.0f, 0.0f, 0.0f}, (v3){1.0f, 1.0f, 1.0f}, &out);
+    return out;
 }
 
-v2 v2NormTo(v2 a)
+//- - - - - - - - - - - - - - -
+
+// Coefficients of the 8 term polynomial from "A Fast and Accurate Algorithm
+// for Computing SLERP" (Eberly), u[i] = 1 / (i * (2i + 1)) and
+// v[i] = i / (2i + 1) for i = 1..8, the last term is scaled by mu to
+// balance the truncation error. The weights are within 2e-5 of sin(t * a) / sin(a).
+static const float quatSlerpU[8] = {
+    1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9),
+    1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), 1.85298109240830f / (8 * 17)
+};
+
+static const float quatSlerpV[8] = {
+    1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9,
+    5.0f / 11, 6.0f / 13, 7.0f / 15, 1.85298109240830f * 8 / 17
+};
+
+static inline quat quatNlerpKernel(quat a, quat b, float t)
 {
-    return v2Divf(a, v2Mag(a));
+    float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    float sign = dot < 0.0f ? -1.0f : 1.0f;
+    float ta = 1.0f - t;
+    float tb = sign * t;
+
+    quat r = {
+        a.x * ta + b.x * tb,
+        a.y * ta + b.y * tb,
+        a.z * ta + b.z * tb,
+        a.w * ta + b.w * tb
+    };
+
+    float mag = sqrtf(r.x * r.x + r.y * r.y + r.z * r.z + r.w * r.w);
+    return (quat){r.x / mag, r.y / mag, r.z / mag, r.w / mag};
 }
 
-void v2Rotate(v2* a, float angle)
+static inline quat quatSlerpKernel(quat a, quat b, float t)
 {
-    a->x = a->x * cosf(angle) - a->y * sinf(angle);
-    a->y = a->x * sinf(angle) - a->y * cosf(angle);
+    float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    float sign = dot < 0.0f ? -1.0f : 1.0f;
+    float xm1 = dot * sign - 1.0f;
+    float d = 1.0f - t;
+    float sqrT = t * t;
+    float sqrD = d * d;
+
+    float ct = 1.0f;
+    float cd = 1.0f;
+
+    for (int i = 7; i >= 0; --i)
+    {
+        ct = 1.0f + (quatSlerpU[i] * sqrT - quatSlerpV[i]) * xm1 * ct;
+        cd = 1.0f + (quatSlerpU[i] * sqrD - quatSlerpV[i]) * xm1 * cd;
+    }
+
+    ct = sign * t * ct;
+    cd = d * cd;
+
+    return (quat) {
+        a.x * cd + b.x * ct,
+        a.y * cd + b.y * ct,
+        a.z * cd + b.z * ct,
+        a.w * cd + b.w * ct
+    };
 }
 
-v2 v2RotateTo(v2 a, float angle)
+static inline void quatToM4Kernel(quat q, v3 t, v3 s, m4* out)
 {
-    return (v2) {
-        a.x * cosf(angle) - a.y * sinf(angle),
-        a.x * sinf(angle) - a.y * cosf(angle)
+    float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+    float xx = q.x * x2, yy = q.y * y2, zz = q.z * z2;
+    float xy = q.x * y2, xz = q.x * z2, yz = q.y * z2;
+    float wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+
+    *out = (m4) {
+        (1.0f - (yy + zz)) * s.x, (xy + wz) * s.x, (xz - wy) * s.x, 0.0f,
+        (xy - wz) * s.y, (1.0f - (xx + zz)) * s.y, (yz + wx) * s.y, 0.0f,
+        (xz + wy) * s.z, (yz - wx) * s.z, (1.0f - (xx + yy)) * s.z, 0.0f,
+        t.x, t.y, t.z, 1.0f
     };
 }
 
 //-----------------------------
-// ~v3
+// ~Inverse
+
+typedef struct m4NormalJob
+{
+    const m4* in;
+    m3* out;
+    bool* ok;
+} m4NormalJob;
+
+static inline float m4Cofactor3(const m4* m, m3* c);
+static void m4NormalRange(void* data, uint begin, uint end);
+
+#ifdef MATHS_SSE2
+static inline __m128 m2Mul(__m128 a, __m128 b);
+static inline __m128 m2AdjMul(__m128 a, __m128 b);
+static inline __m128 m2MulAdj(__m128 a, __m128 b);
+#endif // MATHS_SSE2
+
+float m4Determinant(m4 m)
+{
+    float b00 = m.m00 * m.m11 - m.m01 * m.m10;
+    float b01 = m.m00 * m.m12 - m.m02 * m.m10;
+    float b02 = m.m00 * m.m13 - m.m03 * m.m10;
+    float b03 = m.m01 * m.m12 - m.m02 * m.m11;
+    float b04 = m.m01 * m.m13 - m.m03 * m.m11;
+    float b05 = m.m02 * m.m13 - m.m03 * m.m12;
+    float b06 = m.m20 * m.m31 - m.m21 * m.m30;
+    float b07 = m.m20 * m.m32 - m.m22 * m.m30;
+    float b08 = m.m20 * m.m33 - m.m23 * m.m30;
+    float b09 = m.m21 * m.m32 - m.m22 * m.m31;
+    float b10 = m.m21 * m.m33 - m.m23 * m.m31;
+    float b11 = m.m22 * m.m33 - m.m23 * m.m32;
+
+    return b00 * b11 - b01 * b10 + b02 * b09 + b03 * b08 - b04 * b07 + b05 * b06;
+}
+
+// The SSE path splits the matrix into four 2x2 blocks and inverts it through
+// their adjugates, the scalar path expands the 2x2 minors of the top and
+// bottom halves. Both round differently so results may differ in the last bit.
+bool m4Inverse(m4 m, m4* out)
+{
+#ifdef MATHS_SSE2
+    // Loading columns as rows inverts the transpose, which stores back as the
+    // inverse, so the block math below is written for rows
+    __m128 r0 = _mm_loadu_ps(&m.m00), r1 = _mm_loadu_ps(&m.m10), r2 = _mm_loadu_ps(&m.m20), r3 = _mm_loadu_ps(&m.m30);
+
+    __m128 a = _mm_movelh_ps(r0, r1);
+    __m128 b = _mm_movehl_ps(r1, r0);
+    __m128 c = _mm_movelh_ps(r2, r3);
+    __m128 d = _mm_movehl_ps(r3, r2);
+
+    // |A| |B| |C| |D|
+    __m128 dets = _mm_sub_ps(
+        _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+        _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0)))
+    );
+
+    __m128 detA = _mm_shuffle_ps(dets, dets, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 detB = _mm_shuffle_ps(dets, dets, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 detC = _mm_shuffle_ps(dets, dets, _MM_SHUFFLE(2, 2, 2, 2));
+    __m128 detD = _mm_shuffle_ps(dets, dets, _MM_SHUFFLE(3, 3, 3, 3));
+
+    __m128 dc = m2AdjMul(d, c);
+    __m128 ab = m2AdjMul(a, b);
+
+    __m128 x = _mm_sub_ps(_mm_mul_ps(detD, a), m2Mul(b, dc));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(detA, d), m2Mul(c, ab));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(detB, c), m2MulAdj(d, ab));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(detC, b), m2MulAdj(a, dc));
+
+    // |M| = |A| |D| + |B| |C| - tr((A# B) (D# C))
+    __m128 tr = _mm_mul_ps(ab, _mm_shuffle_ps(dc, dc, _MM_SHUFFLE(3, 1, 2, 0)));
+    tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(2, 3, 0, 1)));
+    tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+    if (!(fabsf(_mm_cvtss_f32(det)) > MATHS_SINGULAR_EPSILON))
+        return 0;
+
+    __m128 inv = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+
+    x = _mm_mul_ps(x, inv);
+    y = _mm_mul_ps(y, inv);
+    z = _mm_mul_ps(z, inv);
+    w = _mm_mul_ps(w, inv);
+
+    // The adjugate shuffle and the block to row shuffle in one go
+    _mm_storeu_ps(&out->m00, _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+    _mm_storeu_ps(&out->m10, _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+    _mm_storeu_ps(&out->m20, _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+    _mm_storeu_ps(&out->m30, _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+
+    return 1;
+#else
+    float b00 = m.m00 * m.m11 - m.m01 * m.m10;
+    float b01 = m.m00 * m.m12 - m.m02 * m.m10;
+    float b02 = m.m00 * m.m13 - m.m03 * m.m10;
+    float b03 = m.m01 * m.m12 - m.m02 * m.m11;
+    float b04 = m.m01 * m.m13 - m.m03 * m.m11;
+    float b05 = m.m02 * m.m13 - m.m03 * m.m12;
+    float b06 = m.m20 * m.m31 - m.m21 * m.m30;
+    float b07 = m.m20 * m.m32 - m.m22 * m.m30;
+    float b08 = m.m20 * m.m33 - m.m23 * m.m30;
+    float b09 = m.m21 * m.m32 - m.m22 * m.m31;
+    float b10 = m.m21 * m.m33 - m.m23 * m.m31;
+    float b11 = m.m22 * m.m33 - m.m23 * m.m32;
+
+    float det = b00 * b11 - b01 * b10 + b02 * b09 + b03 * b08 - b04 * b07 + b05 * b06;
+
+    if (!(fabsf(det) > MATHS_SINGULAR_EPSILON))
+        return 0;
+
+    float inv = 1.0f / det;
+
+    *out = (m4) {
+        (m.m11 * b11 - m.m12 * b10 + m.m13 * b09) * inv,
+        (m.m02 * b10 - m.m01 * b11 - m.m03 * b09) * inv,
+        (m.m31 * b05 - m.m32 * b04 + m.m33 * b03) * inv,
+        (m.m22 * b04 - m.m21 * b05 - m.m23 * b03) * inv,
+
+        (m.m12 * b08 - m.m10 * b11 - m.m13 * b07) * inv,
+        (m.m00 * b11 - m.m02 * b08 + m.m03 * b07) * inv,
+        (m.m32 * b02 - m.m30 * b05 - m.m33 * b01) * inv,
+        (m.m20 * b05 - m.m22 * b02 + m.m23 * b01) * inv,
+
+        (m.m10 * b10 - m.m11 * b08 + m.m13 * b06) * inv,
+        (m.m01 * b08 - m.m00 * b10 - m.m03 * b06) * inv,
+        (m.m30 * b04 - m.m31 * b02 + m.m33 * b00) * inv,
+        (m.m21 * b02 - m.m20 * b04 - m.m23 * b00) * inv,
+
+        (m.m11 * b07 - m.m10 * b09 - m.m12 * b06) * inv,
+        (m.m00 * b09 - m.m01 * b07 + m.m02 * b06) * inv,
+        (m.m31 * b01 - m.m30 * b03 - m.m32 * b00) * inv,
+        (m.m20 * b03 - m.m21 * b01 + m.m22 * b00) * inv
+    };
 
-v3 v3Add(v3 a, v3 b)
-{
-    return (v3){a.x + b.x, a.y + b.y, a.z + b.z};
+    return 1;
+#endif // MATHS_SSE2
 }
 
-v3 v3Sub(v3 a, v3 b)
+// The rows of the inverse upper 3x3 are the cross products of its columns
+// over the determinant, the translation is then just -R^-1 * t
+bool m4AffineInverse(m4 m, m4* out)
 {
-    return (v3){a.x - b.x, a.y - b.y, a.z - b.z};
+    m3 c;
+    float det = m4Cofactor3(&m, &c);
+
+    if (!(fabsf(det) > MATHS_SINGULAR_EPSILON))
+        return 0;
+
+    float inv = 1.0f / det;
+
+    v3 r0 = {c.m00 * inv, c.m01 * inv, c.m02 * inv};
+    v3 r1 = {c.m10 * inv, c.m11 * inv, c.m12 * inv};
+    v3 r2 = {c.m20 * inv, c.m21 * inv, c.m22 * inv};
+    v3 t  = {m.m30, m.m31, m.m32};
+
+    *out = (m4) {
+        r0.x, r1.x, r2.x, 0.0f,
+        r0.y, r1.y, r2.y, 0.0f,
+        r0.z, r1.z, r2.z, 0.0f,
+        -v3Dot(r0, t), -v3Dot(r1, t), -v3Dot(r2, t), 1.0f
+    };
+
+    return 1;
 }
 
-v3 v3Mul(v3 a, v3 b)
+bool m4NormalMatrix(m4 m, m3* out)
 {
-    return (v3){a.x * b.x, a.y * b.y, a.z * b.z};
+    float det = m4Cofactor3(&m, out);
+
+    if (!(fabsf(det) > MATHS_SINGULAR_EPSILON))
+        return 0;
+
+    *out = m3Mulf(*out, 1.0f / det);
+    return 1;
 }
 
-v3 v3Div(v3 a, v3 b)
+void m4NormalMatrixBatch(const m4* in, m3* out, bool* ok, uint n)
 {
-    return (v3){a.x / b.x, a.y / b.y, a.z / b.z};
+    m4NormalJob job = {in, out, ok};
+    parallelFor(n, parallelThreshold(), m4NormalRange, &job);
 }
 
-v3 v3Addf(v3 a, float b)
+//- - - - - - - - - - - - - - -
+
+// Cofactor matrix of the upper 3x3 laid out as a normal transform, so it is
+// the inverse transpose scaled by the returned determinant
+static inline float m4Cofactor3(const m4* m, m3* c)
 {
-    return (v3){a.x + b, a.y + b, a.z + b};
+    c->m00 = m->m11 * m->m22 - m->m12 * m->m21;
+    c->m01 = m->m12 * m->m20 - m->m10 * m->m22;
+    c->m02 = m->m10 * m->m21 - m->m11 * m->m20;
+
+    c->m10 = m->m21 * m->m02 - m->m22 * m->m01;
+    c->m11 = m->m22 * m->m00 - m->m20 * m->m02;
+    c->m12 = m->m20 * m->m01 - m->m21 * m->m00;
+
+    c->m20 = m->m01 * m->m12 - m->m02 * m->m11;
+    c->m21 = m->m02 * m->m10 - m->m00 * m->m12;
+    c->m22 = m->m00 * m->m11 - m->m01 * m->m10;
+
+    return m->m00 * c->m00 + m->m01 * c->m01 + m->m02 * c->m02;
 }
 
-v3 v3Subf(v3 a, float b)
+// Four matrices per iteration, the upper 3x3s are transposed so each register
+// holds one element of all four and the lanes follow m4Cofactor3 and
+// m4NormalMatrix op for op, singular lanes are scaled by 1 instead.
+static void m4NormalRange(void* data, uint begin, uint end)
 {
-    return (v3){a.x - b, a.y - b, a.z - b};
+    m4NormalJob* job = data;
+    uint i = begin;
+
+#ifdef MATHS_SSE2
+    __m128 one  = _mm_set1_ps(1.0f);
+    __m128 eps  = _mm_set1_ps(MATHS_SINGULAR_EPSILON);
+    __m128 sign = _mm_set1_ps(-0.0f);
+
+    for (; i + 4 <= end; i += 4)
+    {
+        const m4* m = &job->in[i];
+
+        __m128 m00 = _mm_loadu_ps(&m[0].m00), m01 = _mm_loadu_ps(&m[1].m00), m02 = _mm_loadu_ps(&m[2].m00), m03 = _mm_loadu_ps(&m[3].m00);
+        __m128 m10 = _mm_loadu_ps(&m[0].m10), m11 = _mm_loadu_ps(&m[1].m10), m12 = _mm_loadu_ps(&m[2].m10), m13 = _mm_loadu_ps(&m[3].m10);
+        __m128 m20 = _mm_loadu_ps(&m[0].m20), m21 = _mm_loadu_ps(&m[1].m20), m22 = _mm_loadu_ps(&m[2].m20), m23 = _mm_loadu_ps(&m[3].m20);
+        _MM_TRANSPOSE4_PS(m00, m01, m02, m03);
+        _MM_TRANSPOSE4_PS(m10, m11, m12, m13);
+        _MM_TRANSPOSE4_PS(m20, m21, m22, m23);
+
+        __m128 c[9] = {
+            _mm_sub_ps(_mm_mul_ps(m11, m22), _mm_mul_ps(m12, m21)), // m00
+            _mm_sub_ps(_mm_mul_ps(m21, m02), _mm_mul_ps(m22, m01)), // m10
+            _mm_sub_ps(_mm_mul_ps(m01, m12), _mm_mul_ps(m02, m11)), // m20
+            _mm_sub_ps(_mm_mul_ps(m12, m20), _mm_mul_ps(m10, m22)), // m01
+            _mm_sub_ps(_mm_mul_ps(m22, m00), _mm_mul_ps(m20, m02)), // m11
+            _mm_sub_ps(_mm_mul_ps(m02, m10), _mm_mul_ps(m00, m12)), // m21
+            _mm_sub_ps(_mm_mul_ps(m10, m21), _mm_mul_ps(m11, m20)), // m02
+            _mm_sub_ps(_mm_mul_ps(m20, m01), _mm_mul_ps(m21, m00)), // m12
+            _mm_sub_ps(_mm_mul_ps(m00, m11), _mm_mul_ps(m01, m10))  // m22
+        };
+
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, c[0]), _mm_mul_ps(m01, c[3])), _mm_mul_ps(m02, c[6]));
+        __m128 regular = _mm_cmpgt_ps(_mm_andnot_ps(sign, det), eps);
+        __m128 inv = _mm_or_ps(_mm_and_ps(regular, _mm_div_ps(one, det)), _mm_andnot_ps(regular, one));
+
+        float lanes[9][4];
+        for (int k = 0; k < 9; ++k)
+            _mm_storeu_ps(lanes[k], _mm_mul_ps(c[k], inv));
+
+        for (int k = 0; k < 4; ++k)
+        {
+            float* o = &job->out[i + k].m00;
+            for (int e = 0; e < 9; ++e)
+                o[e] = lanes[e][k];
+        }
+
+        if (job->ok)
+        {
+            int mask = _mm_movemask_ps(regular);
+            for (int k = 0; k < 4; ++k)
+                job->ok[i + k] = (mask >> k) & 1;
+        }
+    }
+#endif // MATHS_SSE2
+
+    for (; i < end; ++i)
+    {
+        bool r = m4NormalMatrix(job->in[i], &job->out[i]);
+        if (job->ok)
+            job->ok[i] = r;
+    }
 }
 
-v3 v3Mulf(v3 a, float b)
+#ifdef MATHS_SSE2
+// 2x2 blocks are stored row major in one register, A# is the adjugate
+
+// A * B
+static inline __m128 m2Mul(__m128 a, __m128 b)
 {
-    return (v3){a.x * b, a.y * b, a.z * b};
+    return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+                      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
 }
 
-v3 v3Divf(v3 a, float b)
+// A# * B
+static inline __m128 m2AdjMul(__m128 a, __m128 b)
 {
-    return (v3){a.x / b, a.y / b, a.z / b};
+    return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+                      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
 }
 
-float v3Mag2(v3 a)
+// A * B#
+static inline __m128 m2MulAdj(__m128 a, __m128 b)
 {
-    return a.x * a.x + a.y * a.y + a.z * a.z;
+    return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+                      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
 }
+#endif // MATHS_SSE2
+
+//-----------------------------
+// ~m4 batches
 
-float v3Mag(v3 a)
+typedef struct m4TransformJob
 {
-    return sqrtf(v3Mag2(a));
-}
+    m4 m;
+    const v3* in;
+    v3* out;
+    float w;
+    int normalize;
+} m4TransformJob;
 
-float v3Dot(v3 a, v3 b)
+static void m4TransformRange(void* data, uint begin, uint end);
+
+void m4MulBatch(const m4* a, const m4* b, m4* out, uint n)
 {
-    return a.x * b.x + a.y * b.y + a.z * b.z;
+    for (uint i = 0; i < n; ++i)
+        m4MulKernel(&a[i], &b[i], &out[i]);
 }
 
-float v3MinVal(v3 a)
+void m4Mulv4Batch(const m4* a, const v4* b, v4* out, uint n)
 {
-    return MIN(MIN(a.x, a.y), a.z);
+    for (uint i = 0; i < n; ++i)
+        m4Mulv4Kernel(&a[i], &b[i], &out[i]);
 }
 
-float v3MaxVal(v3 a)
+void m4TransformPoints(m4 m, const v3* in, v3* out, uint n)
 {
-    return MAX(MAX(a.x, a.y), a.z);
+    m4TransformJob job = {m, in, out, 1.0f, 0};
+    parallelFor(n, parallelThreshold(), m4TransformRange, &job);
 }
 
-v3 v3Min(v3 a, v3 b)
+void m4TransformDirections(m4 m, const v3* in, v3* out, uint n)
 {
-    return (v3) {
-        MIN(a.x, b.x),
-        MIN(a.y, b.y),
-        MIN(a.z, b.z)
-    };
+    m4TransformJob job = {m, in, out, 0.0f, 0};
+    parallelFor(n, parallelThreshold(), m4TransformRange, &job);
 }
 
-v3 v3Max(v3 a, v3 b)
+// The cofactor matrix of the upper 3x3 is the inverse transpose scaled by the
+// determinant, only its sign matters since the result is renormalized.
+void m4TransformNormals(m4 m, const v3* in, v3* out, uint n)
 {
-    return (v3) {
-        MAX(a.x, b.x),
-        MAX(a.y, b.y),
-        MAX(a.z, b.z)
+    m3 n3;
+    float det = m4Cofactor3(&m, &n3);
+
+    m4 c = {
+        n3.m00, n3.m01, n3.m02, 0.0f,
+        n3.m10, n3.m11, n3.m12, 0.0f,
+        n3.m20, n3.m21, n3.m22, 0.0f,
+        0.0f,   0.0f,   0.0f,   0.0f
     };
+
+    if (det < 0.0f)
+        c = m4Mulf(c, -1.0f);
+
+    m4TransformJob job = {c, in, out, 0.0f, 1};
+    parallelFor(n, parallelThreshold(), m4TransformRange, &job);
+}
+
+//- - - - - - - - - - - - - - -
+
+// Four points per iteration: three loads cover x0 y0 z0 x1 | y1 z1 x2 y2 |
+// z2 x3 y3 z3, which are shuffled into x, y and z registers, transformed and
+// shuffled back. Whatever is left over goes through the scalar path, which
+// accumulates in the same order.
+static void m4TransformRange(void* data, uint begin, uint end)
+{
+    const m4TransformJob* job = data;
+    const m4* m = &job->m;
+    const float* in = &job->in[0].x;
+    float* out = &job->out[0].x;
+    uint i = begin;
+
+#ifdef MATHS_SSE2
+    __m128 m00 = _mm_set1_ps(m->m00), m10 = _mm_set1_ps(m->m10), m20 = _mm_set1_ps(m->m20), m30 = _mm_set1_ps(m->m30 * job->w);
+    __m128 m01 = _mm_set1_ps(m->m01), m11 = _mm_set1_ps(m->m11), m21 = _mm_set1_ps(m->m21), m31 = _mm_set1_ps(m->m31 * job->w);
+    __m128 m02 = _mm_set1_ps(m->m02), m12 = _mm_set1_ps(m->m12), m22 = _mm_set1_ps(m->m22), m32 = _mm_set1_ps(m->m32 * job->w);
+
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(in + i * 3 + 0);
+        __m128 b = _mm_loadu_ps(in + i * 3 + 4);
+        __m128 c = _mm_loadu_ps(in + i * 3 + 8);
+
+        __m128 x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m10, y)), _mm_mul_ps(m20, z)), m30);
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, x), _mm_mul_ps(m11, y)), _mm_mul_ps(m21, z)), m31);
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, x), _mm_mul_ps(m12, y)), _mm_mul_ps(m22, z)), m32);
+
+        if (job->normalize)
+        {
+            __m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz)));
+            rx = _mm_div_ps(rx, mag);
+            ry = _mm_div_ps(ry, mag);
+            rz = _mm_div_ps(rz, mag);
+        }
+
+        __m128 xy = _mm_unpacklo_ps(rx, ry);
+        __m128 xyHi = _mm_unpackhi_ps(rx, ry);
+
+        _mm_storeu_ps(out + i * 3 + 0, _mm_shuffle_ps(xy, _mm_shuffle_ps(rz, rx, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(out + i * 3 + 4, _mm_shuffle_ps(_mm_shuffle_ps(ry, rz, _MM_SHUFFLE(1, 1, 1, 1)), xyHi, _MM_SHUFFLE(1, 0, 2, 0)));
+        _mm_storeu_ps(out + i * 3 + 8, _mm_shuffle_ps(_mm_shuffle_ps(rz, rx, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(ry, rz, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+#endif // MATHS_SSE2
+
+    float tx = m->m30 * job->w;
+    float ty = m->m31 * job->w;
+    float tz = m->m32 * job->w;
+
+    for (; i < end; ++i)
+    {
+        float x = in[i * 3 + 0], y = in[i * 3 + 1], z = in[i * 3 + 2];
+
+        float rx = m->m00 * x + m->m10 * y + m->m20 * z + tx;
+        float ry = m->m01 * x + m->m11 * y + m->m21 * z + ty;
+        float rz = m->m02 * x + m->m12 * y + m->m22 * z + tz;
+
+        if (job->normalize)
+        {
+            float mag = sqrtf(rx * rx + ry * ry + rz * rz);
+            rx /= mag;
+            ry /= mag;
+            rz /= mag;
+        }
+
+        out[i * 3 + 0] = rx;
+        out[i * 3 + 1] = ry;
+        out[i * 3 + 2] = rz;
+    }
 }
 
-void v3Norm(v3* a)
+//-----------------------------
+// ~m4x3 batches
+
+void m4x3MulBatch(const m4x3* a, const m4x3* b, m4x3* out, uint n)
 {
-    *a = v3Divf(*a, v3Mag2(*a));
+    for (uint i = 0; i < n; ++i)
+        m4x3MulKernel(&a[i], &b[i], &out[i]);
 }
 
-v3 v3NormTo(v3 a)
+void m4x3TransformPoints(m4x3 m, const v3* in, v3* out, uint n)
 {
-    return v3Divf(a, v3Mag2(a));
+    m4TransformJob job = {m4x3ToM4(m), in, out, 1.0f, 0};
+    parallelFor(n, parallelThreshold(), m4TransformRange, &job);
+}
+
+//-----------------------------
+// ~quat batches
+
+// Four quaternions per iteration, transposed so each register holds one
+// component of all four. The lane math mirrors the scalar kernels above op
+// for op so the SIMD and scalar paths give identical results.
+
+void quatNlerpBatch(const quat* a, const quat* b, float t, quat* out, uint n)
+{
+    uint i = 0;
+
+#ifdef MATHS_SSE2
+    __m128 ta = _mm_set1_ps(1.0f - t);
+    __m128 vt = _mm_set1_ps(t);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 ax = _mm_loadu_ps(&a[i + 0].x), ay = _mm_loadu_ps(&a[i + 1].x), az = _mm_loadu_ps(&a[i + 2].x), aw = _mm_loadu_ps(&a[i + 3].x);
+        __m128 bx = _mm_loadu_ps(&b[i + 0].x), by = _mm_loadu_ps(&b[i + 1].x), bz = _mm_loadu_ps(&b[i + 2].x), bw = _mm_loadu_ps(&b[i + 3].x);
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz)), _mm_mul_ps(aw, bw));
+        __m128 neg = _mm_cmplt_ps(dot, _mm_setzero_ps());
+        __m128 sign = _mm_or_ps(_mm_and_ps(neg, _mm_set1_ps(-1.0f)), _mm_andnot_ps(neg, _mm_set1_ps(1.0f)));
+        __m128 tb = _mm_mul_ps(sign, vt);
+
+        __m128 rx = _mm_add_ps(_mm_mul_ps(ax, ta), _mm_mul_ps(bx, tb));
+        __m128 ry = _mm_add_ps(_mm_mul_ps(ay, ta), _mm_mul_ps(by, tb));
+        __m128 rz = _mm_add_ps(_mm_mul_ps(az, ta), _mm_mul_ps(bz, tb));
+        __m128 rw = _mm_add_ps(_mm_mul_ps(aw, ta), _mm_mul_ps(bw, tb));
+
+        __m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz)), _mm_mul_ps(rw, rw)));
+        rx = _mm_div_ps(rx, mag);
+        ry = _mm_div_ps(ry, mag);
+        rz = _mm_div_ps(rz, mag);
+        rw = _mm_div_ps(rw, mag);
+
+        _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+        _mm_storeu_ps(&out[i + 0].x, rx);
+        _mm_storeu_ps(&out[i + 1].x, ry);
+        _mm_storeu_ps(&out[i + 2].x, rz);
+        _mm_storeu_ps(&out[i + 3].x, rw);
+    }
+#endif // MATHS_SSE2
+
+    for (; i < n; ++i)
+        out[i] = quatNlerpKernel(a[i], b[i], t);
+}
+
+void quatSlerpBatch(const quat* a, const quat* b, float t, quat* out, uint n)
+{
+    uint i = 0;
+
+#ifdef MATHS_SSE2
+    float d = 1.0f - t;
+
+    // Both polynomial terms only depend on t, hoist them out of the loop
+    __m128 termT[8], termD[8];
+    for (int k = 0; k < 8; ++k)
+    {
+        termT[k] = _mm_set1_ps(quatSlerpU[k] * (t * t) - quatSlerpV[k]);
+        termD[k] = _mm_set1_ps(quatSlerpU[k] * (d * d) - quatSlerpV[k]);
+    }
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 vt = _mm_set1_ps(t);
+    __m128 vd = _mm_set1_ps(d);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 ax = _mm_loadu_ps(&a[i + 0].x), ay = _mm_loadu_ps(&a[i + 1].x), az = _mm_loadu_ps(&a[i + 2].x), aw = _mm_loadu_ps(&a[i + 3].x);
+        __m128 bx = _mm_loadu_ps(&b[i + 0].x), by = _mm_loadu_ps(&b[i + 1].x), bz = _mm_loadu_ps(&b[i + 2].x), bw = _mm_loadu_ps(&b[i + 3].x);
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz)), _mm_mul_ps(aw, bw));
+        __m128 neg = _mm_cmplt_ps(dot, _mm_setzero_ps());
+        __m128 sign = _mm_or_ps(_mm_and_ps(neg, _mm_set1_ps(-1.0f)), _mm_andnot_ps(neg, one));
+        __m128 xm1 = _mm_sub_ps(_mm_mul_ps(dot, sign), one);
+
+        __m128 ct = one;
+        __m128 cd = one;
+
+        for (int k = 7; k >= 0; --k)
+        {
+            ct = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(termT[k], xm1), ct));
+            cd = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(termD[k], xm1), cd));
+        }
+
+        ct = _mm_mul_ps(_mm_mul_ps(sign, vt), ct);
+        cd = _mm_mul_ps(vd, cd);
+
+        __m128 rx = _mm_add_ps(_mm_mul_ps(ax, cd), _mm_mul_ps(bx, ct));
+        __m128 ry = _mm_add_ps(_mm_mul_ps(ay, cd), _mm_mul_ps(by, ct));
+        __m128 rz = _mm_add_ps(_mm_mul_ps(az, cd), _mm_mul_ps(bz, ct));
+        __m128 rw = _mm_add_ps(_mm_mul_ps(aw, cd), _mm_mul_ps(bw, ct));
+
+        _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+        _mm_storeu_ps(&out[i + 0].x, rx);
+        _mm_storeu_ps(&out[i + 1].x, ry);
+        _mm_storeu_ps(&out[i + 2].x, rz);
+        _mm_storeu_ps(&out[i + 3].x, rw);
+    }
+#endif // MATHS_SSE2
+
+    for (; i < n; ++i)
+        out[i] = quatSlerpKernel(a[i], b[i], t);
+}
+
+void quatToM4Batch(const quat* r, const v3* t, const v3* s, m4* out, uint n)
+{
+    uint i = 0;
+
+#ifdef MATHS_SSE2
+    __m128 one = _mm_set1_ps(1.0f);
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&r[i + 0].x), y = _mm_loadu_ps(&r[i + 1].x), z = _mm_loadu_ps(&r[i + 2].x), w = _mm_loadu_ps(&r[i + 3].x);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        __m128 sx = one, sy = one, sz = one;
+        if (s)
+        {
+            sx = _mm_setr_ps(s[i].x, s[i + 1].x, s[i + 2].x, s[i + 3].x);
+            sy = _mm_setr_ps(s[i].y, s[i + 1].y, s[i + 2].y, s[i + 3].y);
+            sz = _mm_setr_ps(s[i].z, s[i + 1].z, s[i + 2].z, s[i + 3].z);
+        }
+
+        __m128 c[3][4];
+        quatToM4Lanes(x, y, z, w, sx, sy, sz, c);
+
+        v3 zero = {0.0f, 0.0f, 0.0f};
+        quatStoreM4(&out[i], c, t ? t[i] : zero, t ? t[i + 1] : zero, t ? t[i + 2] : zero, t ? t[i + 3] : zero);
+    }
+#endif // MATHS_SSE2
+
+    for (; i < n; ++i)
+    {
+        v3 ti = t ? t[i] : (v3){0.0f, 0.0f, 0.0f};
+        v3 si = s ? s[i] : (v3){1.0f, 1.0f, 1.0f};
+        quatToM4Kernel(r[i], ti, si, &out[i]);
+    }
 }
 
-v3 v3Cross(v3 a, v3 b)
+//- - - - - - - - - - - - - - -
+
+#ifdef MATHS_SSE2
+// Rotation times scale for four quaternions, c[j][r] holds the entry in
+// column j and row r of all four with a row of zeros below. Same ops as
+// quatToM4Kernel.
+static inline void quatToM4Lanes(__m128 x, __m128 y, __m128 z, __m128 w, __m128 sx, __m128 sy, __m128 sz, __m128 c[3][4])
+{
+    __m128 one = _mm_set1_ps(1.0f);
+
+    __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+    __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+    __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+    __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+    c[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+    c[0][1] = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+    c[0][2] = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+    c[0][3] = _mm_setzero_ps();
+
+    c[1][0] = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+    c[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+    c[1][2] = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+    c[1][3] = _mm_setzero_ps();
+
+    c[2][0] = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+    c[2][1] = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+    c[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+    c[2][3] = _mm_setzero_ps();
+}
+
+// Transposes the lanes into columns and writes the four matrices
+static inline void quatStoreM4(m4* out, __m128 c[3][4], v3 t0, v3 t1, v3 t2, v3 t3)
 {
-    return (v3) {
-        a.y * b.z - a.z * b.y,
-        a.z * b.x - a.z * b.z,
-        a.x * b.y - a.y * b.x
-    };
+    _MM_TRANSPOSE4_PS(c[0][0], c[0][1], c[0][2], c[0][3]);
+    _MM_TRANSPOSE4_PS(c[1][0], c[1][1], c[1][2], c[1][3]);
+    _MM_TRANSPOSE4_PS(c[2][0], c[2][1], c[2][2], c[2][3]);
+
+    v3 t[4] = {t0, t1, t2, t3};
+
+    for (int k = 0; k < 4; ++k)
+    {
+        float* o = &out[k].m00;
+        _mm_storeu_ps(o + 0, c[0][k]);
+        _mm_storeu_ps(o + 4, c[1][k]);
+        _mm_storeu_ps(o + 8, c[2][k]);
+        o[12] = t[k].x;
+        o[13] = t[k].y;
+        o[14] = t[k].z;
+        o[15] = 1.0f;
+    }
 }
+#endif // MATHS_SSE2
 
 //-----------------------------
-// ~v4
+// ~TRS
+
+typedef struct TrsJob
+{
+    const TRS* in;
+    m4* m4s;
+    m4x3* m4x3s;
+} TrsJob;
+
+static inline void trsToM4x3Kernel(const TRS* trs, m4x3* out);
+static void trsToM4Range(void* data, uint begin, uint end);
+static void trsToM4x3Range(void* data, uint begin, uint end);
+
+#ifdef MATHS_SSE2
+static inline void trsLoadLanes(const TRS* in, __m128 c[3][4]);
+#endif // MATHS_SSE2
 
-v4 v4Add(v4 a, v4 b)
+TRS trsIdentity(void)
 {
-    return (v4){a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+    return (TRS){{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 1.0f}, {1.0f, 1.0f, 1.0f}};
 }
 
-v4 v4Sub(v4 a, v4 b)
+m4 trsToM4(TRS trs)
 {
-    return (v4){a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
+    m4 out;
+    quatToM4Kernel(trs.rotation, trs.translation, trs.scale, &out);
+    return out;
 }
 
-v4 v4Mul(v4 a, v4 b)
+m4x3 trsToM4x3(TRS trs)
 {
-    return (v4){a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w};
+    m4x3 out;
+    trsToM4x3Kernel(&trs, &out);
+    return out;
 }
 
-v4 v4Div(v4 a, v4 b)
+void trsToM4Batch(const TRS* in, m4* out, uint n)
 {
-    return (v4){a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w};
+    TrsJob job = {in, out, NULL};
+    parallelFor(n, parallelThreshold(), trsToM4Range, &job);
 }
 
-v4 v4Addf(v4 a, float b)
+void trsToM4x3Batch(const TRS* in, m4x3* out, uint n)
 {
-    return (v4){a.x + b, a.y + b, a.z + b, a.w + b};
+    TrsJob job = {in, NULL, out};
+    parallelFor(n, parallelThreshold(), trsToM4x3Range, &job);
 }
 
-v4 v4Subf(v4 a, float b)
+//- - - - - - - - - - - - - - -
+
+// The rows of quatToM4Kernel's matrix with the translation on the end
+static inline void trsToM4x3Kernel(const TRS* trs, m4x3* out)
 {
-    return (v4){a.x - b, a.y - b, a.z - b, a.w - b};
+    quat q = trs->rotation;
+    v3 t = trs->translation, s = trs->scale;
+
+    float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+    float xx = q.x * x2, yy = q.y * y2, zz = q.z * z2;
+    float xy = q.x * y2, xz = q.x * z2, yz = q.y * z2;
+    float wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+
+    *out = (m4x3) {
+        (1.0f - (yy + zz)) * s.x, (xy - wz) * s.y, (xz + wy) * s.z, t.x,
+        (xy + wz) * s.x, (1.0f - (xx + zz)) * s.y, (yz - wx) * s.z, t.y,
+        (xz - wy) * s.x, (yz + wx) * s.y, (1.0f - (xx + yy)) * s.z, t.z
+    };
 }
 
-v4 v4Mulf(v4 a, float b)
+static void trsToM4Range(void* data, uint begin, uint end)
 {
-    return (v4){a.x * b, a.y * b, a.z * b, a.w * b};
+    TrsJob* job = data;
+    const TRS* in = job->in;
+    m4* out = job->m4s;
+    uint i = begin;
+
+#ifdef MATHS_SSE2
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 c[3][4];
+        trsLoadLanes(&in[i], c);
+        quatStoreM4(&out[i], c, in[i].translation, in[i + 1].translation, in[i + 2].translation, in[i + 3].translation);
+    }
+#endif // MATHS_SSE2
+
+    for (; i < end; ++i)
+        quatToM4Kernel(in[i].rotation, in[i].translation, in[i].scale, &out[i]);
 }
 
-v4 v4Divf(v4 a, float b)
+// Row r of the four matrices is c[0][r], c[1][r], c[2][r] and the
+// translation's r component, one transpose turns that into four rows
+static void trsToM4x3Range(void* data, uint begin, uint end)
 {
-    return (v4){a.x / b, a.y / b, a.z / b, a.w / b};
+    TrsJob* job = data;
+    const TRS* in = job->in;
+    m4x3* out = job->m4x3s;
+    uint i = begin;
+
+#ifdef MATHS_SSE2
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 c[3][4];
+        trsLoadLanes(&in[i], c);
+
+        __m128 t[3] = {
+            _mm_setr_ps(in[i].translation.x, in[i + 1].translation.x, in[i + 2].translation.x, in[i + 3].translation.x),
+            _mm_setr_ps(in[i].translation.y, in[i + 1].translation.y, in[i + 2].translation.y, in[i + 3].translation.y),
+            _mm_setr_ps(in[i].translation.z, in[i + 1].translation.z, in[i + 2].translation.z, in[i + 3].translation.z)
+        };
+
+        for (int r = 0; r < 3; ++r)
+        {
+            __m128 r0 = c[0][r], r1 = c[1][r], r2 = c[2][r], r3 = t[r];
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            _mm_storeu_ps(&out[i + 0].m00 + r * 4, r0);
+            _mm_storeu_ps(&out[i + 1].m00 + r * 4, r1);
+            _mm_storeu_ps(&out[i + 2].m00 + r * 4, r2);
+            _mm_storeu_ps(&out[i + 3].m00 + r * 4, r3);
+        }
+    }
+#endif // MATHS_SSE2
+
+    for (; i < end; ++i)
+        trsToM4x3Kernel(&in[i], &out[i]);
 }
 
-float v4Mag2(v4 a)
+#ifdef MATHS_SSE2
+static inline void trsLoadLanes(const TRS* in, __m128 c[3][4])
 {
-    return a.x * a.x + a.y * a.y + a.z * a.z + a.w * a.w;
+    __m128 x = _mm_loadu_ps(&in[0].rotation.x), y = _mm_loadu_ps(&in[1].rotation.x);
+    __m128 z = _mm_loadu_ps(&in[2].rotation.x), w = _mm_loadu_ps(&in[3].rotation.x);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+
+    __m128 sx = _mm_setr_ps(in[0].scale.x, in[1].scale.x, in[2].scale.x, in[3].scale.x);
+    __m128 sy = _mm_setr_ps(in[0].scale.y, in[1].scale.y, in[2].scale.y, in[3].scale.y);
+    __m128 sz = _mm_setr_ps(in[0].scale.z, in[1].scale.z, in[2].scale.z, in[3].scale.z);
+
+    quatToM4Lanes(x, y, z, w, sx, sy, sz, c);
 }
+#endif // MATHS_SSE2
+
+//-----------------------------
+// ~Frustum
 
-float v4Mag(v4 a)
+#define FRUSTUM_BLOCK 1024 // Entries per culling block, a multiple of SIMD_PAD
+
+typedef struct FrustumJob
 {
-    return sqrtf(v4Mag2(a));
+    const Frustum* f;
+    float* const* comps; // x y z r for spheres, cx cy cz ex ey ez for boxes
+    uint count;
+    uint* visible;
+    uint* blockCounts;
+} FrustumJob;
+
+static Plane frustumPlane(float x, float y, float z, float d);
+static uint  frustumCull(FrustumJob* job, ParallelFn fn, uint (*kernel)(const Frustum*, float* const*, uint, uint, uint*));
+static void  frustumSpheresRange(void* data, uint begin, uint end);
+static void  frustumAABBsRange(void* data, uint begin, uint end);
+static uint  frustumSpheresKernel(const Frustum* f, float* const* c, uint begin, uint end, uint* visible);
+static uint  frustumAABBsKernel(const Frustum* f, float* const* c, uint begin, uint end, uint* visible);
+static inline uint frustumCompact(int bits, uint i, uint end, uint* visible, uint n);
+
+// Gribb / Hartmann, every plane is the last row of vp plus or minus another row
+Frustum frustumFromM4(m4 vp)
+{
+    return (Frustum) {{
+        frustumPlane(vp.m03 - vp.m01, vp.m13 - vp.m11, vp.m23 - vp.m21, vp.m33 - vp.m31), // Top
+        frustumPlane(vp.m03 + vp.m01, vp.m13 + vp.m11, vp.m23 + vp.m21, vp.m33 + vp.m31), // Bottom
+        frustumPlane(vp.m03 + vp.m00, vp.m13 + vp.m10, vp.m23 + vp.m20, vp.m33 + vp.m30), // Left
+        frustumPlane(vp.m03 - vp.m00, vp.m13 - vp.m10, vp.m23 - vp.m20, vp.m33 - vp.m30), // Right
+        frustumPlane(vp.m03 + vp.m02, vp.m13 + vp.m12, vp.m23 + vp.m22, vp.m33 + vp.m32), // Near
+        frustumPlane(vp.m03 - vp.m02, vp.m13 - vp.m12, vp.m23 - vp.m22, vp.m33 - vp.m32)  // Far
+    }};
 }
 
-float v4Dot(v4 a, v4 b)
+bool frustumTestSphere(const Frustum* f, Sphere s)
 {
-    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    for (int i = 0; i < 6; ++i)
+    {
+        const Plane* p = &f->planes[i];
+        if (p->x * s.x + p->y * s.y + p->z * s.z + p->d < -s.r)
+            return 0;
+    }
+
+    return 1;
 }
 
-float v4MinVal(v4 a)
+// A box is outside a plane when its centre is further behind it than the
+// extents projected onto the normal
+bool frustumTestAABB(const Frustum* f, AABB b)
 {
-    return MIN(MIN(MIN(a.x, a.y), a.z), a.w);
+    float ex = b.w * 0.5f, ey = b.h * 0.5f, ez = b.d * 0.5f;
+    float cx = b.x + ex, cy = b.y + ey, cz = b.z + ez;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        const Plane* p = &f->planes[i];
+        float d = p->x * cx + p->y * cy + p->z * cz + p->d;
+        float r = fabsf(p->x) * ex + fabsf(p->y) * ey + fabsf(p->z) * ez;
+
+        if (d < -r)
+            return 0;
+    }
+
+    return 1;
 }
 
-float v4MaxVal(v4 a)
+uint frustumCullSpheres(const Frustum* f, const v4Stream* spheres, uint* visible)
 {
-    return MAX(MAX(MAX(a.x, a.y), a.z), a.w);
+    FrustumJob job = {f, spheres->comps, spheres->count, visible, NULL};
+    return frustumCull(&job, frustumSpheresRange, frustumSpheresKernel);
 }
 
-v4 v4Min(v4 a, v4 b)
+uint frustumCullAABBs(const Frustum* f, const v3Stream* centres, const v3Stream* extents, uint* visible)
 {
-    return (v4) {
-        MIN(a.x, b.x),
-        MIN(a.y, b.y),
-        MIN(a.z, b.z),
-        MIN(a.w, b.w),
+    float* const comps[6] = {
+        centres->comps[0], centres->comps[1], centres->comps[2],
+        extents->comps[0], extents->comps[1], extents->comps[2],
     };
+    FrustumJob job = {f, comps, MIN(centres->count, extents->count), visible, NULL};
+    return frustumCull(&job, frustumAABBsRange, frustumAABBsKernel);
 }
 
-v4 v4Max(v4 a, v4 b)
+//- - - - - - - - - - - - - - -
+
+static Plane frustumPlane(float x, float y, float z, float d)
 {
-    return (v4) {
-        MAX(a.x, b.x),
-        MAX(a.y, b.y),
-        MAX(a.z, b.z),
-        MAX(a.w, b.w),
-    };
+    float inv = 1.0f / sqrtf(x * x + y * y + z * z);
+    return (Plane){x * inv, y * inv, z * inv, d * inv};
 }
 
-void v4Norm(v4* a)
+// Small inputs are culled in one pass. Large ones are cut into blocks that
+// the threads compact in place at their own offset, the blocks are then
+// moved down over each other so the result is the same as the serial pass.
+static uint frustumCull(FrustumJob* job, ParallelFn fn, uint (*kernel)(const Frustum*, float* const*, uint, uint, uint*))
 {
-    *a = v4Divf(*a, v4Mag2(*a));
+    uint blocks = (job->count + FRUSTUM_BLOCK - 1) / FRUSTUM_BLOCK;
+
+    if (job->count < parallelThreshold() || parallelThreadCount() < 2 || blocks < 2)
+        return kernel(job->f, job->comps, 0, job->count, job->visible);
+
+    job->blockCounts = malloc(blocks * sizeof *job->blockCounts);
+    if (!job->blockCounts)
+        return kernel(job->f, job->comps, 0, job->count, job->visible);
+
+    parallelFor(blocks, 0, fn, job);
+
+    uint total = job->blockCounts[0];
+    for (uint b = 1; b < blocks; ++b)
+    {
+        memmove(job->visible + total, job->visible + b * FRUSTUM_BLOCK, job->blockCounts[b] * sizeof *job->visible);
+        total += job->blockCounts[b];
+    }
+
+    free(job->blockCounts);
+    return total;
 }
 
-v4 v4NormTo(v4 a)
+static void frustumSpheresRange(void* data, uint begin, uint end)
 {
-    return v4Divf(a, v4Mag2(a));
+    FrustumJob* job = data;
+
+    for (uint b = begin; b < end; ++b)
+    {
+        uint first = b * FRUSTUM_BLOCK;
+        job->blockCounts[b] = frustumSpheresKernel(job->f, job->comps, first, MIN(first + FRUSTUM_BLOCK, job->count), job->visible + first);
+    }
 }
 
-//-----------------------------
-// ~m3
+static void frustumAABBsRange(void* data, uint begin, uint end)
+{
+    FrustumJob* job = data;
+
+    for (uint b = begin; b < end; ++b)
+    {
+        uint first = b * FRUSTUM_BLOCK;
+        job->blockCounts[b] = frustumAABBsKernel(job->f, job->comps, first, MIN(first + FRUSTUM_BLOCK, job->count), job->visible + first);
+    }
+}
 
-m3 m3Identity(void)
+// begin is a multiple of SIMD_PAD and the streams are padded, so the last
+// register may read padding, those lanes are dropped by frustumCompact
+static uint frustumSpheresKernel(const Frustum* f, float* const* c, uint begin, uint end, uint* visible)
 {
-    return (m3) {
-        1.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 1.0f
-    };
+    simdf px[6], py[6], pz[6], pd[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        px[p] = simdSet1(f->planes[p].x);
+        py[p] = simdSet1(f->planes[p].y);
+        pz[p] = simdSet1(f->planes[p].z);
+        pd[p] = simdSet1(f->planes[p].d);
+    }
+
+    uint n = 0;
+
+    for (uint i = begin; i < end; i += SIMD_WIDTH)
+    {
+        simdf x = simdLoad(c[0] + i), y = simdLoad(c[1] + i), z = simdLoad(c[2] + i);
+        simdf r = simdSub(simdZero(), simdLoad(c[3] + i));
+        simdf in = simdCmpGe(simdZero(), simdZero()); // All lanes set
+
+        for (int p = 0; p < 6; ++p)
+        {
+            simdf d = simdAdd(simdAdd(simdAdd(simdMul(px[p], x), simdMul(py[p], y)), simdMul(pz[p], z)), pd[p]);
+            in = simdAnd(in, simdCmpGe(d, r));
+        }
+
+        n = frustumCompact(simdMask(in), i, end, visible, n);
+    }
+
+    return n;
 }
 
-m3 m3Add(m3 a, m3 b)
+static uint frustumAABBsKernel(const Frustum* f, float* const* c, uint begin, uint end, uint* visible)
 {
-    return (m3) {
-        a.m00 + b.m00, a.m01 + b.m01, a.m02 + b.m02,
-        a.m10 + b.m10, a.m11 + b.m11, a.m12 + b.m12,
-        a.m20 + b.m20, a.m21 + b.m21, a.m22 + b.m22
-    };
+    simdf px[6], py[6], pz[6], pd[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        px[p] = simdSet1(f->planes[p].x);
+        py[p] = simdSet1(f->planes[p].y);
+        pz[p] = simdSet1(f->planes[p].z);
+        pd[p] = simdSet1(f->planes[p].d);
+        ax[p] = simdSet1(-fabsf(f->planes[p].x));
+        ay[p] = simdSet1(-fabsf(f->planes[p].y));
+        az[p] = simdSet1(-fabsf(f->planes[p].z));
+    }
+
+    uint n = 0;
+
+    for (uint i = begin; i < end; i += SIMD_WIDTH)
+    {
+        simdf cx = simdLoad(c[0] + i), cy = simdLoad(c[1] + i), cz = simdLoad(c[2] + i);
+        simdf ex = simdLoad(c[3] + i), ey = simdLoad(c[4] + i), ez = simdLoad(c[5] + i);
+        simdf in = simdCmpGe(simdZero(), simdZero()); // All lanes set
+
+        for (int p = 0; p < 6; ++p)
+        {
+            simdf d = simdAdd(simdAdd(simdAdd(simdMul(px[p], cx), simdMul(py[p], cy)), simdMul(pz[p], cz)), pd[p]);
+            simdf r = simdAdd(simdAdd(simdMul(ax[p], ex), simdMul(ay[p], ey)), simdMul(az[p], ez));
+            in = simdAnd(in, simdCmpGe(d, r));
+        }
+
+        n = frustumCompact(simdMask(in), i, end, visible, n);
+    }
+
+    return n;
 }
 
-m3 m3Sub(m3 a, m3 b)
+// Branchless append, every lane is written and the cursor only moves for the
+// visible ones. The cursor never passes the lane being written so visible
+// only needs room for end - begin entries.
+static inline uint frustumCompact(int bits, uint i, uint end, uint* visible, uint n)
 {
-    return (m3) {
-        a.m00 - b.m00, a.m01 - b.m01, a.m02 - b.m02,
-        a.m10 - b.m10, a.m11 - b.m11, a.m12 - b.m12,
-        a.m20 - b.m20, a.m21 - b.m21, a.m22 - b.m22
-    };
+    for (uint k = 0; k < SIMD_WIDTH && i + k < end; ++k)
+    {
+        visible[n] = i + k;
+        n += (bits >> k) & 1;
+    }
+
+    return n;
 }
 
-m3 m3Mul(m3 a, m3 b)
+//-----------------------------
+// ~Streams
+
+static void* streamCreate(float** comps, int count, uint* capacity);
+static uint  streamCount(uint capacity, uint a, uint b);
+static uint  streamPadded(uint n);
+
+static void  streamAdd(float* const* out, float* const* a, float* const* b, int comps, uint n);
+static void  streamSub(float* const* out, float* const* a, float* const* b, int comps, uint n);
+static void  streamMul(float* const* out, float* const* a, float* const* b, int comps, uint n);
+static void  streamMulf(float* const* out, float* const* a, float b, int comps, uint n);
+static void  streamMin(float* const* out, float* const* a, float* const* b, int comps, uint n);
+static void  streamMax(float* const* out, float* const* a, float* const* b, int comps, uint n);
+static void  streamDot(float* out, float* const* a, float* const* b, int comps, uint n);
+static void  streamNorm(float* const* out, float* const* a, int comps, uint n);
+
+v2Stream v2StreamCreate(uint capacity)
 {
-    return (m3) {
-        a.m00 * b.m00, a.m01 * b.m01, a.m02 * b.m02,
-        a.m10 * b.m10, a.m11 * b.m11, a.m12 * b.m12,
-        a.m20 * b.m20, a.m21 * b.m21, a.m22 * b.m22
-    };
+    v2Stream s = {0};
+    s.capacity = capacity;
+    s.block = streamCreate(s.comps, 2, &s.capacity);
+    return s;
 }
 
-m3 m3Div(m3 a, m3 b)
+void v2StreamDestroy(v2Stream* s)
 {
-    return (m3) {
-        a.m00 / b.m00, a.m01 / b.m01, a.m02 / b.m02,
-        a.m10 / b.m10, a.m11 / b.m11, a.m12 / b.m12,
-        a.m20 / b.m20, a.m21 / b.m21, a.m22 / b.m22
-    };
+    if (!s)
+        return;
+
+    free(s->block);
+    *s = (v2Stream){0};
 }
 
-m3 m3Addf(m3 a, float b)
+void v2StreamFromArray(v2Stream* s, const v2* in, uint n)
 {
-    return (m3) {
-        a.m00 + b, a.m01 + b, a.m02 + b,
-        a.m10 + b, a.m11 + b, a.m12 + b,
-        a.m20 + b, a.m21 + b, a.m22 + b
-    };
+    s->count = MIN(n, s->capacity);
+
+    for (uint i = 0; i < s->count; ++i)
+    {
+        s->comps[0][i] = in[i].x;
+        s->comps[1][i] = in[i].y;
+    }
 }
 
-m3 m3Subf(m3 a, float b)
+void v2StreamToArray(const v2Stream* s, v2* out)
 {
-    return (m3) {
-        a.m00 - b, a.m01 - b, a.m02 - b,
-        a.m10 - b, a.m11 - b, a.m12 - b,
-        a.m20 - b, a.m21 - b, a.m22 - b
-    };
+    for (uint i = 0; i < s->count; ++i)
+        out[i] = (v2){s->comps[0][i], s->comps[1][i]};
 }
 
-m3 m3Mulf(m3 a, float b)
+void v2StreamAdd(v2Stream* out, const v2Stream* a, const v2Stream* b)
 {
-    return (m3) {
-        a.m00 * b, a.m01 * b, a.m02 * b,
-        a.m10 * b, a.m11 * b, a.m12 * b,
-        a.m20 * b, a.m21 * b, a.m22 * b
-    };
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamAdd(out->comps, a->comps, b->comps, 2, streamPadded(out->count));
 }
 
-m3 m3Divf(m3 a, float b)
+void v2StreamSub(v2Stream* out, const v2Stream* a, const v2Stream* b)
 {
-    return (m3) {
-        a.m00 / b, a.m01 / b, a.m02 / b,
-        a.m10 / b, a.m11 / b, a.m12 / b,
-        a.m20 / b, a.m21 / b, a.m22 / b
-    };
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamSub(out->comps, a->comps, b->comps, 2, streamPadded(out->count));
 }
 
-v3 m3Mulv3(m3 a, v3 b)
+void v2StreamMul(v2Stream* out, const v2Stream* a, const v2Stream* b)
 {
-    return (v3) {
-        a.m00 * b.x + a.m10 * b.y + a.m20 * b.z,
-        a.m01 * b.x + a.m11 * b.y + a.m21 * b.z,
-        a.m02 * b.x + a.m12 * b.y + a.m22 * b.z
-    };
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamMul(out->comps, a->comps, b->comps, 2, streamPadded(out->count));
 }
 
-m3 m3Translate(m3 m, v2 t)
+void v2StreamMulf(v2Stream* out, const v2Stream* a, float b)
 {
-    m3 out = m;
-    out.m20 = m.m00 * t.x + m.m10 * t.y + m.m20;
-    out.m21 = m.m01 * t.x + m.m11 * t.y + m.m21;
-    out.m22 = m.m02 * t.x + m.m12 * t.y + m.m22;
-    return out;
+    out->count = streamCount(out->capacity, a->count, a->count);
+    streamMulf(out->comps, a->comps, b, 2, streamPadded(out->count));
 }
 
-m3 m3TranslateX(m3 m, float x)
+void v2StreamMin(v2Stream* out, const v2Stream* a, const v2Stream* b)
 {
-    m3 out = m;
-    out.m20 = m.m00 * x + m.m20;
-    out.m21 = m.m01 * x + m.m21;
-    out.m22 = m.m02 * x + m.m22;
-    return out;
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamMin(out->comps, a->comps, b->comps, 2, streamPadded(out->count));
 }
 
-m3 m3TranslateY(m3 m, float y)
+void v2StreamMax(v2Stream* out, const v2Stream* a, const v2Stream* b)
 {
-    m3 out = m;
-    out.m20 = m.m10 * y + m.m20;
-    out.m21 = m.m11 * y + m.m21;
-    out.m22 = m.m12 * y + m.m22;
-    return out;
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamMax(out->comps, a->comps, b->comps, 2, streamPadded(out->count));
 }
 
-m3 m3Rotate(m3 m, float angle)
+void v2StreamDot(float* out, const v2Stream* a, const v2Stream* b)
 {
-    float s = sinf(angle);
-    float c = cosf(angle);
+    streamDot(out, a->comps, b->comps, 2, MIN(a->count, b->count));
+}
 
-    m3 out = m;
+void v2StreamNorm(v2Stream* out, const v2Stream* a)
+{
+    out->count = streamCount(out->capacity, a->count, a->count);
+    streamNorm(out->comps, a->comps, 2, streamPadded(out->count));
+}
 
-    out.m00 = m.m00 * c + m.m10 * s;
-    out.m01 = m.m01 * c + m.m11 * s;
-    out.m02 = m.m02 * c + m.m12 * s;
+v3Stream v3StreamCreate(uint capacity)
+{
+    v3Stream s = {0};
+    s.capacity = capacity;
+    s.block = streamCreate(s.comps, 3, &s.capacity);
+    return s;
+}
 
-    out.m10 = m.m00 * -s + m.m10 * c;
-    out.m11 = m.m01 * -s + m.m11 * c;
-    out.m12 = m.m02 * -s + m.m12 * c;
+void v3StreamDestroy(v3Stream* s)
+{
+    if (!s)
+        return;
 
-    return out;
+    free(s->block);
+    *s = (v3Stream){0};
 }
 
-m3 m3Scale(m3 m, v2 s)
+void v3StreamFromArray(v3Stream* s, const v3* in, uint n)
 {
-    m3 out = m;
-    out.m00 *= s.x;
-    out.m01 *= s.x;
-    out.m02 *= s.x;
-    out.m10 *= s.y;
-    out.m11 *= s.y;
-    out.m21 *= s.y;
-    return out;
+    s->count = MIN(n, s->capacity);
+
+    for (uint i = 0; i < s->count; ++i)
+    {
+        s->comps[0][i] = in[i].x;
+        s->comps[1][i] = in[i].y;
+        s->comps[2][i] = in[i].z;
+    }
 }
 
-m3 m3ScaleX(m3 m, float x)
+void v3StreamToArray(const v3Stream* s, v3* out)
 {
-    m3 out = m;
-    out.m00 *= x;
-    out.m01 *= x;
-    out.m02 *= x;
-    return out;
+    for (uint i = 0; i < s->count; ++i)
+        out[i] = (v3){s->comps[0][i], s->comps[1][i], s->comps[2][i]};
 }
 
-m3 m3ScaleY(m3 m, float y)
+void v3StreamAdd(v3Stream* out, const v3Stream* a, const v3Stream* b)
 {
-    m3 out = m;
-    out.m10 *= y;
-    out.m11 *= y;
-    out.m12 *= y;
-    return out;
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamAdd(out->comps, a->comps, b->comps, 3, streamPadded(out->count));
 }
 
-m3 m3Transform(m3 m, v2 t, float angle, v2 s)
+void v3StreamSub(v3Stream* out, const v3Stream* a, const v3Stream* b)
 {
-    m3 mt = m3Translate(m, t);
-    m3 mr = m3Rotate(m, angle);
-    m3 ms = m3Scale(m, s);
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamSub(out->comps, a->comps, b->comps, 3, streamPadded(out->count));
+}
 
-    return m3Mul(m3Mul(ms, mr), mt);
+void v3StreamMul(v3Stream* out, const v3Stream* a, const v3Stream* b)
+{
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamMul(out->comps, a->comps, b->comps, 3, streamPadded(out->count));
 }
 
-//-----------------------------
-// ~m4
+void v3StreamMulf(v3Stream* out, const v3Stream* a, float b)
+{
+    out->count = streamCount(out->capacity, a->count, a->count);
+    streamMulf(out->comps, a->comps, b, 3, streamPadded(out->count));
+}
 
-m4 m4Identity(void)
+void v3StreamMin(v3Stream* out, const v3Stream* a, const v3Stream* b)
 {
-    return (m4) {
-        1.0f, 0.0f, 0.0f, 0.0f,
-        0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, 1.0f
-    };
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamMin(out->comps, a->comps, b->comps, 3, streamPadded(out->count));
 }
 
-m4 m4Add(m4 a, m4 b)
+void v3StreamMax(v3Stream* out, const v3Stream* a, const v3Stream* b)
 {
-    return (m4) {
-        a.m00 + b.m00, a.m01 + b.m01, a.m02 + b.m02, a.m03 + b.m03,
-        a.m10 + b.m10, a.m11 + b.m11, a.m12 + b.m12, a.m13 + b.m13,
-        a.m20 + b.m20, a.m21 + b.m21, a.m22 + b.m22, a.m23 + b.m23,
-        a.m30 + b.m30, a.m31 + b.m31, a.m32 + b.m32, a.m33 + b.m33
-    };
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamMax(out->comps, a->comps, b->comps, 3, streamPadded(out->count));
 }
 
-m4 m4Sub(m4 a, m4 b)
+void v3StreamDot(float* out, const v3Stream* a, const v3Stream* b)
 {
-    return (m4) {
-        a.m00 - b.m00, a.m01 - b.m01, a.m02 - b.m02, a.m03 - b.m03,
-        a.m10 - b.m10, a.m11 - b.m11, a.m12 - b.m12, a.m13 - b.m13,
-        a.m20 - b.m20, a.m21 - b.m21, a.m22 - b.m22, a.m23 - b.m23,
-        a.m30 - b.m30, a.m31 - b.m31, a.m32 - b.m32, a.m33 - b.m33
-    };
+    streamDot(out, a->comps, b->comps, 3, MIN(a->count, b->count));
 }
 
-m4 m4Mul(m4 a, m4 b)
+void v3StreamCross(v3Stream* out, const v3Stream* a, const v3Stream* b)
 {
-    return (m4) {
-        a.m00 * b.m00, a.m01 * b.m01, a.m02 * b.m02, a.m03 * b.m03,
-        a.m10 * b.m10, a.m11 * b.m11, a.m12 * b.m12, a.m13 * b.m13,
-        a.m20 * b.m20, a.m21 * b.m21, a.m22 * b.m22, a.m23 * b.m23,
-        a.m30 * b.m30, a.m31 * b.m31, a.m32 * b.m32, a.m33 * b.m33
-    };
+    out->count = streamCount(out->capacity, a->count, b->count);
+    uint n = streamPadded(out->count);
+
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        simdf ax = simdLoad(a->comps[0] + i), ay = simdLoad(a->comps[1] + i), az = simdLoad(a->comps[2] + i);
+        simdf bx = simdLoad(b->comps[0] + i), by = simdLoad(b->comps[1] + i), bz = simdLoad(b->comps[2] + i);
+
+        simdStore(out->comps[0] + i, simdSub(simdMul(ay, bz), simdMul(az, by)));
+        simdStore(out->comps[1] + i, simdSub(simdMul(az, bx), simdMul(ax, bz)));
+        simdStore(out->comps[2] + i, simdSub(simdMul(ax, by), simdMul(ay, bx)));
+    }
 }
 
-m4 m4Div(m4 a, m4 b)
+void v3StreamNorm(v3Stream* out, const v3Stream* a)
 {
-    return (m4) {
-        a.m00 / b.m00, a.m01 / b.m01, a.m02 / b.m02, a.m03 / b.m03,
-        a.m10 / b.m10, a.m11 / b.m11, a.m12 / b.m12, a.m13 / b.m13,
-        a.m20 / b.m20, a.m21 / b.m21, a.m22 / b.m22, a.m23 / b.m23,
-        a.m30 / b.m30, a.m31 / b.m31, a.m32 / b.m32, a.m33 / b.m33
-    };
+    out->count = streamCount(out->capacity, a->count, a->count);
+    streamNorm(out->comps, a->comps, 3, streamPadded(out->count));
 }
 
-m4 m4Addf(m4 a, float b)
+v4Stream v4StreamCreate(uint capacity)
 {
-    return (m4) {
-        a.m00 + b, a.m01 + b, a.m02 + b, a.m03 + b,
-        a.m10 + b, a.m11 + b, a.m12 + b, a.m13 + b,
-        a.m20 + b, a.m21 + b, a.m22 + b, a.m23 + b,
-        a.m30 + b, a.m31 + b, a.m32 + b, a.m33 + b
-    };
+    v4Stream s = {0};
+    s.capacity = capacity;
+    s.block = streamCreate(s.comps, 4, &s.capacity);
+    return s;
 }
 
-m4 m4Subf(m4 a, float b)
+void v4StreamDestroy(v4Stream* s)
 {
-    return (m4) {
-        a.m00 - b, a.m01 - b, a.m02 - b, a.m03 - b,
-        a.m10 - b, a.m11 - b, a.m12 - b, a.m13 - b,
-        a.m20 - b, a.m21 - b, a.m22 - b, a.m23 - b,
-        a.m30 - b, a.m31 - b, a.m32 - b, a.m33 - b
-    };
+    if (!s)
+        return;
+
+    free(s->block);
+    *s = (v4Stream){0};
 }
 
-m4 m4Mulf(m4 a, float b)
+void v4StreamFromArray(v4Stream* s, const v4* in, uint n)
 {
-    return (m4) {
-        a.m00 * b, a.m01 * b, a.m02 * b, a.m03 * b,
-        a.m10 * b, a.m11 * b, a.m12 * b, a.m13 * b,
-        a.m20 * b, a.m21 * b, a.m22 * b, a.m23 * b,
-        a.m30 * b, a.m31 * b, a.m32 * b, a.m33 * b
-    };
+    s->count = MIN(n, s->capacity);
+
+    for (uint i = 0; i < s->count; ++i)
+    {
+        s->comps[0][i] = in[i].x;
+        s->comps[1][i] = in[i].y;
+        s->comps[2][i] = in[i].z;
+        s->comps[3][i] = in[i].w;
+    }
 }
 
-m4 m4Divf(m4 a, float b)
+void v4StreamToArray(const v4Stream* s, v4* out)
 {
-    return (m4) {
-        a.m00 / b, a.m01 / b, a.m02 / b, a.m03 / b,
-        a.m10 / b, a.m11 / b, a.m12 / b, a.m13 / b,
-        a.m20 / b, a.m21 / b, a.m22 / b, a.m23 / b,
-        a.m30 / b, a.m31 / b, a.m32 / b, a.m33 / b
-    };
+    for (uint i = 0; i < s->count; ++i)
+        out[i] = (v4){s->comps[0][i], s->comps[1][i], s->comps[2][i], s->comps[3][i]};
 }
 
-v3 m4Mulv3(m4 a, v3 b, float w)
+void v4StreamAdd(v4Stream* out, const v4Stream* a, const v4Stream* b)
 {
-    v4 c = m4Mulv4(a, (v4){b.x, b.y, b.z, w});
-    return (v3){c.x, c.y, c.z};
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamAdd(out->comps, a->comps, b->comps, 4, streamPadded(out->count));
 }
 
-v4 m4Mulv4(m4 a, v4 b)
+void v4StreamSub(v4Stream* out, const v4Stream* a, const v4Stream* b)
 {
-    return (v4) {
-        a.m00 * b.x + a.m10 * b.y + a.m20 * b.z + a.m30 * b.w,
-        a.m01 * b.x + a.m11 * b.y + a.m21 * b.z + a.m31 * b.w,
-        a.m02 * b.x + a.m12 * b.y + a.m22 * b.z + a.m32 * b.w,
-        a.m03 * b.x + a.m13 * b.y + a.m23 * b.z + a.m33 * b.w
-    };
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamSub(out->comps, a->comps, b->comps, 4, streamPadded(out->count));
 }
 
-m4 m4Translate(m4 m, v3 t)
+void v4StreamMul(v4Stream* out, const v4Stream* a, const v4Stream* b)
 {
-    m4 out = m;
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamMul(out->comps, a->comps, b->comps, 4, streamPadded(out->count));
+}
 
-    out.m00 += m.m00 * t.x;
-    out.m02 += m.m02 * t.x;
-    out.m03 += m.m03 * t.x;
+void v4StreamMulf(v4Stream* out, const v4Stream* a, float b)
+{
+    out->count = streamCount(out->capacity, a->count, a->count);
+    streamMulf(out->comps, a->comps, b, 4, streamPadded(out->count));
+}
 
-    out.m10 += m.m00 * t.y;
-    out.m12 += m.m02 * t.y;
-    out.m13 += m.m03 * t.y;
+void v4StreamMin(v4Stream* out, const v4Stream* a, const v4Stream* b)
+{
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamMin(out->comps, a->comps, b->comps, 4, streamPadded(out->count));
+}
 
-    out.m20 += m.m00 * t.z;
-    out.m22 += m.m02 * t.z;
-    out.m23 += m.m03 * t.z;
+void v4StreamMax(v4Stream* out, const v4Stream* a, const v4Stream* b)
+{
+    out->count = streamCount(out->capacity, a->count, b->count);
+    streamMax(out->comps, a->comps, b->comps, 4, streamPadded(out->count));
+}
 
-    return out;
+void v4StreamDot(float* out, const v4Stream* a, const v4Stream* b)
+{
+    streamDot(out, a->comps, b->comps, 4, MIN(a->count, b->count));
 }
 
-m4 m4TranslateX(m4 m, float x)
+void v4StreamNorm(v4Stream* out, const v4Stream* a)
 {
-    m4 out = m;
+    out->count = streamCount(out->capacity, a->count, a->count);
+    streamNorm(out->comps, a->comps, 4, streamPadded(out->count));
+}
 
-    out.m30 += m.m00 * x;
-    out.m31 += m.m01 * x;
-    out.m32 += m.m02 * x;
-    out.m33 += m.m03 * x;
+//- - - - - - - - - - - - - - -
 
-    return out;
+// One zeroed allocation holds every component, the returned block is what
+// has to be freed. capacity is rounded up to the padding on the way out.
+static void* streamCreate(float** comps, int count, uint* capacity)
+{
+    uint padded = streamPadded(*capacity);
+    void* block = calloc((size_t)count * padded * sizeof(float) + SIMD_ALIGN, 1);
+
+    if (!block)
+    {
+        *capacity = 0;
+        return NULL;
+    }
+
+    float* base = (float*)(((uintptr_t)block + SIMD_ALIGN - 1) & ~(uintptr_t)(SIMD_ALIGN - 1));
+
+    for (int i = 0; i < count; ++i)
+        comps[i] = base + (size_t)i * padded;
+
+    *capacity = padded;
+    return block;
 }
 
-m4 m4TranslateY(m4 m, float y)
+static uint streamCount(uint capacity, uint a, uint b)
 {
-    m4 out = m;
+    return MIN(capacity, MIN(a, b));
+}
 
-    out.m30 += m.m10 * y;
-    out.m31 += m.m11 * y;
-    out.m32 += m.m12 * y;
-    out.m33 += m.m13 * y;
+static uint streamPadded(uint n)
+{
+    return (n + SIMD_PAD - 1) & ~(uint)(SIMD_PAD - 1);
+}
 
-    return out;
+static void streamAdd(float* const* out, float* const* a, float* const* b, int comps, uint n)
+{
+    for (int c = 0; c < comps; ++c)
+        for (uint i = 0; i < n; i += SIMD_WIDTH)
+            simdStore(out[c] + i, simdAdd(simdLoad(a[c] + i), simdLoad(b[c] + i)));
 }
 
-m4 m4TranslateZ(m4 m, float z)
+static void streamSub(float* const* out, float* const* a, float* const* b, int comps, uint n)
 {
-    m4 out = m;
+    for (int c = 0; c < comps; ++c)
+        for (uint i = 0; i < n; i += SIMD_WIDTH)
+            simdStore(out[c] + i, simdSub(simdLoad(a[c] + i), simdLoad(b[c] + i)));
+}
 
-    out.m30 += m.m20 * z;
-    out.m31 += m.m21 * z;
-    out.m32 += m.m22 * z;
-    out.m33 += m.m23 * z;
+static void streamMul(float* const* out, float* const* a, float* const* b, int comps, uint n)
+{
+    for (int c = 0; c < comps; ++c)
+        for (uint i = 0; i < n; i += SIMD_WIDTH)
+            simdStore(out[c] + i, simdMul(simdLoad(a[c] + i), simdLoad(b[c] + i)));
+}
 
-    return out;
+static void streamMulf(float* const* out, float* const* a, float b, int comps, uint n)
+{
+    simdf vb = simdSet1(b);
+
+    for (int c = 0; c < comps; ++c)
+        for (uint i = 0; i < n; i += SIMD_WIDTH)
+            simdStore(out[c] + i, simdMul(simdLoad(a[c] + i), vb));
 }
 
-// http://fastgraph.com/makegames/3drotation/
-m4 m4Rotate(m4 m, v3 axis, float angle)
+static void streamMin(float* const* out, float* const* a, float* const* b, int comps, uint n)
 {
-    float c = cosf(angle);
-    float s = sinf(angle);
-    float t = 1.0f - c;
+    for (int c = 0; c < comps; ++c)
+        for (uint i = 0; i < n; i += SIMD_WIDTH)
+            simdStore(out[c] + i, simdMin(simdLoad(a[c] + i), simdLoad(b[c] + i)));
+}
 
-    v3Norm(&axis);
+static void streamMax(float* const* out, float* const* a, float* const* b, int comps, uint n)
+{
+    for (int c = 0; c < comps; ++c)
+        for (uint i = 0; i < n; i += SIMD_WIDTH)
+            simdStore(out[c] + i, simdMax(simdLoad(a[c] + i), simdLoad(b[c] + i)));
+}
 
-    v3 at = v3Mulf(axis, t);
-    v3 as = v3Mulf(axis, s);
+// out is a plain caller array, so it is neither aligned nor padded and the
+// remainder is finished one element at a time in the same order.
+static void streamDot(float* out, float* const* a, float* const* b, int comps, uint n)
+{
+    uint i = 0;
 
-    m4 rot = {0};
+    for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    {
+        simdf sum = simdMul(simdLoad(a[0] + i), simdLoad(b[0] + i));
 
-    rot.m00 = axis.x * at.x + c;
-    rot.m01 = axis.y * at.x + as.z;
-    rot.m02 = axis.z * at.x - as.y;
+        for (int c = 1; c < comps; ++c)
+            sum = simdAdd(sum, simdMul(simdLoad(a[c] + i), simdLoad(b[c] + i)));
 
-    rot.m10 = axis.x * at.y - as.z;
-    rot.m11 = axis.y * at.y + c;
-    rot.m12 = axis.z * at.y + as.x;
+        simdStoreu(out + i, sum);
+    }
 
-    rot.m20 = axis.x * at.z + as.y;
-    rot.m21 = axis.y * at.z + as.x;
-    rot.m22 = axis.z * at.z + c;
+    for (; i < n; ++i)
+    {
+        float sum = a[0][i] * b[0][i];
 
-    rot.m33 = 1.0f;
+        for (int c = 1; c < comps; ++c)
+            sum += a[c][i] * b[c][i];
 
-    return m4Mul(m, rot);
+        out[i] = sum;
+    }
 }
 
-m4 m4RotateX(m4 m, float angle)
+static void streamNorm(float* const* out, float* const* a, int comps, uint n)
 {
-    float s = sinf(angle);
-    float c = cosf(angle);
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        simdf mag2 = simdMul(simdLoad(a[0] + i), simdLoad(a[0] + i));
+
+        for (int c = 1; c < comps; ++c)
+            mag2 = simdAdd(mag2, simdMul(simdLoad(a[c] + i), simdLoad(a[c] + i)));
+
+        simdf mag = simdSqrt(mag2);
 
-    m4 rot = m4Identity();
-    rot.m11 =  c;
-    rot.m12 =  s;
-    rot.m21 = -s;
-    rot.m22 =  c;
-    return m4Mul(m, rot);
+        for (int c = 0; c < comps; ++c)
+            simdStore(out[c] + i, simdDiv(simdLoad(a[c] + i), mag));
+    }
 }
 
-m4 m4RotateY(m4 m, float angle)
+//-----------------------------
+// ~Quantize
+
+static inline simdf quantizeLoad(const float* in, uint i, uint n);
+static inline simdf quantizeGather(const float* in, uint stride, uint field, uint i, uint n);
+static inline void  quantizeLanes(int32_t* lanes, simdi v);
+static inline simdi quantizeNorm(simdf x, float lo, float scale);
+
+// Branchless version of the usual bit twiddling conversion: values too
+// large for a half become inf (NaN stays NaN), values below the smallest
+// normal half are rounded by a float add that lines the mantissa up with
+// the denormal steps, and normal values round to nearest even by adding
+// 0xfff plus the lowest kept bit before the shift.
+void quantizeHalf(ushort* out, const float* in, uint n)
 {
-    float s = sinf(angle);
-    float c = cosf(angle);
+    simdi signBit = simdiSet1(INT32_MIN);
+    simdf inf     = simdiCast(simdiSet1(0x7f800000));
+    simdf maxHalf = simdSet1(65536.0f);
+    simdf minHalf = simdSet1(6.103515625e-5f); // 2^-14
+    simdf magic   = simdSet1(0.5f);            // Puts the denormal steps at the bottom of the mantissa
+    simdi rebias  = simdiSet1(-(112 << 23) + 0xfff); // Exponent bias 127 -> 15, plus the rounding
+    simdi all     = simdiSet1(-1);
+
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        simdi f    = simdCast(quantizeLoad(in, i, n));
+        simdi sign = simdiAnd(f, signBit);
+        f = simdiXor(f, sign);
+        simdf af = simdiCast(f);
+
+        simdf nan   = simdAndNot(simdCmpLe(af, inf), simdiCast(all));
+        simdf large = simdOr(simdCmpGe(af, maxHalf), nan);
+        simdf small = simdCmpLt(af, minHalf);
+
+        simdi special  = simdCast(simdSelect(nan, simdiCast(simdiSet1(0x7e00)), simdiCast(simdiSet1(0x7c00))));
+        simdi denormal = simdiSub(simdCast(simdAdd(af, magic)), simdCast(magic));
+        simdi odd      = simdiAnd(simdiShr(f, 13), simdiSet1(1));
+        simdi normal   = simdiShr(simdiAdd(simdiAdd(f, rebias), odd), 13);
+
+        simdi h = simdCast(simdSelect(small, simdiCast(denormal), simdiCast(normal)));
+        h = simdCast(simdSelect(large, simdiCast(special), simdiCast(h)));
+        h = simdiOr(h, simdiShr(sign, 16));
 
-    m4 rot = m4Identity();
-    rot.m00 =  c;
-    rot.m02 = -s;
-    rot.m20 =  s;
-    rot.m22 =  c;
-    return m4Mul(m, rot);
+        int32_t lanes[SIMD_WIDTH];
+        quantizeLanes(lanes, h);
+
+        for (uint k = 0; k < SIMD_WIDTH && i + k < n; ++k)
+            out[i + k] = (ushort)lanes[k];
+    }
 }
 
-m4 m4RotateZ(m4 m, float angle)
+void quantizeSnorm16(short* out, const float* in, uint n)
+{
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        int32_t lanes[SIMD_WIDTH];
+        quantizeLanes(lanes, quantizeNorm(quantizeLoad(in, i, n), -1.0f, 32767.0f));
+
+        for (uint k = 0; k < SIMD_WIDTH && i + k < n; ++k)
+            out[i + k] = (short)lanes[k];
+    }
+}
+
+void quantizeUnorm8(uchar* out, const float* in, uint n)
 {
-    float s = sinf(angle);
-    float c = cosf(angle);
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        int32_t lanes[SIMD_WIDTH];
+        quantizeLanes(lanes, quantizeNorm(quantizeLoad(in, i, n), 0.0f, 255.0f));
 
-    m4 rot = m4Identity();
-    rot.m00 =  c;
-    rot.m01 =  s;
-    rot.m10 = -s;
-    rot.m11 =  c;
-    return m4Mul(m, rot);
+        for (uint k = 0; k < SIMD_WIDTH && i + k < n; ++k)
+            out[i + k] = (uchar)lanes[k];
+    }
 }
 
-m4 m4Scale(m4 m, v3 s)
+// Projects the normal onto the octahedron |x| + |y| + |z| = 1 and folds the
+// lower half over the diagonals, a zero normal encodes as (0, 0, 1)
+void quantizeOctahedral(short* out, const v3* normals, uint n)
 {
-    m4 out = m;
-    out.m00 *= s.x;
-    out.m01 *= s.x;
-    out.m02 *= s.x;
-    out.m10 *= s.y;
-    out.m11 *= s.y;
-    out.m12 *= s.y;
-    out.m20 *= s.z;
-    out.m21 *= s.z;
-    out.m22 *= s.z;
-    return out;
+    const float* in = (const float*)normals;
+    simdf sign = simdSet1(-0.0f), one = simdSet1(1.0f), tiny = simdSet1(1e-30f);
+
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        simdf x = quantizeGather(in, 3, 0, i, n);
+        simdf y = quantizeGather(in, 3, 1, i, n);
+        simdf z = quantizeGather(in, 3, 2, i, n);
+
+        simdf l1 = simdAdd(simdAdd(simdAndNot(sign, x), simdAndNot(sign, y)), simdAndNot(sign, z));
+        simdf inv = simdDiv(one, simdMax(l1, tiny));
+        x = simdMul(x, inv);
+        y = simdMul(y, inv);
+
+        // (1 - |y|, 1 - |x|) with the signs of x and y, 0 counting as positive
+        simdf fx = simdMul(simdSub(one, simdAndNot(sign, y)), simdOr(simdAnd(x, sign), one));
+        simdf fy = simdMul(simdSub(one, simdAndNot(sign, x)), simdOr(simdAnd(y, sign), one));
+        simdf below = simdCmpLt(z, simdZero());
+        x = simdSelect(below, fx, x);
+        y = simdSelect(below, fy, y);
+
+        int32_t lx[SIMD_WIDTH], ly[SIMD_WIDTH];
+        quantizeLanes(lx, quantizeNorm(x, -1.0f, 32767.0f));
+        quantizeLanes(ly, quantizeNorm(y, -1.0f, 32767.0f));
+
+        for (uint k = 0; k < SIMD_WIDTH && i + k < n; ++k)
+        {
+            out[2 * (i + k)]     = (short)lx[k];
+            out[2 * (i + k) + 1] = (short)ly[k];
+        }
+    }
 }
 
-m4 m4ScaleX(m4 m, float x)
+void quantizeSnorm1010102(uint* out, const v4* in, uint n)
 {
-    m4 out = m;
-    out.m00 *= x;
-    out.m01 *= x;
-    out.m02 *= x;
-    return out;
+    const float* f = (const float*)in;
+    simdi mask10 = simdiSet1(0x3ff), mask2 = simdiSet1(0x3);
+
+    for (uint i = 0; i < n; i += SIMD_WIDTH)
+    {
+        simdi x = simdiAnd(quantizeNorm(quantizeGather(f, 4, 0, i, n), -1.0f, 511.0f), mask10);
+        simdi y = simdiAnd(quantizeNorm(quantizeGather(f, 4, 1, i, n), -1.0f, 511.0f), mask10);
+        simdi z = simdiAnd(quantizeNorm(quantizeGather(f, 4, 2, i, n), -1.0f, 511.0f), mask10);
+        simdi w = simdiAnd(quantizeNorm(quantizeGather(f, 4, 3, i, n), -1.0f, 1.0f), mask2);
+
+        int32_t lanes[SIMD_WIDTH];
+        quantizeLanes(lanes, simdiOr(simdiOr(x, simdiShl(y, 10)), simdiOr(simdiShl(z, 20), simdiShl(w, 30))));
+
+        for (uint k = 0; k < SIMD_WIDTH && i + k < n; ++k)
+            out[i + k] = (uint)lanes[k];
+    }
 }
 
-m4 m4ScaleY(m4 m, float y)
+float halfToFloat(ushort h)
 {
-    m4 out = m;
-    out.m10 *= y;
-    out.m11 *= y;
-    out.m12 *= y;
-    return out;
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp  = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t bits;
+
+    if (exp == 0)
+    {
+        float f = (float)mant * 5.9604644775390625e-8f; // 2^-24
+        return sign ? -f : f;
+    }
+
+    if (exp == 31)
+        bits = sign | 0x7f800000u | (mant << 13);
+    else
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+
+    float f;
+    memcpy(&f, &bits, sizeof f);
+    return f;
 }
 
-m4 m4ScaleZ(m4 m, float z)
+v3 octahedralDecode(short x, short y)
 {
-    m4 out = m;
-    out.m20 *= z;
-    out.m21 *= z;
-    out.m22 *= z;
-    return out;
+    v3 n = {MAX(x / 32767.0f, -1.0f), MAX(y / 32767.0f, -1.0f), 0.0f};
+    n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+
+    // Unfolds the lower half, the inverse of the fold in quantizeOctahedral
+    float t = MAX(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+
+    return v3NormTo(n);
 }
 
-m4 m4Transform(m4 m, v3 t, v3 axis, float angle, v3 s)
+//- - - - - - - - - - - - - - -
+
+// Tails are read through a zeroed lane buffer, the inputs aren't padded
+static inline simdf quantizeLoad(const float* in, uint i, uint n)
 {
-    m4 mt = m4Translate(m, t);
-    m4 mr = m4Rotate(m, axis, angle);
-    m4 ms = m4Scale(m, s);
+    if (n - i >= SIMD_WIDTH)
+        return simdLoadu(in + i);
 
-    return m4Mul(m4Mul(ms, mr), mt);
+    float lane[SIMD_WIDTH] = {0};
+    memcpy(lane, in + i, (n - i) * sizeof *in);
+    return simdLoadu(lane);
 }
 
-m4 m4LookAt(v3 eye, v3 target, v3 up)
+static inline simdf quantizeGather(const float* in, uint stride, uint field, uint i, uint n)
 {
-    v3 f = v3NormTo(v3Sub(target, eye));
-    v3 r = v3NormTo(v3Cross(f, up));
-    v3 u = v3Cross(r, f);
+    float lane[SIMD_WIDTH] = {0};
 
-    return (m4){
-        r.x           , u.x           , -f.x          , 0.0f,
-        r.y           , u.y           , -f.y          , 0.0f,
-        r.z           , u.z           , -f.z          , 0.0f,
-        -v3Dot(r, eye), -v3Dot(u, eye), -v3Dot(f, eye), 1.0f
-    };
+    for (uint k = 0; k < SIMD_WIDTH && i + k < n; ++k)
+        lane[k] = in[(i + k) * stride + field];
+
+    return simdLoadu(lane);
 }
 
-m4 m4Perspective(float fov, float aspect, float near, float far)
+static inline void quantizeLanes(int32_t* lanes, simdi v)
 {
-    float fovRad = 1.0f / tanf(fov * DEG2RAD * 0.5f);
-    float nf = 1.0f / (near - far);
+    float raw[SIMD_WIDTH];
+    simdStoreu(raw, simdiCast(v));
+    memcpy(lanes, raw, sizeof raw);
+}
 
-    m4 out = {0};
-    out.m00 =  fovRad / aspect;
-    out.m11 =  fovRad;
-    out.m22 =  (near + far) * nf;
-    out.m23 = -1.0f;
-    out.m32 =  2.0f * near * far * nf;
-    return out;
+// Clamps to [lo, 1] and rounds x * scale, NaN ends up at lo
+static inline simdi quantizeNorm(simdf x, float lo, float scale)
+{
+    x = simdMin(simdMax(x, simdSet1(lo)), simdSet1(1.0f));
+    return simdiRound(simdMul(x, simdSet1(scale)));
 }
 
-m4 m4Frustum(float left, float right, float bottom, float top, float near, float far)
+//-----------------------------
+// ~Parallel
+
+#define PARALLEL_MAX_THREADS 64
+
+static uint parallelThresholdCount = 1u << 16;
+static uint parallelThreads = 0;
+
+typedef struct ParallelRange
 {
-    float rl =  1.0f / (right - left);
-    float tb =  1.0f / (top   - bottom);
-    float fn = -1.0f / (far   - near);
-    float n2 =  2.0f * near;
+    ParallelFn fn;
+    void* data;
+    uint begin;
+    uint end;
+} ParallelRange;
 
-    m4 out = {0};
-    out.m00 = n2 * rl;
-    out.m11 = n2 * tb;
-    out.m20 = (right + left) * rl;
-    out.m21 = (top + bottom) * tb;
-    out.m22 = (far + near)   * fn;
-    out.m23 = -1.0f;
-    out.m32 = far * n2 * fn;
-    return out;
+#ifndef _WIN32
+static void* parallelRun(void* arg);
+#endif // _WIN32
+
+void parallelFor(uint count, uint threshold, ParallelFn fn, void* data)
+{
+    uint threads = parallelThreadCount();
+
+    if (count == 0)
+        return;
+
+#ifndef _WIN32
+    if (count >= threshold && threads > 1)
+    {
+        uint chunk = (count + threads - 1) / threads;
+        chunk = (chunk + SIMD_PAD - 1) & ~(uint)(SIMD_PAD - 1);
+
+        ParallelRange ranges[PARALLEL_MAX_THREADS];
+        pthread_t handles[PARALLEL_MAX_THREADS];
+        int started[PARALLEL_MAX_THREADS] = {0};
+        uint used = 0;
+
+        for (uint begin = 0; begin < count; begin += chunk)
+            ranges[used++] = (ParallelRange){fn, data, begin, MIN(begin + chunk, count)};
+
+        // The calling thread takes the first range, if a thread fails to
+        // start its range also runs here instead of being dropped
+        for (uint i = 1; i < used; ++i)
+            started[i] = pthread_create(&handles[i], NULL, parallelRun, &ranges[i]) == 0;
+
+        fn(data, ranges[0].begin, ranges[0].end);
+
+        for (uint i = 1; i < used; ++i)
+        {
+            if (started[i])
+                pthread_join(handles[i], NULL);
+            else
+                fn(data, ranges[i].begin, ranges[i].end);
+        }
+
+        return;
+    }
+#endif // _WIN32
+
+    (void)threshold; (void)threads;
+    fn(data, 0, count);
 }
 
-m4 m4Orthographic(float left, float right, float bottom, float top, float near, float far)
+void parallelSetThreshold(uint count)
 {
-    float rl =  1.0f / (right - left);
-    float tb =  1.0f / (top   - bottom);
-    float fn = -1.0f / (far   - near);
+    parallelThresholdCount = count;
+}
 
-    m4 out = {0};
-    out.m00 =  2.0f * rl;
-    out.m11 =  2.0f * tb;
-    out.m22 =  2.0f * fn;
-    out.m30 = -(right + left) * rl;
-    out.m31 = -(top + bottom) * tb;
-    out.m32 =  (far + near)   * fn;
-    out.m33 =  1.0f;
-    return out;
+uint parallelThreshold(void)
+{
+    return parallelThresholdCount;
+}
+
+void parallelSetThreadCount(uint count)
+{
+    parallelThreads = MIN(count, PARALLEL_MAX_THREADS);
+}
+
+uint parallelThreadCount(void)
+{
+    if (parallelThreads)
+        return parallelThreads;
+
+#ifndef _WIN32
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? MIN((uint)cores, PARALLEL_MAX_THREADS) : 1;
+#else
+    return 1;
+#endif // _WIN32
+}
+
+//- - - - - - - - - - - - - - -
+
+#ifndef _WIN32
+static void* parallelRun(void* arg)
+{
+    ParallelRange* range = arg;
+    range->fn(range->data, range->begin, range->end);
+    return NULL;
 }
+#endif // _WIN32
@@ -7,9 +7,10 @@
 
 #ifndef uchar
     #define uchar  unsigned char
-    #define ushort unsigned int
+    #define ushort unsigned short
     #define uint   unsigned int
     #define ulong  unsigned long
+    #define bool   unsigned char
 #endif // uchar
 
 #ifndef PI
@@ -21,6 +22,20 @@
     #define RAD2DEG 57.29577951308232087679815481410517
 #endif // PI
 
+// Define MATHS_INLINE to get the vector and matrix functions as static
+// inline definitions in every file that includes this header
+#ifdef MATHS_INLINE
+    #define MATHS_DEF static inline
+#else
+    #define MATHS_DEF
+#endif // MATHS_INLINE
+
+// Matrices whose determinant is at most this in magnitude are reported as
+// singular by the inverse functions instead of producing inf / NaN
+#ifndef MATHS_SINGULAR_EPSILON
+    #define MATHS_SINGULAR_EPSILON 1e-20f
+#endif // MATHS_SINGULAR_EPSILON
+
 #ifndef MIN
     #define MIN(x_, y_)         ((x_) < (y_) ? (x_) : (y_))
     #define MAX(x_, y_)         ((x_) > (y_) ? (x_) : (y_))
@@ -78,6 +93,25 @@ typedef struct m4
     float m30, m31, m32, m33;
 } m4;
 
+// Affine transform, the top three rows of a column major m4 with an implicit
+// (0, 0, 0, 1) bottom row. Each row is 16 bytes so it loads straight into a
+// SIMD register and uploads as three vec4 instance attributes.
+typedef struct m4x3
+{
+    float m00, m10, m20, m30;
+    float m01, m11, m21, m31;
+    float m02, m12, m22, m32;
+} m4x3;
+
+// Translation, rotation and scale, the usual way to store a local
+// transform. Composes to translate(translation) * rotate(rotation) * scale(scale).
+typedef struct TRS
+{
+    v3   translation;
+    quat rotation; // Unit length
+    v3   scale;
+} TRS;
+
 typedef struct c4
 {
     uchar r, g, b, a;
@@ -109,13 +143,13 @@ typedef struct Circle
 
 typedef struct Plane
 {
-    float x, y, z;
-    float n; // normal
+    float x, y, z; // Unit normal
+    float d;       // dot(normal, p) + d = 0 for every p on the plane
 } Plane;
 
 typedef struct AABB
 {
-    float x, y, z;
+    float x, y, z; // Min corner
     float w, h, d; // d is depth
 } AABB;
 
@@ -130,175 +164,410 @@ typedef struct Frustum
     Plane planes[6]; // Top -> bottom -> left -> right -> near -> far
 } Frustum;
 
+//-----------------------------
+// Streams
+
+// Structure of arrays storage for bulk maths. comps holds the x, y, z and w
+// arrays in that order. Every component array is aligned to 32 bytes and
+// padded to a multiple of 8 floats, kernels may write to the padding so it
+// must never hold data.
+
+typedef struct v2Stream
+{
+    float* comps[2]; // x, y
+    uint count;
+    uint capacity;
+    void* block;
+} v2Stream;
+
+typedef struct v3Stream
+{
+    float* comps[3]; // x, y, z
+    uint count;
+    uint capacity;
+    void* block;
+} v3Stream;
+
+typedef struct v4Stream
+{
+    float* comps[4]; // x, y, z, w
+    uint count;
+    uint capacity;
+    void* block;
+} v4Stream;
+
 //-------------------------------------------------------------
 // Prototypes
 //-------------------------------------------------------------
 
+//-----------------------------
+// ~Trig
+
+// sinCosFast reduces x to [-pi/4, pi/4] and evaluates minimax polynomials.
+// Against double precision sin/cos the max absolute error is 9.3e-8 for
+// |x| <= 8192 and 9.6e-7 for |x| <= 65536. sinCos is what every rotation
+// builder uses: it maps to sinCosFast when MATHS_FAST_TRIG is defined and to
+// libm (sinCosPrecise) otherwise, call either one directly to pick per call.
+
+void    sinCos(float x, float* s, float* c);
+void    sinCosFast(float x, float* s, float* c);
+void    sinCosPrecise(float x, float* s, float* c);
+void    sinCosBatch(const float* x, float* s, float* c, uint n); // Always uses the fast path
+
 //-----------------------------
 // ~v2
 
-v2      v2Add(v2 a, v2 b);
-v2      v2Sub(v2 a, v2 b);
-v2      v2Mul(v2 a, v2 b);
-v2      v2Div(v2 a, v2 b);
+MATHS_DEF v2      v2Add(v2 a, v2 b);
+MATHS_DEF v2      v2Sub(v2 a, v2 b);
+MATHS_DEF v2      v2Mul(v2 a, v2 b);
+MATHS_DEF v2      v2Div(v2 a, v2 b);
 
-v2      v2Addf(v2 a, float b);
-v2      v2Subf(v2 a, float b);
-v2      v2Mulf(v2 a, float b);
-v2      v2Divf(v2 a, float b);
+MATHS_DEF v2      v2Addf(v2 a, float b);
+MATHS_DEF v2      v2Subf(v2 a, float b);
+MATHS_DEF v2      v2Mulf(v2 a, float b);
+MATHS_DEF v2      v2Divf(v2 a, float b);
 
-float   v2Mag2(v2 a);
-float   v2Mag(v2 a);
-float   v2Dot(v2 a, v2 b);
+MATHS_DEF float   v2Mag2(v2 a);
+MATHS_DEF float   v2Mag(v2 a);
+MATHS_DEF float   v2Dot(v2 a, v2 b);
 
-float   v2MinVal(v2 a);
-float   v2MaxVal(v2 a);
+MATHS_DEF float   v2MinVal(v2 a);
+MATHS_DEF float   v2MaxVal(v2 a);
 
-v2      v2Min(v2 a, v2 b);
-v2      v2Max(v2 a, v2 b);
+MATHS_DEF v2      v2Min(v2 a, v2 b);
+MATHS_DEF v2      v2Max(v2 a, v2 b);
 
-void    v2Norm(v2* a);
-v2      v2NormTo(v2 a);
+MATHS_DEF void    v2Norm(v2* a);
+MATHS_DEF v2      v2NormTo(v2 a);
 
-void    v2Rotate(v2* a, float angle);
-v2      v2RotateTo(v2 a, float angle);
+MATHS_DEF void    v2Rotate(v2* a, float angle);
+MATHS_DEF v2      v2RotateTo(v2 a, float angle);
 
 //-----------------------------
 // ~v3
 
-v3      v3Add(v3 a, v3 b);
-v3      v3Sub(v3 a, v3 b);
-v3      v3Mul(v3 a, v3 b);
-v3      v3Div(v3 a, v3 b);
+MATHS_DEF v3      v3Add(v3 a, v3 b);
+MATHS_DEF v3      v3Sub(v3 a, v3 b);
+MATHS_DEF v3      v3Mul(v3 a, v3 b);
+MATHS_DEF v3      v3Div(v3 a, v3 b);
 
-v3      v3Addf(v3 a, float b);
-v3      v3Subf(v3 a, float b);
-v3      v3Mulf(v3 a, float b);
-v3      v3Divf(v3 a, float b);
+MATHS_DEF v3      v3Addf(v3 a, float b);
+MATHS_DEF v3      v3Subf(v3 a, float b);
+MATHS_DEF v3      v3Mulf(v3 a, float b);
+MATHS_DEF v3      v3Divf(v3 a, float b);
 
-float   v3Mag2(v3 a);
-float   v3Mag(v3 a);
-float   v3Dot(v3 a, v3 b);
+MATHS_DEF float   v3Mag2(v3 a);
+MATHS_DEF float   v3Mag(v3 a);
+MATHS_DEF float   v3Dot(v3 a, v3 b);
 
-float   v3MinVal(v3 a);
-float   v3MaxVal(v3 a);
+MATHS_DEF float   v3MinVal(v3 a);
+MATHS_DEF float   v3MaxVal(v3 a);
 
-v3      v3Min(v3 a, v3 b);
-v3      v3Max(v3 a, v3 b);
+MATHS_DEF v3      v3Min(v3 a, v3 b);
+MATHS_DEF v3      v3Max(v3 a, v3 b);
 
-void    v3Norm(v3* a);
-v3      v3NormTo(v3 a);
+MATHS_DEF void    v3Norm(v3* a);
+MATHS_DEF v3      v3NormTo(v3 a);
 
-v3      v3Cross(v3 a, v3 b);
+MATHS_DEF v3      v3Cross(v3 a, v3 b);
 
 //-----------------------------
 // ~v4
 
-v4      v4Add(v4 a, v4 b);
-v4      v4Sub(v4 a, v4 b);
-v4      v4Mul(v4 a, v4 b);
-v4      v4Div(v4 a, v4 b);
+MATHS_DEF v4      v4Add(v4 a, v4 b);
+MATHS_DEF v4      v4Sub(v4 a, v4 b);
+MATHS_DEF v4      v4Mul(v4 a, v4 b);
+MATHS_DEF v4      v4Div(v4 a, v4 b);
 
-v4      v4Addf(v4 a, float b);
-v4      v4Subf(v4 a, float b);
-v4      v4Mulf(v4 a, float b);
-v4      v4Divf(v4 a, float b);
+MATHS_DEF v4      v4Addf(v4 a, float b);
+MATHS_DEF v4      v4Subf(v4 a, float b);
+MATHS_DEF v4      v4Mulf(v4 a, float b);
+MATHS_DEF v4      v4Divf(v4 a, float b);
 
-float   v4Mag2(v4 a);
-float   v4Mag(v4 a);
-float   v4Dot(v4 a, v4 b);
+MATHS_DEF float   v4Mag2(v4 a);
+MATHS_DEF float   v4Mag(v4 a);
+MATHS_DEF float   v4Dot(v4 a, v4 b);
 
-float   v4MinVal(v4 a);
-float   v4MaxVal(v4 a);
+MATHS_DEF float   v4MinVal(v4 a);
+MATHS_DEF float   v4MaxVal(v4 a);
 
-v4      v4Min(v4 a, v4 b);
-v4      v4Max(v4 a, v4 b);
+MATHS_DEF v4      v4Min(v4 a, v4 b);
+MATHS_DEF v4      v4Max(v4 a, v4 b);
 
-void    v4Norm(v4* a);
-v4      v4NormTo(v4 a);
+MATHS_DEF void    v4Norm(v4* a);
+MATHS_DEF v4      v4NormTo(v4 a);
 
 //-----------------------------
 // ~quat
 
+// Quaternions are stored as (x, y, z, w) with w the scalar part.
+
 #define quatAdd  v4Add
 #define quatSub  v4Sub
-#define quatMul  v4Mul
-#define quatDiv  v4Div
 
-#define quatAddf v4Addf
-#define quatSubf v4Subf
 #define quatMulf v4Mulf
 #define quatDivf v4Divf
 
+#define quatDot  v4Dot
+
+quat    quatIdentity(void);
+quat    quatFromAxisAngle(v3 axis, float angle);
+
+quat    quatMul(quat a, quat b); // Hamilton product, applies b then a
+quat    quatConjugate(quat q);
+quat    quatInverse(quat q);
+quat    quatNormTo(quat q);
+
+v3      quatRotate(quat q, v3 v);
+
+quat    quatNlerp(quat a, quat b, float t);
+quat    quatSlerp(quat a, quat b, float t); // Polynomial slerp, weights within 2e-5 of exact
+
+m4      quatToM4(quat q);
+
+// out[i] = interpolation from a[i] to b[i] at t, out may alias a or b
+void    quatNlerpBatch(const quat* a, const quat* b, float t, quat* out, uint n);
+void    quatSlerpBatch(const quat* a, const quat* b, float t, quat* out, uint n);
+
+// out[i] = translate(t[i]) * rotate(r[i]) * scale(s[i]), t and s may be NULL
+void    quatToM4Batch(const quat* r, const v3* t, const v3* s, m4* out, uint n);
+
 //-----------------------------
 // ~m3
 
-m3 m3Identity(void);
+MATHS_DEF m3 m3Identity(void);
 
-m3 m3Add(m3 a, m3 b);
-m3 m3Sub(m3 a, m3 b);
-m3 m3Mul(m3 a, m3 b);
-m3 m3Div(m3 a, m3 b);
+MATHS_DEF m3 m3Add(m3 a, m3 b);
+MATHS_DEF m3 m3Sub(m3 a, m3 b);
+MATHS_DEF m3 m3Mul(m3 a, m3 b);
+MATHS_DEF m3 m3Div(m3 a, m3 b);
 
-m3 m3Addf(m3 a, float b);
-m3 m3Subf(m3 a, float b);
-m3 m3Mulf(m3 a, float b);
-m3 m3Divf(m3 a, float b);
+MATHS_DEF m3 m3Addf(m3 a, float b);
+MATHS_DEF m3 m3Subf(m3 a, float b);
+MATHS_DEF m3 m3Mulf(m3 a, float b);
+MATHS_DEF m3 m3Divf(m3 a, float b);
 
-v3 m3Mulv3(m3 a, v3 b);
+MATHS_DEF v3 m3Mulv3(m3 a, v3 b);
 
-m3 m3Translate(m3 m, v2 t);
-m3 m3TranslateX(m3 m, float x);
-m3 m3TranslateY(m3 m, float y);
+MATHS_DEF m3 m3Translate(m3 m, v2 t);
+MATHS_DEF m3 m3TranslateX(m3 m, float x);
+MATHS_DEF m3 m3TranslateY(m3 m, float y);
 
-m3 m3Rotate(m3 m, float angle); // Can only rotate around the z axis
+MATHS_DEF m3 m3Rotate(m3 m, float angle); // Can only rotate around the z axis
 
-m3 m3Scale(m3 m, v2 s);
-m3 m3ScaleX(m3 m, float x);
-m3 m3ScaleY(m3 m, float y);
+MATHS_DEF m3 m3Scale(m3 m, v2 s);
+MATHS_DEF m3 m3ScaleX(m3 m, float x);
+MATHS_DEF m3 m3ScaleY(m3 m, float y);
 
-m3 m3Transform(m3 m, v2 t, float angle, v2 s);
+MATHS_DEF m3 m3Transform(m3 m, v2 t, float angle, v2 s); // m * translate(t) * rotate(angle) * scale(s)
 
 //-----------------------------
 // ~m4
 
-m4 m4Identity(void);
+MATHS_DEF m4 m4Identity(void);
+
+MATHS_DEF m4 m4Add(m4 a, m4 b);
+MATHS_DEF m4 m4Sub(m4 a, m4 b);
+MATHS_DEF m4 m4Mul(m4 a, m4 b); // Matrix product, a * b
+MATHS_DEF m4 m4Div(m4 a, m4 b);
 
-m4 m4Add(m4 a, m4 b);
-m4 m4Sub(m4 a, m4 b);
-m4 m4Mul(m4 a, m4 b);
-m4 m4Div(m4 a, m4 b);
+MATHS_DEF m4 m4Addf(m4 a, float b);
+MATHS_DEF m4 m4Subf(m4 a, float b);
+MATHS_DEF m4 m4Mulf(m4 a, float b);
+MATHS_DEF m4 m4Divf(m4 a, float b);
 
-m4 m4Addf(m4 a, float b);
-m4 m4Subf(m4 a, float b);
-m4 m4Mulf(m4 a, float b);
-m4 m4Divf(m4 a, float b);
+MATHS_DEF v3 m4Mulv3(m4 a, v3 b, float w);
+MATHS_DEF v4 m4Mulv4(m4 a, v4 b);
 
-v3 m4Mulv3(m4 a, v3 b, float w);
-v4 m4Mulv4(m4 a, v4 b);
+// Pointer variants, nothing is copied and out may alias the inputs
+MATHS_DEF void m4MulTo(m4* out, const m4* a, const m4* b);
+MATHS_DEF void m4Mulv4To(v4* out, const m4* a, const v4* b);
 
-m4 m4Translate(m4 m, v3 t);
-m4 m4TranslateX(m4 m, float x);
-m4 m4TranslateY(m4 m, float y);
-m4 m4TranslateZ(m4 m, float z);
+void m4MulBatch(const m4* a, const m4* b, m4* out, uint n);     // out[i] = a[i] * b[i]
+void m4Mulv4Batch(const m4* a, const v4* b, v4* out, uint n);   // out[i] = a[i] * b[i]
 
-m4 m4Rotate(m4 m, v3 axis, float angle);
-m4 m4RotateX(m4 m, float angle);
-m4 m4RotateY(m4 m, float angle);
-m4 m4RotateZ(m4 m, float angle);
+// in may be the same array as out, large batches are split across threads
+void m4TransformPoints(m4 m, const v3* in, v3* out, uint n);      // w = 1
+void m4TransformDirections(m4 m, const v3* in, v3* out, uint n);  // w = 0
+void m4TransformNormals(m4 m, const v3* in, v3* out, uint n);     // Inverse transpose, renormalized
 
-m4 m4Scale(m4 m, v3 s);
-m4 m4ScaleX(m4 m, float x);
-m4 m4ScaleY(m4 m, float y);
-m4 m4ScaleX(m4 m, float z);
+// The inverses return 0 and leave out untouched when the matrix is singular
+float m4Determinant(m4 m);
+bool  m4Inverse(m4 m, m4* out);
+bool  m4AffineInverse(m4 m, m4* out); // Bottom row must be (0, 0, 0, 1), much cheaper
 
-m4 m4Transform(m4 m, v3 t, v3 axis, float angle, v3 s);
+// Inverse transpose of the upper 3x3. A singular matrix returns 0 and gets its
+// cofactor matrix instead, which still points normals the right way once
+// they are renormalized. ok may be NULL, large batches are split across threads
+bool  m4NormalMatrix(m4 m, m3* out);
+void  m4NormalMatrixBatch(const m4* in, m3* out, bool* ok, uint n);
 
-m4 m4LookAt(v3 eye, v3 target, v3 up);
-m4 m4Perspective(float fov, float aspect, float near, float far);
+MATHS_DEF m4 m4Translate(m4 m, v3 t);
+MATHS_DEF m4 m4TranslateX(m4 m, float x);
+MATHS_DEF m4 m4TranslateY(m4 m, float y);
+MATHS_DEF m4 m4TranslateZ(m4 m, float z);
+MATHS_DEF void m4TranslateInPlace(m4* m, v3 t);
 
-m4 m4Frustum(float left, float right, float bottom, float top, float near, float far);
-m4 m4Orthographic(float left, float right, float bottom, float top, float near, float far);
+MATHS_DEF m4 m4Rotate(m4 m, v3 axis, float angle);
+MATHS_DEF m4 m4RotateX(m4 m, float angle);
+MATHS_DEF m4 m4RotateY(m4 m, float angle);
+MATHS_DEF m4 m4RotateZ(m4 m, float angle);
+MATHS_DEF void m4RotateInPlace(m4* m, v3 axis, float angle);
+
+MATHS_DEF m4 m4Scale(m4 m, v3 s);
+MATHS_DEF m4 m4ScaleX(m4 m, float x);
+MATHS_DEF m4 m4ScaleY(m4 m, float y);
+MATHS_DEF m4 m4ScaleZ(m4 m, float z);
+MATHS_DEF void m4ScaleInPlace(m4* m, v3 s);
+
+MATHS_DEF m4 m4Transform(m4 m, v3 t, v3 axis, float angle, v3 s); // m * translate(t) * rotate(axis, angle) * scale(s)
+
+MATHS_DEF m4 m4LookAt(v3 eye, v3 target, v3 up);
+MATHS_DEF m4 m4Perspective(float fov, float aspect, float near, float far);
+
+MATHS_DEF m4 m4Frustum(float left, float right, float bottom, float top, float near, float far);
+MATHS_DEF m4 m4Orthographic(float left, float right, float bottom, float top, float near, float far);
+
+//-----------------------------
+// ~m4x3
+
+MATHS_DEF m4x3 m4x3Identity(void);
+
+MATHS_DEF m4x3 m4x3FromM4(m4 m); // Drops the bottom row
+MATHS_DEF m4   m4x3ToM4(m4x3 m);
+
+MATHS_DEF m4x3 m4x3Mul(m4x3 a, m4x3 b); // a * b, same as multiplying the expanded m4s
+MATHS_DEF void m4x3MulTo(m4x3* out, const m4x3* a, const m4x3* b);
+MATHS_DEF m4x3 m4x3Inverse(m4x3 m);
+
+MATHS_DEF v3   m4x3MulPoint(m4x3 m, v3 p);
+MATHS_DEF v3   m4x3MulDirection(m4x3 m, v3 d);
+
+MATHS_DEF m4x3 m4x3Translate(m4x3 m, v3 t);
+MATHS_DEF m4x3 m4x3Rotate(m4x3 m, v3 axis, float angle);
+MATHS_DEF m4x3 m4x3Scale(m4x3 m, v3 s);
+
+void m4x3MulBatch(const m4x3* a, const m4x3* b, m4x3* out, uint n);  // out[i] = a[i] * b[i]
+void m4x3TransformPoints(m4x3 m, const v3* in, v3* out, uint n);     // Same as m4TransformPoints
+
+//-----------------------------
+// ~TRS
+
+// The matrix is written straight from the quaternion, no rotation, scale or
+// translation matrices are built and multiplied. Bit identical to
+// quatToM4Batch with the same inputs, the batches split large inputs across
+// threads.
+
+TRS  trsIdentity(void);
+
+m4   trsToM4(TRS trs);
+m4x3 trsToM4x3(TRS trs);
+
+void trsToM4Batch(const TRS* in, m4* out, uint n);
+void trsToM4x3Batch(const TRS* in, m4x3* out, uint n);
+
+//-----------------------------
+// ~Frustum
+
+// vp is projection * view with OpenGL clip space (-w <= z <= w), the planes
+// are normalized and point inwards. The tests are conservative, a box near a
+// frustum corner can pass even though it is just outside.
+Frustum frustumFromM4(m4 vp);
+
+bool frustumTestSphere(const Frustum* f, Sphere s);
+bool frustumTestAABB(const Frustum* f, AABB b);
+
+// Write the indices of the visible entries to visible in increasing order and
+// return how many there are, visible must have room for the stream's count.
+// Large streams are split across threads.
+uint frustumCullSpheres(const Frustum* f, const v4Stream* spheres, uint* visible);                        // w is the radius
+uint frustumCullAABBs(const Frustum* f, const v3Stream* centres, const v3Stream* extents, uint* visible); // Half sizes
+
+//-----------------------------
+// ~Parallel
+
+// Splits [0, count) into one contiguous range per thread when count reaches
+// threshold, otherwise fn runs once on the calling thread. Ranges start on
+// multiples of 8 so SoA kernels never share a SIMD register between threads.
+// The batch kernels in this module use parallelThreshold() as their cutoff.
+
+typedef void (*ParallelFn)(void* data, uint begin, uint end);
+
+void parallelFor(uint count, uint threshold, ParallelFn fn, void* data);
+
+void parallelSetThreshold(uint count);
+uint parallelThreshold(void);
+
+void parallelSetThreadCount(uint count); // 0 uses one thread per core
+uint parallelThreadCount(void);
+
+//-----------------------------
+// ~Streams
+
+// Binary kernels process MIN(a->count, b->count) elements, clamped to the
+// output's capacity, and set out->count. out may alias a or b.
+
+v2Stream v2StreamCreate(uint capacity);
+void     v2StreamDestroy(v2Stream* s);
+
+void     v2StreamFromArray(v2Stream* s, const v2* in, uint n);
+void     v2StreamToArray(const v2Stream* s, v2* out);
+
+void     v2StreamAdd(v2Stream* out, const v2Stream* a, const v2Stream* b);
+void     v2StreamSub(v2Stream* out, const v2Stream* a, const v2Stream* b);
+void     v2StreamMul(v2Stream* out, const v2Stream* a, const v2Stream* b);
+void     v2StreamMulf(v2Stream* out, const v2Stream* a, float b);
+void     v2StreamMin(v2Stream* out, const v2Stream* a, const v2Stream* b);
+void     v2StreamMax(v2Stream* out, const v2Stream* a, const v2Stream* b);
+void     v2StreamDot(float* out, const v2Stream* a, const v2Stream* b);
+void     v2StreamNorm(v2Stream* out, const v2Stream* a);
+
+v3Stream v3StreamCreate(uint capacity);
+void     v3StreamDestroy(v3Stream* s);
+
+void     v3StreamFromArray(v3Stream* s, const v3* in, uint n);
+void     v3StreamToArray(const v3Stream* s, v3* out);
+
+void     v3StreamAdd(v3Stream* out, const v3Stream* a, const v3Stream* b);
+void     v3StreamSub(v3Stream* out, const v3Stream* a, const v3Stream* b);
+void     v3StreamMul(v3Stream* out, const v3Stream* a, const v3Stream* b);
+void     v3StreamMulf(v3Stream* out, const v3Stream* a, float b);
+void     v3StreamMin(v3Stream* out, const v3Stream* a, const v3Stream* b);
+void     v3StreamMax(v3Stream* out, const v3Stream* a, const v3Stream* b);
+void     v3StreamDot(float* out, const v3Stream* a, const v3Stream* b);
+void     v3StreamCross(v3Stream* out, const v3Stream* a, const v3Stream* b);
+void     v3StreamNorm(v3Stream* out, const v3Stream* a);
+
+v4Stream v4StreamCreate(uint capacity);
+void     v4StreamDestroy(v4Stream* s);
+
+void     v4StreamFromArray(v4Stream* s, const v4* in, uint n);
+void     v4StreamToArray(const v4Stream* s, v4* out);
+
+void     v4StreamAdd(v4Stream* out, const v4Stream* a, const v4Stream* b);
+void     v4StreamSub(v4Stream* out, const v4Stream* a, const v4Stream* b);
+void     v4StreamMul(v4Stream* out, const v4Stream* a, const v4Stream* b);
+void     v4StreamMulf(v4Stream* out, const v4Stream* a, float b);
+void     v4StreamMin(v4Stream* out, const v4Stream* a, const v4Stream* b);
+void     v4StreamMax(v4Stream* out, const v4Stream* a, const v4Stream* b);
+void     v4StreamDot(float* out, const v4Stream* a, const v4Stream* b);
+void     v4StreamNorm(v4Stream* out, const v4Stream* a);
+
+//-----------------------------
+// ~Quantize
+
+// Packing for compact vertex attributes, each matches a VERTEX_ format in
+// graphics.h. Values are clamped to the format's range and rounded to the
+// nearest step, the flat kernels convert n floats and the others n vectors.
+
+void     quantizeHalf(ushort* out, const float* in, uint n);         // IEEE half, ties to even, too large goes to inf
+void     quantizeSnorm16(short* out, const float* in, uint n);       // [-1, 1], nearest step of 1 / 32767
+void     quantizeUnorm8(uchar* out, const float* in, uint n);        // [0, 1], nearest step of 1 / 255
+void     quantizeOctahedral(short* out, const v3* normals, uint n);  // Two snorm16 per unit normal, error < 0.01 degrees
+void     quantizeSnorm1010102(uint* out, const v4* in, uint n);      // [-1, 1], xyz in 10 bits and w in 2, GL_INT_2_10_10_10_REV
+
+float    halfToFloat(ushort h);
+v3       octahedralDecode(short x, short y); // Unit length
 
 //-----------------------------
 // ~Color
@@ -325,4 +594,1115 @@ m4 m4Orthographic(float left, float right, float bottom, float top, float near,
 #define COLOR_BROWN      (Color){ 127, 106,  79, 255 }
 #define COLOR_DARKBROWN  (Color){  76,  63,  47, 255 }
 
+//-------------------------------------------------------------
+// Implementation
+//-------------------------------------------------------------
+
+// Compiled once into maths.c, or into every file that includes this header
+// when MATHS_INLINE is defined so the calls inline without LTO.
+
+#if defined(MATHS_INLINE) || defined(MATHS_IMPLEMENTATION)
+
+#include "simd.h"
+#include <math.h> // sqrtf
+
+//-----------------------------
+// ~v2
+
+MATHS_DEF v2 v2Add(v2 a, v2 b)
+{
+    return (v2){a.x + b.x, a.y + b.y};
+}
+
+MATHS_DEF v2 v2Sub(v2 a, v2 b)
+{
+    return (v2){a.x - b.x, a.y - b.y};
+}
+
+MATHS_DEF v2 v2Mul(v2 a, v2 b)
+{
+    return (v2){a.x * b.x, a.y * b.y};
+}
+
+MATHS_DEF v2 v2Div(v2 a, v2 b)
+{
+    return (v2){a.x / b.x, a.y / b.y};
+}
+
+MATHS_DEF v2 v2Addf(v2 a, float b)
+{
+    return (v2){a.x + b, a.y + b};
+}
+
+MATHS_DEF v2 v2Subf(v2 a, float b)
+{
+    return (v2){a.x - b, a.y - b};
+}
+
+MATHS_DEF v2 v2Mulf(v2 a, float b)
+{
+    return (v2){a.x * b, a.y * b};
+}
+
+MATHS_DEF v2 v2Divf(v2 a, float b)
+{
+    return (v2){a.x / b, a.y / b};
+}
+
+MATHS_DEF float v2Mag2(v2 a)
+{
+    return a.x * a.x + a.y * a.y;
+}
+
+MATHS_DEF float v2Mag(v2 a)
+{
+    return sqrtf(v2Mag2(a));
+}
+
+MATHS_DEF float v2Dot(v2 a, v2 b)
+{
+    return a.x * b.x + a.y * b.y;
+}
+
+MATHS_DEF float v2MinVal(v2 a)
+{
+    return MIN(a.x, a.y);
+}
+
+MATHS_DEF float v2MaxVal(v2 a)
+{
+    return MAX(a.x, a.y);
+}
+
+MATHS_DEF v2 v2Min(v2 a, v2 b)
+{
+    return (v2){MIN(a.x, b.x), MIN(a.y, b.y)};
+}
+
+MATHS_DEF v2 v2Max(v2 a, v2 b)
+{
+    return (v2){MAX(a.x, b.x), MAX(a.y, b.y)};
+}
+
+MATHS_DEF void v2Norm(v2* a)
+{
+    *a = v2Divf(*a, v2Mag(*a));
+}
+
+MATHS_DEF v2 v2NormTo(v2 a)
+{
+    return v2Divf(a, v2Mag(a));
+}
+
+MATHS_DEF void v2Rotate(v2* a, float angle)
+{
+    *a = v2RotateTo(*a, angle);
+}
+
+MATHS_DEF v2 v2RotateTo(v2 a, float angle)
+{
+    float s, c;
+    sinCos(angle, &s, &c);
+
+    return (v2) {
+        a.x * c - a.y * s,
+        a.x * s + a.y * c
+    };
+}
+
+//-----------------------------
+// ~v3
+
+MATHS_DEF v3 v3Add(v3 a, v3 b)
+{
+    return (v3){a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+MATHS_DEF v3 v3Sub(v3 a, v3 b)
+{
+    return (v3){a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+MATHS_DEF v3 v3Mul(v3 a, v3 b)
+{
+    return (v3){a.x * b.x, a.y * b.y, a.z * b.z};
+}
+
+MATHS_DEF v3 v3Div(v3 a, v3 b)
+{
+    return (v3){a.x / b.x, a.y / b.y, a.z / b.z};
+}
+
+MATHS_DEF v3 v3Addf(v3 a, float b)
+{
+    return (v3){a.x + b, a.y + b, a.z + b};
+}
+
+MATHS_DEF v3 v3Subf(v3 a, float b)
+{
+    return (v3){a.x - b, a.y - b, a.z - b};
+}
+
+MATHS_DEF v3 v3Mulf(v3 a, float b)
+{
+    return (v3){a.x * b, a.y * b, a.z * b};
+}
+
+MATHS_DEF v3 v3Divf(v3 a, float b)
+{
+    return (v3){a.x / b, a.y / b, a.z / b};
+}
+
+MATHS_DEF float v3Mag2(v3 a)
+{
+    return a.x * a.x + a.y * a.y + a.z * a.z;
+}
+
+MATHS_DEF float v3Mag(v3 a)
+{
+    return sqrtf(v3Mag2(a));
+}
+
+MATHS_DEF float v3Dot(v3 a, v3 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+MATHS_DEF float v3MinVal(v3 a)
+{
+    return MIN(MIN(a.x, a.y), a.z);
+}
+
+MATHS_DEF float v3MaxVal(v3 a)
+{
+    return MAX(MAX(a.x, a.y), a.z);
+}
+
+MATHS_DEF v3 v3Min(v3 a, v3 b)
+{
+    return (v3) {
+        MIN(a.x, b.x),
+        MIN(a.y, b.y),
+        MIN(a.z, b.z)
+    };
+}
+
+MATHS_DEF v3 v3Max(v3 a, v3 b)
+{
+    return (v3) {
+        MAX(a.x, b.x),
+        MAX(a.y, b.y),
+        MAX(a.z, b.z)
+    };
+}
+
+MATHS_DEF void v3Norm(v3* a)
+{
+    *a = v3Divf(*a, v3Mag(*a));
+}
+
+MATHS_DEF v3 v3NormTo(v3 a)
+{
+    return v3Divf(a, v3Mag(a));
+}
+
+MATHS_DEF v3 v3Cross(v3 a, v3 b)
+{
+    return (v3) {
+        a.y * b.z - a.z * b.y,
+        a.z * b.x - a.x * b.z,
+        a.x * b.y - a.y * b.x
+    };
+}
+
+//-----------------------------
+// ~v4
+
+MATHS_DEF v4 v4Add(v4 a, v4 b)
+{
+    return (v4){a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+}
+
+MATHS_DEF v4 v4Sub(v4 a, v4 b)
+{
+    return (v4){a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
+}
+
+MATHS_DEF v4 v4Mul(v4 a, v4 b)
+{
+    return (v4){a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w};
+}
+
+MATHS_DEF v4 v4Div(v4 a, v4 b)
+{
+    return (v4){a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w};
+}
+
+MATHS_DEF v4 v4Addf(v4 a, float b)
+{
+    return (v4){a.x + b, a.y + b, a.z + b, a.w + b};
+}
+
+MATHS_DEF v4 v4Subf(v4 a, float b)
+{
+    return (v4){a.x - b, a.y - b, a.z - b, a.w - b};
+}
+
+MATHS_DEF v4 v4Mulf(v4 a, float b)
+{
+    return (v4){a.x * b, a.y * b, a.z * b, a.w * b};
+}
+
+MATHS_DEF v4 v4Divf(v4 a, float b)
+{
+    return (v4){a.x / b, a.y / b, a.z / b, a.w / b};
+}
+
+MATHS_DEF float v4Mag2(v4 a)
+{
+    return a.x * a.x + a.y * a.y + a.z * a.z + a.w * a.w;
+}
+
+MATHS_DEF float v4Mag(v4 a)
+{
+    return sqrtf(v4Mag2(a));
+}
+
+MATHS_DEF float v4Dot(v4 a, v4 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+MATHS_DEF float v4MinVal(v4 a)
+{
+    return MIN(MIN(MIN(a.x, a.y), a.z), a.w);
+}
+
+MATHS_DEF float v4MaxVal(v4 a)
+{
+    return MAX(MAX(MAX(a.x, a.y), a.z), a.w);
+}
+
+MATHS_DEF v4 v4Min(v4 a, v4 b)
+{
+    return (v4) {
+        MIN(a.x, b.x),
+        MIN(a.y, b.y),
+        MIN(a.z, b.z),
+        MIN(a.w, b.w),
+    };
+}
+
+MATHS_DEF v4 v4Max(v4 a, v4 b)
+{
+    return (v4) {
+        MAX(a.x, b.x),
+        MAX(a.y, b.y),
+        MAX(a.z, b.z),
+        MAX(a.w, b.w),
+    };
+}
+
+MATHS_DEF void v4Norm(v4* a)
+{
+    *a = v4Divf(*a, v4Mag(*a));
+}
+
+MATHS_DEF v4 v4NormTo(v4 a)
+{
+    return v4Divf(a, v4Mag(a));
+}
+
+//-----------------------------
+// ~m3
+
+MATHS_DEF m3 m3Identity(void)
+{
+    return (m3) {
+        1.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 1.0f
+    };
+}
+
+MATHS_DEF m3 m3Add(m3 a, m3 b)
+{
+    return (m3) {
+        a.m00 + b.m00, a.m10 + b.m10, a.m20 + b.m20,
+        a.m01 + b.m01, a.m11 + b.m11, a.m21 + b.m21,
+        a.m02 + b.m02, a.m12 + b.m12, a.m22 + b.m22
+    };
+}
+
+MATHS_DEF m3 m3Sub(m3 a, m3 b)
+{
+    return (m3) {
+        a.m00 - b.m00, a.m10 - b.m10, a.m20 - b.m20,
+        a.m01 - b.m01, a.m11 - b.m11, a.m21 - b.m21,
+        a.m02 - b.m02, a.m12 - b.m12, a.m22 - b.m22
+    };
+}
+
+MATHS_DEF m3 m3Mul(m3 a, m3 b)
+{
+    return (m3) {
+        a.m00 * b.m00, a.m10 * b.m10, a.m20 * b.m20,
+        a.m01 * b.m01, a.m11 * b.m11, a.m21 * b.m21,
+        a.m02 * b.m02, a.m12 * b.m12, a.m22 * b.m22
+    };
+}
+
+MATHS_DEF m3 m3Div(m3 a, m3 b)
+{
+    return (m3) {
+        a.m00 / b.m00, a.m10 / b.m10, a.m20 / b.m20,
+        a.m01 / b.m01, a.m11 / b.m11, a.m21 / b.m21,
+        a.m02 / b.m02, a.m12 / b.m12, a.m22 / b.m22
+    };
+}
+
+MATHS_DEF m3 m3Addf(m3 a, float b)
+{
+    return (m3) {
+        a.m00 + b, a.m10 + b, a.m20 + b,
+        a.m01 + b, a.m11 + b, a.m21 + b,
+        a.m02 + b, a.m12 + b, a.m22 + b
+    };
+}
+
+MATHS_DEF m3 m3Subf(m3 a, float b)
+{
+    return (m3) {
+        a.m00 - b, a.m10 - b, a.m20 - b,
+        a.m01 - b, a.m11 - b, a.m21 - b,
+        a.m02 - b, a.m12 - b, a.m22 - b
+    };
+}
+
+MATHS_DEF m3 m3Mulf(m3 a, float b)
+{
+    return (m3) {
+        a.m00 * b, a.m10 * b, a.m20 * b,
+        a.m01 * b, a.m11 * b, a.m21 * b,
+        a.m02 * b, a.m12 * b, a.m22 * b
+    };
+}
+
+MATHS_DEF m3 m3Divf(m3 a, float b)
+{
+    return (m3) {
+        a.m00 / b, a.m10 / b, a.m20 / b,
+        a.m01 / b, a.m11 / b, a.m21 / b,
+        a.m02 / b, a.m12 / b, a.m22 / b
+    };
+}
+
+MATHS_DEF v3 m3Mulv3(m3 a, v3 b)
+{
+    return (v3) {
+        a.m00 * b.x + a.m10 * b.y + a.m20 * b.z,
+        a.m01 * b.x + a.m11 * b.y + a.m21 * b.z,
+        a.m02 * b.x + a.m12 * b.y + a.m22 * b.z
+    };
+}
+
+MATHS_DEF m3 m3Translate(m3 m, v2 t)
+{
+    m3 out = m;
+    out.m20 = m.m00 * t.x + m.m10 * t.y + m.m20;
+    out.m21 = m.m01 * t.x + m.m11 * t.y + m.m21;
+    out.m22 = m.m02 * t.x + m.m12 * t.y + m.m22;
+    return out;
+}
+
+MATHS_DEF m3 m3TranslateX(m3 m, float x)
+{
+    m3 out = m;
+    out.m20 = m.m00 * x + m.m20;
+    out.m21 = m.m01 * x + m.m21;
+    out.m22 = m.m02 * x + m.m22;
+    return out;
+}
+
+MATHS_DEF m3 m3TranslateY(m3 m, float y)
+{
+    m3 out = m;
+    out.m20 = m.m10 * y + m.m20;
+    out.m21 = m.m11 * y + m.m21;
+    out.m22 = m.m12 * y + m.m22;
+    return out;
+}
+
+MATHS_DEF m3 m3Rotate(m3 m, float angle)
+{
+    float s, c;
+    sinCos(angle, &s, &c);
+
+    m3 out = m;
+
+    out.m00 = m.m00 * c + m.m10 * s;
+    out.m01 = m.m01 * c + m.m11 * s;
+    out.m02 = m.m02 * c + m.m12 * s;
+
+    out.m10 = m.m00 * -s + m.m10 * c;
+    out.m11 = m.m01 * -s + m.m11 * c;
+    out.m12 = m.m02 * -s + m.m12 * c;
+
+    return out;
+}
+
+MATHS_DEF m3 m3Scale(m3 m, v2 s)
+{
+    m3 out = m;
+    out.m00 *= s.x;
+    out.m01 *= s.x;
+    out.m02 *= s.x;
+    out.m10 *= s.y;
+    out.m11 *= s.y;
+    out.m12 *= s.y;
+    return out;
+}
+
+MATHS_DEF m3 m3ScaleX(m3 m, float x)
+{
+    m3 out = m;
+    out.m00 *= x;
+    out.m01 *= x;
+    out.m02 *= x;
+    return out;
+}
+
+MATHS_DEF m3 m3ScaleY(m3 m, float y)
+{
+    m3 out = m;
+    out.m10 *= y;
+    out.m11 *= y;
+    out.m12 *= y;
+    return out;
+}
+
+MATHS_DEF m3 m3Transform(m3 m, v2 t, float angle, v2 s)
+{
+    return m3Scale(m3Rotate(m3Translate(m, t), angle), s);
+}
+
+//-----------------------------
+// ~m4
+
+// The matrices are column major, m30, m31 and m32 hold the translation.
+// Every kernel accumulates in the same order (c0 * x + c1 * y + c2 * z + c3 * w)
+// so the SIMD and scalar paths give bit-identical results.
+
+static inline void m4MulKernel(const m4* a, const m4* b, m4* out);
+static inline void m4Mulv4Kernel(const m4* a, const v4* b, v4* out);
+
+MATHS_DEF m4 m4Identity(void)
+{
+    return (m4) {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+}
+
+MATHS_DEF m4 m4Add(m4 a, m4 b)
+{
+#ifdef MATHS_SSE2
+    const float* pa = &a.m00;
+    const float* pb = &b.m00;
+
+    m4 out;
+    float* po = &out.m00;
+
+    for (int i = 0; i < 16; i += 4)
+        _mm_storeu_ps(po + i, _mm_add_ps(_mm_loadu_ps(pa + i), _mm_loadu_ps(pb + i)));
+
+    return out;
+#else
+    return (m4) {
+        a.m00 + b.m00, a.m01 + b.m01, a.m02 + b.m02, a.m03 + b.m03,
+        a.m10 + b.m10, a.m11 + b.m11, a.m12 + b.m12, a.m13 + b.m13,
+        a.m20 + b.m20, a.m21 + b.m21, a.m22 + b.m22, a.m23 + b.m23,
+        a.m30 + b.m30, a.m31 + b.m31, a.m32 + b.m32, a.m33 + b.m33
+    };
+#endif // MATHS_SSE2
+}
+
+MATHS_DEF m4 m4Sub(m4 a, m4 b)
+{
+    return (m4) {
+        a.m00 - b.m00, a.m01 - b.m01, a.m02 - b.m02, a.m03 - b.m03,
+        a.m10 - b.m10, a.m11 - b.m11, a.m12 - b.m12, a.m13 - b.m13,
+        a.m20 - b.m20, a.m21 - b.m21, a.m22 - b.m22, a.m23 - b.m23,
+        a.m30 - b.m30, a.m31 - b.m31, a.m32 - b.m32, a.m33 - b.m33
+    };
+}
+
+MATHS_DEF m4 m4Mul(m4 a, m4 b)
+{
+    m4 out;
+    m4MulKernel(&a, &b, &out);
+    return out;
+}
+
+MATHS_DEF void m4MulTo(m4* out, const m4* a, const m4* b)
+{
+    m4MulKernel(a, b, out);
+}
+
+MATHS_DEF m4 m4Div(m4 a, m4 b)
+{
+    return (m4) {
+        a.m00 / b.m00, a.m01 / b.m01, a.m02 / b.m02, a.m03 / b.m03,
+        a.m10 / b.m10, a.m11 / b.m11, a.m12 / b.m12, a.m13 / b.m13,
+        a.m20 / b.m20, a.m21 / b.m21, a.m22 / b.m22, a.m23 / b.m23,
+        a.m30 / b.m30, a.m31 / b.m31, a.m32 / b.m32, a.m33 / b.m33
+    };
+}
+
+MATHS_DEF m4 m4Addf(m4 a, float b)
+{
+    return (m4) {
+        a.m00 + b, a.m01 + b, a.m02 + b, a.m03 + b,
+        a.m10 + b, a.m11 + b, a.m12 + b, a.m13 + b,
+        a.m20 + b, a.m21 + b, a.m22 + b, a.m23 + b,
+        a.m30 + b, a.m31 + b, a.m32 + b, a.m33 + b
+    };
+}
+
+MATHS_DEF m4 m4Subf(m4 a, float b)
+{
+    return (m4) {
+        a.m00 - b, a.m01 - b, a.m02 - b, a.m03 - b,
+        a.m10 - b, a.m11 - b, a.m12 - b, a.m13 - b,
+        a.m20 - b, a.m21 - b, a.m22 - b, a.m23 - b,
+        a.m30 - b, a.m31 - b, a.m32 - b, a.m33 - b
+    };
+}
+
+MATHS_DEF m4 m4Mulf(m4 a, float b)
+{
+    return (m4) {
+        a.m00 * b, a.m01 * b, a.m02 * b, a.m03 * b,
+        a.m10 * b, a.m11 * b, a.m12 * b, a.m13 * b,
+        a.m20 * b, a.m21 * b, a.m22 * b, a.m23 * b,
+        a.m30 * b, a.m31 * b, a.m32 * b, a.m33 * b
+    };
+}
+
+MATHS_DEF m4 m4Divf(m4 a, float b)
+{
+    return (m4) {
+        a.m00 / b, a.m01 / b, a.m02 / b, a.m03 / b,
+        a.m10 / b, a.m11 / b, a.m12 / b, a.m13 / b,
+        a.m20 / b, a.m21 / b, a.m22 / b, a.m23 / b,
+        a.m30 / b, a.m31 / b, a.m32 / b, a.m33 / b
+    };
+}
+
+MATHS_DEF v3 m4Mulv3(m4 a, v3 b, float w)
+{
+    v4 c = m4Mulv4(a, (v4){b.x, b.y, b.z, w});
+    return (v3){c.x, c.y, c.z};
+}
+
+MATHS_DEF v4 m4Mulv4(m4 a, v4 b)
+{
+    v4 out;
+    m4Mulv4Kernel(&a, &b, &out);
+    return out;
+}
+
+MATHS_DEF void m4Mulv4To(v4* out, const m4* a, const v4* b)
+{
+    m4Mulv4Kernel(a, b, out);
+}
+
+MATHS_DEF m4 m4Translate(m4 m, v3 t)
+{
+    m4TranslateInPlace(&m, t);
+    return m;
+}
+
+MATHS_DEF m4 m4TranslateX(m4 m, float x)
+{
+    m4 out = m;
+
+    out.m30 += m.m00 * x;
+    out.m31 += m.m01 * x;
+    out.m32 += m.m02 * x;
+    out.m33 += m.m03 * x;
+
+    return out;
+}
+
+MATHS_DEF m4 m4TranslateY(m4 m, float y)
+{
+    m4 out = m;
+
+    out.m30 += m.m10 * y;
+    out.m31 += m.m11 * y;
+    out.m32 += m.m12 * y;
+    out.m33 += m.m13 * y;
+
+    return out;
+}
+
+MATHS_DEF m4 m4TranslateZ(m4 m, float z)
+{
+    m4 out = m;
+
+    out.m30 += m.m20 * z;
+    out.m31 += m.m21 * z;
+    out.m32 += m.m22 * z;
+    out.m33 += m.m23 * z;
+
+    return out;
+}
+
+MATHS_DEF void m4TranslateInPlace(m4* m, v3 t)
+{
+    m->m30 += m->m00 * t.x + m->m10 * t.y + m->m20 * t.z;
+    m->m31 += m->m01 * t.x + m->m11 * t.y + m->m21 * t.z;
+    m->m32 += m->m02 * t.x + m->m12 * t.y + m->m22 * t.z;
+    m->m33 += m->m03 * t.x + m->m13 * t.y + m->m23 * t.z;
+}
+
+// http://fastgraph.com/makegames/3drotation/
+MATHS_DEF m4 m4Rotate(m4 m, v3 axis, float angle)
+{
+    m4RotateInPlace(&m, axis, angle);
+    return m;
+}
+
+MATHS_DEF m4 m4RotateX(m4 m, float angle)
+{
+    float s, c;
+    sinCos(angle, &s, &c);
+
+    m4 rot = m4Identity();
+    rot.m11 =  c;
+    rot.m12 =  s;
+    rot.m21 = -s;
+    rot.m22 =  c;
+    return m4Mul(m, rot);
+}
+
+MATHS_DEF m4 m4RotateY(m4 m, float angle)
+{
+    float s, c;
+    sinCos(angle, &s, &c);
+
+    m4 rot = m4Identity();
+    rot.m00 =  c;
+    rot.m02 = -s;
+    rot.m20 =  s;
+    rot.m22 =  c;
+    return m4Mul(m, rot);
+}
+
+MATHS_DEF m4 m4RotateZ(m4 m, float angle)
+{
+    float s, c;
+    sinCos(angle, &s, &c);
+
+    m4 rot = m4Identity();
+    rot.m00 =  c;
+    rot.m01 =  s;
+    rot.m10 = -s;
+    rot.m11 =  c;
+    return m4Mul(m, rot);
+}
+
+MATHS_DEF void m4RotateInPlace(m4* m, v3 axis, float angle)
+{
+    float s, c;
+    sinCos(angle, &s, &c);
+    float t = 1.0f - c;
+
+    v3Norm(&axis);
+
+    v3 at = v3Mulf(axis, t);
+    v3 as = v3Mulf(axis, s);
+
+    m4 rot = {0};
+
+    rot.m00 = axis.x * at.x + c;
+    rot.m01 = axis.y * at.x + as.z;
+    rot.m02 = axis.z * at.x - as.y;
+
+    rot.m10 = axis.x * at.y - as.z;
+    rot.m11 = axis.y * at.y + c;
+    rot.m12 = axis.z * at.y + as.x;
+
+    rot.m20 = axis.x * at.z + as.y;
+    rot.m21 = axis.y * at.z - as.x;
+    rot.m22 = axis.z * at.z + c;
+
+    rot.m33 = 1.0f;
+
+    m4MulKernel(m, &rot, m);
+}
+
+MATHS_DEF m4 m4Scale(m4 m, v3 s)
+{
+    m4ScaleInPlace(&m, s);
+    return m;
+}
+
+MATHS_DEF m4 m4ScaleX(m4 m, float x)
+{
+    m4 out = m;
+    out.m00 *= x;
+    out.m01 *= x;
+    out.m02 *= x;
+    return out;
+}
+
+MATHS_DEF m4 m4ScaleY(m4 m, float y)
+{
+    m4 out = m;
+    out.m10 *= y;
+    out.m11 *= y;
+    out.m12 *= y;
+    return out;
+}
+
+MATHS_DEF m4 m4ScaleZ(m4 m, float z)
+{
+    m4 out = m;
+    out.m20 *= z;
+    out.m21 *= z;
+    out.m22 *= z;
+    return out;
+}
+
+MATHS_DEF void m4ScaleInPlace(m4* m, v3 s)
+{
+    m->m00 *= s.x;
+    m->m01 *= s.x;
+    m->m02 *= s.x;
+    m->m10 *= s.y;
+    m->m11 *= s.y;
+    m->m12 *= s.y;
+    m->m20 *= s.z;
+    m->m21 *= s.z;
+    m->m22 *= s.z;
+}
+
+MATHS_DEF m4 m4Transform(m4 m, v3 t, v3 axis, float angle, v3 s)
+{
+    m4 trs = trsToM4((TRS){t, quatFromAxisAngle(axis, angle), s});
+    m4MulKernel(&m, &trs, &m);
+    return m;
+}
+
+MATHS_DEF m4 m4LookAt(v3 eye, v3 target, v3 up)
+{
+    v3 f = v3NormTo(v3Sub(target, eye));
+    v3 r = v3NormTo(v3Cross(f, up));
+    v3 u = v3Cross(r, f);
+
+    return (m4){
+        r.x           , u.x           , -f.x          , 0.0f,
+        r.y           , u.y           , -f.y          , 0.0f,
+        r.z           , u.z           , -f.z          , 0.0f,
+        -v3Dot(r, eye), -v3Dot(u, eye),  v3Dot(f, eye), 1.0f
+    };
+}
+
+MATHS_DEF m4 m4Perspective(float fov, float aspect, float near, float far)
+{
+    float fovRad = 1.0f / tanf(fov * DEG2RAD * 0.5f);
+    float nf = 1.0f / (near - far);
+
+    m4 out = {0};
+    out.m00 =  fovRad / aspect;
+    out.m11 =  fovRad;
+    out.m22 =  (near + far) * nf;
+    out.m23 = -1.0f;
+    out.m32 =  2.0f * near * far * nf;
+    return out;
+}
+
+MATHS_DEF m4 m4Frustum(float left, float right, float bottom, float top, float near, float far)
+{
+    float rl =  1.0f / (right - left);
+    float tb =  1.0f / (top   - bottom);
+    float fn = -1.0f / (far   - near);
+    float n2 =  2.0f * near;
+
+    m4 out = {0};
+    out.m00 = n2 * rl;
+    out.m11 = n2 * tb;
+    out.m20 = (right + left) * rl;
+    out.m21 = (top + bottom) * tb;
+    out.m22 = (far + near)   * fn;
+    out.m23 = -1.0f;
+    out.m32 = far * n2 * fn;
+    return out;
+}
+
+MATHS_DEF m4 m4Orthographic(float left, float right, float bottom, float top, float near, float far)
+{
+    float rl =  1.0f / (right - left);
+    float tb =  1.0f / (top   - bottom);
+    float fn = -1.0f / (far   - near);
+
+    m4 out = {0};
+    out.m00 =  2.0f * rl;
+    out.m11 =  2.0f * tb;
+    out.m22 =  2.0f * fn;
+    out.m30 = -(right + left) * rl;
+    out.m31 = -(top + bottom) * tb;
+    out.m32 =  (far + near)   * fn;
+    out.m33 =  1.0f;
+    return out;
+}
+
+//- - - - - - - - - - - - - - -
+
+// out may alias a or b: all of a is loaded up front and each column of b is
+// read before the matching column of out is written.
+static inline void m4MulKernel(const m4* a, const m4* b, m4* out)
+{
+    const float* pa = &a->m00;
+    const float* pb = &b->m00;
+    float* po = &out->m00;
+
+#if defined(MATHS_AVX2)
+    // Two output columns per iteration, one in each 128-bit lane
+    __m256 c0 = _mm256_broadcast_ps((const __m128*)(pa + 0));
+    __m256 c1 = _mm256_broadcast_ps((const __m128*)(pa + 4));
+    __m256 c2 = _mm256_broadcast_ps((const __m128*)(pa + 8));
+    __m256 c3 = _mm256_broadcast_ps((const __m128*)(pa + 12));
+
+    for (int j = 0; j < 16; j += 8)
+    {
+        __m256 col = _mm256_loadu_ps(pb + j);
+        __m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(col, 0x00));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_permute_ps(col, 0x55)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_permute_ps(col, 0xAA)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_permute_ps(col, 0xFF)));
+        _mm256_storeu_ps(po + j, r);
+    }
+#elif defined(MATHS_SSE2)
+    __m128 c0 = _mm_loadu_ps(pa + 0);
+    __m128 c1 = _mm_loadu_ps(pa + 4);
+    __m128 c2 = _mm_loadu_ps(pa + 8);
+    __m128 c3 = _mm_loadu_ps(pa + 12);
+
+    for (int j = 0; j < 16; j += 4)
+    {
+        __m128 col = _mm_loadu_ps(pb + j);
+        __m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(col, col, 0x00));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(col, col, 0x55)));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(col, col, 0xAA)));
+        r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(col, col, 0xFF)));
+        _mm_storeu_ps(po + j, r);
+    }
+#else
+    float ta[16];
+    for (int i = 0; i < 16; ++i)
+        ta[i] = pa[i];
+
+    for (int j = 0; j < 16; j += 4)
+    {
+        float x = pb[j + 0], y = pb[j + 1], z = pb[j + 2], w = pb[j + 3];
+
+        for (int r = 0; r < 4; ++r)
+            po[j + r] = ta[r] * x + ta[4 + r] * y + ta[8 + r] * z + ta[12 + r] * w;
+    }
+#endif // MATHS_AVX2
+}
+
+static inline void m4Mulv4Kernel(const m4* a, const v4* b, v4* out)
+{
+#ifdef MATHS_SSE2
+    const float* pa = &a->m00;
+
+    __m128 r = _mm_mul_ps(_mm_loadu_ps(pa + 0), _mm_set1_ps(b->x));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(pa + 4),  _mm_set1_ps(b->y)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(pa + 8),  _mm_set1_ps(b->z)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(pa + 12), _mm_set1_ps(b->w)));
+    _mm_storeu_ps(&out->x, r);
+#else
+    v4 v = *b;
+    *out = (v4) {
+        a->m00 * v.x + a->m10 * v.y + a->m20 * v.z + a->m30 * v.w,
+        a->m01 * v.x + a->m11 * v.y + a->m21 * v.z + a->m31 * v.w,
+        a->m02 * v.x + a->m12 * v.y + a->m22 * v.z + a->m32 * v.w,
+        a->m03 * v.x + a->m13 * v.y + a->m23 * v.z + a->m33 * v.w
+    };
+#endif // MATHS_SSE2
+}
+
+//-----------------------------
+// ~m4x3
+
+static inline void m4x3MulKernel(const m4x3* a, const m4x3* b, m4x3* out);
+
+MATHS_DEF m4x3 m4x3Identity(void)
+{
+    return (m4x3) {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f
+    };
+}
+
+MATHS_DEF m4x3 m4x3FromM4(m4 m)
+{
+    return (m4x3) {
+        m.m00, m.m10, m.m20, m.m30,
+        m.m01, m.m11, m.m21, m.m31,
+        m.m02, m.m12, m.m22, m.m32
+    };
+}
+
+MATHS_DEF m4 m4x3ToM4(m4x3 m)
+{
+    return (m4) {
+        m.m00, m.m01, m.m02, 0.0f,
+        m.m10, m.m11, m.m12, 0.0f,
+        m.m20, m.m21, m.m22, 0.0f,
+        m.m30, m.m31, m.m32, 1.0f
+    };
+}
+
+MATHS_DEF m4x3 m4x3Mul(m4x3 a, m4x3 b)
+{
+    m4x3 out;
+    m4x3MulKernel(&a, &b, &out);
+    return out;
+}
+
+MATHS_DEF void m4x3MulTo(m4x3* out, const m4x3* a, const m4x3* b)
+{
+    m4x3MulKernel(a, b, out);
+}
+
+// The rows of the inverse of the 3x3 part are the cross products of its
+// columns over the determinant, the translation is then -inverse * t.
+// A singular matrix gives infinities or NaNs.
+MATHS_DEF m4x3 m4x3Inverse(m4x3 m)
+{
+    v3 c0 = {m.m00, m.m01, m.m02};
+    v3 c1 = {m.m10, m.m11, m.m12};
+    v3 c2 = {m.m20, m.m21, m.m22};
+    v3 t  = {m.m30, m.m31, m.m32};
+
+    v3 r0 = v3Cross(c1, c2);
+    v3 r1 = v3Cross(c2, c0);
+    v3 r2 = v3Cross(c0, c1);
+
+    float inv = 1.0f / v3Dot(c0, r0);
+
+    r0 = v3Mulf(r0, inv);
+    r1 = v3Mulf(r1, inv);
+    r2 = v3Mulf(r2, inv);
+
+    return (m4x3) {
+        r0.x, r0.y, r0.z, -v3Dot(r0, t),
+        r1.x, r1.y, r1.z, -v3Dot(r1, t),
+        r2.x, r2.y, r2.z, -v3Dot(r2, t)
+    };
+}
+
+MATHS_DEF v3 m4x3MulPoint(m4x3 m, v3 p)
+{
+    return (v3) {
+        m.m00 * p.x + m.m10 * p.y + m.m20 * p.z + m.m30,
+        m.m01 * p.x + m.m11 * p.y + m.m21 * p.z + m.m31,
+        m.m02 * p.x + m.m12 * p.y + m.m22 * p.z + m.m32
+    };
+}
+
+MATHS_DEF v3 m4x3MulDirection(m4x3 m, v3 d)
+{
+    return (v3) {
+        m.m00 * d.x + m.m10 * d.y + m.m20 * d.z,
+        m.m01 * d.x + m.m11 * d.y + m.m21 * d.z,
+        m.m02 * d.x + m.m12 * d.y + m.m22 * d.z
+    };
+}
+
+MATHS_DEF m4x3 m4x3Translate(m4x3 m, v3 t)
+{
+    m.m30 += m.m00 * t.x + m.m10 * t.y + m.m20 * t.z;
+    m.m31 += m.m01 * t.x + m.m11 * t.y + m.m21 * t.z;
+    m.m32 += m.m02 * t.x + m.m12 * t.y + m.m22 * t.z;
+    return m;
+}
+
+MATHS_DEF m4x3 m4x3Rotate(m4x3 m, v3 axis, float angle)
+{
+    m4x3 rot = m4x3FromM4(m4Rotate(m4Identity(), axis, angle));
+    m4x3MulKernel(&m, &rot, &m);
+    return m;
+}
+
+MATHS_DEF m4x3 m4x3Scale(m4x3 m, v3 s)
+{
+    m.m00 *= s.x;
+    m.m01 *= s.x;
+    m.m02 *= s.x;
+    m.m10 *= s.y;
+    m.m11 *= s.y;
+    m.m12 *= s.y;
+    m.m20 *= s.z;
+    m.m21 *= s.z;
+    m.m22 *= s.z;
+    return m;
+}
+
+//- - - - - - - - - - - - - - -
+
+// Row i of the product is a(i, 0) * b.row0 + a(i, 1) * b.row1 +
+// a(i, 2) * b.row2 + (0, 0, 0, a(i, 3)). out may alias a or b.
+static inline void m4x3MulKernel(const m4x3* a, const m4x3* b, m4x3* out)
+{
+    const float* pa = &a->m00;
+    const float* pb = &b->m00;
+    float* po = &out->m00;
+
+#ifdef MATHS_SSE2
+    __m128 b0 = _mm_loadu_ps(pb + 0);
+    __m128 b1 = _mm_loadu_ps(pb + 4);
+    __m128 b2 = _mm_loadu_ps(pb + 8);
+    __m128 a0 = _mm_loadu_ps(pa + 0);
+    __m128 a1 = _mm_loadu_ps(pa + 4);
+    __m128 a2 = _mm_loadu_ps(pa + 8);
+    __m128 w  = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+
+    __m128 rows[3] = {a0, a1, a2};
+
+    for (int i = 0; i < 3; ++i)
+    {
+        __m128 row = rows[i];
+        __m128 r = _mm_mul_ps(_mm_shuffle_ps(row, row, 0x00), b0);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(row, row, 0x55), b1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(row, row, 0xAA), b2));
+        r = _mm_add_ps(r, _mm_and_ps(_mm_shuffle_ps(row, row, 0xFF), w));
+        _mm_storeu_ps(po + i * 4, r);
+    }
+#else
+    float ta[12], tb[12];
+    for (int i = 0; i < 12; ++i)
+    {
+        ta[i] = pa[i];
+        tb[i] = pb[i];
+    }
+
+    for (int i = 0; i < 12; i += 4)
+    {
+        for (int c = 0; c < 4; ++c)
+            po[i + c] = ta[i] * tb[c] + ta[i + 1] * tb[4 + c] + ta[i + 2] * tb[8 + c] + (c == 3 ? ta[i + 3] : 0.0f);
+    }
+#endif // MATHS_SSE2
+}
+
+#endif // MATHS_INLINE || MATHS_IMPLEMENTATION
+
 #endif // MODULE_MATHS_H
@@ -0,0 +1,541 @@
+#include "noise.h"
+#include "simd.h"
+
+//-----------------------------
+// ~Noise
+
+#define NOISE_PARALLEL 4096 // Samples, each one costs far more than a stream element
+
+// Output scales, measured so the largest values come close to 1 without
+// passing it. Anything that still does is clamped.
+#define NOISE_PERLIN2  0.66f
+#define NOISE_PERLIN3  1.0f
+#define NOISE_SIMPLEX2 45.0f
+#define NOISE_SIMPLEX3 76.0f
+
+#define NOISE_F2 0.36602540378f // (sqrt(3) - 1) / 2, skews the plane onto the square lattice
+#define NOISE_G2 0.21132486540f // (3 - sqrt(3)) / 6, unskews it
+#define NOISE_F3 (1.0f / 3.0f)
+#define NOISE_G3 (1.0f / 6.0f)
+
+typedef struct NoiseJob
+{
+    const Noise* noise;
+    const float* points; // 2 or 3 floats per point, NULL for grids
+    float* out;
+    uint width;
+    uint height;
+    v3 origin;
+    float step;
+} NoiseJob;
+
+static void noise2Range(void* data, uint begin, uint end);
+static void noise3Range(void* data, uint begin, uint end);
+static void noiseFill2Range(void* data, uint begin, uint end);
+static void noiseFill3Range(void* data, uint begin, uint end);
+static inline simdf noiseOctaves2(const Noise* noise, simdf x, simdf y);
+static inline simdf noiseOctaves3(const Noise* noise, simdf x, simdf y, simdf z);
+static inline simdf noisePerlin2(simdi seed, simdf x, simdf y);
+static inline simdf noisePerlin3(simdi seed, simdf x, simdf y, simdf z);
+static inline simdf noiseSimplex2(simdi seed, simdf x, simdf y);
+static inline simdf noiseSimplex3(simdi seed, simdf x, simdf y, simdf z);
+static inline simdf noiseValue2(simdi seed, simdf x, simdf y);
+static inline simdf noiseValue3(simdi seed, simdf x, simdf y, simdf z);
+static inline simdf noiseFloor(simdf x, simdi* cell);
+static inline simdf noiseFade(simdf t);
+static inline simdf noiseLerp(simdf a, simdf b, simdf t);
+static inline simdi noiseMix(simdi h, simdi v);
+static inline simdf noiseGrad2(simdi h, simdf x, simdf y);
+static inline simdf noiseGrad3(simdi h, simdf x, simdf y, simdf z);
+static inline simdf noiseRandom(simdi h);
+static inline simdf noiseBit(simdi h, int bit);
+static inline simdf noiseLoad(const float* points, uint stride, uint field, uint i, uint end);
+static inline void  noiseStore(float* out, simdf v, uint i, uint end);
+
+Noise noiseDefault(NoiseType type, uint seed)
+{
+    return (Noise){type, seed, 1, 1.0f, 2.0f, 0.5f};
+}
+
+// Every lane samples the same point, so single samples go through exactly
+// the same arithmetic as batches
+float noise2(const Noise* noise, v2 p)
+{
+    float lanes[SIMD_WIDTH];
+    simdStoreu(lanes, noiseOctaves2(noise, simdSet1(p.x), simdSet1(p.y)));
+    return lanes[0];
+}
+
+float noise3(const Noise* noise, v3 p)
+{
+    float lanes[SIMD_WIDTH];
+    simdStoreu(lanes, noiseOctaves3(noise, simdSet1(p.x), simdSet1(p.y), simdSet1(p.z)));
+    return lanes[0];
+}
+
+void noise2Batch(const Noise* noise, const v2* points, float* out, uint n)
+{
+    NoiseJob job = {noise, &points->x, out, 0, 0, {0.0f, 0.0f, 0.0f}, 0.0f};
+    parallelFor(n, NOISE_PARALLEL, noise2Range, &job);
+}
+
+void noise3Batch(const Noise* noise, const v3* points, float* out, uint n)
+{
+    NoiseJob job = {noise, &points->x, out, 0, 0, {0.0f, 0.0f, 0.0f}, 0.0f};
+    parallelFor(n, NOISE_PARALLEL, noise3Range, &job);
+}
+
+// Split by rows, every sample's position is computed from its own indices
+// so where the ranges fall doesn't change the values
+void noiseFill2(const Noise* noise, float* out, uint width, uint height, v2 origin, float step)
+{
+    if (!width)
+        return;
+
+    NoiseJob job = {noise, NULL, out, width, height, {origin.x, origin.y, 0.0f}, step};
+    parallelFor(height, MAX(NOISE_PARALLEL / width, 1), noiseFill2Range, &job);
+}
+
+void noiseFill3(const Noise* noise, float* out, uint width, uint height, uint depth, v3 origin, float step)
+{
+    if (!width)
+        return;
+
+    NoiseJob job = {noise, NULL, out, width, height, origin, step};
+    parallelFor(height * depth, MAX(NOISE_PARALLEL / width, 1), noiseFill3Range, &job);
+}
+
+//- - - - - - - - - - - - - - -
+
+static void noise2Range(void* data, uint begin, uint end)
+{
+    NoiseJob* job = data;
+
+    for (uint i = begin; i < end; i += SIMD_WIDTH)
+    {
+        simdf x = noiseLoad(job->points, 2, 0, i, end);
+        simdf y = noiseLoad(job->points, 2, 1, i, end);
+        noiseStore(job->out, noiseOctaves2(job->noise, x, y), i, end);
+    }
+}
+
+static void noise3Range(void* data, uint begin, uint end)
+{
+    NoiseJob* job = data;
+
+    for (uint i = begin; i < end; i += SIMD_WIDTH)
+    {
+        simdf x = noiseLoad(job->points, 3, 0, i, end);
+        simdf y = noiseLoad(job->points, 3, 1, i, end);
+        simdf z = noiseLoad(job->points, 3, 2, i, end);
+        noiseStore(job->out, noiseOctaves3(job->noise, x, y, z), i, end);
+    }
+}
+
+static void noiseFill2Range(void* data, uint begin, uint end)
+{
+    NoiseJob* job = data;
+
+    for (uint row = begin; row < end; ++row)
+    {
+        simdf y = simdSet1(job->origin.y + (float)row * job->step);
+        float* out = job->out + (size_t)row * job->width;
+
+        for (uint i = 0; i < job->width; i += SIMD_WIDTH)
+        {
+            float lanes[SIMD_WIDTH];
+            for (uint k = 0; k < SIMD_WIDTH; ++k)
+                lanes[k] = job->origin.x + (float)(i + k) * job->step;
+
+            noiseStore(out, noiseOctaves2(job->noise, simdLoadu(lanes), y), i, job->width);
+        }
+    }
+}
+
+static void noiseFill3Range(void* data, uint begin, uint end)
+{
+    NoiseJob* job = data;
+
+    for (uint row = begin; row < end; ++row)
+    {
+        simdf y = simdSet1(job->origin.y + (float)(row % job->height) * job->step);
+        simdf z = simdSet1(job->origin.z + (float)(row / job->height) * job->step);
+        float* out = job->out + (size_t)row * job->width;
+
+        for (uint i = 0; i < job->width; i += SIMD_WIDTH)
+        {
+            float lanes[SIMD_WIDTH];
+            for (uint k = 0; k < SIMD_WIDTH; ++k)
+                lanes[k] = job->origin.x + (float)(i + k) * job->step;
+
+            noiseStore(out, noiseOctaves3(job->noise, simdLoadu(lanes), y, z), i, job->width);
+        }
+    }
+}
+
+// Each octave gets its own seed so the layers don't line up at the origin
+static inline simdf noiseOctaves2(const Noise* noise, simdf x, simdf y)
+{
+    simdf sum = simdZero();
+    float amplitude = 1.0f, total = 0.0f, frequency = noise->frequency;
+    uint octaves = MAX(noise->octaves, 1);
+
+    for (uint o = 0; o < octaves; ++o)
+    {
+        simdi seed = simdiSet1((int32_t)(noise->seed + o));
+        simdf fx = simdMul(x, simdSet1(frequency));
+        simdf fy = simdMul(y, simdSet1(frequency));
+        simdf n;
+
+        switch (noise->type)
+        {
+            case NOISE_SIMPLEX: n = noiseSimplex2(seed, fx, fy); break;
+            case NOISE_VALUE:   n = noiseValue2(seed, fx, fy);   break;
+            default:            n = noisePerlin2(seed, fx, fy);  break;
+        }
+
+        sum = simdAdd(sum, simdMul(n, simdSet1(amplitude)));
+        total += amplitude;
+        amplitude *= noise->gain;
+        frequency *= noise->lacunarity;
+    }
+
+    sum = simdMul(sum, simdSet1(1.0f / total));
+    return simdMin(simdMax(sum, simdSet1(-1.0f)), simdSet1(1.0f));
+}
+
+static inline simdf noiseOctaves3(const Noise* noise, simdf x, simdf y, simdf z)
+{
+    simdf sum = simdZero();
+    float amplitude = 1.0f, total = 0.0f, frequency = noise->frequency;
+    uint octaves = MAX(noise->octaves, 1);
+
+    for (uint o = 0; o < octaves; ++o)
+    {
+        simdi seed = simdiSet1((int32_t)(noise->seed + o));
+        simdf fx = simdMul(x, simdSet1(frequency));
+        simdf fy = simdMul(y, simdSet1(frequency));
+        simdf fz = simdMul(z, simdSet1(frequency));
+        simdf n;
+
+        switch (noise->type)
+        {
+            case NOISE_SIMPLEX: n = noiseSimplex3(seed, fx, fy, fz); break;
+            case NOISE_VALUE:   n = noiseValue3(seed, fx, fy, fz);   break;
+            default:            n = noisePerlin3(seed, fx, fy, fz);  break;
+        }
+
+        sum = simdAdd(sum, simdMul(n, simdSet1(amplitude)));
+        total += amplitude;
+        amplitude *= noise->gain;
+        frequency *= noise->lacunarity;
+    }
+
+    sum = simdMul(sum, simdSet1(1.0f / total));
+    return simdMin(simdMax(sum, simdSet1(-1.0f)), simdSet1(1.0f));
+}
+
+static inline simdf noisePerlin2(simdi seed, simdf x, simdf y)
+{
+    simdi xi, yi;
+    simdf fx = simdSub(x, noiseFloor(x, &xi));
+    simdf fy = simdSub(y, noiseFloor(y, &yi));
+    simdf one = simdSet1(1.0f);
+    simdi next = simdiSet1(1);
+
+    simdi hx0 = noiseMix(seed, xi);
+    simdi hx1 = noiseMix(seed, simdiAdd(xi, next));
+    simdi yi1 = simdiAdd(yi, next);
+
+    simdf g00 = noiseGrad2(noiseMix(hx0, yi), fx, fy);
+    simdf g10 = noiseGrad2(noiseMix(hx1, yi), simdSub(fx, one), fy);
+    simdf g01 = noiseGrad2(noiseMix(hx0, yi1), fx, simdSub(fy, one));
+    simdf g11 = noiseGrad2(noiseMix(hx1, yi1), simdSub(fx, one), simdSub(fy, one));
+
+    simdf u = noiseFade(fx);
+    simdf n = noiseLerp(noiseLerp(g00, g10, u), noiseLerp(g01, g11, u), noiseFade(fy));
+    return simdMul(n, simdSet1(NOISE_PERLIN2));
+}
+
+static inline simdf noisePerlin3(simdi seed, simdf x, simdf y, simdf z)
+{
+    simdi xi, yi, zi;
+    simdf fx = simdSub(x, noiseFloor(x, &xi));
+    simdf fy = simdSub(y, noiseFloor(y, &yi));
+    simdf fz = simdSub(z, noiseFloor(z, &zi));
+    simdf one = simdSet1(1.0f);
+    simdi next = simdiSet1(1);
+
+    simdf gx[2] = {fx, simdSub(fx, one)};
+    simdf gy[2] = {fy, simdSub(fy, one)};
+    simdf gz[2] = {fz, simdSub(fz, one)};
+    simdi hx[2] = {noiseMix(seed, xi), noiseMix(seed, simdiAdd(xi, next))};
+    simdi cy[2] = {yi, simdiAdd(yi, next)};
+    simdi cz[2] = {zi, simdiAdd(zi, next)};
+    simdf g[8];
+
+    for (uint c = 0; c < 4; ++c)
+    {
+        uint dx = c & 1, dy = c >> 1;
+        simdi h = noiseMix(hx[dx], cy[dy]);
+        g[c] = noiseGrad3(noiseMix(h, cz[0]), gx[dx], gy[dy], gz[0]);
+        g[c + 4] = noiseGrad3(noiseMix(h, cz[1]), gx[dx], gy[dy], gz[1]);
+    }
+
+    simdf u = noiseFade(fx), v = noiseFade(fy);
+    simdf n0 = noiseLerp(noiseLerp(g[0], g[1], u), noiseLerp(g[2], g[3], u), v);
+    simdf n1 = noiseLerp(noiseLerp(g[4], g[5], u), noiseLerp(g[6], g[7], u), v);
+    return simdMul(noiseLerp(n0, n1, noiseFade(fz)), simdSet1(NOISE_PERLIN3));
+}
+
+// The plane is skewed so the triangles become half squares, the lane's
+// triangle is picked by comparing its offsets and each of the 3 corners
+// adds (0.5 - d^2)^4 times its gradient
+static inline simdf noiseSimplex2(simdi seed, simdf x, simdf y)
+{
+    simdf zero = simdZero(), one = simdSet1(1.0f), half = simdSet1(0.5f), g2 = simdSet1(NOISE_G2);
+    simdi next = simdiSet1(1);
+
+    simdf s = simdMul(simdAdd(x, y), simdSet1(NOISE_F2));
+    simdi i, j;
+    simdf fi = noiseFloor(simdAdd(x, s), &i);
+    simdf fj = noiseFloor(simdAdd(y, s), &j);
+    simdf t = simdMul(simdAdd(fi, fj), g2);
+
+    simdf x0 = simdSub(x, simdSub(fi, t));
+    simdf y0 = simdSub(y, simdSub(fj, t));
+
+    simdf lower = simdCmpGt(x0, y0);
+    simdf i1 = simdAnd(lower, one);
+    simdf j1 = simdAndNot(lower, one);
+
+    simdf cx[3] = {x0, simdAdd(simdSub(x0, i1), g2), simdAdd(simdSub(x0, one), simdAdd(g2, g2))};
+    simdf cy[3] = {y0, simdAdd(simdSub(y0, j1), g2), simdAdd(simdSub(y0, one), simdAdd(g2, g2))};
+    simdi ci[3] = {i, simdiAdd(i, simdCast(simdAnd(lower, simdiCast(next)))), simdiAdd(i, next)};
+    simdi cj[3] = {j, simdiAdd(j, simdCast(simdAndNot(lower, simdiCast(next)))), simdiAdd(j, next)};
+
+    simdf n = zero;
+    for (uint c = 0; c < 3; ++c)
+    {
+        simdf r = simdSub(simdSub(half, simdMul(cx[c], cx[c])), simdMul(cy[c], cy[c]));
+        simdf r2 = simdMul(r, r);
+        simdf g = noiseGrad2(noiseMix(noiseMix(seed, ci[c]), cj[c]), cx[c], cy[c]);
+        n = simdAdd(n, simdAnd(simdCmpGt(r, zero), simdMul(simdMul(r2, r2), g)));
+    }
+
+    return simdMul(n, simdSet1(NOISE_SIMPLEX2));
+}
+
+// Same in 3D, the corners of the lane's tetrahedron step along the axes in
+// the order of its largest offsets first
+static inline simdf noiseSimplex3(simdi seed, simdf x, simdf y, simdf z)
+{
+    simdf zero = simdZero(), one = simdSet1(1.0f), half = simdSet1(0.5f), g3 = simdSet1(NOISE_G3);
+    simdf all = simdCmpGe(zero, zero);
+    simdf nextf = simdiCast(simdiSet1(1));
+
+    simdf s = simdMul(simdAdd(simdAdd(x, y), z), simdSet1(NOISE_F3));
+    simdi i, j, k;
+    simdf fi = noiseFloor(simdAdd(x, s), &i);
+    simdf fj = noiseFloor(simdAdd(y, s), &j);
+    simdf fk = noiseFloor(simdAdd(z, s), &k);
+    simdf t = simdMul(simdAdd(simdAdd(fi, fj), fk), g3);
+
+    simdf x0 = simdSub(x, simdSub(fi, t));
+    simdf y0 = simdSub(y, simdSub(fj, t));
+    simdf z0 = simdSub(z, simdSub(fk, t));
+
+    // First step along the largest offset, the second along all but the
+    // smallest. Ties go to x over y over z, so exactly one axis is picked
+    // as the largest and one as the smallest even when offsets are equal.
+    simdf xy = simdCmpGe(x0, y0), yz = simdCmpGe(y0, z0), xz = simdCmpGe(x0, z0);
+    simdf m1[3] = {simdAnd(xy, xz), simdAndNot(xy, yz), simdAndNot(xz, simdXor(yz, all))};
+    simdf m2[3] = {simdOr(xy, xz), simdOr(simdXor(xy, all), yz), simdXor(simdAnd(xz, yz), all)};
+
+    simdf cx[4], cy[4], cz[4];
+    simdi ci[4], cj[4], ck[4];
+
+    cx[0] = x0;
+    cy[0] = y0;
+    cz[0] = z0;
+    ci[0] = i;
+    cj[0] = j;
+    ck[0] = k;
+
+    for (uint c = 1; c < 3; ++c)
+    {
+        const simdf* m = c == 1 ? m1 : m2;
+        simdf offset = simdMul(simdSet1((float)c), g3);
+
+        cx[c] = simdAdd(simdSub(x0, simdAnd(m[0], one)), offset);
+        cy[c] = simdAdd(simdSub(y0, simdAnd(m[1], one)), offset);
+        cz[c] = simdAdd(simdSub(z0, simdAnd(m[2], one)), offset);
+        ci[c] = simdiAdd(i, simdCast(simdAnd(m[0], nextf)));
+        cj[c] = simdiAdd(j, simdCast(simdAnd(m[1], nextf)));
+        ck[c] = simdiAdd(k, simdCast(simdAnd(m[2], nextf)));
+    }
+
+    simdf last = simdSub(simdMul(simdSet1(3.0f), g3), one);
+    cx[3] = simdAdd(x0, last);
+    cy[3] = simdAdd(y0, last);
+    cz[3] = simdAdd(z0, last);
+    ci[3] = simdiAdd(i, simdiSet1(1));
+    cj[3] = simdiAdd(j, simdiSet1(1));
+    ck[3] = simdiAdd(k, simdiSet1(1));
+
+    simdf n = zero;
+    for (uint c = 0; c < 4; ++c)
+    {
+        simdf r = simdSub(simdSub(simdSub(half, simdMul(cx[c], cx[c])), simdMul(cy[c], cy[c])), simdMul(cz[c], cz[c]));
+        simdf r2 = simdMul(r, r);
+        simdi h = noiseMix(noiseMix(noiseMix(seed, ci[c]), cj[c]), ck[c]);
+        simdf g = noiseGrad3(h, cx[c], cy[c], cz[c]);
+        n = simdAdd(n, simdAnd(simdCmpGt(r, zero), simdMul(simdMul(r2, r2), g)));
+    }
+
+    return simdMul(n, simdSet1(NOISE_SIMPLEX3));
+}
+
+static inline simdf noiseValue2(simdi seed, simdf x, simdf y)
+{
+    simdi xi, yi;
+    simdf fx = simdSub(x, noiseFloor(x, &xi));
+    simdf fy = simdSub(y, noiseFloor(y, &yi));
+    simdi next = simdiSet1(1);
+
+    simdi hx0 = noiseMix(seed, xi);
+    simdi hx1 = noiseMix(seed, simdiAdd(xi, next));
+    simdi yi1 = simdiAdd(yi, next);
+
+    simdf v00 = noiseRandom(noiseMix(hx0, yi));
+    simdf v10 = noiseRandom(noiseMix(hx1, yi));
+    simdf v01 = noiseRandom(noiseMix(hx0, yi1));
+    simdf v11 = noiseRandom(noiseMix(hx1, yi1));
+
+    simdf u = noiseFade(fx);
+    return noiseLerp(noiseLerp(v00, v10, u), noiseLerp(v01, v11, u), noiseFade(fy));
+}
+
+static inline simdf noiseValue3(simdi seed, simdf x, simdf y, simdf z)
+{
+    simdi xi, yi, zi;
+    simdf fx = simdSub(x, noiseFloor(x, &xi));
+    simdf fy = simdSub(y, noiseFloor(y, &yi));
+    simdf fz = simdSub(z, noiseFloor(z, &zi));
+    simdi next = simdiSet1(1);
+
+    simdi hx[2] = {noiseMix(seed, xi), noiseMix(seed, simdiAdd(xi, next))};
+    simdi cy[2] = {yi, simdiAdd(yi, next)};
+    simdi cz[2] = {zi, simdiAdd(zi, next)};
+    simdf v[8];
+
+    for (uint c = 0; c < 4; ++c)
+    {
+        simdi h = noiseMix(hx[c & 1], cy[c >> 1]);
+        v[c] = noiseRandom(noiseMix(h, cz[0]));
+        v[c + 4] = noiseRandom(noiseMix(h, cz[1]));
+    }
+
+    simdf u = noiseFade(fx), w = noiseFade(fy);
+    simdf n0 = noiseLerp(noiseLerp(v[0], v[1], u), noiseLerp(v[2], v[3], u), w);
+    simdf n1 = noiseLerp(noiseLerp(v[4], v[5], u), noiseLerp(v[6], v[7], u), w);
+    return noiseLerp(n0, n1, noiseFade(fz));
+}
+
+// simd.h only rounds to nearest, one less where that went up
+static inline simdf noiseFloor(simdf x, simdi* cell)
+{
+    simdf r = simdiToFloat(simdiRound(x));
+    r = simdSub(r, simdAnd(simdCmpGt(r, x), simdSet1(1.0f)));
+    *cell = simdiRound(r);
+    return r;
+}
+
+// 6t^5 - 15t^4 + 10t^3, flat first and second derivatives at 0 and 1
+static inline simdf noiseFade(simdf t)
+{
+    simdf p = simdAdd(simdMul(t, simdSub(simdMul(t, simdSet1(6.0f)), simdSet1(15.0f))), simdSet1(10.0f));
+    return simdMul(simdMul(simdMul(t, t), t), p);
+}
+
+static inline simdf noiseLerp(simdf a, simdf b, simdf t)
+{
+    return simdAdd(a, simdMul(simdSub(b, a), t));
+}
+
+// Adds the next coordinate and scrambles, Thomas Wang's shift only 32 bit
+// hash since SSE2 has no 32 bit multiply. Each coordinate gets the full
+// avalanche so neighbouring cells are unrelated along every axis.
+static inline simdi noiseMix(simdi h, simdi v)
+{
+    h = simdiAdd(h, v);
+    h = simdiAdd(simdiXor(h, simdiSet1(-1)), simdiShl(h, 15));
+    h = simdiXor(h, simdiShr(h, 12));
+    h = simdiAdd(h, simdiShl(h, 2));
+    h = simdiXor(h, simdiShr(h, 4));
+    h = simdiAdd(simdiAdd(h, simdiShl(h, 3)), simdiShl(h, 11)); // h * 2057
+    return simdiXor(h, simdiShr(h, 16));
+}
+
+// Dot product with one of (+-1, +-2) and (+-2, +-1) picked by the top 3
+// bits
+static inline simdf noiseGrad2(simdi h, simdf x, simdf y)
+{
+    simdf swap = noiseBit(h, 29);
+    simdf u = simdSelect(swap, y, x);
+    simdf v = simdSelect(swap, x, y);
+    simdf sign = simdSet1(-0.0f);
+
+    u = simdXor(u, simdAnd(noiseBit(h, 30), sign));
+    v = simdXor(simdAdd(v, v), simdAnd(noiseBit(h, 31), sign));
+    return simdAdd(u, v);
+}
+
+// Dot product with one of the 12 cube edge directions picked by the top 4
+// bits, 4 of them twice, the lowest two of those also pick the signs
+static inline simdf noiseGrad3(simdi h, simdf x, simdf y, simdf z)
+{
+    simdi top = simdiShr(h, 28);
+    simdf index = simdiToFloat(top);
+    simdf u = simdSelect(simdCmpLt(index, simdSet1(8.0f)), x, y);
+    simdf xz = simdSelect(simdOr(simdiCmpEq(top, simdiSet1(12)), simdiCmpEq(top, simdiSet1(14))), x, z);
+    simdf v = simdSelect(simdCmpLt(index, simdSet1(4.0f)), y, xz);
+    simdf sign = simdSet1(-0.0f);
+
+    u = simdXor(u, simdAnd(noiseBit(h, 28), sign));
+    v = simdXor(v, simdAnd(noiseBit(h, 29), sign));
+    return simdAdd(u, v);
+}
+
+// [-1, 1] from the top 24 bits, which convert to float exactly
+static inline simdf noiseRandom(simdi h)
+{
+    simdf r = simdiToFloat(simdiShr(h, 8));
+    return simdSub(simdMul(r, simdSet1(2.0f / 16777215.0f)), simdSet1(1.0f));
+}
+
+// Mask of the lanes with the bit set
+static inline simdf noiseBit(simdi h, int bit)
+{
+    simdi one = simdiSet1(1);
+    return simdiCmpEq(simdiAnd(simdiShr(h, bit), one), one);
+}
+
+static inline simdf noiseLoad(const float* points, uint stride, uint field, uint i, uint end)
+{
+    float lane[SIMD_WIDTH];
+
+    for (uint k = 0; k < SIMD_WIDTH; ++k)
+        lane[k] = points[(size_t)MIN(i + k, end - 1) * stride + field];
+
+    return simdLoadu(lane);
+}
+
+static inline void noiseStore(float* out, simdf v, uint i, uint end)
+{
+    float lane[SIMD_WIDTH];
+    simdStoreu(lane, v);
+
+    for (uint k = 0; k < SIMD_WIDTH && i + k < end; ++k)
+        out[i + k] = lane[k];
+}
@@ -0,0 +1,62 @@
+#ifndef MODULE_NOISE_H
+#define MODULE_NOISE_H
+
+#include "maths.h"
+
+//-------------------------------------------------------------
+// Definitions
+//-------------------------------------------------------------
+
+// Lattice noise for heightmaps and textures. The lattice is hashed instead
+// of read from a permutation table, so any seed works and the pattern doesn't
+// repeat while the lattice coordinates, position times the frequency of the
+// highest octave, stay within +-2^31. Cells are 32-bit integers and overflow
+// past that. Well before it, from 2^24, floats have no fraction left and the
+// noise turns blocky. Results only depend on the Noise and the sample position:
+// single samples, batches and grids filled on any number of threads all
+// agree bit for bit.
+
+typedef enum NoiseType
+{
+    NOISE_PERLIN,  // Gradient noise on a square / cube lattice
+    NOISE_SIMPLEX, // Gradient noise on a simplex lattice, fewer axis aligned artifacts
+    NOISE_VALUE,   // Smoothly interpolated random values, cheapest and blurriest
+} NoiseType;
+
+// octaves above 1 sum that many layers of fractal Brownian motion, each one
+// at lacunarity times the frequency and gain times the amplitude of the one
+// before. The sum is divided by the total amplitude so every setting stays
+// within [-1, 1].
+typedef struct Noise
+{
+    NoiseType type;
+    uint      seed;
+    uint      octaves;
+    float     frequency;  // Lattice cells per unit for the first octave
+    float     lacunarity; // Usually 2
+    float     gain;       // Usually 0.5
+} Noise;
+
+//-------------------------------------------------------------
+// Prototypes
+//-------------------------------------------------------------
+
+//-----------------------------
+// ~Noise
+
+Noise noiseDefault(NoiseType type, uint seed); // One octave at frequency 1, lacunarity 2 and gain 0.5
+
+float noise2(const Noise* noise, v2 p);
+float noise3(const Noise* noise, v3 p);
+
+// One value per point, SIMD_WIDTH points at a time and large batches on
+// several threads
+void  noise2Batch(const Noise* noise, const v2* points, float* out, uint n);
+void  noise3Batch(const Noise* noise, const v3* points, float* out, uint n);
+
+// Fills a width * height grid, row after row, sampled at origin + (x, y) *
+// step. The 3D version fills depth such grids one after the other.
+void  noiseFill2(const Noise* noise, float* out, uint width, uint height, v2 origin, float step);
+void  noiseFill3(const Noise* noise, float* out, uint width, uint height, uint depth, v3 origin, float step);
+
+#endif // MODULE_NOISE_H
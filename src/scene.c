@@ -0,0 +1,377 @@
+#include "scene.h"
+
+#include <stdlib.h> // calloc, realloc, free, qsort
+#include <string.h> // memmove
+
+//-----------------------------
+// ~Hierarchy
+
+#define HIERARCHY_GROW  64  // First node and id capacity, doubled after that
+#define HIERARCHY_GRAIN 256 // Smallest subtree handed to a thread on its own
+#define HIERARCHY_TASKS 8   // Tasks per thread, spare ones even out uneven subtrees
+#define HIERARCHY_SCAN  32  // Dirty nodes are found by scanning once more than 1 / 32 changed
+
+typedef struct HierarchyJob
+{
+    Hierarchy* h;
+    uint taskCount;
+} HierarchyJob;
+
+static bool hierarchyGrow(void* array, uint count, size_t size);
+static bool hierarchyReserve(Hierarchy* h);
+static bool hierarchyReserveIds(Hierarchy* h);
+static void hierarchyMove(Hierarchy* h, uint dst, uint src, uint n);
+static void hierarchyTouch(Hierarchy* h, uint index);
+static void hierarchyUpdateRange(Hierarchy* h, uint first, uint last);
+static void hierarchyTaskRange(void* data, uint begin, uint end);
+static int  hierarchyCompareIndex(const void* a, const void* b);
+
+Hierarchy* hierarchyCreate(void)
+{
+    Hierarchy* h = calloc(1, sizeof *h);
+
+    if (!h)
+        return NULL;
+
+    h->freeList = HIERARCHY_NULL;
+    return h;
+}
+
+void hierarchyDestroy(Hierarchy* h)
+{
+    if (!h)
+        return;
+
+    free(h->parents);
+    free(h->ends);
+    free(h->ids);
+    free(h->locals);
+    free(h->worlds);
+    free(h->dirty);
+    free(h->slots);
+    free(h->dirtyIds);
+    free(h->tasks);
+    free(h->taskStart);
+    free(h);
+}
+
+// The node goes right after its parent's subtree, so only the nodes after
+// that shift and only its ancestors' ranges grow
+uint hierarchyAdd(Hierarchy* h, uint parent, v3 translation, quat rotation, v3 scale)
+{
+    if (h->count == h->capacity && !hierarchyReserve(h))
+        return HIERARCHY_NULL;
+
+    if (h->freeList == HIERARCHY_NULL && !hierarchyReserveIds(h))
+        return HIERARCHY_NULL;
+
+    uint p  = parent == HIERARCHY_NULL ? HIERARCHY_NULL : h->slots[parent];
+    uint at = p == HIERARCHY_NULL ? h->count : h->ends[p];
+
+    if (at < h->count)
+    {
+        hierarchyMove(h, at + 1, at, h->count - at);
+
+        for (uint i = at + 1; i <= h->count; ++i)
+        {
+            if (h->parents[i] != HIERARCHY_NULL && h->parents[i] >= at)
+                h->parents[i]++;
+
+            h->ends[i]++;
+            h->slots[h->ids[i]] = i;
+        }
+    }
+
+    for (uint a = p; a != HIERARCHY_NULL; a = h->parents[a])
+        h->ends[a]++;
+
+    uint id = h->freeList;
+    h->freeList = h->slots[id];
+    h->slots[id] = at;
+
+    h->parents[at] = p;
+    h->ends[at]    = at + 1;
+    h->ids[at]     = id;
+    h->locals[at]  = (TRS){translation, rotation, scale};
+    h->dirty[at]   = 0;
+    h->count++;
+
+    hierarchyTouch(h, at);
+    return id;
+}
+
+void hierarchyRemove(Hierarchy* h, uint node)
+{
+    uint at  = h->slots[node];
+    uint end = h->ends[at];
+    uint n   = end - at;
+
+    uint kept = 0;
+    for (uint i = 0; i < h->dirtyCount; ++i)
+    {
+        uint index = h->slots[h->dirtyIds[i]];
+        if (index < at || index >= end)
+            h->dirtyIds[kept++] = h->dirtyIds[i];
+    }
+    h->dirtyCount = kept;
+
+    for (uint i = at; i < end; ++i)
+    {
+        h->slots[h->ids[i]] = h->freeList;
+        h->freeList = h->ids[i];
+    }
+
+    for (uint a = h->parents[at]; a != HIERARCHY_NULL; a = h->parents[a])
+        h->ends[a] -= n;
+
+    hierarchyMove(h, at, end, h->count - end);
+    h->count -= n;
+
+    for (uint i = at; i < h->count; ++i)
+    {
+        if (h->parents[i] != HIERARCHY_NULL && h->parents[i] >= end)
+            h->parents[i] -= n;
+
+        h->ends[i] -= n;
+        h->slots[h->ids[i]] = i;
+    }
+}
+
+void hierarchySetLocal(Hierarchy* h, uint node, v3 translation, quat rotation, v3 scale)
+{
+    uint i = h->slots[node];
+    h->locals[i] = (TRS){translation, rotation, scale};
+    hierarchyTouch(h, i);
+}
+
+void hierarchySetTranslation(Hierarchy* h, uint node, v3 translation)
+{
+    uint i = h->slots[node];
+    h->locals[i].translation = translation;
+    hierarchyTouch(h, i);
+}
+
+void hierarchySetRotation(Hierarchy* h, uint node, quat rotation)
+{
+    uint i = h->slots[node];
+    h->locals[i].rotation = rotation;
+    hierarchyTouch(h, i);
+}
+
+void hierarchySetScale(Hierarchy* h, uint node, v3 scale)
+{
+    uint i = h->slots[node];
+    h->locals[i].scale = scale;
+    hierarchyTouch(h, i);
+}
+
+uint hierarchyParent(const Hierarchy* h, uint node)
+{
+    uint p = h->parents[h->slots[node]];
+    return p == HIERARCHY_NULL ? HIERARCHY_NULL : h->ids[p];
+}
+
+m4x3 hierarchyWorld(const Hierarchy* h, uint node)
+{
+    return h->worlds[h->slots[node]];
+}
+
+// Sorting the dirty indices lets every dirty node below another one fold
+// into its ancestor's range, leaving disjoint subtrees. Small updates walk
+// those in order. Large ones are cut into tasks of at most grain nodes: a
+// subtree bigger than that has its root updated here and its children
+// considered in turn, so a task only ever reads parents that are already
+// done or inside the task itself.
+void hierarchyUpdate(Hierarchy* h)
+{
+    uint* roots = h->dirtyIds;
+    uint rootCount = 0, covered = 0, total = 0;
+
+    if (!h->dirtyCount)
+        return;
+
+    // Past a few percent a scan of the flags is cheaper than the sort
+    if (h->dirtyCount > h->count / HIERARCHY_SCAN)
+    {
+        uint n = 0;
+        for (uint i = 0; i < h->count; ++i)
+        {
+            if (h->dirty[i])
+            {
+                roots[n++] = i;
+                h->dirty[i] = 0;
+            }
+        }
+    }
+    else
+    {
+        for (uint i = 0; i < h->dirtyCount; ++i)
+        {
+            roots[i] = h->slots[roots[i]];
+            h->dirty[roots[i]] = 0;
+        }
+
+        qsort(roots, h->dirtyCount, sizeof *roots, hierarchyCompareIndex);
+    }
+
+    for (uint i = 0; i < h->dirtyCount; ++i)
+    {
+        if (roots[i] < covered)
+            continue;
+
+        covered = h->ends[roots[i]];
+        total += covered - roots[i];
+        roots[rootCount++] = roots[i];
+    }
+
+    h->dirtyCount = 0;
+
+    uint threads = parallelThreadCount();
+
+    if (total < parallelThreshold() || threads < 2)
+    {
+        for (uint r = 0; r < rootCount; ++r)
+            hierarchyUpdateRange(h, roots[r], h->ends[roots[r]]);
+
+        return;
+    }
+
+    uint grain = MAX(total / (threads * HIERARCHY_TASKS), HIERARCHY_GRAIN);
+    uint taskCount = 0, offset = 0;
+
+    for (uint r = 0; r < rootCount; ++r)
+    {
+        uint i = roots[r], last = h->ends[i];
+
+        while (i < last)
+        {
+            if (h->ends[i] - i > grain)
+            {
+                hierarchyUpdateRange(h, i, i + 1);
+                ++i;
+                continue;
+            }
+
+            h->tasks[taskCount] = i;
+            h->taskStart[taskCount++] = offset;
+            offset += h->ends[i] - i;
+            i = h->ends[i];
+        }
+    }
+
+    h->taskStart[taskCount] = offset;
+
+    HierarchyJob job = {h, taskCount};
+    parallelFor(offset, 0, hierarchyTaskRange, &job);
+}
+
+//- - - - - - - - - - - - - - -
+
+static bool hierarchyGrow(void* array, uint count, size_t size)
+{
+    void** p = array;
+    void* grown = realloc(*p, count * size);
+
+    if (!grown)
+        return 0;
+
+    *p = grown;
+    return 1;
+}
+
+static bool hierarchyReserve(Hierarchy* h)
+{
+    uint capacity = h->capacity ? h->capacity * 2 : HIERARCHY_GROW;
+
+    if (!hierarchyGrow(&h->parents, capacity, sizeof *h->parents) ||
+        !hierarchyGrow(&h->ends, capacity, sizeof *h->ends) ||
+        !hierarchyGrow(&h->ids, capacity, sizeof *h->ids) ||
+        !hierarchyGrow(&h->locals, capacity, sizeof *h->locals) ||
+        !hierarchyGrow(&h->worlds, capacity, sizeof *h->worlds) ||
+        !hierarchyGrow(&h->dirty, capacity, sizeof *h->dirty) ||
+        !hierarchyGrow(&h->tasks, capacity, sizeof *h->tasks) ||
+        !hierarchyGrow(&h->taskStart, capacity + 1, sizeof *h->taskStart))
+        return 0;
+
+    h->capacity = capacity;
+    return 1;
+}
+
+// dirtyIds holds each live id at most once, so it grows with the ids
+static bool hierarchyReserveIds(Hierarchy* h)
+{
+    uint capacity = h->idCapacity ? h->idCapacity * 2 : HIERARCHY_GROW;
+
+    if (!hierarchyGrow(&h->slots, capacity, sizeof *h->slots) ||
+        !hierarchyGrow(&h->dirtyIds, capacity, sizeof *h->dirtyIds))
+        return 0;
+
+    for (uint i = h->idCapacity; i < capacity; ++i)
+        h->slots[i] = i + 1 < capacity ? i + 1 : HIERARCHY_NULL;
+
+    h->freeList   = h->idCapacity;
+    h->idCapacity = capacity;
+    return 1;
+}
+
+// Moves n nodes in every per index array, the links are fixed by the caller
+static void hierarchyMove(Hierarchy* h, uint dst, uint src, uint n)
+{
+    memmove(&h->parents[dst], &h->parents[src], n * sizeof *h->parents);
+    memmove(&h->ends[dst], &h->ends[src], n * sizeof *h->ends);
+    memmove(&h->ids[dst], &h->ids[src], n * sizeof *h->ids);
+    memmove(&h->locals[dst], &h->locals[src], n * sizeof *h->locals);
+    memmove(&h->worlds[dst], &h->worlds[src], n * sizeof *h->worlds);
+    memmove(&h->dirty[dst], &h->dirty[src], n * sizeof *h->dirty);
+}
+
+static void hierarchyTouch(Hierarchy* h, uint index)
+{
+    if (h->dirty[index])
+        return;
+
+    h->dirty[index] = 1;
+    h->dirtyIds[h->dirtyCount++] = h->ids[index];
+}
+
+// Parents come first, so each one is final by the time its children read it
+static void hierarchyUpdateRange(Hierarchy* h, uint first, uint last)
+{
+    for (uint i = first; i < last; ++i)
+    {
+        m4x3 local = trsToM4x3(h->locals[i]);
+        uint p = h->parents[i];
+
+        if (p == HIERARCHY_NULL)
+            h->worlds[i] = local;
+        else
+            m4x3MulTo(&h->worlds[i], &h->worlds[p], &local);
+    }
+}
+
+// [begin, end) counts nodes across the tasks, each task is run by the range
+// holding its first node
+static void hierarchyTaskRange(void* data, uint begin, uint end)
+{
+    HierarchyJob* job = data;
+    Hierarchy* h = job->h;
+
+    uint lo = 0, hi = job->taskCount;
+    while (lo < hi)
+    {
+        uint mid = (lo + hi) / 2;
+        if (h->taskStart[mid] < begin)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (uint t = lo; t < job->taskCount && h->taskStart[t] < end; ++t)
+        hierarchyUpdateRange(h, h->tasks[t], h->ends[h->tasks[t]]);
+}
+
+static int hierarchyCompareIndex(const void* a, const void* b)
+{
+    uint x = *(const uint*)a, y = *(const uint*)b;
+    return (x > y) - (x < y);
+}
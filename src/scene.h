@@ -0,0 +1,74 @@
+#ifndef MODULE_SCENE_H
+#define MODULE_SCENE_H
+
+#include "maths.h"
+
+//-------------------------------------------------------------
+// Definitions
+//-------------------------------------------------------------
+
+// Transform hierarchy stored depth first: every node is followed by its
+// whole subtree, so parents come before their children and a subtree is the
+// index range [i, ends[i]). Local transforms are stored as TRS in that order
+// and an update walks only the subtrees under nodes that changed.
+//
+// Node ids stay valid until the node is removed, slots maps them to the
+// current index. Indices shift when a node is added anywhere but at the end,
+// adding parents before children and each subtree in one go never shifts.
+
+#define HIERARCHY_NULL 0xffffffffu
+
+typedef struct Hierarchy
+{
+    uint  count;
+    uint  capacity;
+
+    // Per index
+    uint* parents;      // Index of the parent, HIERARCHY_NULL for roots
+    uint* ends;         // One past the last index of the subtree
+    uint* ids;
+    TRS*  locals;
+    m4x3* worlds;       // Parent's world * local, valid after hierarchyUpdate
+    bool* dirty;        // Local changed since the last update
+
+    // Per id
+    uint* slots;        // Index of each id, next free id while free
+    uint* dirtyIds;     // Ids of the dirty nodes in the order they changed
+    uint  dirtyCount;
+    uint  idCapacity;
+    uint  freeList;
+
+    // Update scratch, sized with the node arrays so updates never allocate
+    uint* tasks;
+    uint* taskStart;
+} Hierarchy;
+
+//-------------------------------------------------------------
+// Prototypes
+//-------------------------------------------------------------
+
+//-----------------------------
+// ~Hierarchy
+
+Hierarchy* hierarchyCreate(void);
+void       hierarchyDestroy(Hierarchy* h);
+
+// Adds a node as the last child of parent, or as a root when parent is
+// HIERARCHY_NULL. Returns its id, HIERARCHY_NULL if out of memory.
+uint       hierarchyAdd(Hierarchy* h, uint parent, v3 translation, quat rotation, v3 scale);
+void       hierarchyRemove(Hierarchy* h, uint node); // Removes the whole subtree
+
+void       hierarchySetLocal(Hierarchy* h, uint node, v3 translation, quat rotation, v3 scale);
+void       hierarchySetTranslation(Hierarchy* h, uint node, v3 translation);
+void       hierarchySetRotation(Hierarchy* h, uint node, quat rotation);
+void       hierarchySetScale(Hierarchy* h, uint node, v3 scale);
+
+uint       hierarchyParent(const Hierarchy* h, uint node); // HIERARCHY_NULL for roots
+m4x3       hierarchyWorld(const Hierarchy* h, uint node);
+
+// Recomputes the world transforms of the dirty nodes and everything below
+// them in one pass over their index ranges. Large updates are split by
+// subtree across threads, the results don't depend on the thread count.
+void       hierarchyUpdate(Hierarchy* h);
+
+#endif // MODULE_SCENE_H
@@ -0,0 +1,188 @@
+#ifndef MODULE_SIMD_H
+#define MODULE_SIMD_H
+
+// Internal header shared by the maths heavy modules, not part of the public
+// API. simdf is the widest float vector available (AVX2 -> SSE2 -> scalar)
+// and every helper is a thin wrapper so kernels are written once.
+//
+// SSE2 is part of the x86-64 baseline so it is always used when available,
+// AVX2 has to be enabled with -mavx2, or the MATHS_AVX2 CMake option. Define
+// MATHS_NO_SIMD to force the scalar path, which produces the same results as
+// the SIMD one.
+
+#if !defined(MATHS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+    #define MATHS_SSE2
+    #include <emmintrin.h> // __m128, _mm_*
+#endif // MATHS_NO_SIMD
+
+#if defined(MATHS_SSE2) && defined(__AVX2__)
+    #define MATHS_AVX2
+    #include <immintrin.h> // __m256, _mm256_*
+#endif // __AVX2__
+
+#include <math.h>   // sqrtf, lrintf
+#include <stdint.h> // int32_t, uint32_t
+#include <string.h> // memcpy
+
+//-------------------------------------------------------------
+// Definitions
+//-------------------------------------------------------------
+
+#define SIMD_ALIGN 32 // Alignment used for SoA arrays, enough for every backend
+#define SIMD_PAD   8  // SoA arrays are padded to a multiple of this many floats
+
+// Comparisons return masks with every bit of a lane set or cleared, simdi
+// holds 32-bit integers in the same lanes as simdf.
+
+#if defined(MATHS_AVX2)
+    #define SIMD_WIDTH 8
+    typedef __m256  simdf;
+    typedef __m256i simdi;
+#elif defined(MATHS_SSE2)
+    #define SIMD_WIDTH 4
+    typedef __m128  simdf;
+    typedef __m128i simdi;
+#else
+    #define SIMD_WIDTH 1
+    typedef float   simdf;
+    typedef int32_t simdi;
+#endif // MATHS_AVX2
+
+//-------------------------------------------------------------
+// Functions
+//-------------------------------------------------------------
+
+#if defined(MATHS_AVX2)
+
+static inline simdf simdLoad(const float* p)            { return _mm256_load_ps(p); }
+static inline simdf simdLoadu(const float* p)           { return _mm256_loadu_ps(p); }
+static inline void  simdStore(float* p, simdf a)        { _mm256_store_ps(p, a); }
+static inline void  simdStoreu(float* p, simdf a)       { _mm256_storeu_ps(p, a); }
+static inline simdf simdSet1(float a)                   { return _mm256_set1_ps(a); }
+static inline simdf simdZero(void)                      { return _mm256_setzero_ps(); }
+
+static inline simdf simdAdd(simdf a, simdf b)           { return _mm256_add_ps(a, b); }
+static inline simdf simdSub(simdf a, simdf b)           { return _mm256_sub_ps(a, b); }
+static inline simdf simdMul(simdf a, simdf b)           { return _mm256_mul_ps(a, b); }
+static inline simdf simdDiv(simdf a, simdf b)           { return _mm256_div_ps(a, b); }
+static inline simdf simdMin(simdf a, simdf b)           { return _mm256_min_ps(a, b); }
+static inline simdf simdMax(simdf a, simdf b)           { return _mm256_max_ps(a, b); }
+static inline simdf simdSqrt(simdf a)                   { return _mm256_sqrt_ps(a); }
+
+static inline simdf simdCmpLt(simdf a, simdf b)         { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline simdf simdCmpLe(simdf a, simdf b)         { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline simdf simdCmpGt(simdf a, simdf b)         { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline simdf simdCmpGe(simdf a, simdf b)         { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline simdf simdAnd(simdf a, simdf b)           { return _mm256_and_ps(a, b); }
+static inline simdf simdOr(simdf a, simdf b)            { return _mm256_or_ps(a, b); }
+static inline simdf simdXor(simdf a, simdf b)           { return _mm256_xor_ps(a, b); }
+static inline simdf simdAndNot(simdf a, simdf b)        { return _mm256_andnot_ps(a, b); } // ~a & b
+static inline int   simdMask(simdf a)                   { return _mm256_movemask_ps(a); }
+
+static inline simdi simdiSet1(int32_t a)                { return _mm256_set1_epi32(a); }
+static inline simdi simdiRound(simdf a)                 { return _mm256_cvtps_epi32(a); } // Nearest, ties to even
+static inline simdf simdiToFloat(simdi a)               { return _mm256_cvtepi32_ps(a); }
+static inline simdi simdiAdd(simdi a, simdi b)          { return _mm256_add_epi32(a, b); }
+static inline simdi simdiSub(simdi a, simdi b)          { return _mm256_sub_epi32(a, b); }
+static inline simdi simdiAnd(simdi a, simdi b)          { return _mm256_and_si256(a, b); }
+static inline simdi simdiOr(simdi a, simdi b)           { return _mm256_or_si256(a, b); }
+static inline simdi simdiXor(simdi a, simdi b)          { return _mm256_xor_si256(a, b); }
+static inline simdi simdiShl(simdi a, int n)            { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+static inline simdi simdiShr(simdi a, int n)            { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(n)); } // Logical
+static inline simdf simdiCmpEq(simdi a, simdi b)        { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+static inline simdf simdiCast(simdi a)                  { return _mm256_castsi256_ps(a); }
+static inline simdi simdCast(simdf a)                   { return _mm256_castps_si256(a); }
+
+#elif defined(MATHS_SSE2)
+
+static inline simdf simdLoad(const float* p)            { return _mm_load_ps(p); }
+static inline simdf simdLoadu(const float* p)           { return _mm_loadu_ps(p); }
+static inline void  simdStore(float* p, simdf a)        { _mm_store_ps(p, a); }
+static inline void  simdStoreu(float* p, simdf a)       { _mm_storeu_ps(p, a); }
+static inline simdf simdSet1(float a)                   { return _mm_set1_ps(a); }
+static inline simdf simdZero(void)                      { return _mm_setzero_ps(); }
+
+static inline simdf simdAdd(simdf a, simdf b)           { return _mm_add_ps(a, b); }
+static inline simdf simdSub(simdf a, simdf b)           { return _mm_sub_ps(a, b); }
+static inline simdf simdMul(simdf a, simdf b)           { return _mm_mul_ps(a, b); }
+static inline simdf simdDiv(simdf a, simdf b)           { return _mm_div_ps(a, b); }
+static inline simdf simdMin(simdf a, simdf b)           { return _mm_min_ps(a, b); }
+static inline simdf simdMax(simdf a, simdf b)           { return _mm_max_ps(a, b); }
+static inline simdf simdSqrt(simdf a)                   { return _mm_sqrt_ps(a); }
+
+static inline simdf simdCmpLt(simdf a, simdf b)         { return _mm_cmplt_ps(a, b); }
+static inline simdf simdCmpLe(simdf a, simdf b)         { return _mm_cmple_ps(a, b); }
+static inline simdf simdCmpGt(simdf a, simdf b)         { return _mm_cmpgt_ps(a, b); }
+static inline simdf simdCmpGe(simdf a, simdf b)         { return _mm_cmpge_ps(a, b); }
+static inline simdf simdAnd(simdf a, simdf b)           { return _mm_and_ps(a, b); }
+static inline simdf simdOr(simdf a, simdf b)            { return _mm_or_ps(a, b); }
+static inline simdf simdXor(simdf a, simdf b)           { return _mm_xor_ps(a, b); }
+static inline simdf simdAndNot(simdf a, simdf b)        { return _mm_andnot_ps(a, b); } // ~a & b
+static inline int   simdMask(simdf a)                   { return _mm_movemask_ps(a); }
+
+static inline simdi simdiSet1(int32_t a)                { return _mm_set1_epi32(a); }
+static inline simdi simdiRound(simdf a)                 { return _mm_cvtps_epi32(a); } // Nearest, ties to even
+static inline simdf simdiToFloat(simdi a)               { return _mm_cvtepi32_ps(a); }
+static inline simdi simdiAdd(simdi a, simdi b)          { return _mm_add_epi32(a, b); }
+static inline simdi simdiSub(simdi a, simdi b)          { return _mm_sub_epi32(a, b); }
+static inline simdi simdiAnd(simdi a, simdi b)          { return _mm_and_si128(a, b); }
+static inline simdi simdiOr(simdi a, simdi b)           { return _mm_or_si128(a, b); }
+static inline simdi simdiXor(simdi a, simdi b)          { return _mm_xor_si128(a, b); }
+static inline simdi simdiShl(simdi a, int n)            { return _mm_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+static inline simdi simdiShr(simdi a, int n)            { return _mm_srl_epi32(a, _mm_cvtsi32_si128(n)); } // Logical
+static inline simdf simdiCmpEq(simdi a, simdi b)        { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+static inline simdf simdiCast(simdi a)                  { return _mm_castsi128_ps(a); }
+static inline simdi simdCast(simdf a)                   { return _mm_castps_si128(a); }
+
+#else
+
+static inline simdf simdLoad(const float* p)            { return *p; }
+static inline simdf simdLoadu(const float* p)           { return *p; }
+static inline void  simdStore(float* p, simdf a)        { *p = a; }
+static inline void  simdStoreu(float* p, simdf a)       { *p = a; }
+static inline simdf simdSet1(float a)                   { return a; }
+static inline simdf simdZero(void)                      { return 0.0f; }
+
+static inline simdf simdAdd(simdf a, simdf b)           { return a + b; }
+static inline simdf simdSub(simdf a, simdf b)           { return a - b; }
+static inline simdf simdMul(simdf a, simdf b)           { return a * b; }
+static inline simdf simdDiv(simdf a, simdf b)           { return a / b; }
+static inline simdf simdMin(simdf a, simdf b)           { return a < b ? a : b; } // Same NaN rules as minps
+static inline simdf simdMax(simdf a, simdf b)           { return a > b ? a : b; }
+static inline simdf simdSqrt(simdf a)                   { return sqrtf(a); }
+
+static inline simdi simdCast(simdf a)                   { simdi r; memcpy(&r, &a, sizeof r); return r; }
+static inline simdf simdiCast(simdi a)                  { simdf r; memcpy(&r, &a, sizeof r); return r; }
+static inline simdf simdMaskOf(int set)                 { return simdiCast(set ? -1 : 0); }
+
+static inline simdf simdCmpLt(simdf a, simdf b)         { return simdMaskOf(a < b); }
+static inline simdf simdCmpLe(simdf a, simdf b)         { return simdMaskOf(a <= b); }
+static inline simdf simdCmpGt(simdf a, simdf b)         { return simdMaskOf(a > b); }
+static inline simdf simdCmpGe(simdf a, simdf b)         { return simdMaskOf(a >= b); }
+static inline simdf simdAnd(simdf a, simdf b)           { return simdiCast(simdCast(a) & simdCast(b)); }
+static inline simdf simdOr(simdf a, simdf b)            { return simdiCast(simdCast(a) | simdCast(b)); }
+static inline simdf simdXor(simdf a, simdf b)           { return simdiCast(simdCast(a) ^ simdCast(b)); }
+static inline simdf simdAndNot(simdf a, simdf b)        { return simdiCast(~simdCast(a) & simdCast(b)); } // ~a & b
+static inline int   simdMask(simdf a)                   { return (uint32_t)simdCast(a) >> 31; }
+
+static inline simdi simdiSet1(int32_t a)                { return a; }
+static inline simdi simdiRound(simdf a)                 { return (simdi)lrintf(a); } // Nearest, ties to even
+static inline simdf simdiToFloat(simdi a)               { return (float)a; }
+static inline simdi simdiAdd(simdi a, simdi b)          { return (simdi)((uint32_t)a + (uint32_t)b); }
+static inline simdi simdiSub(simdi a, simdi b)          { return (simdi)((uint32_t)a - (uint32_t)b); }
+static inline simdi simdiAnd(simdi a, simdi b)          { return a & b; }
+static inline simdi simdiOr(simdi a, simdi b)           { return a | b; }
+static inline simdi simdiXor(simdi a, simdi b)          { return a ^ b; }
+static inline simdi simdiShl(simdi a, int n)            { return (simdi)((uint32_t)a << n); }
+static inline simdi simdiShr(simdi a, int n)            { return (simdi)((uint32_t)a >> n); } // Logical
+static inline simdf simdiCmpEq(simdi a, simdi b)        { return simdMaskOf(a == b); }
+
+#endif // MATHS_AVX2
+
+// mask ? a : b
+static inline simdf simdSelect(simdf mask, simdf a, simdf b)
+{
+    return simdOr(simdAnd(mask, a), simdAndNot(mask, b));
+}
+
+#endif // MODULE_SIMD_H
@@ -43,7 +43,7 @@ int main(void)
     vaoBind(vao);
 
     VBO vbo = vboCreate(vertices, sizeof vertices, sizeof *vertices, STATIC_DRAW);
-    vboPushAttribute(vbo, GL_FLOAT, 2, 0);
+    vboPushAttribute(&vbo, VERTEX_F32x2);
 
     vaoPushVbo(vao, vbo);
 
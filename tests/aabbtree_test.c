@@ -0,0 +1,182 @@
+#include "collision.h"
+#include "test.h"
+
+#include <stdlib.h>
+
+// More proxies than the move buffer holds after the first frames, so moving
+// all of them at once overflows it
+#define PROXY_COUNT  600
+#define INSERT_FRAME 100
+#define FRAMES       20
+#define MARGIN       0.1f
+#define NODE_COUNT   2048 // Node capacity for the proxies and their parents
+
+// Linked with -Wl,--wrap=realloc, every realloc in the engine comes through
+// here and fails while failRealloc is set
+void* __real_realloc(void* p, size_t size);
+
+static bool failRealloc = 0;
+
+void* __wrap_realloc(void* p, size_t size)
+{
+    return failRealloc ? NULL : __real_realloc(p, size);
+}
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static AABB randomBox(void)
+{
+    float size = 0.2f + (randomf() + 1.0f) * 0.6f;
+    return (AABB){randomf() * 10.0f, randomf() * 10.0f, randomf() * 10.0f, size, size * 0.5f, size};
+}
+
+// Every pair of live proxies whose fat boxes overlap and where either one
+// moved since the last update, in the a then b order aabbTreeUpdatePairs
+// sorts by
+static uint brutePairs(const AabbTree* tree, const bool* moved, AabbPair* pairs)
+{
+    uint count = 0;
+
+    for (uint a = 0; a < tree->capacity; ++a)
+    {
+        const AabbTreeNode* na = &tree->nodes[a];
+        if (na->height != 0)
+            continue;
+
+        for (uint b = a + 1; b < tree->capacity; ++b)
+        {
+            const AabbTreeNode* nb = &tree->nodes[b];
+            if (nb->height != 0 || !(moved[a] || moved[b]))
+                continue;
+
+            if (na->lo.x <= nb->hi.x && nb->lo.x <= na->hi.x &&
+                na->lo.y <= nb->hi.y && nb->lo.y <= na->hi.y &&
+                na->lo.z <= nb->hi.z && nb->lo.z <= na->hi.z)
+                pairs[count++] = (AabbPair){a, b};
+        }
+    }
+
+    return count;
+}
+
+static void checkPairs(AabbTree* tree, bool* moved, AabbPair* expected)
+{
+    const AabbPair* pairs;
+    uint count = aabbTreeUpdatePairs(tree, &pairs);
+    uint n = brutePairs(tree, moved, expected);
+    uint wrong = 0;
+
+    CHECK(count == n);
+
+    for (uint i = 0; i < count && i < n; ++i)
+        wrong += pairs[i].a != expected[i].a || pairs[i].b != expected[i].b;
+
+    CHECK(wrong == 0);
+
+    for (uint i = 0; i < tree->capacity; ++i)
+        moved[i] = 0;
+}
+
+// A move far enough to leave the fat box, so the proxy is reinserted
+static void moveFar(AabbTree* tree, uint proxy, bool* moved)
+{
+    CHECK(aabbTreeMove(tree, proxy, randomBox(), (v3){0.0f, 0.0f, 0.0f}));
+    moved[proxy] = 1;
+}
+
+static void testPairs(void)
+{
+    AabbTree* tree     = aabbTreeCreate(MARGIN);
+    uint*     proxies  = malloc(PROXY_COUNT * sizeof *proxies);
+    bool*     moved    = calloc(NODE_COUNT, sizeof *moved);
+    AabbPair* expected = malloc(PROXY_COUNT * PROXY_COUNT / 2 * sizeof *expected);
+
+    // Inserted a frame at a time, the move buffer only grows to one frame
+    for (uint i = 0; i < PROXY_COUNT; ++i)
+    {
+        proxies[i] = aabbTreeInsert(tree, randomBox(), i);
+        moved[proxies[i]] = 1;
+
+        if (i % INSERT_FRAME == INSERT_FRAME - 1)
+            checkPairs(tree, moved, expected);
+    }
+
+    CHECK(tree->capacity <= NODE_COUNT);
+    CHECK(tree->movedCapacity < PROXY_COUNT);
+
+    // Frames that fit in the buffer, with small moves that mostly keep the
+    // fat box and some that don't
+    for (uint f = 0; f < FRAMES; ++f)
+    {
+        for (uint i = 0; i < PROXY_COUNT; ++i)
+        {
+            if (rand() % 4)
+                continue;
+
+            AABB box = aabbTreeFatBox(tree, proxies[i]);
+            box.x += MARGIN + randomf() * MARGIN * 2.0f;
+            box.y += MARGIN;
+            box.z += MARGIN;
+            box.w -= MARGIN * 2.0f;
+            box.h -= MARGIN * 2.0f;
+            box.d -= MARGIN * 2.0f;
+
+            moved[proxies[i]] |= aabbTreeMove(tree, proxies[i], box, (v3){randomf() * 0.1f, 0.0f, 0.0f});
+        }
+
+        checkPairs(tree, moved, expected);
+    }
+
+    // Every proxy moves with realloc failing, so the buffer overflows. A
+    // proxy removed and one reinserted in the same frame must not show up
+    // as a stale id either.
+    failRealloc = 1;
+
+    for (uint i = 0; i < PROXY_COUNT; ++i)
+        moveFar(tree, proxies[i], moved);
+
+    CHECK(aabbTreeInsert(tree, randomBox(), PROXY_COUNT) == AABBTREE_NULL);
+
+    failRealloc = 0;
+
+    CHECK(tree->rebuildPairs);
+
+    aabbTreeRemove(tree, proxies[0]);
+    moved[proxies[0]] = 0;
+    proxies[0] = aabbTreeInsert(tree, randomBox(), 0);
+    moved[proxies[0]] = 1;
+
+    // Unmoved proxies report nothing in the brute force, but after the
+    // overflow every leaf counts as moved
+    for (uint i = 0; i < tree->capacity; ++i)
+        moved[i] |= tree->nodes[i].height == 0;
+
+    checkPairs(tree, moved, expected);
+    CHECK(!tree->rebuildPairs);
+
+    // Back to buffered moves, nothing left flagged from the rebuild
+    for (uint i = 0; i < PROXY_COUNT; i += 7)
+        moveFar(tree, proxies[i], moved);
+
+    checkPairs(tree, moved, expected);
+
+    // And nothing when nothing moved
+    CHECK(aabbTreeUpdatePairs(tree, NULL) == 0);
+
+    aabbTreeDestroy(tree);
+    free(proxies);
+    free(moved);
+    free(expected);
+}
+
+int main(void)
+{
+    srand(12);
+
+    testPairs();
+
+    return testResult();
+}
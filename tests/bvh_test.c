@@ -0,0 +1,183 @@
+#include "collision.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Enough triangles for several levels of nodes and, with the threshold
+// below, a threaded build
+#define TRIANGLE_COUNT 5003
+#define RAY_COUNT      2000
+#define MAX_T          1000.0f
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+// Closest hit by testing every triangle, BVH_NO_HIT when the ray misses
+static uint bruteRayCast(const v3* vertices, const uint* indices, uint count, Ray r, float* best)
+{
+    uint found = BVH_NO_HIT;
+    *best = MAX_T;
+
+    for (uint i = 0; i < count; ++i)
+    {
+        v3 v0 = vertices[indices ? indices[i * 3 + 0] : i * 3 + 0];
+        v3 v1 = vertices[indices ? indices[i * 3 + 1] : i * 3 + 1];
+        v3 v2 = vertices[indices ? indices[i * 3 + 2] : i * 3 + 2];
+        float t;
+
+        if (rayCastTriangle(r, v0, v1, v2, *best, &t) && t < *best)
+        {
+            *best = t;
+            found = i;
+        }
+    }
+
+    return found;
+}
+
+// Rays from a shell around the soup aimed at a random point inside it, so
+// most of them hit and some pass through the gaps
+static Ray randomRay(void)
+{
+    v3 origin = {randomf(), randomf(), randomf()};
+    v3Norm(&origin);
+    origin = v3Mulf(origin, 30.0f);
+
+    v3 target = {randomf() * 10.0f, randomf() * 10.0f, randomf() * 10.0f};
+    v3 dir = v3Sub(target, origin);
+    v3Norm(&dir);
+
+    return (Ray){origin, dir};
+}
+
+// Every query against the brute force loop. Two triangles can sit within
+// rounding of each other along a ray, so a different triangle only counts
+// as a mismatch when its t differs too. Returns how many rays hit.
+static uint testAgainstBruteForce(const v3* vertices, const uint* indices, uint count)
+{
+    Bvh* bvh = bvhCreate(vertices, indices, count);
+    CHECK(bvh != NULL);
+
+    if (!bvh)
+        return 0;
+
+    Ray*    rays  = malloc(RAY_COUNT * sizeof *rays);
+    BvhHit* batch = malloc(RAY_COUNT * sizeof *batch);
+    uint hits = 0, wrong = 0, wrongAny = 0, wrongBatch = 0;
+
+    for (uint i = 0; i < RAY_COUNT; ++i)
+        rays[i] = randomRay();
+
+    bvhRayCastBatch(bvh, rays, MAX_T, batch, RAY_COUNT);
+
+    for (uint i = 0; i < RAY_COUNT; ++i)
+    {
+        float t;
+        uint expected = bruteRayCast(vertices, indices, count, rays[i], &t);
+
+        BvhHit hit = {0.0f, 0.0f, 0.0f, BVH_NO_HIT};
+        bool any = bvhRayAny(bvh, rays[i], MAX_T);
+
+        if (!bvhRayCast(bvh, rays[i], MAX_T, &hit))
+            hit.triangle = BVH_NO_HIT;
+
+        hits += expected != BVH_NO_HIT;
+
+        if (expected == BVH_NO_HIT)
+            wrong += hit.triangle != BVH_NO_HIT;
+        else
+            wrong += hit.triangle == BVH_NO_HIT || (hit.triangle != expected && fabsf(hit.t - t) > 1e-4f * t);
+
+        wrongAny += any != (expected != BVH_NO_HIT);
+        wrongBatch += batch[i].triangle != hit.triangle || (hit.triangle != BVH_NO_HIT && batch[i].t != hit.t);
+    }
+
+    CHECK(wrong == 0);
+    CHECK(wrongAny == 0);
+    CHECK(wrongBatch == 0);
+
+    bvhDestroy(bvh);
+    free(rays);
+    free(batch);
+    return hits;
+}
+
+// A soup of small random triangles, and the same soup as an indexed mesh
+// with its vertices in reverse order
+static void testRayCast(void)
+{
+    v3*   soup     = malloc(TRIANGLE_COUNT * 3 * sizeof *soup);
+    v3*   vertices = malloc(TRIANGLE_COUNT * 3 * sizeof *vertices);
+    uint* indices  = malloc(TRIANGLE_COUNT * 3 * sizeof *indices);
+
+    for (uint i = 0; i < TRIANGLE_COUNT; ++i)
+    {
+        v3 centre = {randomf() * 10.0f, randomf() * 10.0f, randomf() * 10.0f};
+
+        for (uint k = 0; k < 3; ++k)
+            soup[i * 3 + k] = v3Add(centre, (v3){randomf(), randomf(), randomf()});
+    }
+
+    for (uint i = 0; i < TRIANGLE_COUNT * 3; ++i)
+    {
+        vertices[TRIANGLE_COUNT * 3 - 1 - i] = soup[i];
+        indices[i] = TRIANGLE_COUNT * 3 - 1 - i;
+    }
+
+    uint threads[] = {1, 4};
+    for (uint k = 0; k < sizeof threads / sizeof *threads; ++k)
+    {
+        parallelSetThreadCount(threads[k]);
+        parallelSetThreshold(256);
+
+        // Most rays hit but some find a gap, so both outcomes are covered
+        uint hits = testAgainstBruteForce(soup, NULL, TRIANGLE_COUNT);
+        CHECK(hits > RAY_COUNT / 4 && hits < RAY_COUNT);
+        CHECK(testAgainstBruteForce(vertices, indices, TRIANGLE_COUNT) > RAY_COUNT / 4);
+
+        // A single triangle makes a leaf root
+        testAgainstBruteForce(soup, NULL, 1);
+    }
+    parallelSetThreadCount(1);
+
+    free(soup);
+    free(vertices);
+    free(indices);
+}
+
+// No triangles give an empty BVH, not the out of memory NULL
+static void testEmpty(void)
+{
+    v3 vertices[3] = {{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}};
+    Bvh* empty[] = {bvhCreate(NULL, NULL, 0), bvhCreate(vertices, NULL, 0), bvhCreate(NULL, NULL, 4)};
+
+    Ray r = {{0.25f, 0.25f, -1.0f}, {0.0f, 0.0f, 1.0f}};
+
+    for (uint i = 0; i < sizeof empty / sizeof *empty; ++i)
+    {
+        BvhHit hit = {0.0f, 0.0f, 0.0f, BVH_NO_HIT}, batch;
+
+        CHECK(empty[i] != NULL);
+        CHECK(!bvhRayCast(empty[i], r, MAX_T, &hit));
+        CHECK(!bvhRayAny(empty[i], r, MAX_T));
+        CHECK(hit.triangle == BVH_NO_HIT);
+
+        bvhRayCastBatch(empty[i], &r, MAX_T, &batch, 1);
+        CHECK(batch.triangle == BVH_NO_HIT);
+
+        bvhDestroy(empty[i]);
+    }
+}
+
+int main(void)
+{
+    srand(11);
+
+    testRayCast();
+    testEmpty();
+
+    return testResult();
+}
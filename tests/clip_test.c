@@ -0,0 +1,239 @@
+#include "animation.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The clip benchmark's motion on fewer joints, a count that leaves a partial
+// last register at every SIMD_WIDTH
+#define JOINT_COUNT 37
+#define FRAME_COUNT 61
+#define FRAME_RATE  30.0f
+#define TOLERANCE   1e-3f
+#define QUANTIZE    5e-5f // Largest rotation error from the 48 bit packing alone
+#define SLACK       2e-5f // Rounding in the sampler on top of the tolerance
+
+static TRS pose(uint joint, float time, float phase)
+{
+    float a = sinf(time * 1.3f + joint * 0.7f + phase) * 1.2f;
+    float b = cosf(time * 0.9f + joint * 0.3f) * 0.8f;
+    quat rotation = quatMul(quatFromAxisAngle((v3){0.0f, 0.0f, 1.0f}, a), quatFromAxisAngle((v3){1.0f, 0.0f, 0.0f}, b));
+
+    v3 translation = joint % 10 == 0 ? (v3){sinf(time) * 2.0f, 0.5f * time, cosf(time * 2.0f)} : (v3){0.0f, 1.0f, 0.0f};
+    v3 scale = joint % 7 == 0 ? (v3){1.0f + 0.2f * sinf(time * 3.0f), 1.0f, 1.0f} : (v3){1.0f, 1.0f, 1.0f};
+
+    return (TRS){translation, rotation, scale};
+}
+
+// Rotations flip hemisphere at random, as exported ones often do
+static TRS* makeFrames(float phase)
+{
+    TRS* frames = malloc(JOINT_COUNT * FRAME_COUNT * sizeof *frames);
+
+    for (uint f = 0; f < FRAME_COUNT; ++f)
+    {
+        for (uint j = 0; j < JOINT_COUNT; ++j)
+        {
+            TRS* t = &frames[f * JOINT_COUNT + j];
+            *t = pose(j, f / FRAME_RATE, phase);
+
+            if (rand() % 2)
+                t->rotation = quatMulf(t->rotation, -1.0f);
+        }
+    }
+
+    return frames;
+}
+
+static quat hemisphere(quat q, quat like)
+{
+    return q.x * like.x + q.y * like.y + q.z * like.z + q.w * like.w < 0.0f ? quatMulf(q, -1.0f) : q;
+}
+
+// Largest difference in any component, rotations compared on the same
+// hemisphere since q and -q are the same rotation
+static float trsError(TRS a, TRS b)
+{
+    quat r = hemisphere(b.rotation, a.rotation);
+    float e = 0.0f;
+
+    e = fmaxf(e, fmaxf(fabsf(a.translation.x - b.translation.x), fmaxf(fabsf(a.translation.y - b.translation.y), fabsf(a.translation.z - b.translation.z))));
+    e = fmaxf(e, fmaxf(fmaxf(fabsf(a.rotation.x - r.x), fabsf(a.rotation.y - r.y)), fmaxf(fabsf(a.rotation.z - r.z), fabsf(a.rotation.w - r.w))));
+    e = fmaxf(e, fmaxf(fabsf(a.scale.x - b.scale.x), fmaxf(fabsf(a.scale.y - b.scale.y), fabsf(a.scale.z - b.scale.z))));
+    return e;
+}
+
+// Worst error of the clip against the source poses at every source frame
+static float frameError(const Clip* clip, const TRS* frames, TRS* out)
+{
+    float error = 0.0f;
+
+    for (uint f = 0; f < FRAME_COUNT; ++f)
+    {
+        clipSample(clip, f / FRAME_RATE, out);
+
+        for (uint j = 0; j < JOINT_COUNT; ++j)
+            error = fmaxf(error, trsError(out[j], frames[f * JOINT_COUNT + j]));
+    }
+
+    return error;
+}
+
+static void testCompression(void)
+{
+    TRS* frames = makeFrames(0.0f);
+    TRS* out    = malloc(JOINT_COUNT * sizeof *out);
+    TRS* clamp  = malloc(JOINT_COUNT * sizeof *clamp);
+
+    Clip* clip     = clipCreate(frames, JOINT_COUNT, FRAME_COUNT, FRAME_RATE, TOLERANCE);
+    Clip* lossless = clipCreate(frames, JOINT_COUNT, FRAME_COUNT, FRAME_RATE, 0.0f);
+
+    if (!CHECK(clip && lossless))
+        return;
+
+    // The tolerance holds with the quantization included, and dropping
+    // keys actually saves something
+    CHECK(frameError(clip, frames, out) <= TOLERANCE + SLACK);
+    CHECK(frameError(lossless, frames, out) <= QUANTIZE);
+    CHECK(clipSize(clip) < clipSize(lossless));
+    CHECK(clipSize(lossless) < JOINT_COUNT * FRAME_COUNT * sizeof(TRS));
+
+    // Halfway between frames the lossless clip interpolates its neighbours
+    float between = 0.0f;
+
+    for (uint f = 0; f + 1 < FRAME_COUNT; ++f)
+    {
+        clipSample(lossless, (f + 0.5f) / FRAME_RATE, out);
+
+        for (uint j = 0; j < JOINT_COUNT; ++j)
+        {
+            TRS a = frames[f * JOINT_COUNT + j], b = frames[(f + 1) * JOINT_COUNT + j];
+            quat r = quatNormTo(quatAdd(a.rotation, hemisphere(b.rotation, a.rotation)));
+
+            TRS expected = {v3Mulf(v3Add(a.translation, b.translation), 0.5f), r, v3Mulf(v3Add(a.scale, b.scale), 0.5f)};
+            between = fmaxf(between, trsError(out[j], expected));
+        }
+    }
+
+    CHECK(between <= QUANTIZE + SLACK);
+
+    // Times outside the clip clamp to its ends
+    clipSample(clip, 0.0f, out);
+    clipSample(clip, -1.0f, clamp);
+    CHECK(memcmp(out, clamp, JOINT_COUNT * sizeof *out) == 0);
+
+    clipSample(clip, clip->duration, out);
+    clipSample(clip, clip->duration + 5.0f, clamp);
+    CHECK(memcmp(out, clamp, JOINT_COUNT * sizeof *out) == 0);
+
+    clipDestroy(clip);
+    clipDestroy(lossless);
+    free(frames);
+    free(out);
+    free(clamp);
+}
+
+static void testBlend(void)
+{
+    TRS* frames  = makeFrames(0.0f);
+    TRS* frames2 = makeFrames(1.5f);
+    TRS* a   = malloc(JOINT_COUNT * sizeof *a);
+    TRS* b   = malloc(JOINT_COUNT * sizeof *b);
+    TRS* out = malloc(JOINT_COUNT * sizeof *out);
+
+    // The second clip is turned past half a revolution, so the samples of a
+    // joint land on opposite hemispheres
+    quat turn = quatFromAxisAngle((v3){0.0f, 1.0f, 0.0f}, 4.0f);
+    for (uint i = 0; i < JOINT_COUNT * FRAME_COUNT; ++i)
+        frames2[i].rotation = quatMul(turn, frames2[i].rotation);
+
+    const Clip* clips[2] = {
+        clipCreate(frames, JOINT_COUNT, FRAME_COUNT, FRAME_RATE, TOLERANCE),
+        clipCreate(frames2, JOINT_COUNT, FRAME_COUNT, FRAME_RATE, TOLERANCE),
+    };
+
+    if (!CHECK(clips[0] && clips[1]))
+        return;
+
+    float times[2] = {0.77f, 1.3f};
+    clipSample(clips[0], times[0], a);
+    clipSample(clips[1], times[1], b);
+
+    // All the weight on one clip is that clip, no weight at all the first
+    float one[2] = {1.0f, 0.0f}, none[2] = {0.0f, -1.0f}, half[2] = {2.0f, 2.0f};
+    float error = 0.0f;
+
+    clipBlend(clips, times, one, 2, out);
+    for (uint j = 0; j < JOINT_COUNT; ++j)
+        error = fmaxf(error, trsError(out[j], a[j]));
+
+    clipBlend(clips, times, none, 2, out);
+    CHECK(memcmp(out, a, JOINT_COUNT * sizeof *out) == 0);
+
+    // Equal weights are the average and the nlerp of the two samples
+    clipBlend(clips, times, half, 2, out);
+    for (uint j = 0; j < JOINT_COUNT; ++j)
+    {
+        quat r = quatNormTo(quatAdd(a[j].rotation, hemisphere(b[j].rotation, a[j].rotation)));
+        TRS expected = {v3Mulf(v3Add(a[j].translation, b[j].translation), 0.5f), r, v3Mulf(v3Add(a[j].scale, b[j].scale), 0.5f)};
+
+        error = fmaxf(error, trsError(out[j], expected));
+    }
+
+    CHECK(error <= SLACK);
+
+    clipDestroy((Clip*)clips[0]);
+    clipDestroy((Clip*)clips[1]);
+    free(frames);
+    free(frames2);
+    free(a);
+    free(b);
+    free(out);
+}
+
+// One frame makes a constant clip, invalid input gives NULL
+static void testEdges(void)
+{
+    TRS frames[JOINT_COUNT], out[JOINT_COUNT];
+
+    for (uint j = 0; j < JOINT_COUNT; ++j)
+        frames[j] = pose(j, 0.5f, 0.0f);
+
+    Clip* clip = clipCreate(frames, JOINT_COUNT, 1, FRAME_RATE, TOLERANCE);
+
+    if (CHECK(clip))
+    {
+        float error = 0.0f;
+        float times[] = {-1.0f, 0.0f, 2.0f};
+
+        for (uint t = 0; t < sizeof times / sizeof *times; ++t)
+        {
+            clipSample(clip, times[t], out);
+
+            for (uint j = 0; j < JOINT_COUNT; ++j)
+                error = fmaxf(error, trsError(out[j], frames[j]));
+        }
+
+        CHECK(clip->duration == 0.0f);
+        CHECK(error <= QUANTIZE);
+        clipDestroy(clip);
+    }
+
+    CHECK(clipCreate(NULL, JOINT_COUNT, 1, FRAME_RATE, TOLERANCE) == NULL);
+    CHECK(clipCreate(frames, 0, 1, FRAME_RATE, TOLERANCE) == NULL);
+    CHECK(clipCreate(frames, JOINT_COUNT, 0, FRAME_RATE, TOLERANCE) == NULL);
+    CHECK(clipCreate(frames, 1, 65537, FRAME_RATE, TOLERANCE) == NULL);
+    CHECK(clipCreate(frames, JOINT_COUNT, 1, 0.0f, TOLERANCE) == NULL);
+}
+
+int main(void)
+{
+    srand(19);
+
+    testCompression();
+    testBlend();
+    testEdges();
+
+    return testResult();
+}
@@ -0,0 +1,426 @@
+#include "collision.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Not a multiple of any SIMD_WIDTH, so every kernel ends on a partial
+// register. Shapes are packed close enough that a good share of pairs touch.
+#define SHAPE_COUNT 257
+#define PAIR_COUNT  4003
+#define EPSILON     1e-12f // COLLISION_EPSILON
+#define TOLERANCE   1e-4f
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+// Every eighth coordinate is on a 0.5 grid, so edges and centres line up
+static float randomCoord(void)
+{
+    return rand() % 8 ? randomf() * 2.0f : (float)(rand() % 9 - 4) * 0.5f;
+}
+
+//-----------------------------
+// ~Scalar
+
+// One pair at a time with plain branches, following the rules documented
+// on each kernel. Return 0 when the shapes don't touch.
+
+static bool scalarCircleCircle(Circle a, Circle b, Contact* c)
+{
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float d2 = dx * dx + dy * dy;
+    float r  = a.r + b.r;
+
+    if (!(d2 <= r * r))
+        return 0;
+
+    c->normal = (v2){1.0f, 0.0f};
+    c->depth  = r;
+
+    if (d2 > EPSILON)
+    {
+        float d = sqrtf(d2);
+        c->normal = (v2){dx / d, dy / d};
+        c->depth  = fmaxf(r - d, 0.0f);
+    }
+
+    c->pointCount = 1;
+    c->points[0] = (v2){b.x - c->normal.x * b.r, b.y - c->normal.y * b.r};
+    return 1;
+}
+
+static bool scalarCircleRect(Circle a, Rect b, Contact* c)
+{
+    float lx = b.x, hx = b.x + b.w;
+    float ly = b.y, hy = b.y + b.h;
+    float qx = fminf(fmaxf(a.x, lx), hx);
+    float qy = fminf(fmaxf(a.y, ly), hy);
+    float dx = qx - a.x, dy = qy - a.y;
+    float d2 = dx * dx + dy * dy;
+
+    if (!(d2 <= a.r * a.r))
+        return 0;
+
+    c->pointCount = 1;
+
+    if (d2 > EPSILON)
+    {
+        float d = sqrtf(d2);
+        c->normal = (v2){dx / d, dy / d};
+        c->depth  = fmaxf(a.r - d, 0.0f);
+        c->points[0] = (v2){qx, qy};
+        return 1;
+    }
+
+    // Out through the nearest side, ties go left, right, bottom, top
+    float dl = a.x - lx, dr = hx - a.x, db = a.y - ly, dt = hy - a.y;
+    float m  = fminf(fminf(dl, dr), fminf(db, dt));
+
+    c->depth = a.r + m;
+
+    if (dl <= m)
+    {
+        c->normal = (v2){1.0f, 0.0f};
+        c->points[0] = (v2){lx, a.y};
+    }
+    else if (dr <= m)
+    {
+        c->normal = (v2){-1.0f, 0.0f};
+        c->points[0] = (v2){hx, a.y};
+    }
+    else if (db <= m)
+    {
+        c->normal = (v2){0.0f, 1.0f};
+        c->points[0] = (v2){a.x, ly};
+    }
+    else
+    {
+        c->normal = (v2){0.0f, -1.0f};
+        c->points[0] = (v2){a.x, hy};
+    }
+
+    return 1;
+}
+
+static bool scalarRectRect(Rect a, Rect b, Contact* c)
+{
+    float alx = a.x, ahx = a.x + a.w, aly = a.y, ahy = a.y + a.h;
+    float blx = b.x, bhx = b.x + b.w, bly = b.y, bhy = b.y + b.h;
+
+    float px = ahx - blx, mx = bhx - alx;
+    float py = ahy - bly, my = bhy - aly;
+    float ox = fminf(px, mx), oy = fminf(py, my);
+
+    if (!(ox >= 0.0f && oy >= 0.0f))
+        return 0;
+
+    c->pointCount = 2;
+
+    if (ox < oy)
+    {
+        float fx = px <= mx ? blx : bhx;
+        c->normal = (v2){px <= mx ? 1.0f : -1.0f, 0.0f};
+        c->depth  = ox;
+        c->points[0] = (v2){fx, fmaxf(aly, bly)};
+        c->points[1] = (v2){fx, fminf(ahy, bhy)};
+    }
+    else
+    {
+        float fy = py <= my ? bly : bhy;
+        c->normal = (v2){0.0f, py <= my ? 1.0f : -1.0f};
+        c->depth  = oy;
+        c->points[0] = (v2){fmaxf(alx, blx), fy};
+        c->points[1] = (v2){fminf(ahx, bhx), fy};
+    }
+
+    return 1;
+}
+
+static bool scalarLineCircle(Line a, Circle b, Contact* c)
+{
+    float dx = a.x1 - a.x0, dy = a.y1 - a.y0;
+    float dd = dx * dx + dy * dy;
+    float t  = 0.0f;
+
+    if (dd > EPSILON)
+        t = fminf(fmaxf(((b.x - a.x0) * dx + (b.y - a.y0) * dy) / dd, 0.0f), 1.0f);
+
+    float vx = b.x - (a.x0 + t * dx), vy = b.y - (a.y0 + t * dy);
+    float d2 = vx * vx + vy * vy;
+
+    if (!(d2 <= b.r * b.r))
+        return 0;
+
+    // On the line it goes along the segment's normal, or x for a point
+    if (d2 > EPSILON)
+    {
+        float d = sqrtf(d2);
+        c->normal = (v2){vx / d, vy / d};
+        c->depth  = fmaxf(b.r - d, 0.0f);
+    }
+    else
+    {
+        float len = dd > EPSILON ? sqrtf(dd) : 0.0f;
+        c->normal = dd > EPSILON ? (v2){-dy / len, dx / len} : (v2){1.0f, 0.0f};
+        c->depth  = b.r;
+    }
+
+    c->pointCount = 1;
+    c->points[0] = (v2){b.x - c->normal.x * b.r, b.y - c->normal.y * b.r};
+    return 1;
+}
+
+static float clampf(float x, float lo, float hi)
+{
+    return fminf(fmaxf(x, lo), hi);
+}
+
+static bool scalarLineRect(Line a, Rect b, Contact* c)
+{
+    float ex = b.w * 0.5f, ey = b.h * 0.5f;
+    float cx = b.x + ex, hx = cx + ex;
+    float cy = b.y + ey, hy = cy + ey;
+
+    float px = fmaxf(a.x0, a.x1) - b.x, mx = hx - fminf(a.x0, a.x1);
+    float py = fmaxf(a.y0, a.y1) - b.y, my = hy - fminf(a.y0, a.y1);
+    float ox = fminf(px, mx), oy = fminf(py, my);
+
+    // The segment's normal, a point has none and never separates on it. The
+    // normal axis can tie with x or y, so it is rounded as in the kernel.
+    float dx = a.x1 - a.x0, dy = a.y1 - a.y0;
+    float dd = dx * dx + dy * dy;
+    float nx = 0.0f, ny = 0.0f, on = 3.4e38f;
+
+    if (dd > EPSILON)
+    {
+        float inv = 1.0f / sqrtf(dd);
+        nx = -dy * inv;
+        ny = dx * inv;
+
+        float s = nx * a.x0 + ny * a.y0;
+        float d = nx * cx + ny * cy - s;
+        on = fabsf(nx) * ex + fabsf(ny) * ey - fabsf(d);
+
+        if (d < 0.0f)
+        {
+            nx = -nx;
+            ny = -ny;
+        }
+    }
+
+    if (!(ox >= 0.0f && oy >= 0.0f && on >= 0.0f))
+        return 0;
+
+    bool right = px <= mx, up = py <= my;
+    c->pointCount = 1;
+
+    if (ox <= oy && ox <= on)
+    {
+        bool deep = right ? a.x1 >= a.x0 : a.x0 >= a.x1;
+        c->normal = (v2){right ? 1.0f : -1.0f, 0.0f};
+        c->depth  = ox;
+        c->points[0] = (v2){right ? b.x : hx, clampf(deep ? a.y1 : a.y0, b.y, hy)};
+    }
+    else if (oy <= on)
+    {
+        bool deep = up ? a.y1 >= a.y0 : a.y0 >= a.y1;
+        c->normal = (v2){0.0f, up ? 1.0f : -1.0f};
+        c->depth  = oy;
+        c->points[0] = (v2){clampf(deep ? a.x1 : a.x0, b.x, hx), up ? b.y : hy};
+    }
+    else
+    {
+        c->normal = (v2){nx, ny};
+        c->depth  = on;
+        c->points[0] = (v2){nx >= 0.0f ? b.x : hx, ny >= 0.0f ? b.y : hy};
+    }
+
+    return 1;
+}
+
+//-----------------------------
+// ~Tests
+
+typedef struct Shapes
+{
+    Circle circles[SHAPE_COUNT];
+    Rect   rects[SHAPE_COUNT];
+    Line   lines[SHAPE_COUNT];
+} Shapes;
+
+static bool near(float a, float b)
+{
+    return fabsf(a - b) <= TOLERANCE * (1.0f + fabsf(b));
+}
+
+// Same pairs in the same order, each contact within rounding of the scalar
+// one. Points only count up to pointCount.
+static void checkContacts(const Contact* got, uint count, const Contact* expected, uint n)
+{
+    uint wrong = 0;
+
+    CHECK(count == n);
+
+    for (uint i = 0; i < count && i < n; ++i)
+    {
+        const Contact* g = &got[i];
+        const Contact* e = &expected[i];
+        bool same = g->a == e->a && g->b == e->b && g->pointCount == e->pointCount;
+
+        same = same && near(g->normal.x, e->normal.x) && near(g->normal.y, e->normal.y) && near(g->depth, e->depth);
+
+        for (uint k = 0; same && k < e->pointCount; ++k)
+            same = near(g->points[k].x, e->points[k].x) && near(g->points[k].y, e->points[k].y);
+
+        wrong += !same;
+    }
+
+    CHECK(wrong == 0);
+}
+
+// The first few pairs of each kind hit the degenerate cases: concentric
+// circles, centres inside rects on a tie, circles centred on a segment and
+// zero length segments
+static void shapesCreate(Shapes* s)
+{
+    for (uint i = 0; i < SHAPE_COUNT; ++i)
+    {
+        float size = 0.25f + fabsf(randomf()) * 1.5f;
+
+        s->circles[i] = (Circle){randomCoord(), randomCoord(), size * 0.5f};
+        s->rects[i]   = (Rect){randomCoord(), randomCoord(), size, rand() % 4 ? size * 0.75f : size};
+
+        v2 p = {randomCoord(), randomCoord()};
+        v2 d = {randomf() * 2.0f, randomf() * 2.0f};
+
+        switch (rand() % 8)
+        {
+            case 0: d = (v2){0.0f, 0.0f};  break;
+            case 1: d = (v2){d.x, 0.0f};   break;
+            case 2: d = (v2){0.0f, d.y};   break;
+        }
+
+        s->lines[i] = (Line){p.x, p.y, p.x + d.x, p.y + d.y};
+    }
+
+    s->circles[1] = (Circle){s->circles[0].x, s->circles[0].y, 0.5f};
+    s->circles[2] = (Circle){s->rects[2].x + s->rects[2].w * 0.5f, s->rects[2].y + s->rects[2].w * 0.5f, 0.3f};
+    s->rects[2].h = s->rects[2].w;
+
+    s->lines[3]   = (Line){-1.0f, 0.5f, 1.0f, 0.5f};
+    s->circles[3] = (Circle){0.0f, 0.5f, 0.5f};
+    s->lines[4]   = (Line){0.5f, 0.5f, 0.5f, 0.5f};
+    s->circles[4] = (Circle){0.5f, 0.5f, 0.25f};
+}
+
+static void testKernels(void)
+{
+    Shapes*   s        = malloc(sizeof *s);
+    AabbPair* pairs    = malloc(PAIR_COUNT * sizeof *pairs);
+    Contact*  got      = malloc(PAIR_COUNT * sizeof *got);
+    Contact*  expected = malloc(PAIR_COUNT * sizeof *expected);
+
+    shapesCreate(s);
+
+    pairs[0] = (AabbPair){0, 1};
+    pairs[1] = (AabbPair){2, 2};
+    pairs[2] = (AabbPair){3, 3};
+    pairs[3] = (AabbPair){4, 4};
+
+    for (uint i = 4; i < PAIR_COUNT; ++i)
+        pairs[i] = (AabbPair){(uint)rand() % SHAPE_COUNT, (uint)rand() % SHAPE_COUNT};
+
+    // Each kernel over every prefix length up to a few registers, then all
+    // of the pairs
+    uint lengths[] = {0, 1, 2, 3, 5, 7, 9, 17, PAIR_COUNT};
+    uint touching[5] = {0}, disagree[5] = {0};
+
+    for (uint k = 0; k < sizeof lengths / sizeof *lengths; ++k)
+    {
+        uint len = lengths[k];
+        uint n[5] = {0};
+
+        for (uint i = 0; i < len; ++i)
+        {
+            uint a = pairs[i].a, b = pairs[i].b;
+            Contact c = {a, b, {0.0f, 0.0f}, 0.0f, 0, {{0.0f, 0.0f}, {0.0f, 0.0f}}};
+
+            if (scalarCircleCircle(s->circles[a], s->circles[b], &c)) expected[n[0]++] = c;
+            disagree[0] += scalarCircleCircle(s->circles[a], s->circles[b], &c) != circleOverlapsCircle(s->circles[a], s->circles[b]);
+        }
+
+        checkContacts(got, contactsCircleCircle(s->circles, pairs, len, got), expected, n[0]);
+
+        for (uint i = 0; i < len; ++i)
+        {
+            uint a = pairs[i].a, b = pairs[i].b;
+            Contact c = {a, b, {0.0f, 0.0f}, 0.0f, 0, {{0.0f, 0.0f}, {0.0f, 0.0f}}};
+
+            if (scalarCircleRect(s->circles[a], s->rects[b], &c)) expected[n[1]++] = c;
+            disagree[1] += scalarCircleRect(s->circles[a], s->rects[b], &c) != circleOverlapsRect(s->circles[a], s->rects[b]);
+        }
+
+        checkContacts(got, contactsCircleRect(s->circles, s->rects, pairs, len, got), expected, n[1]);
+
+        for (uint i = 0; i < len; ++i)
+        {
+            uint a = pairs[i].a, b = pairs[i].b;
+            Contact c = {a, b, {0.0f, 0.0f}, 0.0f, 0, {{0.0f, 0.0f}, {0.0f, 0.0f}}};
+
+            if (scalarRectRect(s->rects[a], s->rects[b], &c)) expected[n[2]++] = c;
+            disagree[2] += scalarRectRect(s->rects[a], s->rects[b], &c) != rectOverlapsRect(s->rects[a], s->rects[b]);
+        }
+
+        checkContacts(got, contactsRectRect(s->rects, pairs, len, got), expected, n[2]);
+
+        for (uint i = 0; i < len; ++i)
+        {
+            uint a = pairs[i].a, b = pairs[i].b;
+            Contact c = {a, b, {0.0f, 0.0f}, 0.0f, 0, {{0.0f, 0.0f}, {0.0f, 0.0f}}};
+
+            if (scalarLineCircle(s->lines[a], s->circles[b], &c)) expected[n[3]++] = c;
+            disagree[3] += scalarLineCircle(s->lines[a], s->circles[b], &c) != lineOverlapsCircle(s->lines[a], s->circles[b]);
+        }
+
+        checkContacts(got, contactsLineCircle(s->lines, s->circles, pairs, len, got), expected, n[3]);
+
+        for (uint i = 0; i < len; ++i)
+        {
+            uint a = pairs[i].a, b = pairs[i].b;
+            Contact c = {a, b, {0.0f, 0.0f}, 0.0f, 0, {{0.0f, 0.0f}, {0.0f, 0.0f}}};
+
+            if (scalarLineRect(s->lines[a], s->rects[b], &c)) expected[n[4]++] = c;
+            disagree[4] += scalarLineRect(s->lines[a], s->rects[b], &c) != lineOverlapsRect(s->lines[a], s->rects[b]);
+        }
+
+        checkContacts(got, contactsLineRect(s->lines, s->rects, pairs, len, got), expected, n[4]);
+
+        for (uint j = 0; j < 5; ++j)
+            touching[j] = n[j];
+    }
+
+    // Both outcomes covered for every kind, and the scalar versions agree
+    // with the overlap tests on which pairs touch
+    for (uint j = 0; j < 5; ++j)
+    {
+        CHECK(touching[j] > PAIR_COUNT / 10 && touching[j] < PAIR_COUNT);
+        CHECK(disagree[j] == 0);
+    }
+
+    free(s);
+    free(pairs);
+    free(got);
+    free(expected);
+}
+
+int main(void)
+{
+    srand(14);
+
+    testKernels();
+
+    return testResult();
+}
@@ -0,0 +1,194 @@
+#include "collision.h"
+#include "test.h"
+
+#include <stdlib.h>
+
+// Enough objects for several build blocks and, with the threshold below, a
+// threaded build. Sizes go up to a few cells so objects span several.
+#define OBJECT_COUNT 3001
+#define QUERY_COUNT  300
+#define CELL_SIZE    1.0f
+#define WORLD_SIZE   40.0f
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+// Every fourth coordinate and size lands on a cell edge, so bounds often
+// touch exactly
+static float randomCoord(void)
+{
+    if (rand() % 4 == 0)
+        return (float)(rand() % 41 - 20) * CELL_SIZE;
+
+    return randomf() * WORLD_SIZE * 0.5f;
+}
+
+static float randomSize(void)
+{
+    if (rand() % 4 == 0)
+        return (float)(1 + rand() % 3) * CELL_SIZE;
+
+    return rand() % 8 ? (randomf() + 1.0f) * 0.5f * CELL_SIZE : (randomf() + 1.5f) * 2.0f * CELL_SIZE;
+}
+
+static int compareUint(const void* a, const void* b)
+{
+    uint x = *(const uint*)a, y = *(const uint*)b;
+    return (x > y) - (x < y);
+}
+
+static bool boundsOverlap(v4 a, v4 b)
+{
+    return a.x <= b.z && b.x <= a.z && a.y <= b.w && b.y <= a.w;
+}
+
+// The query's ids sorted against every object tested in turn, and the
+// count without room for any of them
+static void checkQuery(const Grid* grid, const v4* bounds, uint n, Rect r, const Circle* c, uint* found, uint* expected)
+{
+    v4 q = {r.x, r.y, r.x + r.w, r.y + r.h};
+    uint count = c ? gridQueryCircle(grid, *c, found, n) : gridQueryRect(grid, r, found, n);
+    uint wrong = 0, m = 0;
+
+    for (uint i = 0; i < n; ++i)
+    {
+        Rect b = {bounds[i].x, bounds[i].y, bounds[i].z - bounds[i].x, bounds[i].w - bounds[i].y};
+
+        if (c ? circleOverlapsRect(*c, b) : boundsOverlap(q, bounds[i]))
+            expected[m++] = i;
+    }
+
+    qsort(found, count, sizeof *found, compareUint);
+
+    CHECK(count == m);
+
+    for (uint i = 0; i < count && i < m; ++i)
+        wrong += found[i] != expected[i];
+
+    CHECK(wrong == 0);
+
+    uint none = c ? gridQueryCircle(grid, *c, NULL, 0) : gridQueryRect(grid, r, NULL, 0);
+    CHECK(none == m);
+}
+
+// gridPairs sorted by a then b against the O(n^2) loop in the same order
+static void checkPairs(Grid* grid, const v4* bounds, uint n)
+{
+    const AabbPair* pairs;
+    uint count = gridPairs(grid, &pairs);
+    uint wrong = 0, m = 0;
+
+    for (uint a = 0; a < n; ++a)
+    {
+        for (uint b = a + 1; b < n; ++b)
+        {
+            if (!boundsOverlap(bounds[a], bounds[b]))
+                continue;
+
+            wrong += m >= count || pairs[m].a != a || pairs[m].b != b;
+            ++m;
+        }
+    }
+
+    CHECK(count > 0);
+    CHECK(count == m);
+    CHECK(wrong == 0);
+}
+
+static void checkGrid(Grid* grid, const v4* bounds, uint n)
+{
+    uint* found    = malloc(OBJECT_COUNT * sizeof *found);
+    uint* expected = malloc(OBJECT_COUNT * sizeof *expected);
+
+    checkPairs(grid, bounds, n);
+
+    for (uint k = 0; k < QUERY_COUNT; ++k)
+    {
+        Rect   r = {randomCoord(), randomCoord(), randomSize() * 2.0f, randomSize() * 2.0f};
+        Circle c = {randomCoord(), randomCoord(), randomSize()};
+
+        checkQuery(grid, bounds, n, r, NULL, found, expected);
+        checkQuery(grid, bounds, n, r, &c, found, expected);
+    }
+
+    free(found);
+    free(expected);
+}
+
+static void testBuild(void)
+{
+    Rect*   rects   = malloc(OBJECT_COUNT * sizeof *rects);
+    Circle* circles = malloc(OBJECT_COUNT * sizeof *circles);
+    v4*     bounds  = malloc(OBJECT_COUNT * sizeof *bounds);
+
+    uint threads[] = {1, 4};
+    for (uint t = 0; t < sizeof threads / sizeof *threads; ++t)
+    {
+        parallelSetThreadCount(threads[t]);
+        parallelSetThreshold(256);
+
+        Grid* grid = gridCreate(CELL_SIZE);
+
+        // Rebuilt smaller and larger again, so the reused arrays are covered
+        uint counts[] = {OBJECT_COUNT, OBJECT_COUNT / 3, OBJECT_COUNT};
+        for (uint k = 0; k < sizeof counts / sizeof *counts; ++k)
+        {
+            uint n = counts[k];
+
+            for (uint i = 0; i < n; ++i)
+            {
+                rects[i]  = (Rect){randomCoord(), randomCoord(), randomSize(), randomSize()};
+                bounds[i] = (v4){rects[i].x, rects[i].y, rects[i].x + rects[i].w, rects[i].y + rects[i].h};
+            }
+
+            CHECK(gridBuild(grid, rects, n));
+            checkGrid(grid, bounds, n);
+
+            for (uint i = 0; i < n; ++i)
+            {
+                circles[i] = (Circle){randomCoord(), randomCoord(), randomSize()};
+                bounds[i]  = (v4){circles[i].x - circles[i].r, circles[i].y - circles[i].r, circles[i].x + circles[i].r, circles[i].y + circles[i].r};
+            }
+
+            CHECK(gridBuildCircles(grid, circles, n));
+            checkGrid(grid, bounds, n);
+        }
+
+        gridDestroy(grid);
+    }
+    parallelSetThreadCount(1);
+
+    free(rects);
+    free(circles);
+    free(bounds);
+}
+
+// Nothing built, or built from nothing, finds nothing
+static void testEmpty(void)
+{
+    Grid* grid = gridCreate(CELL_SIZE);
+    Rect  r = {-1.0f, -1.0f, 2.0f, 2.0f};
+    uint  out[1];
+
+    CHECK(gridQueryRect(grid, r, out, 1) == 0);
+    CHECK(gridPairs(grid, NULL) == 0);
+
+    CHECK(gridBuild(grid, &r, 0));
+    CHECK(gridQueryRect(grid, r, out, 1) == 0);
+    CHECK(gridQueryCircle(grid, (Circle){0.0f, 0.0f, 1.0f}, out, 1) == 0);
+    CHECK(gridPairs(grid, NULL) == 0);
+
+    gridDestroy(grid);
+}
+
+int main(void)
+{
+    srand(13);
+
+    testBuild();
+    testEmpty();
+
+    return testResult();
+}
@@ -0,0 +1,241 @@
+#include "scene.h"
+#include "test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Two hierarchies get the same edits, one is updated on a single thread and
+// the other on several. Sizes are well past the threshold set below, so the
+// second one splits its updates into tasks.
+#define NODE_LIMIT 12000
+#define ID_LIMIT   (NODE_LIMIT + 1024)
+#define ROUNDS     40
+#define THREADS    4
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static TRS randomTrs(void)
+{
+    quat r = quatNormTo((quat){randomf(), randomf(), randomf(), randomf()});
+    return (TRS){{randomf() * 2.0f, randomf() * 2.0f, randomf() * 2.0f}, r, {1.0f + randomf() * 0.5f, 1.0f, 1.0f - randomf() * 0.25f}};
+}
+
+// What the hierarchies should hold, by id
+typedef struct Shadow
+{
+    uint parents[ID_LIMIT];
+    TRS  locals[ID_LIMIT];
+    bool alive[ID_LIMIT];
+    uint live[ID_LIMIT];
+    uint liveCount;
+} Shadow;
+
+static void shadowCollect(Shadow* s)
+{
+    s->liveCount = 0;
+
+    for (uint id = 0; id < ID_LIMIT; ++id)
+        if (s->alive[id])
+            s->live[s->liveCount++] = id;
+}
+
+static bool shadowBelow(const Shadow* s, uint id, uint ancestor)
+{
+    for (uint a = id; a != HIERARCHY_NULL; a = s->parents[a])
+        if (a == ancestor)
+            return 1;
+
+    return 0;
+}
+
+//-----------------------------
+// ~Edits
+
+static void add(Hierarchy** hs, Shadow* s)
+{
+    uint parent = rand() % 8 == 0 || !s->liveCount ? HIERARCHY_NULL : s->live[(uint)rand() % s->liveCount];
+    TRS  local  = randomTrs();
+    uint id     = hierarchyAdd(hs[0], parent, local.translation, local.rotation, local.scale);
+
+    CHECK(hierarchyAdd(hs[1], parent, local.translation, local.rotation, local.scale) == id);
+
+    if (!CHECK(id < ID_LIMIT) || !CHECK(!s->alive[id]))
+        return;
+
+    s->parents[id] = parent;
+    s->locals[id]  = local;
+    s->alive[id]   = 1;
+    s->live[s->liveCount++] = id;
+}
+
+// Removes the whole subtree from the shadow too
+static void removeSubtree(Hierarchy** hs, Shadow* s)
+{
+    uint node = s->live[(uint)rand() % s->liveCount];
+
+    hierarchyRemove(hs[0], node);
+    hierarchyRemove(hs[1], node);
+
+    bool* below = calloc(ID_LIMIT, sizeof *below);
+
+    for (uint k = 0; k < s->liveCount; ++k)
+        below[s->live[k]] = shadowBelow(s, s->live[k], node);
+
+    for (uint id = 0; id < ID_LIMIT; ++id)
+        s->alive[id] &= !below[id];
+
+    free(below);
+    shadowCollect(s);
+}
+
+static void set(Hierarchy** hs, Shadow* s)
+{
+    uint id = s->live[(uint)rand() % s->liveCount];
+    TRS  local = randomTrs();
+
+    for (uint k = 0; k < 2; ++k)
+    {
+        switch (id % 4)
+        {
+            case 0: hierarchySetLocal(hs[k], id, local.translation, local.rotation, local.scale); break;
+            case 1: hierarchySetTranslation(hs[k], id, local.translation); break;
+            case 2: hierarchySetRotation(hs[k], id, local.rotation); break;
+            case 3: hierarchySetScale(hs[k], id, local.scale); break;
+        }
+    }
+
+    switch (id % 4)
+    {
+        case 0: s->locals[id] = local; break;
+        case 1: s->locals[id].translation = local.translation; break;
+        case 2: s->locals[id].rotation = local.rotation; break;
+        case 3: s->locals[id].scale = local.scale; break;
+    }
+}
+
+//-----------------------------
+// ~Checks
+
+// Depth first layout, ids and locals against the shadow, and every world
+// its parent's world times its local, computed the same way the update does
+static void checkHierarchy(const Hierarchy* h, const Shadow* s)
+{
+    uint layout = 0, ids = 0, locals = 0, worlds = 0;
+
+    CHECK(h->count == s->liveCount);
+
+    for (uint i = 0; i < h->count; ++i)
+    {
+        uint p  = h->parents[i];
+        uint id = h->ids[i];
+
+        layout += h->ends[i] <= i || h->ends[i] > h->count;
+        layout += p != HIERARCHY_NULL && (p >= i || h->ends[i] > h->ends[p]);
+
+        if (id >= ID_LIMIT || !s->alive[id] || h->slots[id] != i)
+        {
+            ++ids;
+            continue;
+        }
+
+        uint parent = s->parents[id];
+        ids += parent == HIERARCHY_NULL ? p != HIERARCHY_NULL : p == HIERARCHY_NULL || h->ids[p] != parent;
+        ids += hierarchyParent(h, id) != parent;
+
+        locals += memcmp(&h->locals[i], &s->locals[id], sizeof(TRS)) != 0;
+
+        m4x3 local = trsToM4x3(h->locals[i]), world = local;
+        if (p != HIERARCHY_NULL)
+            m4x3MulTo(&world, &h->worlds[p], &local);
+
+        worlds += memcmp(&h->worlds[i], &world, sizeof world) != 0;
+    }
+
+    CHECK(layout == 0);
+    CHECK(ids == 0);
+    CHECK(locals == 0);
+    CHECK(worlds == 0);
+}
+
+static void testEdits(void)
+{
+    Hierarchy* hs[2] = {hierarchyCreate(), hierarchyCreate()};
+    Shadow*    s     = calloc(1, sizeof *s);
+
+    parallelSetThreshold(256);
+
+    for (uint r = 0; r < ROUNDS; ++r)
+    {
+        // Grows to the limit over the first rounds, then a few hundred
+        // nodes come and go each round. Adds under random parents land in
+        // the middle and shift everything after them.
+        uint adds = s->liveCount < NODE_LIMIT / 2 ? 1500 : 300;
+        for (uint k = 0; k < adds && s->liveCount < NODE_LIMIT; ++k)
+            add(hs, s);
+
+        // Some of the edits hit nodes that are removed before the update
+        for (uint k = 0; k < s->liveCount / 20; ++k)
+            set(hs, s);
+
+        for (uint k = 0, n = 1 + rand() % 3; k < n && s->liveCount; ++k)
+            removeSubtree(hs, s);
+
+        // Every few rounds the dirty nodes are found by scan, not by sort
+        if (r % 4 == 3)
+        {
+            for (uint k = 0; k < s->liveCount / 10; ++k)
+                set(hs, s);
+        }
+
+        parallelSetThreadCount(1);
+        hierarchyUpdate(hs[0]);
+        parallelSetThreadCount(THREADS);
+        hierarchyUpdate(hs[1]);
+
+        checkHierarchy(hs[0], s);
+        checkHierarchy(hs[1], s);
+
+        CHECK(hs[0]->count == hs[1]->count);
+        CHECK(memcmp(hs[0]->ids, hs[1]->ids, hs[0]->count * sizeof *hs[0]->ids) == 0);
+        CHECK(memcmp(hs[0]->worlds, hs[1]->worlds, hs[0]->count * sizeof *hs[0]->worlds) == 0);
+    }
+
+    CHECK(s->liveCount > NODE_LIMIT / 4);
+    parallelSetThreadCount(1);
+
+    // Everything removed root by root leaves an empty hierarchy that still
+    // takes new nodes
+    while (hs[0]->count)
+    {
+        uint id = hs[0]->ids[0];
+        hierarchyRemove(hs[0], id);
+        hierarchyRemove(hs[1], id);
+    }
+
+    CHECK(hs[0]->count == 0 && hs[1]->count == 0);
+
+    memset(s, 0, sizeof *s);
+    for (uint k = 0; k < 100; ++k)
+        add(hs, s);
+
+    hierarchyUpdate(hs[0]);
+    hierarchyUpdate(hs[1]);
+    checkHierarchy(hs[0], s);
+    checkHierarchy(hs[1], s);
+
+    hierarchyDestroy(hs[0]);
+    hierarchyDestroy(hs[1]);
+    free(s);
+}
+
+int main(void)
+{
+    srand(16);
+
+    testEdits();
+
+    return testResult();
+}
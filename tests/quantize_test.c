@@ -0,0 +1,220 @@
+#include "maths.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Counts are odd so every kernel also runs its tail
+#define SWEEP_COUNT  200003
+#define NORMAL_COUNT 100001
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static float clampf(float x, float lo, float hi)
+{
+    return x < lo ? lo : x > hi ? hi : x;
+}
+
+// Every half goes back to itself through a float, NaNs stay NaN
+static void testHalfRoundTrip(void)
+{
+    float* f = malloc(65536 * sizeof *f);
+    ushort* h = malloc(65536 * sizeof *h);
+
+    for (uint i = 0; i < 65536; ++i)
+        f[i] = halfToFloat((ushort)i);
+
+    quantizeHalf(h, f, 65536);
+
+    uint wrong = 0;
+    for (uint i = 0; i < 65536; ++i)
+    {
+        bool nan = (i & 0x7c00) == 0x7c00 && (i & 0x3ff);
+        if (nan)
+            wrong += (h[i] & 0x7c00) != 0x7c00 || !(h[i] & 0x3ff) || (h[i] & 0x8000) != (i & 0x8000);
+        else
+            wrong += h[i] != i;
+    }
+    CHECK(wrong == 0);
+
+    free(f);
+    free(h);
+}
+
+// A half is the nearest one to its float when neither neighbour is closer,
+// on a tie the even mantissa wins
+static bool halfIsNearest(float f, ushort h)
+{
+    if ((h & 0x8000) != (signbit(f) ? 0x8000 : 0))
+        return 0;
+
+    ushort mag = h & 0x7fff;
+    double x = fabs((double)f);
+
+    if (x >= 65520.0)
+        return mag == 0x7c00;
+
+    if (mag >= 0x7c00)
+        return 0;
+
+    double d = fabs(halfToFloat(mag) - x);
+
+    if (mag > 0)
+    {
+        double below = fabs(halfToFloat(mag - 1) - x);
+        if (below < d || (below == d && (mag & 1)))
+            return 0;
+    }
+
+    if (mag < 0x7bff)
+    {
+        double above = fabs(halfToFloat(mag + 1) - x);
+        if (above < d || (above == d && (mag & 1)))
+            return 0;
+    }
+
+    return 1;
+}
+
+// Strided over every float bit pattern, NaNs excluded
+static void testHalfNearest(void)
+{
+    enum { CHUNK = 1 << 16 };
+    float* f = malloc(CHUNK * sizeof *f);
+    ushort* h = malloc(CHUNK * sizeof *h);
+    uint wrong = 0;
+
+    uint64_t bits = 0;
+    while (bits < UINT64_C(0x100000000))
+    {
+        uint n = 0;
+        for (; n < CHUNK && bits < UINT64_C(0x100000000); bits += 251)
+        {
+            uint32_t b = (uint32_t)bits;
+            memcpy(&f[n], &b, sizeof b);
+            if (!isnan(f[n]))
+                ++n;
+        }
+
+        quantizeHalf(h, f, n);
+
+        for (uint i = 0; i < n; ++i)
+            wrong += !halfIsNearest(f[i], h[i]);
+    }
+    CHECK(wrong == 0);
+
+    free(f);
+    free(h);
+}
+
+// The norm kernels against the clamped value scaled and rounded by lrintf
+static void testNorms(void)
+{
+    float* in = malloc(SWEEP_COUNT * sizeof *in);
+    v4* in4 = malloc(SWEEP_COUNT * sizeof *in4);
+    short* snorm = malloc(SWEEP_COUNT * sizeof *snorm);
+    uchar* unorm = malloc(SWEEP_COUNT * sizeof *unorm);
+    uint* packed = malloc(SWEEP_COUNT * sizeof *packed);
+
+    // Evenly over [-1.5, 1.5] so both clamps and every step are hit
+    for (uint i = 0; i < SWEEP_COUNT; ++i)
+        in[i] = -1.5f + 3.0f * i / (SWEEP_COUNT - 1);
+
+    for (uint i = 0; i < SWEEP_COUNT; ++i)
+        in4[i] = (v4){in[i], in[SWEEP_COUNT - 1 - i], randomf() * 1.5f, randomf() * 1.5f};
+
+    quantizeSnorm16(snorm, in, SWEEP_COUNT);
+    quantizeUnorm8(unorm, in, SWEEP_COUNT);
+    quantizeSnorm1010102(packed, in4, SWEEP_COUNT);
+
+    uint wrongSnorm = 0, wrongUnorm = 0, wrongPacked = 0;
+    for (uint i = 0; i < SWEEP_COUNT; ++i)
+    {
+        wrongSnorm += snorm[i] != lrintf(clampf(in[i], -1.0f, 1.0f) * 32767.0f);
+        wrongUnorm += unorm[i] != lrintf(clampf(in[i], 0.0f, 1.0f) * 255.0f);
+
+        uint x = (uint)lrintf(clampf(in4[i].x, -1.0f, 1.0f) * 511.0f) & 0x3ff;
+        uint y = (uint)lrintf(clampf(in4[i].y, -1.0f, 1.0f) * 511.0f) & 0x3ff;
+        uint z = (uint)lrintf(clampf(in4[i].z, -1.0f, 1.0f) * 511.0f) & 0x3ff;
+        uint w = (uint)lrintf(clampf(in4[i].w, -1.0f, 1.0f)) & 0x3;
+        wrongPacked += packed[i] != (x | y << 10 | z << 20 | w << 30);
+    }
+    CHECK(wrongSnorm == 0);
+    CHECK(wrongUnorm == 0);
+    CHECK(wrongPacked == 0);
+
+    free(in);
+    free(in4);
+    free(snorm);
+    free(unorm);
+    free(packed);
+}
+
+// Random unit normals plus the axes and the folds' edges decode within the
+// 0.01 degree bound documented on quantizeOctahedral
+static void testOctahedral(void)
+{
+    v3* normals = malloc(NORMAL_COUNT * sizeof *normals);
+    short* out = malloc(2 * NORMAL_COUNT * sizeof *out);
+
+    v3 edges[] = {
+        { 1.0f,  0.0f,  0.0f}, {-1.0f,  0.0f,  0.0f},
+        { 0.0f,  1.0f,  0.0f}, { 0.0f, -1.0f,  0.0f},
+        { 0.0f,  0.0f,  1.0f}, { 0.0f,  0.0f, -1.0f},
+        { 0.7071068f, 0.7071068f, 0.0f}, {-0.7071068f, 0.0f, -0.7071068f},
+        { 0.0f, -0.7071068f, -0.7071068f}, { 0.5773503f, -0.5773503f, -0.5773503f},
+    };
+    uint edgeCount = sizeof edges / sizeof *edges;
+
+    for (uint i = 0; i < NORMAL_COUNT; ++i)
+    {
+        if (i < edgeCount)
+        {
+            normals[i] = edges[i];
+            continue;
+        }
+
+        v3 n;
+        do n = (v3){randomf(), randomf(), randomf()};
+        while (v3Dot(n, n) < 1e-4f || v3Dot(n, n) > 1.0f);
+        normals[i] = v3NormTo(n);
+    }
+
+    quantizeOctahedral(out, normals, NORMAL_COUNT);
+
+    double worst = 0.0;
+    for (uint i = 0; i < NORMAL_COUNT; ++i)
+    {
+        v3 a = normals[i], b = octahedralDecode(out[2 * i], out[2 * i + 1]);
+
+        double cx = (double)a.y * b.z - (double)a.z * b.y;
+        double cy = (double)a.z * b.x - (double)a.x * b.z;
+        double cz = (double)a.x * b.y - (double)a.y * b.x;
+        double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+        double degrees = atan2(sqrt(cx * cx + cy * cy + cz * cz), dot) * 180.0 / PI;
+
+        if (degrees > worst)
+            worst = degrees;
+    }
+    CHECK(worst < 0.01);
+
+    free(normals);
+    free(out);
+}
+
+int main(void)
+{
+    srand(5);
+
+    testHalfRoundTrip();
+    testHalfNearest();
+    testNorms();
+    testOctahedral();
+
+    return testResult();
+}
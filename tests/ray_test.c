@@ -0,0 +1,166 @@
+#include "collision.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Enough boxes and spheres for the SIMD loops and a partial last register
+#define SHAPE_COUNT 1003
+#define RAY_COUNT   500
+#define MAX_T       100.0f
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+// Coordinates on a 0.5 grid, so rays and box faces often share a plane
+static float randomGrid(void)
+{
+    return (float)(rand() % 9 - 4) * 0.5f;
+}
+
+// Batch hits in a mask per shape, the batch output is sorted by t instead
+static void hitsToMask(const RayHit* hits, uint n, float* t, bool* hit)
+{
+    for (uint i = 0; i < SHAPE_COUNT; ++i)
+        hit[i] = 0;
+
+    for (uint k = 0; k < n; ++k)
+    {
+        hit[hits[k].index] = 1;
+        t[hits[k].index] = hits[k].t;
+    }
+}
+
+// A zero direction used to give 0 / 0 = NaN, which passed both range tests
+// in rayCastSphere and failed them in rayCastSpheres
+static void testZeroDirection(void)
+{
+    Ray still = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+    float t = -1.0f;
+
+    CHECK(!rayCastSphere(still, (Sphere){5.0f, 0.0f, 0.0f, 1.0f}, MAX_T, &t));
+    CHECK(rayCastSphere(still, (Sphere){0.5f, 0.0f, 0.0f, 1.0f}, MAX_T, &t) && t == 0.0f);
+
+    v4 spheres[4] = {{5.0f, 0.0f, 0.0f, 1.0f}, {0.5f, 0.0f, 0.0f, 1.0f}, {0.0f, 3.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f, 2.0f}};
+    v4Stream stream = v4StreamCreate(4);
+    v4StreamFromArray(&stream, spheres, 4);
+
+    RayHit hits[4];
+    uint n = rayCastSpheres(still, MAX_T, &stream, hits);
+
+    CHECK(n == 2);
+    CHECK(n == 2 && hits[0].t == 0.0f && hits[1].t == 0.0f);
+    CHECK(n == 2 && hits[0].index + hits[1].index == 4);
+
+    v4StreamDestroy(&stream);
+}
+
+// An axis the ray is parallel to, with the origin on one of the slab's
+// planes, used to make 0 * inf = NaN decide the result
+static void testParallelSlabs(void)
+{
+    AABB box = {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+    float t = -1.0f;
+
+    // Along z with x and y on the faces of the box
+    CHECK(rayCastAABB((Ray){{0.0f, 0.0f, -2.0f}, {0.0f, 0.0f, 1.0f}}, box, MAX_T, &t) && t == 2.0f);
+    CHECK(rayCastAABB((Ray){{1.0f, 1.0f, -2.0f}, {0.0f, 0.0f, 1.0f}}, box, MAX_T, &t) && t == 2.0f);
+    CHECK(!rayCastAABB((Ray){{1.5f, 0.5f, -2.0f}, {0.0f, 0.0f, 1.0f}}, box, MAX_T, &t));
+    CHECK(!rayCastAABB((Ray){{-0.5f, 0.5f, -2.0f}, {0.0f, 0.0f, 1.0f}}, box, MAX_T, &t));
+
+    Rect rect = {0.0f, 0.0f, 1.0f, 1.0f};
+
+    CHECK(lineOverlapsRect((Line){0.0f, -1.0f, 0.0f, 2.0f}, rect));
+    CHECK(lineOverlapsRect((Line){-1.0f, 1.0f, 2.0f, 1.0f}, rect));
+    CHECK(!lineOverlapsRect((Line){1.5f, -1.0f, 1.5f, 2.0f}, rect));
+    CHECK(!lineOverlapsRect((Line){-1.0f, -0.5f, 2.0f, -0.5f}, rect));
+}
+
+// rayCastAABBs and rayCastSpheres against the single shape tests, with
+// axis aligned rays starting on the grid the boxes are placed on
+static void testBatches(void)
+{
+    AABB* boxes   = malloc(SHAPE_COUNT * sizeof *boxes);
+    v3*   centres = malloc(SHAPE_COUNT * sizeof *centres);
+    v3*   extents = malloc(SHAPE_COUNT * sizeof *extents);
+    v4*   spheres = malloc(SHAPE_COUNT * sizeof *spheres);
+    float*  t   = malloc(SHAPE_COUNT * sizeof *t);
+    bool*   hit = malloc(SHAPE_COUNT * sizeof *hit);
+    RayHit* hits = malloc(SHAPE_COUNT * sizeof *hits);
+
+    for (uint i = 0; i < SHAPE_COUNT; ++i)
+    {
+        boxes[i]   = (AABB){randomGrid(), randomGrid(), randomGrid(), 0.5f + (rand() % 3) * 0.5f, 0.5f, 1.0f};
+        extents[i] = (v3){boxes[i].w * 0.5f, boxes[i].h * 0.5f, boxes[i].d * 0.5f};
+        centres[i] = (v3){boxes[i].x + extents[i].x, boxes[i].y + extents[i].y, boxes[i].z + extents[i].z};
+        spheres[i] = (v4){randomf() * 4.0f, randomf() * 4.0f, randomf() * 4.0f, 0.25f + fabsf(randomf())};
+    }
+
+    v3Stream centreStream = v3StreamCreate(SHAPE_COUNT), extentStream = v3StreamCreate(SHAPE_COUNT);
+    v4Stream sphereStream = v4StreamCreate(SHAPE_COUNT);
+    v3StreamFromArray(&centreStream, centres, SHAPE_COUNT);
+    v3StreamFromArray(&extentStream, extents, SHAPE_COUNT);
+    v4StreamFromArray(&sphereStream, spheres, SHAPE_COUNT);
+
+    uint wrongBoxes = 0, wrongSpheres = 0, boxHits = 0;
+
+    for (uint r = 0; r < RAY_COUNT; ++r)
+    {
+        // Every fourth ray is axis aligned or, for the spheres, doesn't move
+        v3 dir = {randomf(), randomf(), randomf()};
+        if (r % 4 == 0)
+            dir = r % 8 ? (v3){0.0f, 0.0f, 1.0f} : (v3){0.0f, 0.0f, 0.0f};
+
+        Ray ray = {{randomGrid(), randomGrid(), randomGrid() * 3.0f}, dir};
+        float single;
+
+        if (r % 8)
+        {
+            hitsToMask(hits, rayCastAABBs(ray, MAX_T, &centreStream, &extentStream, hits), t, hit);
+
+            for (uint i = 0; i < SHAPE_COUNT; ++i)
+            {
+                bool expected = rayCastAABB(ray, boxes[i], MAX_T, &single);
+                boxHits += expected;
+                wrongBoxes += expected != hit[i] || (expected && fabsf(single - t[i]) > 1e-5f * (1.0f + single));
+            }
+        }
+
+        hitsToMask(hits, rayCastSpheres(ray, MAX_T, &sphereStream, hits), t, hit);
+
+        for (uint i = 0; i < SHAPE_COUNT; ++i)
+        {
+            Sphere s = {spheres[i].x, spheres[i].y, spheres[i].z, spheres[i].w};
+            bool expected = rayCastSphere(ray, s, MAX_T, &single);
+            wrongSpheres += expected != hit[i] || (expected && fabsf(single - t[i]) > 1e-4f * (1.0f + single));
+        }
+    }
+
+    CHECK(boxHits > 0);
+    CHECK(wrongBoxes == 0);
+    CHECK(wrongSpheres == 0);
+
+    v3StreamDestroy(&centreStream);
+    v3StreamDestroy(&extentStream);
+    v4StreamDestroy(&sphereStream);
+    free(boxes);
+    free(centres);
+    free(extents);
+    free(spheres);
+    free(t);
+    free(hit);
+    free(hits);
+}
+
+int main(void)
+{
+    srand(5);
+
+    testZeroDirection();
+    testParallelSlabs();
+    testBatches();
+
+    return testResult();
+}
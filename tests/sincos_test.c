@@ -0,0 +1,65 @@
+#include "maths.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SINCOS_COUNT 1000003
+
+// Max absolute error of sinCosFast against double sin / cos over
+// [-range, range], and whether sinCosBatch matched it bit for bit
+static double sinCosError(float range, bool* matches)
+{
+    float* x  = malloc(SINCOS_COUNT * sizeof *x);
+    float* s  = malloc(SINCOS_COUNT * sizeof *s);
+    float* c  = malloc(SINCOS_COUNT * sizeof *c);
+
+    for (uint i = 0; i < SINCOS_COUNT; ++i)
+        x[i] = -range + 2.0f * range * i / (SINCOS_COUNT - 1);
+
+    sinCosBatch(x, s, c, SINCOS_COUNT);
+
+    double worst = 0.0;
+    *matches = 1;
+
+    for (uint i = 0; i < SINCOS_COUNT; ++i)
+    {
+        float fs, fc;
+        sinCosFast(x[i], &fs, &fc);
+
+        if (memcmp(&fs, &s[i], sizeof fs) || memcmp(&fc, &c[i], sizeof fc))
+            *matches = 0;
+
+        double es = fabs(fs - sin((double)x[i]));
+        double ec = fabs(fc - cos((double)x[i]));
+        worst = fmax(worst, fmax(es, ec));
+    }
+
+    free(x);
+    free(s);
+    free(c);
+    return worst;
+}
+
+int main(void)
+{
+    // The bounds documented on sinCosFast, with a little room for the
+    // samples landing on different worst cases
+    bool matches;
+
+    CHECK(sinCosError(PI_4, &matches) < 1e-7);
+    CHECK(matches);
+
+    CHECK(sinCosError(8192.0f, &matches) < 1e-7);
+    CHECK(matches);
+
+    CHECK(sinCosError(65536.0f, &matches) < 1e-6);
+    CHECK(matches);
+
+    float s, c;
+    sinCosFast(0.0f, &s, &c);
+    CHECK(s == 0.0f && c == 1.0f);
+
+    return testResult();
+}
@@ -0,0 +1,303 @@
+#include "animation.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Past SKIN_PARALLEL several times over and not a multiple of any
+// SIMD_WIDTH, so the threaded split and the partial last register are both
+// covered
+#define VERTEX_COUNT 100003
+#define JOINT_COUNT  64
+#define TOLERANCE    1e-5f
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static float maxError(const v3* a, const double* b, uint n)
+{
+    float error = 0.0f;
+
+    for (uint i = 0; i < n; ++i)
+    {
+        error = fmaxf(error, fabsf(a[i].x - (float)b[i * 3 + 0]) / (1.0f + fabsf((float)b[i * 3 + 0])));
+        error = fmaxf(error, fabsf(a[i].y - (float)b[i * 3 + 1]) / (1.0f + fabsf((float)b[i * 3 + 1])));
+        error = fmaxf(error, fabsf(a[i].z - (float)b[i * 3 + 2]) / (1.0f + fabsf((float)b[i * 3 + 2])));
+    }
+
+    return error;
+}
+
+//-----------------------------
+// ~Reference
+
+// The blended matrix in doubles, normals renormalized after it
+static void referenceLinear(const m4x3* palette, const ushort* joints, const v4* weights,
+                            const v3* positions, const v3* normals, double* outPositions, double* outNormals, uint n)
+{
+    for (uint i = 0; i < n; ++i)
+    {
+        double m[12] = {0.0};
+        const float* w = &weights[i].x;
+
+        for (uint k = 0; k < 4; ++k)
+        {
+            const float* p = &palette[joints[i * 4 + k]].m00;
+
+            for (uint c = 0; c < 12; ++c)
+                m[c] += (double)w[k] * p[c];
+        }
+
+        double x = positions[i].x, y = positions[i].y, z = positions[i].z;
+        outPositions[i * 3 + 0] = m[0] * x + m[1] * y + m[2] * z + m[3];
+        outPositions[i * 3 + 1] = m[4] * x + m[5] * y + m[6] * z + m[7];
+        outPositions[i * 3 + 2] = m[8] * x + m[9] * y + m[10] * z + m[11];
+
+        x = normals[i].x, y = normals[i].y, z = normals[i].z;
+        double nx = m[0] * x + m[1] * y + m[2] * z;
+        double ny = m[4] * x + m[5] * y + m[6] * z;
+        double nz = m[8] * x + m[9] * y + m[10] * z;
+        double len = sqrt(nx * nx + ny * ny + nz * nz);
+
+        outNormals[i * 3 + 0] = nx / len;
+        outNormals[i * 3 + 1] = ny / len;
+        outNormals[i * 3 + 2] = nz / len;
+    }
+}
+
+// v + 2 * cross(r, cross(r, v) + w * v) with r the unit real part
+static void rotate(const double* r, const double* v, double* out)
+{
+    double c[3] = {
+        r[1] * v[2] - r[2] * v[1] + r[3] * v[0],
+        r[2] * v[0] - r[0] * v[2] + r[3] * v[1],
+        r[0] * v[1] - r[1] * v[0] + r[3] * v[2],
+    };
+
+    out[0] = v[0] + 2.0 * (r[1] * c[2] - r[2] * c[1]);
+    out[1] = v[1] + 2.0 * (r[2] * c[0] - r[0] * c[2]);
+    out[2] = v[2] + 2.0 * (r[0] * c[1] - r[1] * c[0]);
+}
+
+// Every joint flipped onto the first one's hemisphere, the sum normalized,
+// then the rotation followed by the translation 2 * dual * conjugate(real)
+static void referenceDualQuat(const DualQuat* palette, const ushort* joints, const v4* weights,
+                              const v3* positions, const v3* normals, double* outPositions, double* outNormals, uint n)
+{
+    for (uint i = 0; i < n; ++i)
+    {
+        double b[8] = {0.0};
+        const float* w = &weights[i].x;
+        const float* first = &palette[joints[i * 4]].real.x;
+
+        for (uint k = 0; k < 4; ++k)
+        {
+            const float* q = &palette[joints[i * 4 + k]].real.x;
+            double dot = (double)first[0] * q[0] + (double)first[1] * q[1] + (double)first[2] * q[2] + (double)first[3] * q[3];
+            double s = dot < 0.0 ? -w[k] : w[k];
+
+            for (uint c = 0; c < 8; ++c)
+                b[c] += s * q[c];
+        }
+
+        double len = sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2] + b[3] * b[3]);
+        for (uint c = 0; c < 8; ++c)
+            b[c] /= len;
+
+        const double* r = b;
+        const double* d = b + 4;
+        double t[3] = {
+            2.0 * (r[3] * d[0] - d[3] * r[0] + r[1] * d[2] - r[2] * d[1]),
+            2.0 * (r[3] * d[1] - d[3] * r[1] + r[2] * d[0] - r[0] * d[2]),
+            2.0 * (r[3] * d[2] - d[3] * r[2] + r[0] * d[1] - r[1] * d[0]),
+        };
+
+        double p[3] = {positions[i].x, positions[i].y, positions[i].z}, q[3];
+        rotate(r, p, q);
+
+        outPositions[i * 3 + 0] = q[0] + t[0];
+        outPositions[i * 3 + 1] = q[1] + t[1];
+        outPositions[i * 3 + 2] = q[2] + t[2];
+
+        double nrm[3] = {normals[i].x, normals[i].y, normals[i].z};
+        rotate(r, nrm, outNormals + i * 3);
+    }
+}
+
+//-----------------------------
+// ~Tests
+
+typedef struct Mesh
+{
+    v3*     positions;
+    v3*     normals;
+    ushort* joints;
+    v4*     weights;
+} Mesh;
+
+// 1 to 4 joints per vertex cycling, the unused slots with weight 0, or a
+// single joint in every vertex
+static void setWeights(Mesh* mesh, bool single)
+{
+    for (uint i = 0; i < VERTEX_COUNT; ++i)
+    {
+        uint used = single ? 1 : 1 + i % 4;
+        float w[4] = {0.0f, 0.0f, 0.0f, 0.0f}, sum = 0.0f;
+
+        for (uint k = 0; k < 4; ++k)
+        {
+            mesh->joints[i * 4 + k] = (ushort)(rand() % JOINT_COUNT);
+
+            if (k < used)
+            {
+                w[k] = rand() / (float)RAND_MAX + 0.01f;
+                sum += w[k];
+            }
+        }
+
+        mesh->weights[i] = (v4){w[0] / sum, w[1] / sum, w[2] / sum, w[3] / sum};
+    }
+}
+
+static void testSkinning(void)
+{
+    m4x3     scaled[JOINT_COUNT], rigid[JOINT_COUNT];
+    DualQuat dualQuats[JOINT_COUNT];
+
+    // Scale only goes into the linear palette, dual quaternions drop it
+    for (uint j = 0; j < JOINT_COUNT; ++j)
+    {
+        TRS trs = {{randomf() * 5.0f, randomf() * 5.0f, randomf() * 5.0f}, quatNormTo((quat){randomf(), randomf(), randomf(), randomf()}), {1.0f, 1.0f, 1.0f}};
+        rigid[j]     = trsToM4x3(trs);
+        dualQuats[j] = dualQuatFromTRS(trs);
+
+        trs.scale = (v3){1.0f + randomf() * 0.5f, 1.0f + randomf() * 0.25f, 1.0f};
+        scaled[j] = trsToM4x3(trs);
+    }
+
+    Mesh mesh = {
+        malloc(VERTEX_COUNT * sizeof *mesh.positions),
+        malloc(VERTEX_COUNT * sizeof *mesh.normals),
+        malloc(VERTEX_COUNT * 4 * sizeof *mesh.joints),
+        malloc(VERTEX_COUNT * sizeof *mesh.weights),
+    };
+
+    v3* positions  = malloc(VERTEX_COUNT * sizeof *positions);
+    v3* normals    = malloc(VERTEX_COUNT * sizeof *normals);
+    v3* positions2 = malloc(VERTEX_COUNT * sizeof *positions2);
+    v3* normals2   = malloc(VERTEX_COUNT * sizeof *normals2);
+    double* refPositions = malloc(VERTEX_COUNT * 3 * sizeof *refPositions);
+    double* refNormals   = malloc(VERTEX_COUNT * 3 * sizeof *refNormals);
+
+    for (uint i = 0; i < VERTEX_COUNT; ++i)
+    {
+        mesh.positions[i] = (v3){randomf(), randomf(), randomf()};
+        mesh.normals[i]   = v3NormTo((v3){randomf(), randomf(), randomf() + 2.0f});
+    }
+
+    setWeights(&mesh, 0);
+    parallelSetThreshold(256);
+
+    // Against the double precision references, on one thread
+    parallelSetThreadCount(1);
+
+    skinLinear(scaled, mesh.joints, mesh.weights, mesh.positions, mesh.normals, positions, normals, VERTEX_COUNT);
+    referenceLinear(scaled, mesh.joints, mesh.weights, mesh.positions, mesh.normals, refPositions, refNormals, VERTEX_COUNT);
+    CHECK(maxError(positions, refPositions, VERTEX_COUNT) < TOLERANCE);
+    CHECK(maxError(normals, refNormals, VERTEX_COUNT) < TOLERANCE);
+
+    skinDualQuat(dualQuats, mesh.joints, mesh.weights, mesh.positions, mesh.normals, positions2, normals2, VERTEX_COUNT);
+    referenceDualQuat(dualQuats, mesh.joints, mesh.weights, mesh.positions, mesh.normals, refPositions, refNormals, VERTEX_COUNT);
+    CHECK(maxError(positions2, refPositions, VERTEX_COUNT) < TOLERANCE);
+    CHECK(maxError(normals2, refNormals, VERTEX_COUNT) < TOLERANCE);
+
+    // The same bits on several threads, in place, and without normals
+    v3* threaded        = malloc(VERTEX_COUNT * sizeof *threaded);
+    v3* threadedNormals = malloc(VERTEX_COUNT * sizeof *threadedNormals);
+    parallelSetThreadCount(4);
+
+    skinLinear(scaled, mesh.joints, mesh.weights, mesh.positions, mesh.normals, threaded, threadedNormals, VERTEX_COUNT);
+    CHECK(memcmp(threaded, positions, VERTEX_COUNT * sizeof *threaded) == 0);
+    CHECK(memcmp(threadedNormals, normals, VERTEX_COUNT * sizeof *threadedNormals) == 0);
+
+    memcpy(threaded, mesh.positions, VERTEX_COUNT * sizeof *threaded);
+    memcpy(threadedNormals, mesh.normals, VERTEX_COUNT * sizeof *threadedNormals);
+    skinDualQuat(dualQuats, mesh.joints, mesh.weights, threaded, threadedNormals, threaded, threadedNormals, VERTEX_COUNT);
+    CHECK(memcmp(threaded, positions2, VERTEX_COUNT * sizeof *threaded) == 0);
+    CHECK(memcmp(threadedNormals, normals2, VERTEX_COUNT * sizeof *threadedNormals) == 0);
+
+    skinLinear(scaled, mesh.joints, mesh.weights, mesh.positions, NULL, threaded, NULL, VERTEX_COUNT);
+    CHECK(memcmp(threaded, positions, VERTEX_COUNT * sizeof *threaded) == 0);
+
+    // A single rigid joint per vertex is the same transform either way
+    setWeights(&mesh, 1);
+
+    skinLinear(rigid, mesh.joints, mesh.weights, mesh.positions, mesh.normals, positions, normals, VERTEX_COUNT);
+    skinDualQuat(dualQuats, mesh.joints, mesh.weights, mesh.positions, mesh.normals, positions2, normals2, VERTEX_COUNT);
+
+    for (uint i = 0; i < VERTEX_COUNT; ++i)
+    {
+        refPositions[i * 3 + 0] = positions2[i].x;
+        refPositions[i * 3 + 1] = positions2[i].y;
+        refPositions[i * 3 + 2] = positions2[i].z;
+        refNormals[i * 3 + 0] = normals2[i].x;
+        refNormals[i * 3 + 1] = normals2[i].y;
+        refNormals[i * 3 + 2] = normals2[i].z;
+    }
+
+    CHECK(maxError(positions, refPositions, VERTEX_COUNT) < TOLERANCE);
+    CHECK(maxError(normals, refNormals, VERTEX_COUNT) < TOLERANCE);
+
+    parallelSetThreadCount(1);
+
+    free(mesh.positions);
+    free(mesh.normals);
+    free(mesh.joints);
+    free(mesh.weights);
+    free(positions);
+    free(normals);
+    free(positions2);
+    free(normals2);
+    free(refPositions);
+    free(refNormals);
+    free(threaded);
+    free(threadedNormals);
+}
+
+// dualQuatFromM4x3 recovers the rotation and translation of a scaled
+// matrix, up to the sign of the whole dual quaternion
+static void testDualQuatFromM4x3(void)
+{
+    uint wrong = 0;
+
+    for (uint i = 0; i < 1000; ++i)
+    {
+        TRS trs = {{randomf() * 5.0f, randomf() * 5.0f, randomf() * 5.0f}, quatNormTo((quat){randomf(), randomf(), randomf(), randomf()}), {1.0f, 1.0f, 1.0f}};
+        DualQuat expected = dualQuatFromTRS(trs);
+
+        trs.scale = (v3){1.0f + fabsf(randomf()), 0.5f + fabsf(randomf()), 2.0f};
+        DualQuat got = dualQuatFromM4x3(trsToM4x3(trs));
+
+        const float* e = &expected.real.x;
+        const float* g = &got.real.x;
+        float sign = e[0] * g[0] + e[1] * g[1] + e[2] * g[2] + e[3] * g[3] < 0.0f ? -1.0f : 1.0f;
+
+        for (uint c = 0; c < 8; ++c)
+            wrong += fabsf(g[c] * sign - e[c]) > 1e-4f * (1.0f + fabsf(e[c]));
+    }
+
+    CHECK(wrong == 0);
+}
+
+int main(void)
+{
+    srand(18);
+
+    testSkinning();
+    testDualQuatFromM4x3();
+
+    return testResult();
+}
@@ -0,0 +1,38 @@
+#ifndef MODULE_TEST_H
+#define MODULE_TEST_H
+
+#include <stdio.h>
+
+//-------------------------------------------------------------
+// Definitions
+//-------------------------------------------------------------
+
+// Each test is its own executable, CHECK logs a failure and carries on so
+// one run reports every broken case. main returns testResult().
+
+static int testFailures = 0;
+
+#define CHECK(cond_) testCheck((cond_) != 0, #cond_, __FILE__, __LINE__)
+
+//-------------------------------------------------------------
+// Prototypes
+//-------------------------------------------------------------
+
+static inline int testCheck(int ok, const char* expr, const char* file, int line)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "[%10s:%3d] [FAILED] %s\n", file, line, expr);
+        ++testFailures;
+    }
+    return ok;
+}
+
+static inline int testResult(void)
+{
+    if (testFailures)
+        fprintf(stderr, "%d checks failed\n", testFailures);
+    return testFailures != 0;
+}
+
+#endif // MODULE_TEST_H
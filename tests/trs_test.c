@@ -0,0 +1,160 @@
+#include "maths.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Enough for the batches to take their SIMD loops, a scalar tail and, with
+// the threshold below, several threads
+#define TRS_COUNT 100003
+
+static float randomf(void)
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static bool nearlyEqual(const float* a, const float* b, uint n, float tolerance)
+{
+    for (uint i = 0; i < n; ++i)
+        if (fabsf(a[i] - b[i]) > tolerance * (1.0f + fabsf(b[i])))
+            return 0;
+    return 1;
+}
+
+// trsToM4, trsToM4x3 and their batches against quatToM4Batch, which they
+// are documented to match bit for bit
+static void testTrs(void)
+{
+    TRS*  in = malloc(TRS_COUNT * sizeof *in);
+    quat* r  = malloc(TRS_COUNT * sizeof *r);
+    v3*   t  = malloc(TRS_COUNT * sizeof *t);
+    v3*   s  = malloc(TRS_COUNT * sizeof *s);
+    m4*   expected   = malloc(TRS_COUNT * sizeof *expected);
+    m4x3* expected43 = malloc(TRS_COUNT * sizeof *expected43);
+    m4*   out   = malloc(TRS_COUNT * sizeof *out);
+    m4x3* out43 = malloc(TRS_COUNT * sizeof *out43);
+
+    for (uint i = 0; i < TRS_COUNT; ++i)
+    {
+        r[i] = quatNormTo((quat){randomf(), randomf(), randomf(), randomf()});
+        t[i] = (v3){randomf() * 100.0f, randomf(), randomf()};
+        s[i] = (v3){randomf() * 3.0f, randomf(), randomf() + 2.0f};
+        in[i] = (TRS){t[i], r[i], s[i]};
+    }
+
+    quatToM4Batch(r, t, s, expected, TRS_COUNT);
+
+    for (uint i = 0; i < TRS_COUNT; ++i)
+        expected43[i] = m4x3FromM4(expected[i]);
+
+    uint single = 0, single43 = 0;
+    for (uint i = 0; i < TRS_COUNT; ++i)
+    {
+        m4   a = trsToM4(in[i]);
+        m4x3 b = trsToM4x3(in[i]);
+        single   += memcmp(&a, &expected[i], sizeof a) != 0;
+        single43 += memcmp(&b, &expected43[i], sizeof b) != 0;
+    }
+    CHECK(single == 0);
+    CHECK(single43 == 0);
+
+    uint threads[] = {1, 4};
+    for (uint k = 0; k < sizeof threads / sizeof *threads; ++k)
+    {
+        parallelSetThreadCount(threads[k]);
+        parallelSetThreshold(1000);
+
+        memset(out, 0, TRS_COUNT * sizeof *out);
+        memset(out43, 0, TRS_COUNT * sizeof *out43);
+        trsToM4Batch(in, out, TRS_COUNT);
+        trsToM4x3Batch(in, out43, TRS_COUNT);
+
+        CHECK(memcmp(out, expected, TRS_COUNT * sizeof *out) == 0);
+        CHECK(memcmp(out43, expected43, TRS_COUNT * sizeof *out43) == 0);
+    }
+    parallelSetThreadCount(1);
+
+    m4 identity = m4Identity(), fromIdentity = trsToM4(trsIdentity());
+    CHECK(memcmp(&identity, &fromIdentity, sizeof identity) == 0);
+
+    free(in);
+    free(r);
+    free(t);
+    free(s);
+    free(expected);
+    free(expected43);
+    free(out);
+    free(out43);
+}
+
+// m4Transform is m * translate * rotate * scale, it used to apply m three
+// times in the order scale, rotate, translate
+static void testM4Transform(void)
+{
+    m4 m = m4Transform(m4Identity(), (v3){1.0f, 2.0f, 3.0f}, (v3){0.0f, 0.0f, 1.0f}, (float)PI_2, (v3){2.0f, 3.0f, 4.0f});
+    v3 p = m4Mulv3(m, (v3){1.0f, 0.0f, 0.0f}, 1.0f);
+
+    // Scaled to (2, 0, 0), rotated to (0, 2, 0) and moved by (1, 2, 3)
+    CHECK(fabsf(p.x - 1.0f) < 1e-6f);
+    CHECK(fabsf(p.y - 4.0f) < 1e-6f);
+    CHECK(fabsf(p.z - 3.0f) < 1e-6f);
+
+    for (uint i = 0; i < 1000; ++i)
+    {
+        TRS base = {{randomf(), randomf(), randomf()}, quatNormTo((quat){randomf(), randomf(), randomf(), randomf()}), {1.0f, 2.0f, 0.5f}};
+        v3 t = {randomf() * 10.0f, randomf(), randomf()};
+        v3 axis = {randomf(), randomf(), randomf() + 2.0f};
+        v3 s = {randomf() + 2.0f, randomf() - 2.0f, randomf()};
+        float angle = randomf() * 7.0f;
+
+        m = trsToM4(base);
+        m4 a = m4Transform(m, t, axis, angle, s);
+        m4 b = m4Scale(m4Rotate(m4Translate(m, t), axis, angle), s);
+
+        if (!CHECK(nearlyEqual(&a.m00, &b.m00, 16, 1e-5f)))
+            break;
+    }
+}
+
+// m3Transform is m * translate * rotate * scale and m3Scale scales the x and
+// y columns, m12 but not m21
+static void testM3Transform(void)
+{
+    m3 m = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f};
+    m3 s = m3Scale(m, (v2){10.0f, 100.0f});
+    m3 expected = {10.0f, 200.0f, 3.0f, 40.0f, 500.0f, 6.0f, 70.0f, 800.0f, 9.0f};
+    CHECK(memcmp(&s, &expected, sizeof s) == 0);
+
+    m = m3Transform(m3Identity(), (v2){1.0f, 2.0f}, (float)PI_2, (v2){2.0f, 3.0f});
+    v3 p = m3Mulv3(m, (v3){1.0f, 0.0f, 1.0f});
+
+    CHECK(fabsf(p.x - 1.0f) < 1e-6f);
+    CHECK(fabsf(p.y - 4.0f) < 1e-6f);
+    CHECK(p.z == 1.0f);
+
+    for (uint i = 0; i < 1000; ++i)
+    {
+        m3 base = m3Rotate(m3Translate(m3Identity(), (v2){randomf(), randomf()}), randomf());
+        v2 t = {randomf(), randomf()};
+        v2 sc = {randomf() + 2.0f, randomf() - 2.0f};
+        float angle = randomf() * 3.0f;
+
+        m3 a = m3Transform(base, t, angle, sc);
+        m3 b = m3ScaleY(m3ScaleX(m3Rotate(m3Translate(base, t), angle), sc.x), sc.y);
+
+        if (!CHECK(nearlyEqual(&a.m00, &b.m00, 9, 1e-6f)))
+            break;
+    }
+}
+
+int main(void)
+{
+    srand(3);
+
+    testTrs();
+    testM4Transform();
+    testM3Transform();
+
+    return testResult();
+}